@@ -0,0 +1,51 @@
+/**
+ * @file 	compress_wav.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * Example converting WAV files to losslessly compressed files and back.
+ * Files with extension .iac are treated as compressed, all others as WAV.
+ */
+
+#include "iimavlib/WaveSink.h"
+#include "iimavlib/WaveSource.h"
+#include "iimavlib/CompressedSink.h"
+#include "iimavlib/CompressedSource.h"
+#include "iimavlib/Utils.h"
+#include <string>
+
+namespace {
+bool is_compressed(const std::string& filename)
+{
+	return filename.size() > 4 && filename.substr(filename.size() - 4) == ".iac";
+}
+}
+
+int main(int argc, char** argv)
+{
+	using namespace iimavlib;
+	/* ******************************************************************
+	 *                Process command line parameters
+	 ****************************************************************** */
+	if (argc<3) {
+		logger[log_level::fatal] << "Not enough parameters. Specify the input and output files.";
+		return 1;
+	}
+
+	const std::string filename (argv[1]);
+	const std::string filename2 (argv[2]);
+	logger[log_level::debug] << "Converting " << filename << " -> " << filename2;
+
+	/* ******************************************************************
+	 *                Create and run the filter chain
+	 ****************************************************************** */
+	pAudioSink chain;
+	if (is_compressed(filename)) {
+		if (is_compressed(filename2)) chain = filter_chain<CompressedSource>(filename).add<CompressedSink>(filename2).sink();
+		else chain = filter_chain<CompressedSource>(filename).add<WaveSink>(filename2).sink();
+	} else {
+		if (is_compressed(filename2)) chain = filter_chain<WaveSource>(filename).add<CompressedSink>(filename2).sink();
+		else chain = filter_chain<WaveSource>(filename).add<WaveSink>(filename2).sink();
+	}
+	chain->run();
+}
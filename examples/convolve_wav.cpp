@@ -0,0 +1,58 @@
+/*
+ * convolve_wav.cpp
+ *
+ *  Created on: 28.10.2026
+ *      Author: neneko
+ */
+
+
+#include "iimavlib/WaveSink.h"
+#include "iimavlib/WaveSource.h"
+#include "iimavlib/filters/ConvolutionReverb.h"
+#include "iimavlib/Utils.h"
+#include <string>
+
+
+int main(int argc, char** argv)
+try
+{
+	using namespace iimavlib;
+	/* ******************************************************************
+	 *                Process command line parameters
+	 ****************************************************************** */
+	if (argc<4) {
+		logger[log_level::fatal] << "Not enough parameters. Specify the in wave file, the impulse response and the out wave file.";
+		return 1;
+	}
+
+	const std::string filename (argv[1]);
+	const std::string impulse_response (argv[2]);
+	const std::string filename2 (argv[3]);
+	const double wet = argc > 4 ? simple_cast<double>(argv[4]) : 0.3;
+	const double dry = argc > 5 ? simple_cast<double>(argv[5]) : 1.0;
+	logger[log_level::debug] << "Convolving " << filename << " with " << impulse_response << " -> " << filename2;
+
+	/* ******************************************************************
+	 *                Create and run the filter chain
+	 ****************************************************************** */
+
+	pAudioSink chain = filter_chain<WaveSource>(filename)
+						.add<ConvolutionReverb>(impulse_response, wet, dry)
+						.add<WaveSink>(filename2)
+						.sink();
+	chain->run();
+
+	const auto reverb = std::dynamic_pointer_cast<ConvolutionReverb>(chain->get_child(0));
+	if (reverb) {
+		const convolution_stats_t stats = reverb->get_stats();
+		logger[log_level::info] << "Latency " << stats.latency << " samples, " << stats.partitions << " partitions in "
+				<< stats.stages << " sizes, average load " << stats.average_load * 100.0 << "%, peak load "
+				<< stats.peak_load * 100.0 << "%";
+	}
+}
+catch (std::exception& e)
+{
+	using namespace iimavlib;
+	logger[log_level::fatal] << "Convolution failed: " << e.what();
+	return 1;
+}
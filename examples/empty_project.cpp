@@ -34,7 +34,8 @@ public:
 	{
 		const audio_params_t& params = get_params();
 		cache_size_ = static_cast<size_t>(time_ * convert_rate_to_int(params.rate));
-		cache_size_ = static_cast<size_t>(pow(2, ceil(log2(cache_size_))) * 2);
+		// Real FFT needs an even number of samples, any other size is fine
+		cache_size_ = std::max<size_t>(2, cache_size_ + (cache_size_ & 1));
 		logger[log_level::info] << "Cache size: " << cache_size_;
 		sample_cache_.resize(cache_size_);
 		barwidth = 40;
@@ -113,25 +114,25 @@ private:
 		complexarray_t<float> coefficient_array;
 		{
 			std::unique_lock<std::mutex> lock(mutex_);
-			coefficient_array = fft.FFT1D(sample_cache_.begin(), sample_cache_.end());
+			fft.RFFT1D(sample_cache_.begin(), sample_cache_.end(), coefficient_array);
 			time_elapsed += time_;
 
 
 		}
 
-		const auto unique_coefficients = (coefficient_array.size() + 1) / 2;
+		// Only the first half of the spectrum is computed (without the Nyquist bin)
+		const auto unique_coefficients = coefficient_array.size() - 1;
+
+		// Brightness of all the coefficients
+		assign(levels_, abs(lazy(coefficient_array)) * (100.0f * 255.0f * magic_constant));
 
 
 		for (int y = 0; y < height_; ++y) {
 			// Calculate the index of coefficient to display at this frequency
 			const size_t coefficient_number = y * unique_coefficients / height_;
 
-			// Get value for the coefficient
-			auto coefficient = std::abs(coefficient_array[coefficient_number]) * magic_constant;
-			coefficient *= 100;
-
-			//auto yycol = static_cast<int>(255 * (1.0f - coefficient));
-			auto yycol = static_cast<int>(255 * (coefficient));
+			// Get brightness for the coefficient
+			auto yycol = static_cast<int>(levels_[coefficient_number]);
 
 			std::vector<int> colr = { 1, 0 , 0 };
 			//if (yycol < (255 / 3)) {
@@ -197,6 +198,8 @@ private:
 	float time_elapsed;
 	float whole;
 	float magic_constant;
+	/// Brightness of the coefficients, used only by the drawing thread
+	std::vector<float> levels_;
 
 
 	AudioFFT<float> fft;
@@ -0,0 +1,127 @@
+/**
+ * @file 	fft_benchmark.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * Benchmark comparing the iterative FFT (fft_plan_t) with the original recursive implementation
+ * and with the real-input transform (real_fft_plan_t).
+ * Throughput is reported in GFLOPS, counting 5*N*log2(N) operations per complex transform of size N.
+ * Sizes that aren't powers of 2 (mixed radix and Bluestein's algorithm) are compared with the next power of 2.
+ */
+
+#include "iimavlib/FFT.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+using namespace iimavlib;
+
+/**
+ * The recursive FFT previously used by FFT<T>::FFT1D, kept for comparison.
+ * It allocates temporary arrays and computes twiddles at every level.
+ */
+template<class T>
+complexarray_t<T> recursive_fft(const simplearray_t<T>& ab)
+{
+	const auto N = ab.size();
+	const T pi = 4 * std::atan(static_cast<T>(1));
+	if (N == 1) return complexarray_t<T>(1, ab[0]);
+	simplearray_t<T> samples_odd;
+	samples_odd.reserve(N / 2);
+	for(auto i = 0u; i < N; i += 2)
+		samples_odd.push_back(ab[i]);
+	auto coefficients_odd = recursive_fft(samples_odd);
+
+	simplearray_t<T> samples_even;
+	samples_even.reserve(N / 2);
+	for(auto i = 1u; i < N; i += 2)
+		samples_even.push_back(ab[i]);
+	auto coefficients_even = recursive_fft(samples_even);
+
+	complexarray_t<T> f;
+	for(auto n = 0u; n < N; n++) {
+		f.push_back(std::exp(pi * n / N * std::complex<T>(0, -2)));
+	}
+
+	complexarray_t<T> result(N, 0);
+	for(auto i = 0u; i < N / 2; ++i) {
+		result[i] = coefficients_odd[i] + f[i] * coefficients_even[i];
+		result[i + N / 2] = coefficients_odd[i] + f[i + N / 2] * coefficients_even[i];
+	}
+	return result;
+}
+
+/// Runs @em func repeatedly for at least 200ms and returns average time of a single run in microseconds
+template<class F>
+double measure(F func)
+{
+	using clock = std::chrono::steady_clock;
+	size_t runs = 0;
+	const auto start = clock::now();
+	auto now = start;
+	while (now - start < std::chrono::milliseconds(200)) {
+		for (int i = 0; i < 4; ++i) func();
+		runs += 4;
+		now = clock::now();
+	}
+	return std::chrono::duration<double, std::micro>(now - start).count() / runs;
+}
+}
+
+int main()
+{
+	std::cout << "Vectorized butterflies: " << fft_plan_t<float>::vector_extension() << "\n";
+	std::cout << std::setw(8) << "size" << std::setw(16) << "recursive [us]" << std::setw(16) << "plan [us]"
+			<< std::setw(10) << "speedup" << std::setw(10) << "GFLOPS" << std::setw(12) << "real [us]" << std::setw(12) << "max error" << "\n";
+	for (size_t size = 512; size <= 65536; size *= 2) {
+		simplearray_t<float> signal(size);
+		for (auto& s: signal) s = static_cast<float>(std::rand()) / RAND_MAX - 0.5f;
+
+		complexarray_t<float> reference;
+		const double recursive_time = measure([&](){ reference = recursive_fft(signal); });
+
+		const fft_plan_t<float> plan(size);
+		complexarray_t<float> result(size), work(plan.work_size());
+		const double plan_time = measure([&](){ plan.transform(signal.data(), result.data(), work.data()); });
+
+		const real_fft_plan_t<float> real_plan(size);
+		complexarray_t<float> real_result(real_plan.bins()), real_work(real_plan.work_size());
+		const double real_time = measure([&](){ real_plan.transform(signal.data(), real_result.data(), real_work.data()); });
+
+		float error = 0.0f;
+		for (size_t i = 0; i < size; ++i) error = std::max(error, std::abs(result[i] - reference[i]));
+		for (size_t i = 0; i < real_result.size(); ++i) error = std::max(error, std::abs(real_result[i] - reference[i]));
+		std::cout << std::setw(8) << size << std::setw(16) << std::fixed << std::setprecision(1) << recursive_time
+				<< std::setw(16) << plan_time << std::setw(9) << recursive_time / plan_time << "x"
+				<< std::setw(10) << std::setprecision(2) << 5.0 * size * std::log2(static_cast<double>(size)) / plan_time / 1000.0
+				<< std::setw(12) << std::setprecision(1) << real_time
+				<< std::setw(12) << std::scientific << std::setprecision(2) << error << "\n";
+	}
+
+	std::cout << "\n" << std::setw(8) << "size" << std::setw(14) << "algorithm" << std::setw(12) << "plan [us]"
+			<< std::setw(10) << "GFLOPS" << std::setw(10) << "pow2" << std::setw(12) << "pow2 [us]" << std::setw(10) << "GFLOPS" << "\n";
+	// Frame durations at 44.1kHz and 48kHz (10ms to 1s) and primes
+	const size_t sizes[] = {441, 480, 1000, 1021, 1323, 2205, 4099, 4410, 4800, 8820, 44100, 48000};
+	for (const auto size: sizes) {
+		size_t pow2 = 1;
+		while (pow2 < size) pow2 *= 2;
+		complexarray_t<float> signal(pow2);
+		for (auto& s: signal) s = std::complex<float>(static_cast<float>(std::rand()) / RAND_MAX - 0.5f, 0.0f);
+		complexarray_t<float> result(pow2);
+
+		const fft_plan_t<float> plan(size);
+		// Scratch buffer for Bluestein sizes, so that the transform doesn't allocate
+		complexarray_t<float> work(plan.work_size());
+		const double plan_time = measure([&](){ plan.transform(signal.data(), result.data(), work.data()); });
+		const fft_plan_t<float> pow2_plan(pow2);
+		const double pow2_time = measure([&](){ pow2_plan.transform(signal.data(), result.data()); });
+		const char* names[] = {"power of 2", "mixed radix", "Bluestein"};
+		std::cout << std::setw(8) << size << std::setw(14) << names[static_cast<int>(plan.algorithm())]
+				<< std::setw(12) << std::fixed << std::setprecision(1) << plan_time
+				<< std::setw(10) << std::setprecision(2) << 5.0 * size * std::log2(static_cast<double>(size)) / plan_time / 1000.0
+				<< std::setw(10) << pow2 << std::setw(12) << std::setprecision(1) << pow2_time
+				<< std::setw(10) << std::setprecision(2) << 5.0 * pow2 * std::log2(static_cast<double>(pow2)) / pow2_time / 1000.0 << "\n";
+	}
+}
@@ -0,0 +1,53 @@
+/**
+ * @file 	playback_stems.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * Example playing several long files (stems) at once, streaming them from disk.
+ * Only the first half a second of every file is loaded to memory.
+ */
+
+#include "iimavlib.h"
+#include "iimavlib/VoiceEngine.h"
+#include "iimavlib/Utils.h"
+#include <string>
+
+int main(int argc, char** argv) try
+{
+	using namespace iimavlib;
+	/* ******************************************************************
+	 *                Process command line parameters
+	 ****************************************************************** */
+	if (argc<2) {
+		logger[log_level::fatal] << "Not enough parameters. Specify the wave (or .iac) files please";
+		return 1;
+	}
+	const size_t stems = static_cast<size_t>(argc - 1);
+
+	/* ******************************************************************
+	 *                Load beginnings of the files and start the voices
+	 ****************************************************************** */
+	SampleBank bank;
+	auto engine = std::make_shared<VoiceEngine>(pAudioFilter(), stems, stems);
+	engine->enable_streaming(stems);
+	for (size_t i = 0; i < stems; ++i) {
+		auto sample = bank.load(argv[i + 1], 0.5);
+		logger[log_level::info] << "Streaming " << sample->get_filename() << " (" << sample->get_length() << " samples)";
+		engine->set_sample(i, sample);
+		engine->trigger(i);
+	}
+
+	/* ******************************************************************
+	 *                Create and run the filter chain
+	 ****************************************************************** */
+	auto sink = std::make_shared<DefaultSink>(engine, PlatformDevice::default_device());
+	sink->run();
+
+	const voice_stats_t stats = engine->get_stats();
+	logger[log_level::info] << "Starved " << stats.starved_blocks << " times (" << stats.starved_samples << " samples)";
+}
+catch (std::exception& e)
+{
+	using namespace iimavlib;
+	logger[log_level::fatal] << "ERROR: An error occured during program run: " << e.what();
+}
@@ -9,7 +9,7 @@
  */
 
 #include "iimavlib.h"
-#include "iimavlib/WaveSink.h"
+#include "iimavlib/WaveRecorder.h"
 #include "iimavlib/filters/NullFilter.h"
 #include "iimavlib/filters/SimpleEchoFilter.h"
 #include "iimavlib/Utils.h"
@@ -40,9 +40,10 @@ int main(int argc, char** argv) try
 						.add<NullFilter>()
 						.add<SimpleEchoFilter>(0.2);
 
-	// If there's an output file specified, let's add WaveSink filter to the chain
+	// If there's an output file specified, let's add WaveRecorder filter to the chain.
+	// It writes the file from a separate thread, so slow disk can't cause dropouts in the playback
 	if (!out_file.empty()) filters = filters
-						.add<WaveSink>(out_file);
+						.add<WaveRecorder>(out_file);
 
 	// And finally add audio sink
 	auto chain = filters.add<PlatformSink>(device_out)
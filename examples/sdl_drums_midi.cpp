@@ -10,13 +10,14 @@
 
 #include "iimavlib/SDLDevice.h"
 #include "iimavlib/Utils.h"
-#include "iimavlib/WaveFile.h"
+#include "iimavlib/SampleBank.h"
+#include "iimavlib/VoiceEngine.h"
 #include "iimavlib/AudioFilter.h"
 #include "iimavlib/midi/MidiDevice.h"
 #include "iimavlib/midi/MidiTypes.h"
 #include "iimavlib_high_api.h"
 #include <cstdint>
-#include <mutex>
+#include <atomic>
 #ifdef SYSTEM_LINUX
 #include <unistd.h>
 #endif
@@ -35,14 +36,19 @@ public:
 		SDLDevice(width,height,"Drums"),
 		midi::Midi("Drums"),
 		AudioFilter(pAudioFilter()),
-	data_(rectangle_t(0,0,width,height),black),index_(-1),position_(0)
+	engine_(pAudioFilter()),data_(rectangle_t(0,0,width,height),black),index_(-1),position_(0)
 	{
 		// Load the smaples
 		load_file("../data/drum0.wav");
 		load_file("../data/drum1.wav");
 		load_file("../data/drum2.wav");
-		logger[log_level::info] << "Drums: " << drums_.size();
-		if (drums_.size()==0) throw std::runtime_error("Failed to load drum samples!");
+		const size_t loaded = wait_for_samples();
+		logger[log_level::info] << "Drums: " << loaded;
+		if (loaded==0) throw std::runtime_error("Failed to load drum samples!");
+		for (size_t i = 0; i < drums_.size(); ++i) {
+			if (drums_[i]) engine_.set_sample(i, drums_[i]);
+		}
+		std::fill(note_voices_, note_voices_ + 128, 0);
 		// Start the rendering thread
 		SDLDevice::start();
 		midi::Midi::start();
@@ -54,40 +60,58 @@ public:
 		midi::Midi::stop();
 	}
 private:
-	/// Vector of vector to hold audio samples for the drums
-	std::vector<std::vector<audio_sample_t>> drums_;
+	/// Storage of the samples, loads them in background
+	SampleBank bank_;
+	/// Handles to audio samples for the drums (owned by @em bank_)
+	std::vector<pBankSample> drums_;
+	/// Engine mixing all playing drums
+	VoiceEngine engine_;
 	/// Video data
 	video_buffer_t data_;
-	/// Index of currently playing drum
-	int index_;
-	/// Next sample to be played for current drum
-	size_t position_;
-	/// Mutex to lock @em index_ and @em position_
-	std::mutex position_mutex_;
+	/// Index of the last triggered drum
+	std::atomic<int> index_;
+	/// Number of samples played since the last drum was triggered
+	std::atomic<size_t> position_;
+	/// Voices started by MIDI notes, so they can be released by noteoff
+	voice_id_t note_voices_[128];
+
+	/**
+	 * Starts playing a drum. The drums are mixed together, so a new drum doesn't stop the previous ones.
+	 * @param idx Index of the drum
+	 * @param gain Gain of the drum
+	 * @return Identifier of the started voice
+	 */
+	voice_id_t trigger(int idx, float gain = 1.0f)
+	{
+		const voice_id_t voice = engine_.trigger(idx, gain);
+		position_ = 0;
+		index_ = idx;
+		return voice;
+	}
 
 	/**
 	 * Overloaded method for noteon event handling
 	*/
 	void on_noteon(const midi::note_t& note) {
-		std::unique_lock<std::mutex> lock(position_mutex_); // Lock the variables
-
 		// Print information about the received note
 		logger[log_level::info] << "Note: " << static_cast<int>(note.channel) << ", " << static_cast<int>(note.note) << ", " << static_cast<int>(note.velocity);
 		// Select a drum based on the received note
 		int idx = note.note % 3;
 		logger[log_level::info] << "Drum " << idx;
-		index_ 		= idx;
-		position_	= 0;
+		if (!has_drum(idx)) return;
+		// Velocity controls the gain, a repeated note releases its previous voice
+		if (note_voices_[note.note & 0x7F]) engine_.release(note_voices_[note.note & 0x7F]);
+		note_voices_[note.note & 0x7F] = trigger(idx, note.velocity / 127.0f);
 	}
 
 	/**
 	 * Overloaded method for noteoff event handling
 	*/
-	void on_noteoff(const midi::note_t&) {
-		// Stop playing when a noteoff event is received
-		std::unique_lock<std::mutex> lock(position_mutex_);
-		index_    = -1;
-		position_ = 0;
+	void on_noteoff(const midi::note_t& note) {
+		// Fade out the voice started by the note when a noteoff event is received
+		voice_id_t& voice = note_voices_[note.note & 0x7F];
+		if (voice) engine_.release(voice);
+		voice = 0;
 	}
 
 	/**
@@ -97,9 +121,7 @@ private:
 		// Play drum 2 on any control event (these are usually many in sequence, so not the best for directly starting playback)
 		logger[log_level::info] << "Control: " << static_cast<int>(control.channel) << ", " << static_cast<int>(control.param) << ", " << static_cast<int>(control.value);
 		logger[log_level::info] << "Drum 2";
-		std::unique_lock<std::mutex> lock(position_mutex_); // Lock the variables
-		index_ 		= 2;
-		position_	= 0;
+		if (has_drum(2)) trigger(2);
 	}
 
 	/**
@@ -128,11 +150,9 @@ private:
 	 */
 	virtual bool do_mouse_button(const int button, const bool pressed, const int, const int)
 	{
-		if (pressed && static_cast<size_t>(button) < drums_.size()) {
-			std::unique_lock<std::mutex> lock(position_mutex_); // Lock the variables
-			index_ = button;
-			position_ = 0;
-			logger[log_level::info] << "Playing " << index_ ;
+		if (pressed && has_drum(button)) {
+			trigger(button);
+			logger[log_level::info] << "Playing " << button;
 		}
 		return true;
 	}
@@ -146,15 +166,15 @@ private:
 		rgb_t color = black;
 		/// Intensity of the color (255 at the beginning of the sample and gets darker as the sample continues.)
 		uint8_t intensity = 0;
-		{
-			std::unique_lock<std::mutex> lock(position_mutex_); // Lock the variables
-			if (index_ >= 0 && static_cast<size_t>(index_) < drums_.size()) {
-				// Calculate the intensity for valid index
-				intensity = static_cast<uint8_t>(255.0 - (255.0*position_/drums_[index_].size()));
-			}
+		const int index = index_;
+		if (has_drum(index)) {
+			// Calculate the intensity for valid index
+			const size_t samples = drums_[index]->data().size();
+			const size_t position = std::min<size_t>(position_, samples);
+			if (samples) intensity = static_cast<uint8_t>(255.0 - (255.0*position/samples));
 		}
 		// Set the color based on sample index
-		switch (index_) {
+		switch (index) {
 			case 0: color.r = intensity; break; // Red
 			case 1: color.g = intensity; break; // Green
 			case 2: color.b = intensity; break; // Blue
@@ -169,69 +189,55 @@ private:
 	error_type_t do_process(audio_buffer_t& buffer)
 	{
 		if (SDLDevice::is_stopped()) return error_type_t::failed;
-//		const audio_params_t& params = buffer.params;
-
-		// Get iterator to the data in the buffer
-		auto data = buffer.data.begin();
-
-		if (index_ < 0 || (drums_.size()<=static_cast<size_t>(index_))) {
-			// If there's no active drum, we just fill the buffer with zeroes
-			std::fill(data,data+buffer.valid_samples,0);
-		} else {
-			//logger[log_level::info] << "Using " << index_ << " from " << position_;
-			std::unique_lock<std::mutex> lock(position_mutex_);
-			// Get ref. to the current drum's buffer
-			const auto& drum = drums_[index_];
-			size_t samples = drums_[index_].size();
-			size_t remaining = buffer.valid_samples;
-			size_t written = 0;
-			if (position_<samples) {
-				// We still have some non-copied samples
-				const size_t avail = samples - position_; // How many samples are available current drum
-				written = (avail>=remaining)?remaining:avail; // We will copy this count of samples.
-				auto first = drum.cbegin()+position_;		// Iterator to first sample to copy
-				auto last = (avail>=remaining)?first+remaining:drum.cend(); // Iterator after the last sample that will be written
-				std::copy(first,last,data); // Copy the samples to the buffer
-				position_+=written; // Advance the drum's buffer position
-				remaining-=written;
-			} else {
-				// We've already copied all the sample, so let's set current drum to none
-				index_ = -1;
-				position_ = 0;
-			}
-			// Fill the rest of the buffer (if there's still some space) with zeroes
-			std::fill(data+written, data+written+remaining, 0);
-		}
+		// The engine mixes all active drums into the buffer
+		engine_.process(buffer);
+		position_ += buffer.valid_samples;
 		// Update display (because we changed the position_)
 		update_screen();
 		return error_type_t::ok;
 	}
 
 	/**
-	 * Loads a wave file into @em drums_ vector.
+	 * Requests a wave file from @em bank_ and adds handle to it into @em drums_ vector.
+	 * The file is loaded in background, so @em wait_for_samples has to be called before playing.
 	 * @param filename Path to the file to load.
-	 * @return true if the file was loaded successfully, false otherwise
 	 */
-	bool load_file(const std::string filename)
+	void load_file(const std::string filename)
 	{
-		try {
-			WaveFile wav(filename);  // Load wave file
-			const audio_params_t params = wav.get_params();
-			if (params.rate != sampling_rate_t::rate_44kHz) throw std::runtime_error("Wrong sampling rate. 44kHz expected.");
-//			if (params.format != sampling_format_t::format_16bit_signed) throw std::runtime_error("Wrong sampling format. Signed 16bits expected.");
-//			if (params.num_channels != 2) throw std::runtime_error("Wrong number of channel. Expected stereo file.");
-			size_t samples = 44100;
-			std::vector<audio_sample_t> data(samples);
-			wav.read_data(data,samples);
-			data.resize(samples);
-			logger[log_level::info] << "Read " << samples << "samples";
-			drums_.push_back(std::move(data));
-		}
-		catch (std::exception &e) {
-			logger[log_level::fatal] << "Failed to load " << filename << " (" << e.what() << ")";
+		drums_.push_back(bank_.get(filename));
+	}
+
+	/**
+	 * Waits until all requested samples are loaded. Handles of those that can't be used are reset,
+	 * so the drums keep their indices.
+	 * @return Number of drums that can be played
+	 */
+	size_t wait_for_samples()
+	{
+		auto unusable = [this](const pBankSample& drum) {
+			if (!bank_.wait(drum)) {
+				logger[log_level::fatal] << "Failed to load " << drum->get_filename();
+				return true;
+			}
+			if (drum->get_params().rate != sampling_rate_t::rate_44kHz) {
+				logger[log_level::fatal] << "Failed to load " << drum->get_filename() << " (Wrong sampling rate. 44kHz expected.)";
+				return true;
+			}
+			logger[log_level::info] << "Loaded " << drum->data().size() << " samples";
 			return false;
+		};
+		size_t loaded = 0;
+		for (auto& drum: drums_) {
+			if (unusable(drum)) drum.reset();
+			else ++loaded;
 		}
-		return true;
+		return loaded;
+	}
+
+	/// Returns true if there's a loaded drum with index @em idx
+	bool has_drum(int idx) const
+	{
+		return idx >= 0 && static_cast<size_t>(idx) < drums_.size() && drums_[idx];
 	}
 };
 const rgb_t Drums::black (0, 0, 0);
@@ -11,6 +11,7 @@
 #include "iimavlib/Utils.h"
 #include "iimavlib/WaveSink.h"
 #include "iimavlib/AudioFilter.h"
+#include "iimavlib/Oscillator.h"
 #include "iimavlib_high_api.h"
 #include "iimavlib/video_ops.h"
 #ifdef SYSTEM_LINUX
@@ -30,39 +31,36 @@ using iimavlib::error_type_t;
 using iimavlib::logger;
 using iimavlib::log_level;
 
-// Value of 2*PI
-const double pi2 = 8.0 * std::atan(1.0);
-
 class Generator: public AudioFilter
 {
 public:
 	Generator(double frequency):AudioFilter(pAudioFilter()),
-	frequency_(frequency),time_(0.0),amplitude_(32767)
+	oscillator_(iimavlib::waveform_t::sine, frequency),amplitude_(32767)
 {
 }
 	void set_frequency(double frequency)
 	{
 		std::unique_lock<std::mutex> lock(frequency_mutex_);
-		// Adjusting time so the function is continuous (this should make the sound nicer)
-		if (frequency > 0.1) time_ = frequency_ * time_ / frequency;
-		frequency_ = frequency;
+		// The oscillator keeps its phase, so the signal stays continuous
+		oscillator_.set_frequency(frequency);
 	}
 private:
 	error_type_t do_process(iimavlib::audio_buffer_t& buffer)
 	{
-		// Prepare few values to save typing (and enable some optimizations)
-		const double step = 1.0 / convert_rate_to_int(buffer.params.rate);
-		std::unique_lock<std::mutex> lock(frequency_mutex_);
-		for (auto& sample: buffer.data) {
-			sample = static_cast<int16_t>(amplitude_ * std::sin(time_ * frequency_ * pi2));
-			time_=time_ + step;
+		values_.resize(buffer.data.size());
+		{
+			std::unique_lock<std::mutex> lock(frequency_mutex_);
+			oscillator_.generate(values_.data(), values_.size(), convert_rate_to_int(buffer.params.rate));
+		}
+		for (size_t i = 0; i < buffer.data.size(); ++i) {
+			buffer.data[i] = static_cast<int16_t>(amplitude_ * values_[i]);
 		}
 		buffer.valid_samples = buffer.data.size();
 		return error_type_t::ok;
 	}
 
-	double frequency_;
-	double time_;
+	iimavlib::Oscillator oscillator_;
+	std::vector<float> values_;
 	int16_t amplitude_;
 	std::mutex frequency_mutex_;
 };
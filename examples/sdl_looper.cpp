@@ -6,18 +6,23 @@
  * @copyright GNU Public License 3.0
  *
  */
-#include "iimavlib/AudioFFT.h"
+#include "iimavlib/STFT.h"
 #include "iimavlib/AudioTypes.h"
 #include "SDL/SDL_video.h"
 #include "iimavlib/WaveSource.h"
 #include "iimavlib/filters/SineMultiply.h"
 #include "iimavlib/filters/SimpleEchoFilter.h"
+#include "iimavlib/filters/ConvolutionReverb.h"
+#include "iimavlib/filters/BiquadFilter.h"
+#include "iimavlib/filters/FDNReverb.h"
+#include "iimavlib/Oscillator.h"
 
 #include "iimavlib/midi/MidiDevice.h"
 #include "iimavlib/midi/MidiTypes.h"
 
 #include <iimavlib/SDLDevice.h>
 #include <iimavlib/AudioFilter.h>
+#include <iimavlib/RingBuffer.h>
 #include <iimavlib_high_api.h>
 #include <iimavlib/video_ops.h>
 #include <iimavlib/Utils.h>
@@ -71,431 +76,127 @@ private:
 	std::mutex enabled_mutex_;
 };
 
+/**
+ * Echo with feedback, which can be toggled on and off.
+ * The old samples are kept in a delay line, so the cost doesn't depend on the delay.
+ */
 class MySimpleEchoFilter : public AudioFilter, public ToggleableFilter
 {
 public:
 	MySimpleEchoFilter(const pAudioFilter& child, double delay, double decay)
-		:AudioFilter(child), delay_(delay), decay_(decay)
-	{
-
-	}
-	MySimpleEchoFilter::~MySimpleEchoFilter()
-	{
-
-	}
-	/**
-	 * Adds 'echo' to the @em dest buffer, by adding weighted values from @em src.
-	 * @tparam T type of the samples. Should be signed.
-	 * @param dest Destination buffer to add echo to.
-	 * @param src Source buffer to read old values for echo.
-	 * @param count Number of samples to read.
-	 * @param decay Weighting of old and new values.
-	 */
-	template<typename T>
-	void add_echo(T dest, T src, size_t count, double decay)
+		:AudioFilter(child), echo_(pAudioFilter(), delay, decay)
 	{
 
-		for (size_t sample = 0; sample < count; ++sample) {
-			*dest = (decay * *src++) + ((1.0 - decay) * *dest);
-			dest++;
-		}
 	}
 private:
-	std::vector<audio_sample_t> old_samples_;
-	double delay_;
-	double decay_;
-	double time_;
-	error_type_t MySimpleEchoFilter::do_process(audio_buffer_t& buffer)
+	SimpleEchoFilter echo_;
+
+	error_type_t do_process(audio_buffer_t& buffer) override
 	{
 		if (!is_enabled())
 			return error_type_t::ok;
-		// Return OK for empty buffer - nothing to do here
-		if (buffer.valid_samples == 0) return error_type_t::ok;
-
-		// Some constant values that is convenient to have prepared
-		const size_t frequency = convert_rate_to_int(buffer.params.rate);
-		const size_t delay_samples = static_cast<size_t>(frequency * delay_);
-
-
-		// Make sure old_samples_ is large enough
-		old_samples_.resize(delay_samples, 0);
-
-		// Pointer to the buffer after type conversion to int16_t
-		const auto data = buffer.data.begin();
-
-		// Calculate how many samples from old_samples we're gonna use
-		const size_t from_old = std::min(buffer.valid_samples, delay_samples);
-
-		// And add echo to them (from old_samples_)
-		add_echo(data, old_samples_.begin(), from_old, decay_);
-
-		// if buffer.valid_samples is lesser or equal than delay_samples, we already have processed all the samples
-		if (buffer.valid_samples <= delay_samples) {
-			// Move unused part of the buffer to the beginning
-			std::copy(old_samples_.begin() + from_old, old_samples_.end(), old_samples_.begin());
-			// Resize old_samples_ to the size of valid data in it
-			old_samples_.resize(std::distance(old_samples_.begin() + from_old, old_samples_.end()));
-			// And insert samples from processed buffer
-			old_samples_.insert(old_samples_.end(), data, data + buffer.valid_samples);
-		}
-		else {
-			// Our input buffer was larger then old_samples_, that means we still need to add echo to some samples
-			//logger[log_level::debug] << "Too large input buffer or too small delay, not tested";
-			// Add echo to the rest of input buffer
-			add_echo(data + from_old, data, (buffer.valid_samples - from_old), decay_);
-			// We have no valid old samples
-			old_samples_.resize(0);
-			// Copy samples to old_samples_ from input buffer
-			old_samples_.insert(old_samples_.end(),
-				data + (buffer.valid_samples - delay_samples),
-				data + buffer.valid_samples);
-		}
-		return error_type_t::ok;
-	};
+		return echo_.process(buffer);
+	}
 	void reinitialize() override
 	{
-		time_ = 0.0f;
+		// Don't replay the echo from the time the filter was enabled last time
+		echo_.reset();
 	}
 };
-class MySimpleReverbFilter : public AudioFilter, public ToggleableFilter
+/**
+ * Reverb, which can be toggled on and off.
+ * Convolves the samples with the impulse response from a file, or uses an algorithmic (feedback delay network) reverb,
+ * when no file is specified.
+ */
+class MyReverbFilter : public AudioFilter, public ToggleableFilter
 {
 public:
-	MySimpleReverbFilter(const pAudioFilter& child, double reverb_factor, double decay)
-		: AudioFilter(child), reverb_factor_(reverb_factor), decay_(decay)
+	MyReverbFilter(const pAudioFilter& child, const std::string& filename, double wet, double dry)
+		: AudioFilter(child), reverb_(make_reverb(filename, wet, dry))
 	{
 
 	}
 
-	~MySimpleReverbFilter()
+	~MyReverbFilter()
 	{
-
+		const ConvolutionReverb* convolution = dynamic_cast<const ConvolutionReverb*>(reverb_.get());
+		if (!convolution)
+			return;
+		const convolution_stats_t stats = convolution->get_stats();
+		logger[log_level::info] << "[MyReverbFilter] Processed " << stats.blocks << " blocks in "
+				<< stats.partitions << " partitions, average load " << stats.average_load * 100.0
+				<< "%, peak load " << stats.peak_load * 100.0 << "%";
 	}
 
-	template<typename T>
-	void add_reverb(T dest, T src, size_t count, double decay, audio_buffer_t& buffer)
+private:
+	std::unique_ptr<AudioFilter> reverb_;
+
+	static std::unique_ptr<AudioFilter> make_reverb(const std::string& filename, double wet, double dry)
 	{
-		//const double feedback1 = 0.6;
-		//const double feedback2 = 0.3;
-		//const double feedback3 = 0.1;
-		//const size_t delay1 = static_cast<size_t>(convert_rate_to_int(buffer.params.rate) * 0.02);
-		//const size_t delay2 = static_cast<size_t>(convert_rate_to_int(buffer.params.rate) * 0.04);
-		//const size_t delay3 = static_cast<size_t>(convert_rate_to_int(buffer.params.rate) * 0.06);
-
-		//for (size_t sample = 0; sample < count; ++sample) {
-		//	// Delay Line 1
-		//	const audio_sample_t delayed1 = old_samples_[0];
-		//	old_samples_[0] = *src + feedback1 * delayed1;
-
-		//	// Delay Line 2
-		//	const audio_sample_t delayed2 = old_samples_[1];
-		//	old_samples_[1] = delayed1 + feedback2 * delayed2;
-
-		//	// Delay Line 3
-		//	const audio_sample_t delayed3 = old_samples_[2];
-		//	old_samples_[2] = delayed2 + feedback3 * delayed3;
-
-		//	// Combine delayed samples and apply decay
-		//	*dest = (decay * (*src++ + delayed1 + delayed2 + delayed3)) + ((1.0 - decay) * *dest);
-		//	dest++;
-		//}
-		const double feedback = 0.1; // Adjust as needed
-		const size_t delay1 = static_cast<size_t>(convert_rate_to_int(buffer.params.rate) * 0.03); // Adjust delay times
-		const size_t delay2 = static_cast<size_t>(convert_rate_to_int(buffer.params.rate) * 0.05);
-
-		for (size_t sample = 0; sample < count; ++sample) {
-			// Delay Line 1
-			const audio_sample_t delayed1 = old_samples_[0];
-			old_samples_[0] = *src + feedback * delayed1;
-
-			// Delay Line 2
-			const audio_sample_t delayed2 = old_samples_[1];
-			old_samples_[1] = delayed1 + feedback * delayed2;
-
-
-
-			// Combine delayed samples and apply decay
-			*dest = (decay * (*src++ + delayed1 + delayed2)) + ((1.0 - decay) * *dest);
-			//logger[log_level::info] << "dest : " << ;
-						//*dest = (std::copysignl(max_val, (decay * (*src++ + delayed1 + delayed2)) + ((1.0 - decay) * *dest)));
-			//*dest = std::max(max_val, (decay * (*src++ + delayed1 + delayed2)) + ((1.0 - decay) * *dest));
-			/*if ((long double)((decay * (*src++ + delayed1 + delayed2)) + ((1.0 - decay) * *dest)) > max_val) {
-				*dest = max_val;
-			}
-			else {
-				*dest = (decay * (*src++ + delayed1 + delayed2)) + ((1.0 - decay) * *dest);
-			}*/
-			dest++;
+		if (!filename.empty()) {
+			return std::unique_ptr<AudioFilter>(new ConvolutionReverb(pAudioFilter(), filename, wet, dry));
 		}
+		// 1.5 seconds long reverb with darker tail
+		fdn_params_t params(16, 1.5, 0.4, wet, dry);
+		return std::unique_ptr<AudioFilter>(new FDNReverb(pAudioFilter(), params));
+	}
+
+	error_type_t do_process(audio_buffer_t& buffer) override
+	{
+		if (!is_enabled())
+			return error_type_t::ok;
+		return reverb_->process(buffer);
+	}
+
+	void reinitialize() override
+	{
+	}
+};
+
+/**
+ * Resonant low pass filter with the cutoff frequency swept by a LFO, which can be toggled on and off.
+ * The cutoff moves exponentially between 1/16 of @em maxCutoff and @em maxCutoff,
+ * the biquad interpolates the coefficients over each buffer, so the sweep doesn't click.
+ */
+class MySimpleLowPassFilter : public AudioFilter, public ToggleableFilter
+{
+public:
+	MySimpleLowPassFilter(const pAudioFilter& child, double lfoFrequency, double maxCutoff)
+		: AudioFilter(child), lfoFrequency_(lfoFrequency), maxCutoff_(maxCutoff), time_(0.0),
+		  filter_(pAudioFilter(), std::vector<biquad_params_t>(2, biquad_params_t(biquad_type_t::lowpass, maxCutoff, 0.7071)))
+	{
 	}
 
 private:
-	std::vector<audio_sample_t> old_samples_;
-	double decay_;
-	double reverb_factor_;
+	double lfoFrequency_;
+	double maxCutoff_;
 	double time_;
+	BiquadFilter filter_;
 
-
-	error_type_t MySimpleReverbFilter::do_process(audio_buffer_t& buffer) override
+	error_type_t do_process(audio_buffer_t& buffer) override
 	{
 		if (!is_enabled())
 			return error_type_t::ok;
 
+		// Return OK for an empty buffer - nothing to do here
 		if (buffer.valid_samples == 0)
 			return error_type_t::ok;
 
-		const size_t frequency = convert_rate_to_int(buffer.params.rate);
-		const size_t delay_samples = static_cast<size_t>(frequency * reverb_factor_);
-
-		old_samples_.resize(delay_samples, 0);
-
-		const auto data = buffer.data.begin();
-
-		const size_t from_old = std::min(buffer.valid_samples, delay_samples);
-
-		add_reverb(data, old_samples_.begin(), from_old, decay_, buffer);
-
-		if (buffer.valid_samples <= delay_samples) {
-			std::copy(old_samples_.begin() + from_old, old_samples_.end(), old_samples_.begin());
-			old_samples_.resize(std::distance(old_samples_.begin() + from_old, old_samples_.end()));
-			old_samples_.insert(old_samples_.end(), data, data + buffer.valid_samples);
-		}
-		else {
-			add_reverb(data + from_old, data, (buffer.valid_samples - from_old), decay_, buffer);
-			old_samples_.resize(0);
-			old_samples_.insert(old_samples_.end(),
-				data + (buffer.valid_samples - delay_samples),
-				data + buffer.valid_samples);
-		}
+		const double lfoValue = std::sin(2.0 * M_PI * time_ * lfoFrequency_);
+		const double cutoff = maxCutoff_ * std::pow(2.0, 2.0 * (lfoValue - 1.0));
+		filter_.set_section(0, biquad_params_t(biquad_type_t::lowpass, cutoff, 0.7071));
+		filter_.set_section(1, biquad_params_t(biquad_type_t::lowpass, cutoff, 2.0));
+		time_ += buffer.valid_samples * 1.0 / convert_rate_to_int(buffer.params.rate);
 
-		return error_type_t::ok;
+		return filter_.process(buffer);
 	}
+
 	void reinitialize() override
 	{
-		time_ = 0.0f;
+		time_ = 0.0;
 	}
-
 };
 
-//template <class T>
-//simplearray_t<T> IDFT1D(const complexarray_t<T>& ab) {
-//	const auto N = ab.size();
-//
-//	if (N == 0 || (N & (N - 1))) {
-//		throw std::runtime_error("IDFT Error: the input number of samples must be a power of 2!");
-//	}
-//	else if (N <= 8) {
-//		// Assuming you have a DFT1D function for the base case
-//		// Replace with your actual implementation of IDFT1D for N <= 8
-//		// return DFT1D(ab);
-//		simplearray_t<T> realInput;
-//		realInput.reserve(N * 2);
-//		for (const auto& val : ab) {
-//			realInput.push_back(val.real());
-//			realInput.push_back(val.imag());
-//		}
-//		AudioFFT<float> fft;
-//		std::vector<audio_sample_t> s = realInput;
-//		simplearray_t<T> result = fft.FFT1D(s.begin(), s.end()); 
-//
-//
-//		return result;
-//	}
-//	else {
-//		complexarray_t<T> coefficients_odd;
-//		coefficients_odd.reserve(N / 2);
-//		for (auto i = 0u; i < N; i += 2)
-//			coefficients_odd.push_back(ab[i]);
-//		auto samples_odd = IDFT1D(coefficients_odd);
-//
-//		complexarray_t<T> coefficients_even;
-//		coefficients_even.reserve(N / 2);
-//		for (auto i = 1u; i < N; i += 2)
-//			coefficients_even.push_back(ab[i]);
-//		auto samples_even = IDFT1D(coefficients_even);
-//
-//		complexarray_t<T> f;
-//		for (auto n = 0u; n < N; n++) {
-//			f.push_back(std::exp(std::complex<T>(0, 2 * M_PI * n / N))); // Corrected the sign
-//		}
-//
-//		simplearray_t<T> result(N, 0);
-//		for (auto i = 0u; i < N / 2; ++i) {
-//			result[i] = samples_odd[i] + f[i].real() * samples_even[i];
-//			result[i + N / 2] = samples_odd[i] - f[i + N / 2].real() * samples_even[i]; // Change the sign
-//		}
-//		return result;
-//	}
-//}
-//
-//template <class T>
-//simplearray_t<T> IFFT1D(const complexarray_t<T>& ab) {
-//	const auto N = ab.size();
-//
-//	if (N == 0 || (N & (N - 1))) {
-//
-//		throw std::runtime_error("IFFT Error: the input number of samples must be a power of 2!");
-//	}
-//	else if (N <= 8) {
-//		// Assuming you have a DFT1D function for the base case
-//		return IDFT1D(ab);
-//	}
-//	else {
-//
-//		complexarray_t<T> coefficients_odd;
-//		coefficients_odd.reserve(N / 2);
-//		for (auto i = 0u; i < N; i += 2)
-//			coefficients_odd.push_back(ab[i]);
-//
-//		simplearray_t<T> samples_odd = IFFT1D(coefficients_odd);
-//
-//		complexarray_t<T> coefficients_even;
-//		coefficients_even.reserve(N / 2);
-//		for (auto i = 1u; i < N; i += 2)
-//			coefficients_even.push_back(ab[i]);
-//		auto samples_even = IFFT1D(coefficients_even);
-//
-//		complexarray_t<T> f;
-//		for (auto n = 0u; n < N; n++) {
-//			f.push_back(std::exp(std::complex<T>(0, -2 * M_PI * static_cast<T>(n) / N))); // Corrected the sign and type
-//		}
-//
-//
-//
-//		simplearray_t<T> result(N, 0);
-//		for (auto i = 0u; i < N / 2; ++i) {
-//			result[i] = samples_odd[i] + f[i].real() * samples_even[i];
-//			result[i + N / 2] = samples_odd[i] + f[i + N / 2].real() * samples_even[i];
-//		}
-//		return result;
-//	}
-//}
-//
-//class MySimpleLowPassFilter : public AudioFilter, public ToggleableFilter
-//{
-//public:
-//	MySimpleLowPassFilter(const pAudioFilter& child, double lfoFrequency, double maxCutoff)
-//		: AudioFilter(child), lfoFrequency_(lfoFrequency), maxCutoff_(maxCutoff)
-//	{
-//		float timespec_ = 10.0f / 1000.0f;
-//
-//		const audio_params_t& params = get_params();
-//		cache_size_ = static_cast<size_t>(timespec_ * convert_rate_to_int(params.rate));
-//		cache_size_ = static_cast<size_t>(pow(2, ceil(log2(cache_size_))) * 2);
-//		logger[log_level::info] << "Cache size: " << cache_size_;
-//		
-//		sample_cache_.resize(cache_size_);
-//		time_ = 0.0;
-//		last_sample_ = 0.0;
-//		changed_ = false;
-//	}
-//
-//	~MySimpleLowPassFilter()
-//	{
-//	}
-//
-//private:
-//	double lfoFrequency_;
-//	double maxCutoff_;
-//	AudioFFT<float> fft;
-//	double time_;
-//	std::vector<audio_sample_t> sample_cache_;
-//	
-//	std::atomic<bool> end_;
-//	std::atomic<bool> changed_;
-//	size_t last_sample_;
-//	size_t cache_size_;
-//	std::vector<complexarray_t<float>> coefficient_array_entire;
-//
-//	void cleanupFilter()
-//	{
-//		// Cleanup if needed
-//	}
-//
-//	void update_cache(const audio_buffer_t& buffer)
-//	{
-//		const audio_sample_t* src = &buffer.data[0];
-//		size_t src_remaining = buffer.valid_samples;
-//
-//		while (src_remaining)
-//		{
-//			const size_t to_copy = std::min(src_remaining, sample_cache_.size() - last_sample_);
-//			std::copy_n(src, to_copy, &sample_cache_[0] + last_sample_);
-//			last_sample_ += to_copy;
-//			if (last_sample_ >= sample_cache_.size())
-//				last_sample_ = 0;
-//			src_remaining -= to_copy;
-//		}
-//		changed_.store(true);
-//	}
-//
-//
-//	complexarray_t<float> applyLowPassFilter(complexarray_t<float>& spectrum)
-//	{
-//		// Implement your low-pass filter logic here
-//		// You can modulate the cutoff frequency based on the LFO and maxCutoff parameters
-//		// Modify the spectrum in-place
-//		// Example: simple low-pass filter with a linear cutoff modulation
-//		double lfoValue = std::sin(2.0 * M_PI * time_ * lfoFrequency_);
-//		double cutoff = maxCutoff_ * (lfoValue + 1.0) / 2.0;
-//
-//		for (size_t i = 0; i < spectrum.size(); ++i)
-//		{
-//			// Implement your low-pass filter logic here
-//			// You may want to design a more sophisticated filter based on your requirements
-//			if (i > cutoff)
-//			{
-//				spectrum[i] = 0.0;
-//			}
-//		}
-//		return spectrum;
-//	}
-//
-//	error_type_t do_process(audio_buffer_t& buffer) override
-//	{
-//
-//		if (!is_enabled())
-//			return error_type_t::ok;
-//
-//		// Return OK for an empty buffer - nothing to do here
-//		if (buffer.valid_samples == 0)
-//			return error_type_t::ok;
-//
-//
-//		const size_t frequency = convert_rate_to_int(buffer.params.rate);
-//		const size_t N = buffer.valid_samples;
-//
-//		update_cache(buffer);
-//
-//		time_ += buffer.valid_samples * 1.0 / convert_rate_to_int(buffer.params.rate);
-//
-//		// Convert audio samples to a complex spectrum
-//		complexarray_t<float> coefficient_array;
-//		{
-//			coefficient_array = fft.FFT1D(sample_cache_.begin(), sample_cache_.end());
-//		}
-//		// Apply the low-pass filter to the spectrum
-//
-//		coefficient_array = applyLowPassFilter(coefficient_array);
-//		// Perform IFFT
-//
-//		simplearray_t<float> result = IFFT1D(coefficient_array);
-//		std::cout << "jsem tady\n\n\n";;
-//
-//		// Copy the modified samples back to the audio buffer
-//		for (size_t i = 0; i < N; ++i)
-//		{
-//			buffer.data[i] = static_cast<audio_sample_t>(result[i]);
-//		}
-//
-//		return error_type_t::ok;
-//	}
-//
-//	void reinitialize() override
-//	{
-//		time_ = 0.0;
-//	}
-//};
-
 
 
 
@@ -503,9 +204,6 @@ namespace
 {
 	// Max value for int16_t
 	const double max_val = std::numeric_limits<int16_t>::max();
-
-	// Value of 2*PI
-	const double pi2 = 8.0 * std::atan(1.0);
 }
 
 
@@ -513,7 +211,8 @@ namespace
 class MIDIFrequencyGenerator : public AudioFilter, public midi::Midi
 {
 public:
-	MIDIFrequencyGenerator() : AudioFilter(pAudioFilter()), frequency_(880), time_(0.0), amplitude_(10.0)
+	MIDIFrequencyGenerator() : AudioFilter(pAudioFilter()), events_(256), frame_(0), frequency_(880), amplitude_(10.0),
+		oscillator_(waveform_t::sine, 880)
 	{
 		midi::Midi::start();
 		midi::Midi::open_all_inputs();
@@ -525,26 +224,52 @@ public:
 		midi::Midi::stop();
 	}
 
-	error_type_t do_process(audio_buffer_t& buffer) override
+	/**
+	 * Applies the control changes due at the current frame, the buffer is split at the next one
+	 */
+	size_t do_split(const audio_params_t& /*params*/, size_t count) override
 	{
-		// If disabled, clear the output buffer
-
-
-		const double step = 1.0 / convert_rate_to_int(buffer.params.rate);
+		const uint64_t frame = frame_.load();
+		event_queue_t<control_event_t>::event_t event;
+		while (events_.pop(frame + 1, event))
+		{
+			if (event.data.frequency)
+			{
+				frequency_ = event.data.value;
+				oscillator_.set_frequency(frequency_);
+			}
+			else {
+				amplitude_ = event.data.value;
+			}
+		}
+		return events_.distance(frame, count);
+	}
 
-		for (auto& sample : buffer.data)
+	error_type_t do_process(audio_buffer_t& buffer) override
+	{
+		values_.resize(buffer.data.size());
+		oscillator_.generate(values_.data(), values_.size(), convert_rate_to_int(buffer.params.rate));
+		for (size_t i = 0; i < buffer.data.size(); ++i)
 		{
-			sample = static_cast<int16_t>(max_val * std::sin(time_ * frequency_ * pi2));
-			time_ = time_ + step;
+			buffer.data[i] = static_cast<int16_t>(max_val * values_[i]);
 		}
 		buffer.valid_samples = buffer.data.size();
+		frame_ += buffer.valid_samples;
 		return error_type_t::ok;
 	}
 private:
 
 	/// MIDI ---
-	/// Mutex to lock @em index_ and @em position_
-	std::mutex position_mutex_;
+	struct control_event_t
+	{
+		/// Whether the value is frequency or amplitude
+		bool frequency;
+		double value;
+	};
+	/// Control changes from the MIDI thread, applied in the audio thread
+	event_queue_t<control_event_t> events_;
+	/// Number of samples generated so far
+	std::atomic<uint64_t> frame_;
 	/*/// Index of currently playing drum
 	int index_;
 	/// Next sample to be played for current drum
@@ -552,7 +277,8 @@ private:
 
 	double frequency_;
 	double amplitude_;
-	double time_;
+	iimavlib::Oscillator oscillator_;
+	std::vector<float> values_;
 
 
 
@@ -565,14 +291,11 @@ private:
 		// Play drum 2 on any control event (these are usually many in sequence, so not the best for directly starting playback)
 		logger[log_level::info] << "Control: " << static_cast<int>(control.channel) << ", " << static_cast<int>(control.param) << ", " << static_cast<int>(control.value);
 		logger[log_level::info] << "Drum 2";
-		std::unique_lock<std::mutex> lock(position_mutex_); // Lock the variables
-		if (control.channel > 13)
-		{
-			frequency_ = control.value;
-		}
-		else {
-			amplitude_ = control.value;
-		}
+		// Scheduled to the current frame, so it's applied at the beginning of the next buffer
+		control_event_t event;
+		event.frequency = control.channel > 13;
+		event.value = control.value;
+		events_.push(frame_.load(), event);
 		// Playing from sdl_drums_midi.cpp
 		// index_ = 2;
 		//position_ = 0;
@@ -587,7 +310,7 @@ private:
 class SineGenerator : public AudioFilter, public ToggleableFilter
 {
 public:
-	SineGenerator(const pAudioFilter& child, float frequency) : AudioFilter(pAudioFilter()), ToggleableFilter(), frequency_(frequency), time_(0.0f)
+	SineGenerator(const pAudioFilter& child, float frequency) : AudioFilter(pAudioFilter()), ToggleableFilter(), oscillator_(iimavlib::waveform_t::sine, frequency)
 	{
 	}
 
@@ -603,34 +326,30 @@ public:
 			return error_type_t::ok;
 		}
 
-		const double step = 1.0 / convert_rate_to_int(buffer.params.rate);
-
-		for (auto& sample : buffer.data)
+		values_.resize(buffer.data.size());
+		oscillator_.generate(values_.data(), values_.size(), convert_rate_to_int(buffer.params.rate));
+		for (size_t i = 0; i < buffer.data.size(); ++i)
 		{
-			sample = static_cast<int16_t>(max_val * std::sin(time_ * frequency_ * pi2));
-			//sample += static_cast<int16_t>(std::copysignl(max_val, std::sin(time_ * frequency_ * pi2)));
-			//sample = static_cast<int16_t>(max_val * (2.0 * (time_ * frequency_ - std::floor(time_ * frequency_ + 0.5))));
-
-			time_ = time_ + step;
+			buffer.data[i] = static_cast<int16_t>(max_val * values_[i]);
 		}
 		buffer.valid_samples = buffer.data.size();
 		return error_type_t::ok;
 	}
 
 private:
-	double frequency_;
-	double time_;
+	iimavlib::Oscillator oscillator_;
+	std::vector<float> values_;
 
 	void reinitialize() override
 	{
-		time_ = 0.0f;
+		oscillator_.set_phase(0.0);
 	}
 };
 
 class SawtoothWaveGenerator : public AudioFilter, public ToggleableFilter
 {
 public:
-	SawtoothWaveGenerator(float frequency) : AudioFilter(pAudioFilter()), ToggleableFilter(), frequency_(frequency), time_(0.0f)
+	SawtoothWaveGenerator(float frequency) : AudioFilter(pAudioFilter()), ToggleableFilter(), oscillator_(iimavlib::waveform_t::sawtooth, frequency)
 	{
 	}
 
@@ -646,14 +365,12 @@ public:
 			return error_type_t::ok;
 		}
 
-		const double step = 1.0 / convert_rate_to_int(buffer.params.rate);
-
-		for (auto& sample : buffer.data)
+		// Generate a band limited sawtooth wave
+		values_.resize(buffer.data.size());
+		oscillator_.generate(values_.data(), values_.size(), convert_rate_to_int(buffer.params.rate));
+		for (size_t i = 0; i < buffer.data.size(); ++i)
 		{
-			// Generate a sawtooth wave sample
-			sample = static_cast<int16_t>(max_val * (2.0 * (time_ * frequency_ - std::floor(time_ * frequency_ + 0.5))));
-
-			time_ = std::fmod(time_ + step, 1.0 / frequency_);
+			buffer.data[i] = static_cast<int16_t>(max_val * values_[i]);
 		}
 
 		buffer.valid_samples = buffer.data.size();
@@ -661,12 +378,12 @@ public:
 	}
 
 private:
-	double frequency_;
-	double time_;
+	iimavlib::Oscillator oscillator_;
+	std::vector<float> values_;
 
 	void reinitialize() override
 	{
-		time_ = 0.0f;
+		oscillator_.set_phase(0.0);
 	}
 };
 
@@ -680,7 +397,7 @@ private:
 class SquareAdder : public AudioFilter, public ToggleableFilter
 {
 public:
-	SquareAdder(const pAudioFilter& child, float frequency) : AudioFilter(child), frequency_(frequency), time_(0.0f)
+	SquareAdder(const pAudioFilter& child, float frequency) : AudioFilter(child), oscillator_(iimavlib::waveform_t::square, frequency)
 	{
 	}
 
@@ -690,33 +407,32 @@ public:
 		if (!is_enabled())
 			return error_type_t::ok;
 
-		const double step = 1.0 / convert_rate_to_int(buffer.params.rate);
-
-		for (auto& sample : buffer.data)
+		values_.resize(buffer.data.size());
+		oscillator_.generate(values_.data(), values_.size(), convert_rate_to_int(buffer.params.rate));
+		for (size_t i = 0; i < buffer.data.size(); ++i)
 		{
-			// Insead of overwriting sample data, add out own generated signal to it, so the original
+			// Instead of overwriting sample data, add our own generated signal to it, so the original
 			// signal doesn't get lost.
-			sample += static_cast<int16_t>(std::copysignl(max_val, std::sin(time_ * frequency_ * pi2)));
-			time_ = time_ + step;
+			buffer.data[i] += static_cast<int16_t>(max_val * values_[i]);
 		}
 		buffer.valid_samples = buffer.data.size();
 		return error_type_t::ok;
 	}
 
 private:
-	double frequency_;
-	double time_;
+	iimavlib::Oscillator oscillator_;
+	std::vector<float> values_;
 
 	void reinitialize() override
 	{
-		time_ = 0.0f;
+		oscillator_.set_phase(0.0);
 	}
 };
 
 class SawtoothAdder : public AudioFilter, public ToggleableFilter
 {
 public:
-	SawtoothAdder(const pAudioFilter& child, float frequency) : AudioFilter(child), frequency_(frequency), time_(0.0f)
+	SawtoothAdder(const pAudioFilter& child, float frequency) : AudioFilter(child), oscillator_(iimavlib::waveform_t::sawtooth, frequency)
 	{
 	}
 
@@ -726,42 +442,32 @@ public:
 		if (!is_enabled())
 			return error_type_t::ok;
 
-		const double step = 1.0 / convert_rate_to_int(buffer.params.rate);
-
-		for (auto& sample : buffer.data)
+		values_.resize(buffer.data.size());
+		oscillator_.generate(values_.data(), values_.size(), convert_rate_to_int(buffer.params.rate));
+		for (size_t i = 0; i < buffer.data.size(); ++i)
 		{
 			// Instead of overwriting sample data, add our own generated signal to it, so the original
 			// signal doesn't get lost.
-			sample += static_cast<int16_t>(std::copysignl(max_val, sawtooth_wave(time_, frequency_)));
-			time_ = time_ + step;
+			buffer.data[i] += static_cast<int16_t>(max_val * values_[i]);
 		}
 		buffer.valid_samples = buffer.data.size();
 		return error_type_t::ok;
 	}
 
 private:
-	double frequency_;
-	double time_;
+	iimavlib::Oscillator oscillator_;
+	std::vector<float> values_;
 
 	void reinitialize() override
 	{
-		time_ = 0.0f;
-	}
-
-	// Function to generate a sawtooth wave
-	double sawtooth_wave(double time, double frequency)
-	{
-		// Implement the sawtooth wave generation logic here
-		// You can use different mathematical formulas to generate a sawtooth wave
-		// For example, you can use the modulus function to create a sawtooth shape
-		return 2.0 * (time * frequency - std::floor(time * frequency + 0.5));
+		oscillator_.set_phase(0.0);
 	}
 };
 
 class TriangleAdder : public AudioFilter, public ToggleableFilter
 {
 public:
-	TriangleAdder(const pAudioFilter& child, float frequency) : AudioFilter(child), frequency_(frequency), time_(0.0f)
+	TriangleAdder(const pAudioFilter& child, float frequency) : AudioFilter(child), oscillator_(iimavlib::waveform_t::triangle, frequency)
 	{
 	}
 
@@ -771,35 +477,25 @@ public:
 		if (!is_enabled())
 			return error_type_t::ok;
 
-		const double step = 1.0 / convert_rate_to_int(buffer.params.rate);
-
-		for (auto& sample : buffer.data)
+		values_.resize(buffer.data.size());
+		oscillator_.generate(values_.data(), values_.size(), convert_rate_to_int(buffer.params.rate));
+		for (size_t i = 0; i < buffer.data.size(); ++i)
 		{
 			// Instead of overwriting sample data, add our own generated signal to it, so the original
 			// signal doesn't get lost.
-			sample += static_cast<int16_t>(std::copysignl(max_val, triangle_wave(time_, frequency_)));
-			time_ = time_ + step;
+			buffer.data[i] += static_cast<int16_t>(max_val * values_[i]);
 		}
 		buffer.valid_samples = buffer.data.size();
 		return error_type_t::ok;
 	}
 
 private:
-	double frequency_;
-	double time_;
+	iimavlib::Oscillator oscillator_;
+	std::vector<float> values_;
 
 	void reinitialize() override
 	{
-		time_ = 0.0f;
-	}
-
-	// Function to generate a triangle wave
-	double triangle_wave(double time, double frequency)
-	{
-		// Implement the triangle wave generation logic here
-		// You can use different mathematical formulas to generate a triangle wave
-		// For example, you can use the modulus function to create a triangle shape
-		return std::fmod(2.0 * time * frequency, 2.0) - 1.0;
+		oscillator_.set_phase(0.0);
 	}
 };
 
@@ -813,16 +509,12 @@ class Control : public SDLDevice, public midi::Midi, public AudioFilter
 {
 public:
 	Control(const pAudioFilter& child, int width, int height, int instruments, int steps, float loop_length) : SDLDevice(width, height, "Sequencer"),
-		AudioFilter(child), instruments_(instruments), steps_(steps), last_step_(-1), loop_length_(loop_length), time_(0.0f), data_(width, height)
+		AudioFilter(child), timespec_(10.0f / 1000.0f), instruments_(instruments), steps_(steps), last_step_(-1), loop_length_(loop_length), time_(0.0f),
+		events_(256), frame_(0), loop_position_(0), end_(false), stft_(frame_size(timespec_, get_params()), frame_size(timespec_, get_params()) / 2), data_(width, height)
 	{
-		timespec_ = 10.0f / 1000.0f;
 		sequence_.resize(instruments * steps, false);
 
-		const audio_params_t& params = get_params();
-		cache_size_ = static_cast<size_t>(timespec_ * convert_rate_to_int(params.rate));
-		cache_size_ = static_cast<size_t>(pow(2, ceil(log2(cache_size_))) * 2);
-		logger[log_level::info] << "Cache size: " << cache_size_;
-		sample_cache_.resize(cache_size_);
+		logger[log_level::info] << "Frame size: " << stft_.get_size() << ", hop: " << stft_.get_hop();
 		barwidth = 40;
 		x_count = 0;
 		height_ = height / 2;
@@ -830,10 +522,10 @@ public:
 
 		thread_ = std::thread(std::bind(&Control::execute_thread, this));
 		time_elapsed = 0.000f;
-		const auto max_int16_value = std::numeric_limits<int16_t>::max();
 		load_file(sequence_, "sequence.dat");
 
-		magic_constant = 1.0f / 16384.0f / max_int16_value;
+		// Brightness of the normalized magnitudes
+		magic_constant = 3.0f;
 
 		SDLDevice::start();
 
@@ -854,23 +546,29 @@ private:
 	int last_step_;
 	double loop_length_;
 	double time_;
+	/// Toggles of the instruments (their indices) from the key handler, applied in the audio thread
+	event_queue_t<int> events_;
+	/// Number of samples processed so far
+	std::atomic<uint64_t> frame_;
+	/// Position in the loop, in samples
+	uint64_t loop_position_;
 	std::thread thread_;
-	std::mutex mutex_;
-	std::vector<audio_sample_t> sample_cache_;
 	int width_;
 	int x_count;
 	int height_;
 	int barwidth;
 	std::atomic<bool> end_;
-	std::atomic<bool> changed_;
-	size_t last_sample_;
-	size_t cache_size_;
 	std::vector<complexarray_t<float>> coefficient_array_entire;
 	float time_elapsed;
 	float whole;
 	float magic_constant;
 
-	AudioFFT<float> fft;
+	/// Spectrum of the output, a new frame for every hop of samples
+	STFT stft_;
+	/// Latest frame, used only by the drawing thread
+	std::vector<float> magnitudes_;
+	/// Brightness of the magnitudes in the latest frame
+	std::vector<float> levels_;
 
 	/// Video data
 	iimavlib::video_buffer_t data_;
@@ -882,7 +580,8 @@ private:
 		logger[log_level::debug] << "Drawing thread started";
 		while (!end_)
 		{
-			if (changed_)
+			// Redraw only when there's a new frame
+			if (stft_.read_frame(magnitudes_))
 			{
 				draw_wave();
 				draw_sequence();
@@ -900,22 +599,11 @@ private:
 		SDL_SaveBMP(surface, "screenshot.bmp");
 	}
 
-	void update_cache(const audio_buffer_t& buffer)
+	static size_t frame_size(double time, const audio_params_t& params)
 	{
-		std::unique_lock<std::mutex> lock(mutex_);
-		const audio_sample_t* src = &buffer.data[0];
-		size_t src_remaining = buffer.valid_samples;
-
-		while (src_remaining)
-		{
-			const size_t to_copy = std::min(src_remaining, sample_cache_.size() - last_sample_);
-			std::copy_n(src, to_copy, &sample_cache_[0] + last_sample_);
-			last_sample_ += to_copy;
-			if (last_sample_ >= sample_cache_.size())
-				last_sample_ = 0;
-			src_remaining -= to_copy;
-		}
-		changed_.store(true);
+		// Exact duration, rounded up to an even number of samples for the real FFT
+		const size_t samples = static_cast<size_t>(time * convert_rate_to_int(params.rate));
+		return std::max<size_t>(2, samples + (samples & 1));
 	}
 
 	void save_file(const std::vector<bool>& vec, const std::string& filename) {
@@ -954,30 +642,20 @@ private:
 
 	void draw_wave()
 	{
-		// Max value for int16_t
-
-		changed_.store(false);
-
-		// Array for the coefficients from FFT
-		complexarray_t<float> coefficient_array;
-		{
-			std::unique_lock<std::mutex> lock(mutex_);
-			coefficient_array = fft.FFT1D(sample_cache_.begin(), sample_cache_.end());
-		}
-
-		const auto unique_coefficients = (coefficient_array.size() + 1) / 2;
+		// Number of displayed magnitudes (the last one is for the Nyquist frequency)
+		const auto unique_coefficients = magnitudes_.size() - 1;
 
 		double loop_fraction = time_ / loop_length_;
 
+		// Brightness of all the magnitudes
+		assign(levels_, lazy(magnitudes_) * (255.0f * magic_constant));
+
 		for (int y = 0; y < height_; ++y)
 		{
 			const size_t coefficient_number = y * unique_coefficients / height_;
 
-			// Get value for the coefficient
-			auto coefficient = std::abs(coefficient_array[coefficient_number]) * magic_constant;
-			coefficient *= 100;
-
-			auto yycol = static_cast<int>(255 * (coefficient));
+			// Get brightness for the coefficient
+			auto yycol = static_cast<int>(levels_[coefficient_number]);
 
 			std::vector<int> colr = { 1, 0, 0 };
 			colr[0] = int(yycol);
@@ -1037,32 +715,41 @@ private:
 		draw_line(data_, rectangle_t(static_cast<int>(loop_fraction * data_.size.width), (data_.size.height / 2)), rectangle_t(static_cast<int>(loop_fraction * data_.size.width), (data_.size.height)), rgb_t(255, 255, 0));
 		// blit(data_);
 	}
-	inline int current_step()
+	/// Length of the loop in samples
+	uint64_t loop_frames(const audio_params_t& params) const
 	{
-		return static_cast<int>(steps_ * time_ / loop_length_);
+		return static_cast<uint64_t>(loop_length_ * convert_rate_to_int(params.rate) + 0.5);
 	}
 
 	/**
 	 * Overrides the parent method. This is where we perform the actual actions of enabling/disabling generators.
-	 * We also trigger a redraw here.
+	 * The buffer is split at the step boundaries and at the toggles, so the generators
+	 * (which are processed for each part separately) change exactly at the right sample.
 	 */
-	error_type_t do_process(audio_buffer_t& buffer) override
+	size_t do_split(const audio_params_t& params, size_t count) override
 	{
-		if (SDLDevice::is_stopped())
-			return error_type_t::failed;
-		// Not touching the data, simply passing it through
-		// But update graphics and control generators
-
-		// Update our loop time (and loop it if appropriate)
-		time_ += buffer.valid_samples * 1.0 / convert_rate_to_int(buffer.params.rate);
-		if (time_ > loop_length_)
-			time_ -= loop_length_;
+		const uint64_t loop = loop_frames(params);
+		loop_position_ %= loop;
+		const int cur_step = static_cast<int>(loop_position_ * steps_ / loop);
+		bool changed = cur_step != last_step_;
 
-		update_cache(buffer);
+		// Apply the toggles due at the current sample
+		event_queue_t<int>::event_t event;
+		while (events_.pop(frame_.load() + 1, event))
+		{
+			const int filter_index = event.data;
+			if (filter_index < 2) {
+				// The effects are toggled for the whole loop
+				for (int i = 0; i < steps_; i++) {
+					sequence_[i * instruments_ + filter_index] = !sequence_[i * instruments_ + filter_index];
+				}
+			} else {
+				sequence_[cur_step * instruments_ + filter_index] = !sequence_[cur_step * instruments_ + filter_index];
+			}
+			changed = true;
+		}
 
-		// Get our current step and check if we want any generators enabled
-		int cur_step = current_step();
-		if (cur_step != last_step_)
+		if (changed)
 		{
 			for (int i = 0; i < instruments_; ++i)
 			{
@@ -1070,16 +757,31 @@ private:
 				std::shared_ptr<ToggleableFilter> filter = std::dynamic_pointer_cast<ToggleableFilter>(get_child(i));
 				filter->set_enabled(sequence_[cur_step * instruments_ + i]);
 			}
-
-
 			// We only enable/disable at step boundary to save some processing, so we have to remember which step we just processed
 			last_step_ = cur_step;
 		}
 
+		// First sample of the next step
+		const uint64_t next_step = ((cur_step + 1) * loop + steps_ - 1) / steps_;
+		return std::min<size_t>(static_cast<size_t>(next_step - loop_position_), events_.distance(frame_.load(), count));
+	}
 
+	/**
+	 * Overrides the parent method, updates the loop position. We also trigger a redraw here.
+	 */
+	error_type_t do_process(audio_buffer_t& buffer) override
+	{
+		if (SDLDevice::is_stopped())
+			return error_type_t::failed;
+		// Not touching the data, simply passing it through
+		// But update graphics
 
+		// Update our loop time (and loop it if appropriate)
+		frame_ += buffer.valid_samples;
+		loop_position_ = (loop_position_ + buffer.valid_samples) % loop_frames(buffer.params);
+		time_ = loop_position_ * 1.0 / convert_rate_to_int(buffer.params.rate);
 
-
+		stft_.push(buffer);
 
 		return error_type_t::ok;
 	}
@@ -1122,21 +824,8 @@ private:
 		// Calculate the filter index based on the position of the key in the QWERTZ layout
 		int filter_index = std::max(std::min(instruments_, static_cast<int>(std::distance(qwertz_keys.begin(), it))), 0);
 		//std::cout << filter_index << "\n";
-		int cur_step = current_step();
-		if (filter_index == 0) {
-			for (int i = 0; i < steps_; i++) {
-				sequence_[i * instruments_ + filter_index] = !sequence_[i * instruments_ + filter_index];
-			}
-			return true;
-		}
-		if (filter_index == 1) {
-			for (int i = 0; i < steps_; i++) {
-				sequence_[i * instruments_ + filter_index] = !sequence_[i * instruments_ + filter_index];
-			}
-			return true;
-		}
-		sequence_[cur_step * instruments_ + filter_index] = !sequence_[cur_step * instruments_ + filter_index];
-
+		// The sequence is changed in the audio thread, at the beginning of the next buffer
+		events_.push(frame_.load(), filter_index);
 
 		return true;
 	}
@@ -1154,6 +843,8 @@ try
 	{
 		device_id = iimavlib::simple_cast<iimavlib::audio_id_t>(argv[1]);
 	}
+	// Optional impulse response for the reverb
+	const std::string impulse_response = argc > 2 ? argv[2] : "";
 
 	auto sink = iimavlib::filter_chain<MIDIFrequencyGenerator>()
 
@@ -1165,8 +856,8 @@ try
 		.add<MySimpleEchoFilter>(1.0, 0.1)
 
 
-		.add<MySimpleReverbFilter>(0.1, 0.25)
-		//.add<MySimpleLowPassFilter>(80.0, 40.0)
+		.add<MyReverbFilter>(impulse_response, 0.3, 1.0)
+		//.add<MySimpleLowPassFilter>(0.25, 4000.0)
 
 
 
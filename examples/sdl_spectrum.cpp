@@ -7,7 +7,8 @@
  *
  */
 
-#include "iimavlib/AudioFFT.h"
+#include "iimavlib/STFT.h"
+#include "iimavlib/SpectrumKernels.h"
 #include "iimavlib/AudioTypes.h"
 
 #include "iimavlib/SDLDevice.h"
@@ -29,13 +30,10 @@ class Spectrum: public AudioFilter {
 public:
 	Spectrum(const pAudioFilter& child, int width, int height, double time):
 			AudioFilter(child),sdl_(width, height),data_(width,height),width_(width),height_(height),
-			time_(time),end_(false),changed_(false),last_sample_(0),cache_size_(0)
+			time_(time),end_(false),stft_(frame_size(time, get_params()), frame_size(time, get_params()) / 4),
+			smoother_(stft_.get_size() / 2 + 1, 1.0f, 0.3f, 0.5f)
 		{
-			const audio_params_t& params = get_params();
-			cache_size_ = static_cast<size_t>(time_*convert_rate_to_int(params.rate));
-			cache_size_ = static_cast<size_t>(pow(2,ceil(log2(cache_size_)))*2);
-			logger[log_level::info] << "Cache size: " << cache_size_;
-			sample_cache_.resize(cache_size_);
+			logger[log_level::info] << "Frame size: " << stft_.get_size() << ", hop: " << stft_.get_hop();
 			barwidth = 40;
 			sdl_.start();
 			thread_ = std::thread(std::bind(&Spectrum::execute_thread,this));
@@ -47,17 +45,25 @@ public:
 		}
 
 	private:
+		static size_t frame_size(double time, const audio_params_t& params)
+		{
+			// Exact duration, rounded up to an even number of samples for the real FFT
+			const size_t samples = static_cast<size_t>(time*convert_rate_to_int(params.rate));
+			return std::max<size_t>(2, samples + (samples & 1));
+		}
 		error_type_t do_process(audio_buffer_t& buffer)
 		{
 			if (end_) return error_type_t::failed;
 
-			update_cache(buffer);
+			// Computes a new spectrum for every hop of samples
+			stft_.push(buffer);
 			return error_type_t::ok;
 		}
 		void execute_thread() {
 			logger[log_level::debug] << "Drawing thread started";
 			while (!end_) {
-				if (changed_) {
+				// Redraw only when there's a new frame
+				if (stft_.read_frame(magnitudes_)) {
 						draw_wave();
 				}
 				if (!sdl_.blit(data_)) {
@@ -67,56 +73,35 @@ public:
 			}
 		}
 
-		void update_cache(const audio_buffer_t& buffer) {
-			std::unique_lock<std::mutex> lock(mutex_);
-			const audio_sample_t *src = &buffer.data[0];
-			size_t src_remaining = buffer.valid_samples;
-			while (src_remaining) {
-				const size_t to_copy = std::min(src_remaining, sample_cache_.size()-last_sample_);
-				std::copy_n(src,to_copy,&sample_cache_[0]+last_sample_);
-				last_sample_+=to_copy;
-				if (last_sample_ >= sample_cache_.size()) last_sample_ = 0;
-				src_remaining-=to_copy;
-			}
-			changed_.store(true);
-		}
-
 		void draw_wave() {
-			// Max value for int16_t
-			const auto max_int16_value = std::numeric_limits<int16_t>::max();
 			// Black color
 			const rgb_t black(0, 0, 0);
 
-			const float magic_constant = 1.0f / 16384.0f / max_int16_value;
-			changed_.store(false);
 			data_.clear(black);
 
-			// Array for the coefficients from FFT
-			complexarray_t<float> coefficient_array;
-			{
-				std::unique_lock<std::mutex> lock(mutex_);
-				coefficient_array = fft.FFT1D(sample_cache_.begin(), sample_cache_.end());
-			}
+			// Number of displayed magnitudes (the last one is for the Nyquist frequency)
+			const auto unique_coefficients = magnitudes_.size() - 1;
 
-			// Number of unique coefficients
-			const auto unique_coefficients = (coefficient_array.size() + 1) / 2;
+			// Convert the magnitudes to decibels (0 dB for a full scale sine wave),
+			// bars fall slowly and the peaks are held for a while
+			magnitudes_to_decibels(magnitudes_.data(), magnitudes_.data(), magnitudes_.size(), floor_db);
+			smoother_.update(magnitudes_);
+
+			// Calculate heights of bars for all the magnitudes, limited to interval <0, height_ -1>
+			assign(heights_, clamp(height_ * (lazy(smoother_.get_values()) / floor_db), 0.0f, height_ - 1.0f));
+			assign(peaks_, clamp(height_ * (lazy(smoother_.get_peaks()) / floor_db), 0.0f, height_ - 1.0f));
 
 			// This loop calculated the heights of displayed bars
 			for (int x = 0; x < width_; ++x) {
 				// Calculate the index of coefficient to display in this bar
 				const size_t coefficient_number = x * unique_coefficients / width_;
 
-				// Get value for the coefficient
-				const auto coefficient = std::abs(coefficient_array[coefficient_number]) * magic_constant;
-
-				// And calculate bar height
-				auto y = static_cast<int>(height_ * (1.0f - coefficient));
-
-				// Limit the bar height to interval <0, height_ -1>
-				y = std::min(height_ - 1, std::max(y, 0));
+				// Get height of the bar
+				const auto y = static_cast<int>(heights_[coefficient_number]);
 
-				// And draw the bar
+				// And draw the bar with its peak
 				draw_bars(x, y);
+				draw_peak(x, static_cast<int>(peaks_[coefficient_number]));
 
 			}
 
@@ -130,23 +115,34 @@ public:
 			iimavlib::draw_rectangle(data_,rectangle_t(x, y, barwidth/10, height_-y),rgb_t(255,0,0));
 		}
 
+		void draw_peak(int x, int y) {
+			iimavlib::draw_rectangle(data_,rectangle_t(x, y, barwidth/10, 1),rgb_t(255,255,0));
+		}
+
 		SDLDevice sdl_;
 		video_buffer_t data_;
 		std::thread thread_;
-		std::mutex mutex_;
-		std::vector<audio_sample_t> sample_cache_;
 		int width_;
 		int height_;
 		int barwidth;
 		double time_;
 		std::atomic<bool> end_;
-		std::atomic<bool> changed_;
-		size_t last_sample_;
-		size_t cache_size_;
 
-		AudioFFT<float> fft;
+		STFT stft_;
+		/// Latest frame, used only by the drawing thread
+		std::vector<float> magnitudes_;
+		/// Smoothed levels and peaks in decibels
+		SpectrumSmoother smoother_;
+		/// Heights of the bars and of the peaks for the latest frame
+		std::vector<float> heights_;
+		std::vector<float> peaks_;
+
+		/// Level displayed at the bottom of the window
+		static const float floor_db;
 };
 
+const float Spectrum::floor_db = -80.0f;
+
 int main(int argc, char** argv)
 {
 	if (argc<2) {
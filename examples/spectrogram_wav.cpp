@@ -0,0 +1,60 @@
+/*
+ * spectrogram_wav.cpp
+ *
+ *  Created on: 29.10.2026
+ *      Author: neneko
+ *
+ * Computes spectrogram of a WAV file with increasing number of threads and reports the throughput.
+ */
+
+
+#include "iimavlib/Spectrogram.h"
+#include "iimavlib/WaveFile.h"
+#include "iimavlib/Utils.h"
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+
+int main(int argc, char** argv)
+try
+{
+	using namespace iimavlib;
+	/* ******************************************************************
+	 *                Process command line parameters
+	 ****************************************************************** */
+	if (argc<2) {
+		logger[log_level::fatal] << "Not enough parameters. Specify the wave file (and optionally frame size and hop).";
+		return 1;
+	}
+
+	const std::string filename (argv[1]);
+	const size_t size = argc > 2 ? simple_cast<size_t>(argv[2]) : 2048;
+	const size_t hop = argc > 3 ? simple_cast<size_t>(argv[3]) : size / 4;
+	const size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+	/* ******************************************************************
+	 *                Compute the spectrogram with 1, 2, 4 ... threads
+	 ****************************************************************** */
+	std::cout << std::setw(8) << "threads" << std::setw(10) << "frames" << std::setw(12) << "time [s]"
+			<< std::setw(14) << "frames/s" << std::setw(10) << "speedup" << "\n";
+	double single = 0.0;
+	for (size_t threads = 1; ; threads = std::min(threads * 2, cores)) {
+		WaveFile wav(filename);
+		Spectrogram spectrogram(spectrogram_params_t(size, hop, window_type_t::hann, threads));
+		const spectrogram_t result = spectrogram.compute(wav);
+		if (threads == 1) single = result.frames_per_second();
+		std::cout << std::setw(8) << threads << std::setw(10) << result.frames
+				<< std::setw(12) << std::fixed << std::setprecision(3) << result.seconds
+				<< std::setw(14) << std::setprecision(0) << result.frames_per_second()
+				<< std::setw(9) << std::setprecision(2) << (single > 0.0 ? result.frames_per_second() / single : 0.0) << "x\n";
+		if (threads == cores) break;
+	}
+}
+catch (std::exception& e)
+{
+	using namespace iimavlib;
+	logger[log_level::fatal] << "Spectrogram failed: " << e.what();
+	return 1;
+}
@@ -0,0 +1,239 @@
+/**
+ * @file 	ArrayExpressions.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file defines lazily evaluated element-wise operations on arrays
+ */
+
+#ifndef INCLUDE_IIMAVLIB_ARRAYEXPRESSIONS_H_
+#define INCLUDE_IIMAVLIB_ARRAYEXPRESSIONS_H_
+
+#include "iimavlib/AudioTypes.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace iimavlib {
+
+/*
+ * Arithmetic operators and functions applied to an expression don't compute anything,
+ * they only build a (small, copyable) description of the computation. All the operations
+ * are computed for each element in a single loop when the expression is assigned to an array,
+ * so there are no temporary arrays and the compiler can vectorize the loop.
+ *
+ * Arrays are turned to expressions by lazy(). The operators are defined only for expressions,
+ * so operator+ on std::vector keeps its meaning (concatenation).
+ *
+ *   std::vector<float> db(spectrum.size());
+ *   assign(db, clamp(20.0f * log10(abs(lazy(spectrum)) * scale), -100.0f, 0.0f));
+ */
+namespace expressions {
+
+/// Base of all the expressions, @em E is the type of the expression
+template<class E>
+struct array_expr_t {
+	const E& self() const { return static_cast<const E&>(*this); }
+};
+
+/// Elements of an array (not owned by the expression)
+template<class T>
+struct terminal_t: array_expr_t<terminal_t<T> > {
+	typedef T value_type;
+	terminal_t(const T* data, size_t size):data_(data),size_(size) {}
+	size_t size() const { return size_; }
+	T operator[](size_t i) const { return data_[i]; }
+private:
+	const T* data_;
+	size_t size_;
+};
+
+/// Scalar used as an operand of an array operation
+template<class T>
+struct scalar_t: array_expr_t<scalar_t<T> > {
+	typedef T value_type;
+	explicit scalar_t(T value):value_(value) {}
+	/// Scalars match arrays of any size
+	size_t size() const { return 0; }
+	T operator[](size_t) const { return value_; }
+private:
+	T value_;
+};
+
+template<class Op, class E>
+struct unary_t: array_expr_t<unary_t<Op, E> > {
+	typedef decltype(Op::apply(std::declval<typename E::value_type>())) value_type;
+	explicit unary_t(const E& e):e_(e) {}
+	size_t size() const { return e_.size(); }
+	value_type operator[](size_t i) const { return Op::apply(e_[i]); }
+private:
+	E e_;
+};
+
+template<class Op, class L, class R>
+struct binary_t: array_expr_t<binary_t<Op, L, R> > {
+	typedef decltype(Op::apply(std::declval<typename L::value_type>(), std::declval<typename R::value_type>())) value_type;
+	binary_t(const L& l, const R& r):l_(l),r_(r) {
+		if (l_.size() && r_.size() && l_.size() != r_.size()) {
+			throw std::runtime_error("Expression Error: sizes of the arrays don't match");
+		}
+	}
+	size_t size() const { return l_.size() ? l_.size() : r_.size(); }
+	value_type operator[](size_t i) const { return Op::apply(l_[i], r_[i]); }
+private:
+	L l_;
+	R r_;
+};
+
+/*
+ * Operations on single elements
+ */
+struct plus_op { template<class A, class B> static auto apply(A a, B b) -> decltype(a + b) { return a + b; } };
+struct minus_op { template<class A, class B> static auto apply(A a, B b) -> decltype(a - b) { return a - b; } };
+struct multiplies_op { template<class A, class B> static auto apply(A a, B b) -> decltype(a * b) { return a * b; } };
+struct divides_op { template<class A, class B> static auto apply(A a, B b) -> decltype(a / b) { return a / b; } };
+struct min_op { template<class A> static A apply(A a, A b) { return b < a ? b : a; } };
+struct max_op { template<class A> static A apply(A a, A b) { return a < b ? b : a; } };
+struct negate_op { template<class A> static A apply(A a) { return -a; } };
+
+/// Absolute value, magnitude of complex numbers (without the overflow checks of std::abs)
+struct abs_op {
+	template<class A> static A apply(A a) { return std::abs(a); }
+	template<class A> static A apply(std::complex<A> a) { return std::sqrt(a.real() * a.real() + a.imag() * a.imag()); }
+};
+/// Squared absolute value (power)
+struct norm_op {
+	template<class A> static A apply(A a) { return a * a; }
+	template<class A> static A apply(std::complex<A> a) { return a.real() * a.real() + a.imag() * a.imag(); }
+};
+struct sqrt_op { template<class A> static A apply(A a) { return std::sqrt(a); } };
+struct log10_op { template<class A> static A apply(A a) { return std::log10(a); } };
+struct exp_op { template<class A> static A apply(A a) { return std::exp(a); } };
+
+/*
+ * Operators, for two expressions or for an expression and a scalar.
+ * Scalars are converted to the type of elements of the expression.
+ */
+#define IIMAVLIB_EXPRESSION_OPERATOR(op, name) \
+template<class L, class R> \
+binary_t<name, L, R> operator op(const array_expr_t<L>& l, const array_expr_t<R>& r) \
+	{ return binary_t<name, L, R>(l.self(), r.self()); } \
+template<class L> \
+binary_t<name, L, scalar_t<typename L::value_type> > operator op(const array_expr_t<L>& l, typename L::value_type r) \
+	{ return binary_t<name, L, scalar_t<typename L::value_type> >(l.self(), scalar_t<typename L::value_type>(r)); } \
+template<class R> \
+binary_t<name, scalar_t<typename R::value_type>, R> operator op(typename R::value_type l, const array_expr_t<R>& r) \
+	{ return binary_t<name, scalar_t<typename R::value_type>, R>(scalar_t<typename R::value_type>(l), r.self()); }
+
+IIMAVLIB_EXPRESSION_OPERATOR(+, plus_op)
+IIMAVLIB_EXPRESSION_OPERATOR(-, minus_op)
+IIMAVLIB_EXPRESSION_OPERATOR(*, multiplies_op)
+IIMAVLIB_EXPRESSION_OPERATOR(/, divides_op)
+#undef IIMAVLIB_EXPRESSION_OPERATOR
+
+template<class E>
+unary_t<negate_op, E> operator-(const array_expr_t<E>& e) { return unary_t<negate_op, E>(e.self()); }
+
+/*
+ * Functions
+ */
+#define IIMAVLIB_EXPRESSION_FUNCTION(function, name) \
+template<class E> \
+unary_t<name, E> function(const array_expr_t<E>& e) { return unary_t<name, E>(e.self()); }
+
+IIMAVLIB_EXPRESSION_FUNCTION(abs, abs_op)
+IIMAVLIB_EXPRESSION_FUNCTION(norm, norm_op)
+IIMAVLIB_EXPRESSION_FUNCTION(sqrt, sqrt_op)
+IIMAVLIB_EXPRESSION_FUNCTION(log10, log10_op)
+IIMAVLIB_EXPRESSION_FUNCTION(exp, exp_op)
+#undef IIMAVLIB_EXPRESSION_FUNCTION
+
+/// Element-wise minimum of an expression and a scalar
+template<class E>
+binary_t<min_op, E, scalar_t<typename E::value_type> > min(const array_expr_t<E>& e, typename E::value_type value)
+{
+	return binary_t<min_op, E, scalar_t<typename E::value_type> >(e.self(), scalar_t<typename E::value_type>(value));
+}
+
+/// Element-wise maximum of an expression and a scalar
+template<class E>
+binary_t<max_op, E, scalar_t<typename E::value_type> > max(const array_expr_t<E>& e, typename E::value_type value)
+{
+	return binary_t<max_op, E, scalar_t<typename E::value_type> >(e.self(), scalar_t<typename E::value_type>(value));
+}
+
+/// Limits the elements to interval <low, high>
+template<class E>
+auto clamp(const array_expr_t<E>& e, typename E::value_type low, typename E::value_type high)
+	-> decltype(min(max(e, low), high))
+{
+	return min(max(e, low), high);
+}
+
+}
+
+/// Returns expression with elements of an array
+template<class T>
+expressions::terminal_t<T> lazy(const std::vector<T>& v)
+{
+	return expressions::terminal_t<T>(v.data(), v.size());
+}
+
+template<class T>
+expressions::terminal_t<typename std::remove_const<T>::type> lazy(array_view_t<T> v)
+{
+	return expressions::terminal_t<typename std::remove_const<T>::type>(v.data(), v.size());
+}
+
+/**
+ * @brief Computes all the elements of an expression, storing them to @em output
+ *
+ * Throws std::runtime_error when size of @em output doesn't match size of the expression.
+ */
+template<class T, class E>
+void assign(array_view_t<T> output, const expressions::array_expr_t<E>& e)
+{
+	const E& expression = e.self();
+	const size_t size = output.size();
+	if (expression.size() != size) {
+		throw std::runtime_error("Expression Error: size of the output doesn't match the expression");
+	}
+	T* data = output.data();
+	for (size_t i = 0; i < size; ++i) data[i] = static_cast<T>(expression[i]);
+}
+
+/**
+ * @brief Computes all the elements of an expression to a vector, resized to size of the expression
+ *
+ * No memory is allocated when the vector has sufficient capacity.
+ */
+template<class T, class E>
+void assign(std::vector<T>& output, const expressions::array_expr_t<E>& e)
+{
+	output.resize(e.self().size());
+	assign(array_view_t<T>(output), e);
+}
+
+/// Returns elements of an expression converted to T
+template<class T, class E>
+std::vector<T> evaluate(const expressions::array_expr_t<E>& e)
+{
+	std::vector<T> output;
+	assign(output, e);
+	return output;
+}
+
+template<class E>
+std::vector<typename E::value_type> evaluate(const expressions::array_expr_t<E>& e)
+{
+	return evaluate<typename E::value_type>(e);
+}
+
+}
+
+#endif /* INCLUDE_IIMAVLIB_ARRAYEXPRESSIONS_H_ */
@@ -18,6 +18,7 @@
 #include <string>
 
 #include "Utils.h"
+#include "MatrixKernels.h"
 
 namespace iimavlib {
 
@@ -40,6 +41,97 @@ std::ostream & operator<<(std::ostream &o, const complexarray_t<T>& v);
 template <class T>
 std::ostream & operator<<(std::ostream &o, const simplearray_t<T>& v);
 
+/**
+ * @brief Non-owning view of a matrix stored by rows
+ *
+ * The rows don't have to be contiguous, @em stride is the distance between starts of two rows,
+ * so a view can refer to a block of a larger matrix. Like array_view_t, the view is valid
+ * only as long as the owner of the storage is alive.
+ */
+template <class T>
+class matrix_view_t {
+public:
+	matrix_view_t():
+		data_(nullptr), rows_(0), columns_(0), stride_(0)
+	{}
+	matrix_view_t(T* data, int rows, int columns, int stride = 0):
+		data_(data), rows_(rows), columns_(columns), stride_(stride ? stride : columns)
+	{}
+	/// View of an array with @em rows * @em columns elements, throws std::runtime_error for other sizes
+	matrix_view_t(array_view_t<T> v, int rows, int columns = 1):
+		data_(v.data()), rows_(rows), columns_(columns), stride_(columns)
+	{
+		if (v.size() != static_cast<size_t>(rows * columns)) {
+			throw std::runtime_error("Wrong array dimmensions");
+		}
+	}
+	template <class U>
+	matrix_view_t(const matrix_view_t<U>& v):
+		data_(v.data()), rows_(v.rows()), columns_(v.columns()), stride_(v.stride())
+	{}
+
+	T* data() const { return data_; }
+	int rows() const { return rows_; }
+	int columns() const { return columns_; }
+	int stride() const { return stride_; }
+	bool contiguous() const { return stride_ == columns_ || rows_ < 2; }
+	T& operator()(int row, int column) const { return data_[row * stride_ + column]; }
+	array_view_t<T> row(int index) const { return array_view_t<T>(data_ + index * stride_, columns_); }
+	/// Returns view of @em rows x @em columns block starting at [row, column]
+	matrix_view_t block(int row, int column, int rows, int columns) const {
+		return matrix_view_t(data_ + row * stride_ + column, rows, columns, stride_);
+	}
+private:
+	T* data_;
+	int rows_;
+	int columns_;
+	int stride_;
+};
+
+/**
+ * @brief Multiplies matrices @em a and @em b, storing the result to @em c
+ *
+ * No memory is allocated, the storage of @em c has to be distinct from the inputs.
+ * Throws std::runtime_error when the dimensions don't match.
+ */
+template <class A, class B, class C>
+void multiply(const matrix_view_t<A>& a, const matrix_view_t<B>& b, const matrix_view_t<C>& c)
+{
+	if (a.columns() != b.rows() || c.rows() != a.rows() || c.columns() != b.columns()) {
+		throw std::runtime_error("Wrong dimensions of matrices in multiply");
+	}
+	typedef typename std::remove_const<A>::type a_type;
+	typedef typename std::remove_const<B>::type b_type;
+	matrix_kernels::gemm_t<a_type, b_type, C>::gemm(a.data(), a.stride(), b.data(), b.stride(),
+			c.data(), c.stride(), c.rows(), c.columns(), a.columns());
+}
+
+/**
+ * @brief Multiplies matrix @em a by vector @em x, storing the result to @em y
+ */
+template <class A, class B, class C>
+void multiply(const matrix_view_t<A>& a, array_view_t<B> x, array_view_t<C> y)
+{
+	if (x.size() != static_cast<size_t>(a.columns()) || y.size() != static_cast<size_t>(a.rows())) {
+		throw std::runtime_error("Wrong dimensions of vectors in multiply");
+	}
+	typedef typename std::remove_const<A>::type a_type;
+	typedef typename std::remove_const<B>::type b_type;
+	matrix_kernels::gemm_t<a_type, b_type, C>::gemv(a.data(), a.stride(), x.data(), y.data(), a.rows(), a.columns());
+}
+
+/**
+ * @brief Copies transposition of @em in to @em out, which has to have the transposed dimensions
+ */
+template <class A, class B>
+void transpose(const matrix_view_t<A>& in, const matrix_view_t<B>& out)
+{
+	if (in.rows() != out.columns() || in.columns() != out.rows()) {
+		throw std::runtime_error("Wrong dimensions of matrices in transpose");
+	}
+	matrix_kernels::transpose(in.data(), in.stride(), out.data(), out.stride(), in.rows(), in.columns());
+}
+
 template <class T>
 class matrix {
 	std::vector<T> m;
@@ -75,13 +167,26 @@ public:
 
 	void set_matrix(int rows, int columns);
 	matrix& sequence();
-	matrix<T> operator*(const matrix<T> &v);
+	matrix<T> operator*(const matrix<T> &v) const;
 	template <class U>
-	matrix<T> operator *(const simplearray_t<U> &v);
-	matrix<T> transpose();
+	matrix<T> operator *(const simplearray_t<U> &v) const;
+	matrix<T> transpose() const;
+	/// Transposes the matrix in place, without allocating a copy
 	matrix<T>& self_transpose();
 	T& operator[](int ix);
-	simplearray_t<T> data();
+	const T& operator[](int ix) const;
+	T& operator()(int row, int column) { return m[row * columns_ + column]; }
+	const T& operator()(int row, int column) const { return m[row * columns_ + column]; }
+	int rows() const { return rows_; }
+	int columns() const { return columns_; }
+	/// Returns the elements stored by rows, moved out of temporary matrices
+	const simplearray_t<T>& data() const & { return m; }
+	simplearray_t<T> data() && { return std::move(m); }
+	/// Returns views of the storage, valid until the matrix is resized or destroyed
+	matrix_view_t<T> view() { return matrix_view_t<T>(m.data(), rows_, columns_); }
+	matrix_view_t<const T> view() const { return matrix_view_t<const T>(m.data(), rows_, columns_); }
+	array_view_t<T> elements() { return array_view_t<T>(m); }
+	array_view_t<const T> elements() const { return array_view_t<const T>(m); }
 
 	/* *******************************************************************
 	 *     Methods for textual output
@@ -158,71 +263,39 @@ matrix<T>& matrix<T>::sequence() {
 }
 
 template<class T>
-matrix<T> matrix<T>::operator *(const matrix<T> &v) {
+matrix<T> matrix<T>::operator *(const matrix<T> &v) const {
 	if (v.rows_ != columns_) {
 		throw std::runtime_error("Wrong dimensions of second matrix in matrix::operator*");
 	}
-	const auto& columns2 = v.columns_;
-	matrix<T> w(rows_, columns2);
-	for(auto x = 0; x < rows_; ++x) {
-		for(auto y = 0; y < columns_; ++y) {
-			const auto index = x * columns2 + y;
-			w[index] = 0;
-			for(auto z = 0; z < columns_; ++z)
-				w[index] += m[x * columns_ + z] * v.m[z * columns2 + y];
-		}
-	}
+	matrix<T> w(rows_, v.columns_);
+	multiply(view(), v.view(), w.view());
 	return w;
 }
 
 template<class T>
 template <class U>
-matrix<T> matrix<T>::operator *(const simplearray_t<U> &v) {
+matrix<T> matrix<T>::operator *(const simplearray_t<U> &v) const {
 	if (v.size() != static_cast<size_t>(columns_)) {
 		throw std::runtime_error("Wrong dimensions of simple_array in matrix::operator*");
 	}
 
 	matrix<T> w(rows_, 1);
-	for(auto x = 0; x < rows_; ++x) {
-		const auto index = x;
-		w[index] = 0;
-		for(auto z = 0; z < columns_; ++z) {
-			w[index] += m[x * columns_ + z] * v[z];
-		}
-
-	}
+	multiply(view(), array_view_t<const U>(v), w.elements());
 	return w;
 }
 
-template<class T>
-simplearray_t<T> matrix<T>::data() {
-	return m;
-}
-
 template<class T>
 matrix<T>& matrix<T>::self_transpose() {
 	using std::swap;
-	if (rows_ == columns_) {
-		for(auto i=0;i<rows_;i++) {
-			for(auto j=i+1;j<columns_;j++) {
-				swap(m[j * columns_ + i], m[i * columns_ + j]);
-			}
-		}
-	} else {
-		auto transposed_matrix = transpose();
-		m = transposed_matrix.data();
-	}
+	matrix_kernels::transpose_in_place(m.data(), rows_, columns_);
 	swap(columns_, rows_);
 	return *this;
 }
 
 template<class T>
-matrix<T> matrix<T>::transpose() {
+matrix<T> matrix<T>::transpose() const {
 	matrix<T> w(columns_, rows_);
-	for(auto i = 0; i < rows_; ++i)
-		for(auto j = 0; j < columns_; ++j) {
-			w[j * rows_ + i] = m[i * columns_ + j];
-		}
+	iimavlib::transpose(view(), w.view());
 	return w;
 }
 
@@ -231,6 +304,11 @@ T& matrix<T>::operator [](int ix) {
 	return m[ix];
 }
 
+template<class T>
+const T& matrix<T>::operator [](int ix) const {
+	return m[ix];
+}
+
 template<class T>
 void matrix<T>::to() {
 	logger[log_level::info] << "TO:";
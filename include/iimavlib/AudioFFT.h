@@ -21,16 +21,62 @@ class AudioFFT: FFT<T> {
 public:
 	AudioFFT():FFT<T>::FFT(){}
 	complexarray_t<T> FFT1D(const std::vector<audio_sample_t>::iterator s, const std::vector<audio_sample_t>::iterator e);
+	/**
+	 * @brief Computes FFT of the left channel into a caller supplied array, without allocating memory for repeated calls.
+	 */
+	void FFT1D(const std::vector<audio_sample_t>::iterator s, const std::vector<audio_sample_t>::iterator e, complexarray_t<T>& result);
+	/**
+	 * @brief Computes FFT of the left channel, returning only the non-redundant N/2+1 bins.
+	 */
+	void RFFT1D(const std::vector<audio_sample_t>::iterator s, const std::vector<audio_sample_t>::iterator e, complexarray_t<T>& result);
+	/**
+	 * @brief Computes spectra of both channels with a single complex FFT, each of them has N/2+1 bins.
+	 */
+	void StereoFFT1D(const std::vector<audio_sample_t>::iterator s, const std::vector<audio_sample_t>::iterator e,
+			complexarray_t<T>& left, complexarray_t<T>& right);
+private:
+	// Left channel converted to T
+	simplearray_t<T> buffer_;
+	// Both channels packed to complex numbers
+	complexarray_t<T> complex_buffer_;
 };
 
 template<class T>
 complexarray_t<T> AudioFFT<T>::FFT1D(const std::vector<audio_sample_t>::iterator s, const std::vector<audio_sample_t>::iterator e) {
-	simplearray_t<T> bf;
-	bf.resize(std::distance(s, e));
+	complexarray_t<T> result;
+	FFT1D(s, e, result);
+	return result;
+}
+
+template<class T>
+void AudioFFT<T>::FFT1D(const std::vector<audio_sample_t>::iterator s, const std::vector<audio_sample_t>::iterator e, complexarray_t<T>& result) {
+	buffer_.resize(std::distance(s, e));
+
+	std::transform(s, e, buffer_.begin(), [](const audio_sample_t& sample){return sample.left;});
+
+	FFT<T>::FFT1D(buffer_, result);
+}
+
+template<class T>
+void AudioFFT<T>::RFFT1D(const std::vector<audio_sample_t>::iterator s, const std::vector<audio_sample_t>::iterator e, complexarray_t<T>& result) {
+	buffer_.resize(std::distance(s, e));
+
+	std::transform(s, e, buffer_.begin(), [](const audio_sample_t& sample){return sample.left;});
+
+	FFT<T>::RFFT1D(buffer_, result);
+}
+
+template<class T>
+void AudioFFT<T>::StereoFFT1D(const std::vector<audio_sample_t>::iterator s, const std::vector<audio_sample_t>::iterator e,
+		complexarray_t<T>& left, complexarray_t<T>& right) {
+	complex_buffer_.resize(std::distance(s, e));
 
-	std::transform(s, e, bf.begin(), [](const audio_sample_t& sample){return sample.left;});
+	std::transform(s, e, complex_buffer_.begin(), [](const audio_sample_t& sample){return std::complex<T>(sample.left, sample.right);});
 
-	return FFT<T>::FFT1D(bf);
+	const auto& fft_plan = FFT<T>::plan(complex_buffer_.size());
+	left.resize(complex_buffer_.size() / 2 + 1);
+	right.resize(complex_buffer_.size() / 2 + 1);
+	fft_plan.transform_pair(complex_buffer_.data(), left.data(), right.data(), FFT<T>::work_.data());
 }
 
 }
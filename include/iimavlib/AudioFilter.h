@@ -89,7 +89,26 @@ private:
 	 * @return Current parameters
 	 */
 	virtual audio_params_t do_get_params() const;
+	/**
+	 * @brief Splits buffers at events of the filter
+	 *
+	 * Called by @em process before processing a buffer and after each of its parts. The filter should apply
+	 * the events due at the current position (e.g. enable a generator among its children) and return
+	 * number of samples until the next event. When the returned value is smaller than @em count,
+	 * the child filters and @em do_process are called for each part of the buffer separately,
+	 * so the events take effect at the exact sample.
+	 * The default implementation returns @em count, so the buffers aren't split.
+	 *
+	 * @param params Parameters of the buffer
+	 * @param count Number of samples remaining in the buffer
+	 * @return Number of samples to process before the next event, values smaller than 1 are treated as 1
+	 */
+	virtual size_t do_split(const audio_params_t& params, size_t count);
+	/// Processes the buffer in parts, the first one has @em length samples
+	error_type_t process_parts(audio_buffer_t& buffer, size_t length);
 	pAudioFilter child_;
+	/// Part of the buffer processed by @em process_parts
+	audio_buffer_t part_;
 };
 
 
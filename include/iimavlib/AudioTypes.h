@@ -17,6 +17,7 @@
 #include <set>
 #include <stdexcept>
 #include <type_traits>
+#include <algorithm>
 #include "AudioSample.h"
 namespace iimavlib {
 
@@ -117,6 +118,47 @@ struct audio_buffer_t {
 	audio_buffer_t():valid_samples(0),empty(true),position(0) {}
 };
 
+/*!
+ * @brief Non-owning view of a contiguous array
+ *
+ * The view doesn't manage the lifetime of the data, so it's valid only as long
+ * as the owner of the underlying storage (vector, mapped file, ...) is alive.
+ */
+template<typename T>
+struct array_view_t {
+	typedef T value_type;
+	typedef T* iterator;
+
+	array_view_t():data_(nullptr),size_(0) {}
+	array_view_t(T* data, std::size_t size):data_(data),size_(size) {}
+	template<typename U>
+	array_view_t(std::vector<U>& v):data_(v.data()),size_(v.size()) {}
+	template<typename U>
+	array_view_t(const std::vector<U>& v):data_(v.data()),size_(v.size()) {}
+	template<typename U>
+	array_view_t(const array_view_t<U>& v):data_(v.data()),size_(v.size()) {}
+
+	T* data() const { return data_; }
+	std::size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+	T* begin() const { return data_; }
+	T* end() const { return data_ + size_; }
+	T& operator[](std::size_t i) const { return data_[i]; }
+
+	/*!
+	 * @brief Returns view of a part of the array, clamped to the size of this view
+	 * @param offset Index of the first element
+	 * @param count Maximal number of elements
+	 */
+	array_view_t subview(std::size_t offset, std::size_t count) const {
+		if (offset >= size_) return array_view_t(data_ + size_, 0);
+		return array_view_t(data_ + offset, std::min(count, size_ - offset));
+	}
+private:
+	T* data_;
+	std::size_t size_;
+};
+
 template<typename T>
 struct circular_buffer_t {
 	std::vector<T> data;
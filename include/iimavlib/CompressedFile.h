@@ -0,0 +1,181 @@
+/**
+ * @file 	CompressedFile.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares reading and writing of losslessly compressed audio files
+ */
+
+#ifndef COMPRESSEDFILE_H_
+#define COMPRESSEDFILE_H_
+
+#include "AudioTypes.h"
+#include "PlatformDefs.h"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace iimavlib {
+
+/**
+ * @brief Header of compressed audio files
+ *
+ * The header is followed by independently decodable frames, each starting with
+ * @em compressed_frame_header_t. All frames except the last one contain @em frame_size samples.
+ * Finalized files end with a seek table (offsets of all frames as 64bit integers).
+ */
+PACKED_PRE
+struct compressed_header_t
+{
+	char magic[4];
+	uint16_t version;
+	uint16_t channels;
+	uint32_t rate;
+	uint32_t frame_size;
+	/// Total number of samples, 0 if the file wasn't finalized
+	uint64_t sample_count;
+	/// Offset of the seek table, 0 if the file wasn't finalized
+	uint64_t seek_table;
+	compressed_header_t(uint32_t rate = 44100, uint32_t frame_size = 4096):
+		version(1),channels(2),rate(rate),frame_size(frame_size),sample_count(0),seek_table(0)
+	{
+		std::copy_n("IIAC",4,magic);
+	}
+	bool valid() const { return std::equal(magic, magic+4, "IIAC") && version == 1 && channels == 2; }
+} PACKED;
+
+/**
+ * @brief Header of a single compressed frame
+ */
+PACKED_PRE
+struct compressed_frame_header_t
+{
+	/// Size of the compressed data following the header
+	uint32_t size;
+	/// Number of samples in the frame
+	uint16_t samples;
+	/// Stereo decorrelation used in the frame
+	uint8_t channel_mode;
+	uint8_t reserved;
+} PACKED;
+
+/**
+ * @brief Lossless compressed audio file
+ *
+ * The codec uses fixed polynomial linear predictors (orders 0 - 4) chosen per channel and frame,
+ * stereo decorrelation (left/side, side/right, mid/side) and adaptive Rice coding of the residuals.
+ * Typical music compresses to 50 - 70% of the size of 16bit WAV
+ * and the decoding is cheap enough to run many streams in parallel.
+ * Files that weren't finalized properly (e.g. after a crash) are recovered up to the last complete frame.
+ */
+class EXPORT CompressedFile
+{
+#ifdef SYSTEM_LINUX
+	CompressedFile() = delete;
+	CompressedFile(const CompressedFile&) = delete;
+	CompressedFile& operator=(const CompressedFile&) = delete;
+#endif
+public:
+	/**
+	 * @brief Constructor for writing a compressed file
+	 *
+	 * Throws std::runtime_exception if it faild to create the file
+	 * @param filename Name of the file to write to
+	 * @param params Parameters of the data
+	 * @param frame_size Number of samples in one frame. Smaller frames allow finer seeking, but compress worse.
+	 */
+	CompressedFile(const std::string& filename, audio_params_t params, size_t frame_size = default_frame_size);
+
+	/**
+	 * @brief Constructor for reading a compressed file
+	 *
+	 * Throws std::runtime_exception when the file doesn't exist or isn't a valid compressed file.
+	 * @param filename Name of the file to read
+	 */
+	CompressedFile(const std::string& filename);
+
+	/**
+	 * @brief Destructor, writes out buffered samples and finalizes the file
+	 */
+	~CompressedFile();
+
+	/**
+	 * @brief Adds data to the file
+	 * @param data Buffer containing samples for writing
+	 * @param sample_count Number of samples in the buffer. Set to 0 to use the whole buffer.
+	 * @return Returns error_type_t::ok when written successfully
+	 */
+	error_type_t store_data(const std::vector<audio_sample_t>& data, size_t sample_count = 0);
+
+	/**
+	 * @brief Reads data from the file
+	 * @param data Buffer to store the samples to
+	 * @param sample_count Number of samples to read. Contains number of samples actually read after the call.
+	 * @return Returns error_type_t::ok when read successfully, error_type_t::failed for corrupted data
+	 */
+	error_type_t read_data(std::vector<audio_sample_t>& data, size_t& sample_count);
+
+	/**
+	 * @brief Sets read position
+	 *
+	 * Only the frame containing the position is decoded.
+	 * @param position Index of the next sample to read
+	 */
+	error_type_t seek(uint64_t position);
+
+	/**
+	 * @brief Returns params corresponding to current file
+	 */
+	audio_params_t get_params() const;
+
+	/**
+	 * @brief Returns number of samples in the file (including buffered ones when writing)
+	 */
+	uint64_t get_sample_count() const;
+
+	/**
+	 * @brief Returns index of the next sample to read
+	 */
+	uint64_t get_position() const { return position_; }
+
+	/**
+	 * @brief Returns number of frames in the file
+	 */
+	size_t get_frame_count() const { return frame_offsets_.size(); }
+
+	/// Default number of samples in a frame
+	static const size_t default_frame_size = 4096;
+	/// Size of the buffer used for file I/O
+	static const size_t io_buffer_size = 256*1024;
+
+private:
+	compressed_header_t header_;
+	audio_params_t params_;
+	/// Buffer of the file stream, has to outlive @em file_
+	std::vector<char> io_buffer_;
+	std::fstream file_;
+	bool write_mode_;
+	/// Offsets of all frames in the file
+	std::vector<uint64_t> frame_offsets_;
+	/// Samples waiting for encoding, or decoded samples of the current frame
+	std::vector<audio_sample_t> samples_;
+	/// Encoded (or read) frame data
+	std::vector<uint8_t> frame_data_;
+	/// Prediction residuals and decoded channels
+	std::vector<int32_t> scratch_;
+	/// Position of the next sample within @em samples_ when reading
+	size_t frame_position_;
+	/// Index of the frame following the last one read from the file
+	size_t next_frame_;
+	/// Index of the next sample to read
+	uint64_t position_;
+
+	error_type_t write_frame(const audio_sample_t* samples, size_t count);
+	error_type_t read_frame(size_t index);
+	void scan_frames(uint64_t file_size);
+};
+
+}
+
+#endif /* COMPRESSEDFILE_H_ */
@@ -0,0 +1,30 @@
+/**
+ * @file 	CompressedSink.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file defines sink filter for compressed audio files
+ */
+
+#ifndef COMPRESSEDSINK_H_
+#define COMPRESSEDSINK_H_
+
+#include "AudioSink.h"
+#include "CompressedFile.h"
+#include <string>
+namespace iimavlib {
+
+class EXPORT CompressedSink: public AudioSink
+{
+public:
+	CompressedSink(const pAudioFilter& child, const std::string& filename);
+	CompressedSink(const pAudioFilter& child, const std::string& filename, const audio_params_t& params);
+	virtual ~CompressedSink();
+private:
+	virtual error_type_t do_run();
+	virtual error_type_t do_process(audio_buffer_t& buffer);
+	CompressedFile file_;
+};
+
+}
+#endif /* COMPRESSEDSINK_H_ */
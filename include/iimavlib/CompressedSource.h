@@ -0,0 +1,45 @@
+/**
+ * @file 	CompressedSource.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file defines source filter for compressed audio files
+ */
+
+#ifndef COMPRESSEDSOURCE_H_
+#define COMPRESSEDSOURCE_H_
+
+#include "CompressedFile.h"
+#include "AudioFilter.h"
+#include <string>
+
+namespace iimavlib {
+class EXPORT CompressedSource: public AudioFilter {
+public:
+	/**
+	 * @brief Creates source decoding a compressed file
+	 * @param filename Name of the file to read
+	 */
+	CompressedSource(const std::string filename);
+	virtual ~CompressedSource();
+
+	/**
+	 * @brief Sets read position
+	 * @param position Index of the next sample to read
+	 */
+	error_type_t seek(uint64_t position);
+
+	/**
+	 * @brief Returns number of samples in the file
+	 */
+	uint64_t get_sample_count() const;
+
+private:
+	virtual error_type_t do_process(audio_buffer_t& buffer);
+	virtual audio_params_t do_get_params() const;
+	CompressedFile file_;
+};
+
+}
+
+#endif /* COMPRESSEDSOURCE_H_ */
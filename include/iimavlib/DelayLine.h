@@ -0,0 +1,146 @@
+/**
+ * @file 	DelayLine.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file defines delay line for echoes, reverbs and other delay based effects
+ */
+
+#ifndef DELAYLINE_H_
+#define DELAYLINE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace iimavlib {
+
+/*!
+ * @brief Delay line with power of 2 size and masked indexing
+ *
+ * The line keeps the last written values in a ring, so writing a value
+ * and reading an older one costs the same for any delay, nothing is ever moved.
+ * Delays are counted from the next written value: read(1) returns the value written last,
+ * read(capacity()) the oldest one, which is going to be overwritten by the next write.
+ *
+ * Fractional delays are interpolated, which requires T to be a floating point type
+ * (or a type with similar arithmetic operators).
+ * @tparam T Type of the stored values
+ */
+template<typename T>
+class delay_line_t {
+public:
+	/*!
+	 * @param max_delay Maximal delay (in samples) the line has to provide, including fractional delays.
+	 * The size is rounded up to a power of 2.
+	 */
+	delay_line_t(std::size_t max_delay = 1):position_(0)
+	{
+		resize(max_delay);
+	}
+
+	/*!
+	 * @brief Changes the maximal delay, clearing the line
+	 *
+	 * Memory is allocated only when the line has to grow.
+	 */
+	void resize(std::size_t max_delay) {
+		std::size_t size = 2;
+		// Cubic interpolation reads one value older than the delay
+		while (size < max_delay + 2) size <<= 1;
+		data_.assign(size, T());
+		mask_ = size - 1;
+		position_ = 0;
+	}
+
+	/// Sets all the stored values to T()
+	void clear() {
+		std::fill(data_.begin(), data_.end(), T());
+	}
+
+	/// Maximal integer delay
+	std::size_t capacity() const { return data_.size(); }
+
+	/// Appends a value to the line
+	void write(const T& value) {
+		data_[position_++ & mask_] = value;
+	}
+
+	/// Appends @em count values to the line
+	void write(const T* src, std::size_t count) {
+		// Only the last capacity() values would be kept anyway
+		if (count > capacity()) {
+			position_ += count - capacity();
+			src += count - capacity();
+			count = capacity();
+		}
+		const std::size_t first = position_ & mask_;
+		const std::size_t part1 = std::min(count, capacity() - first);
+		std::copy(src, src + part1, data_.begin() + first);
+		std::copy(src + part1, src + count, data_.begin());
+		position_ += count;
+	}
+
+	/// Returns value written @em delay writes ago, @em delay should be in interval <1, capacity()>
+	const T& read(std::size_t delay) const {
+		return data_[(position_ - delay) & mask_];
+	}
+
+	/*!
+	 * @brief Copies @em count consecutive values, starting with the one written @em delay writes ago
+	 *
+	 * @em count should be at most @em delay, so all the values were already written.
+	 */
+	void read(T* dst, std::size_t delay, std::size_t count) const {
+		const std::size_t first = (position_ - delay) & mask_;
+		const std::size_t part1 = std::min(count, capacity() - first);
+		std::copy(data_.begin() + first, data_.begin() + first + part1, dst);
+		std::copy(data_.begin(), data_.begin() + (count - part1), dst + part1);
+	}
+
+	/*!
+	 * @brief Returns linearly interpolated value for fractional delay
+	 *
+	 * @em delay should be in interval <1, capacity() - 1>.
+	 * The delay can change smoothly for every sample (e.g. for chorus or flanger).
+	 */
+	T read_linear(float delay) const {
+		const float whole = std::floor(delay);
+		const float fraction = delay - whole;
+		const std::size_t index = position_ - static_cast<std::size_t>(whole);
+		const T& newer = data_[index & mask_];
+		const T& older = data_[(index - 1) & mask_];
+		return newer + (older - newer) * fraction;
+	}
+
+	/*!
+	 * @brief Returns value for fractional delay interpolated by cubic Hermite spline
+	 *
+	 * Smoother than linear interpolation, suitable for pitch shifting and modulated delays.
+	 * @em delay should be in interval <2, capacity() - 2>.
+	 */
+	T read_cubic(float delay) const {
+		const float whole = std::floor(delay);
+		const float t = delay - whole;
+		const std::size_t index = position_ - static_cast<std::size_t>(whole);
+		const T& y0 = data_[(index + 1) & mask_];
+		const T& y1 = data_[index & mask_];
+		const T& y2 = data_[(index - 1) & mask_];
+		const T& y3 = data_[(index - 2) & mask_];
+		const T c1 = (y2 - y0) * 0.5f;
+		const T c2 = y0 - y1 * 2.5f + y2 * 2.0f - y3 * 0.5f;
+		const T c3 = (y3 - y0) * 0.5f + (y1 - y2) * 1.5f;
+		return y1 + ((c3 * t + c2) * t + c1) * t;
+	}
+
+private:
+	std::vector<T> data_;
+	std::size_t mask_;
+	/// Number of values written so far (modulo size of size_t), so the position in the ring is position_ & mask_
+	std::size_t position_;
+};
+
+}
+
+#endif /* DELAYLINE_H_ */
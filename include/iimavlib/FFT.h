@@ -11,18 +11,760 @@
 #define INCLUDE_IIMAVLIB_FFT_H_
 
 #include "iimavlib/ArrayTypes.h"
+#include "iimavlib/ArrayExpressions.h"
+#include "iimavlib/FFTKernels.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 namespace iimavlib {
 const int defaultWindowWidth = 64;
 
 template<class IN, class OUT>
 simplearray_t<OUT> powerSpectrum(const complexarray_t<IN> & coefficient_array) {
-	simplearray_t<OUT> spectrum;
-	for (const auto& coefficient: coefficient_array) {
-		spectrum.push_back(static_cast<OUT>(std::abs(coefficient)));
+	return evaluate<OUT>(abs(lazy(coefficient_array)));
+}
+
+/**
+ * @brief Window functions for spectral analysis
+ */
+enum class window_type_t: uint8_t {
+	rectangular,
+	hann,
+	hamming,
+	blackman
+};
+
+/**
+ * @brief Returns coefficients of a window function
+ *
+ * The windows are periodic (the value at index @em size would equal the first one),
+ * as used for frames overlapping by a fraction of their size.
+ */
+template<class T>
+simplearray_t<T> make_window(window_type_t type, size_t size)
+{
+	simplearray_t<T> window(size, static_cast<T>(1));
+	const double pi = 4.0 * std::atan(1.0);
+	for (size_t k = 0; k < size; ++k) {
+		const double x = 2.0 * pi * k / size;
+		switch (type) {
+			case window_type_t::hann: window[k] = static_cast<T>(0.5 - 0.5 * std::cos(x)); break;
+			case window_type_t::hamming: window[k] = static_cast<T>(0.54 - 0.46 * std::cos(x)); break;
+			case window_type_t::blackman: window[k] = static_cast<T>(0.42 - 0.5 * std::cos(x) + 0.08 * std::cos(2 * x)); break;
+			default: break;
+		}
+	}
+	return window;
+}
+
+/**
+ * @brief Algorithms used by FFT plans
+ */
+enum class fft_algorithm_t: uint8_t {
+	/// Radix-4 (and radix-2) butterflies for powers of 2
+	power_of_2,
+	/// Power of 2 butterflies followed by radix 3, 5 and 7 stages, for sizes without other prime factors
+	mixed_radix,
+	/// Chirp z-transform evaluated as a convolution by a larger FFT, for all other sizes
+	bluestein
+};
+
+/**
+ * @brief Precomputed tables for FFT of a single size
+ *
+ * Holds digit reversal permutation and twiddle factors for an iterative in-place FFT.
+ * Powers of 2 are transformed using radix-4 butterflies, with a single radix-2 stage for sizes that aren't powers of 4.
+ * For float and double the butterflies are vectorized (AVX2 or SSE2, see fft_kernels::butterflies_t),
+ * small transforms and other types use scalar code.
+ *
+ * Sizes with prime factors 2, 3, 5 and 7 only use mixed radix transform: the power of 2 part is transformed
+ * by the butterflies above, followed by a stage for every other factor (vectorized as well,
+ * see fft_kernels::odd_radix_t). Any other size is transformed
+ * by Bluestein's algorithm, using two transforms of at least double size (power of 2 or mixed radix).
+ *
+ * Transforms don't modify the plan, so single plan can be used from several threads at once.
+ * They don't allocate any memory, except a scratch buffer for Bluestein's algorithm
+ * when the caller doesn't supply one (of @em work_size() values) in the @em work parameter.
+ */
+template <class T>
+class fft_plan_t {
+public:
+	typedef std::complex<T> complex_t;
+
+	/**
+	 * @param size Number of points, larger than 0
+	 */
+	explicit fft_plan_t(size_t size);
+
+	/// Returns number of points of the transform
+	size_t size() const { return size_; }
+
+	/// Returns the algorithm used for the size
+	fft_algorithm_t algorithm() const { return algorithm_; }
+
+	/// Returns number of values in the scratch buffer used by the transforms (0 if they don't need any)
+	size_t work_size() const { return algorithm_ == fft_algorithm_t::bluestein ? inner_->size() : 0; }
+
+	/**
+	 * @brief Computes FFT in place
+	 * @param data Array of @em size() values
+	 */
+	void transform(complex_t* data) const { transform_in_place(data, nullptr); }
+
+	/**
+	 * @brief Computes FFT of complex data
+	 * @param in Input array of @em size() values
+	 * @param out Output array of @em size() values, must not overlap with @em in
+	 * @param work Scratch buffer of @em work_size() values, allocated by the transform if null
+	 */
+	void transform(const complex_t* in, complex_t* out, complex_t* work = nullptr) const;
+
+	/**
+	 * @brief Computes FFT of real data
+	 * @param in Input array of @em size() values
+	 * @param out Output array of @em size() values
+	 * @param work Scratch buffer of @em work_size() values, allocated by the transform if null
+	 */
+	void transform(const T* in, complex_t* out, complex_t* work = nullptr) const;
+
+	/**
+	 * @brief Computes spectra of two real signals using a single complex FFT
+	 *
+	 * As spectra of real signals are Hermitian symmetric, only first @em size()/2+1 bins are returned.
+	 * @param data Array of @em size() values, containing the first signal in real parts
+	 * 		and the second signal in imaginary parts. Overwritten by its FFT.
+	 * @param first Output array of @em size()/2+1 bins for the first signal
+	 * @param second Output array of @em size()/2+1 bins for the second signal
+	 * @param work Scratch buffer of @em work_size() values, allocated by the transform if null
+	 */
+	void transform_pair(complex_t* data, complex_t* first, complex_t* second, complex_t* work = nullptr) const;
+
+	/**
+	 * @brief Computes inverse FFT in place
+	 *
+	 * The result is divided by @em size(), so inverse of a transform returns the original data.
+	 * @param data Array of @em size() values
+	 */
+	void inverse(complex_t* data) const { inverse_in_place(data, nullptr); }
+
+	/**
+	 * @brief Computes inverse FFT
+	 * @param in Input array of @em size() values
+	 * @param out Output array of @em size() values, must not overlap with @em in
+	 * @param work Scratch buffer of @em work_size() values, allocated by the transform if null
+	 */
+	void inverse(const complex_t* in, complex_t* out, complex_t* work = nullptr) const;
+
+	/// Returns true if the transform uses vectorized butterflies
+	bool vectorized() const { return inner_ ? inner_->vectorized() : vectorized_; }
+
+	/// Returns name of the instruction set used by the vectorized butterflies for T
+	static const char* vector_extension() { return fft_kernels::vector_ops_t<T>::name(); }
+
+	/// Multiplies complex numbers
+	static complex_t multiply(const complex_t& a, const complex_t& b) {
+		// Plain formula, std::complex multiplication checks for infinities and NaNs
+		return complex_t(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+	}
+private:
+	/// Stage of mixed radix transform with an odd radix
+	struct radix_stage_t {
+		/// Radix (3, 5 or 7)
+		size_t radix;
+		/// Size of the transforms combined by the stage
+		size_t span;
+		/// Position of the twiddles of the stage in @em twiddles_
+		size_t twiddles;
+		/// cos(2*pi*q*k/radix) and sin(2*pi*q*k/radix) for k, q from 1 to (radix-1)/2
+		T cos[3][3];
+		T sin[3][3];
+		/// True if the stage is vectorized, using twiddles from @em vector_twiddles_
+		bool vectorized;
+		/// Position of the vector twiddles of the stage
+		size_t vector_twiddles;
+	};
+
+	void init_power_of_2();
+	void init_mixed_radix(size_t power_of_2, const std::vector<size_t>& radices);
+	void init_bluestein();
+	/// Reorders data in place to digit reversed order
+	void permute(complex_t* data) const;
+	void butterflies(complex_t* data) const;
+	template<size_t R>
+	void odd_stage(complex_t* data, const radix_stage_t& stage) const;
+	/// Scalar implementation of an odd radix stage, for blocks from @em first_block on
+	template<size_t R>
+	void radix_stage(complex_t* data, const radix_stage_t& stage, size_t first_block) const;
+	template <class U>
+	friend class real_fft_plan_t;
+
+	/// Computes FFT in place, @em work may be null
+	void transform_in_place(complex_t* data, complex_t* work) const;
+	/// Computes inverse FFT in place, @em work may be null
+	void inverse_in_place(complex_t* data, complex_t* work) const;
+	/// Replaces data by its FFT using Bluestein's algorithm, @em work may be null
+	void bluestein(complex_t* data, complex_t* work) const;
+
+	size_t size_;
+	fft_algorithm_t algorithm_;
+	/// Digit (bit for powers of 2) reversed indices
+	std::vector<uint32_t> bitrev_;
+	/// Pairs of indices swapped to reorder the data in place
+	std::vector<std::pair<uint32_t, uint32_t>> swaps_;
+	/**
+	 * Twiddles of radix-4 stages, (w, w^2, w^3) for every butterfly in a block, stages follow each other.
+	 * For mixed radix, twiddles of the odd radix stages, (w, ..., w^(radix-1)) for every butterfly.
+	 */
+	std::vector<complex_t> twiddles_;
+	/// True if the size isn't a power of 4, so the first stage is radix-2
+	bool radix2_;
+	/// True if vectorized butterflies are used
+	bool vectorized_;
+	/// Twiddles in the layout used by the vectorized butterflies (or the vectorized odd radix stages)
+	std::vector<T> vector_twiddles_;
+	/// Stages with odd radices for mixed radix transform
+	std::vector<radix_stage_t> stages_;
+	/// Plan for the power of 2 part of mixed radix transform, or the convolution in Bluestein's algorithm
+	std::shared_ptr<const fft_plan_t<T>> inner_;
+	/// exp(-i*pi*n^2/size) for Bluestein's algorithm
+	std::vector<complex_t> chirp_;
+	/// Spectrum of the conjugate chirp, divided by size of the inner transform
+	std::vector<complex_t> chirp_spectrum_;
+};
+
+template <class T>
+fft_plan_t<T>::fft_plan_t(size_t size):
+	size_(size),algorithm_(fft_algorithm_t::power_of_2),radix2_(false),vectorized_(false)
+{
+	if (size == 0 || size > (static_cast<size_t>(1) << 31)) {
+		throw std::runtime_error("FFT Error: the input number of samples must be between 1 and 2^31!");
+	}
+	size_t power_of_2 = 1;
+	size_t rest = size;
+	while (!(rest & 1)) {
+		rest >>= 1;
+		power_of_2 <<= 1;
+	}
+	std::vector<size_t> radices;
+	const size_t odd_radices[] = {3, 5, 7};
+	for (const auto radix: odd_radices) {
+		while (rest % radix == 0) {
+			rest /= radix;
+			radices.push_back(radix);
+		}
+	}
+	if (rest > 1) {
+		init_bluestein();
+	} else if (radices.empty()) {
+		init_power_of_2();
+	} else {
+		init_mixed_radix(power_of_2, radices);
+	}
+}
+
+template <class T>
+void fft_plan_t<T>::init_power_of_2()
+{
+	size_t bits = 0;
+	while ((static_cast<size_t>(1) << bits) < size_) ++bits;
+	bitrev_.resize(size_);
+	for (size_t i = 0; i < size_; ++i) {
+		uint32_t reversed = 0;
+		for (size_t b = 0; b < bits; ++b) {
+			if (i & (static_cast<size_t>(1) << b)) reversed |= 1u << (bits - 1 - b);
+		}
+		bitrev_[i] = reversed;
+		if (i < reversed) swaps_.push_back(std::make_pair(static_cast<uint32_t>(i), reversed));
+	}
+	radix2_ = bits & 1;
+	// Twiddles are computed in double precision, so the error doesn't grow with the size
+	const double pi = 4.0 * std::atan(1.0);
+	for (size_t quarter = radix2_ ? 2 : 1; quarter * 4 <= size_; quarter *= 4) {
+		for (size_t j = 0; j < quarter; ++j) {
+			const double angle = -2.0 * pi * j / (4 * quarter);
+			for (int k = 1; k <= 3; ++k) {
+				twiddles_.push_back(complex_t(static_cast<T>(std::cos(k * angle)), static_cast<T>(std::sin(k * angle))));
+			}
+		}
+	}
+	typedef fft_kernels::vector_butterflies_t<T> vector_butterflies;
+	if (vector_butterflies::available && size_ >= vector_butterflies::min_size()) {
+		vectorized_ = true;
+		vector_butterflies::make_twiddles(size_, vector_twiddles_);
+	}
+}
+
+template <class T>
+void fft_plan_t<T>::init_mixed_radix(size_t power_of_2, const std::vector<size_t>& radices)
+{
+	algorithm_ = fft_algorithm_t::mixed_radix;
+	inner_ = std::make_shared<fft_plan_t<T>>(power_of_2);
+
+	// Index n goes to the position given by its digits in reverse order, the last radix being the most significant.
+	// The power of 2 part consists of radix-2 digits, so each block of power_of_2 values is in bit reversed order.
+	std::vector<size_t> all_radices;
+	for (size_t p = power_of_2; p > 1; p >>= 1) all_radices.push_back(2);
+	all_radices.insert(all_radices.end(), radices.begin(), radices.end());
+	bitrev_.resize(size_);
+	for (size_t i = 0; i < size_; ++i) {
+		size_t n = i;
+		size_t span = size_;
+		size_t position = 0;
+		for (auto radix = all_radices.rbegin(); radix != all_radices.rend(); ++radix) {
+			span /= *radix;
+			position += (n % *radix) * span;
+			n /= *radix;
+		}
+		bitrev_[i] = static_cast<uint32_t>(position);
+	}
+	// In place reordering follows the cycles of the permutation
+	std::vector<bool> visited(size_, false);
+	for (size_t start = 0; start < size_; ++start) {
+		if (visited[start]) continue;
+		visited[start] = true;
+		for (size_t i = bitrev_[start]; i != start; i = bitrev_[i]) {
+			visited[i] = true;
+			swaps_.push_back(std::make_pair(static_cast<uint32_t>(start), static_cast<uint32_t>(i)));
+		}
+	}
+
+	const double pi = 4.0 * std::atan(1.0);
+	size_t span = power_of_2;
+	for (const auto radix: radices) {
+		radix_stage_t stage;
+		stage.radix = radix;
+		stage.span = span;
+		stage.twiddles = twiddles_.size();
+		for (size_t k = 1; 2 * k < radix; ++k) {
+			for (size_t q = 1; 2 * q < radix; ++q) {
+				stage.cos[k - 1][q - 1] = static_cast<T>(std::cos(2.0 * pi * q * k / radix));
+				stage.sin[k - 1][q - 1] = static_cast<T>(std::sin(2.0 * pi * q * k / radix));
+			}
+		}
+		typedef fft_kernels::vector_odd_radix_t<T> vector_odd_radix;
+		stage.vectorized = vector_odd_radix::supports(span);
+		stage.vector_twiddles = vector_twiddles_.size();
+		if (stage.vectorized) {
+			vector_odd_radix::make_twiddles(span, radix, vector_twiddles_);
+		} else {
+			for (size_t j = 0; j < span; ++j) {
+				for (size_t q = 1; q < radix; ++q) {
+					const double angle = -2.0 * pi * q * j / (span * radix);
+					twiddles_.push_back(complex_t(static_cast<T>(std::cos(angle)), static_cast<T>(std::sin(angle))));
+				}
+			}
+		}
+		stages_.push_back(stage);
+		span *= radix;
+	}
+}
+
+template <class T>
+void fft_plan_t<T>::init_bluestein()
+{
+	algorithm_ = fft_algorithm_t::bluestein;
+	// The linear convolution has 2*size-1 values. Power of 2 multiplied by a small odd number
+	// is transformed nearly as fast as a power of 2, and may be much closer to the required size.
+	const size_t required = 2 * size_ - 1;
+	size_t inner_size = 0;
+	const size_t odd_factors[] = {1, 3, 5, 9, 15};
+	for (const auto factor: odd_factors) {
+		size_t candidate = factor;
+		while (candidate < required) candidate <<= 1;
+		if (!inner_size || candidate < inner_size) inner_size = candidate;
+	}
+	inner_ = std::make_shared<fft_plan_t<T>>(inner_size);
+
+	const double pi = 4.0 * std::atan(1.0);
+	chirp_.resize(size_);
+	for (size_t n = 0; n < size_; ++n) {
+		// n^2 modulo 2*size keeps the angle small
+		const uint64_t square = (static_cast<uint64_t>(n) * n) % (2 * static_cast<uint64_t>(size_));
+		const double angle = -pi * static_cast<double>(square) / size_;
+		chirp_[n] = complex_t(static_cast<T>(std::cos(angle)), static_cast<T>(std::sin(angle)));
+	}
+	chirp_spectrum_.assign(inner_size, complex_t());
+	chirp_spectrum_[0] = std::conj(chirp_[0]);
+	for (size_t n = 1; n < size_; ++n) {
+		chirp_spectrum_[n] = chirp_spectrum_[inner_size - n] = std::conj(chirp_[n]);
+	}
+	inner_->transform(chirp_spectrum_.data());
+	const T scale = static_cast<T>(1) / static_cast<T>(inner_size);
+	for (auto& value: chirp_spectrum_) value *= scale;
+}
+
+template <class T>
+void fft_plan_t<T>::permute(complex_t* data) const
+{
+	for (const auto& swap: swaps_) {
+		std::swap(data[swap.first], data[swap.second]);
+	}
+}
+
+template <class T>
+void fft_plan_t<T>::transform_in_place(complex_t* data, complex_t* work) const
+{
+	if (algorithm_ == fft_algorithm_t::bluestein) {
+		bluestein(data, work);
+		return;
+	}
+	permute(data);
+	butterflies(data);
+}
+
+template <class T>
+void fft_plan_t<T>::transform(const complex_t* in, complex_t* out, complex_t* work) const
+{
+	if (algorithm_ == fft_algorithm_t::bluestein) {
+		std::copy(in, in + size_, out);
+		bluestein(out, work);
+		return;
+	}
+	for (size_t i = 0; i < size_; ++i) {
+		out[bitrev_[i]] = in[i];
+	}
+	butterflies(out);
+}
+
+template <class T>
+void fft_plan_t<T>::transform(const T* in, complex_t* out, complex_t* work) const
+{
+	if (algorithm_ == fft_algorithm_t::bluestein) {
+		for (size_t i = 0; i < size_; ++i) out[i] = complex_t(in[i], 0);
+		bluestein(out, work);
+		return;
+	}
+	for (size_t i = 0; i < size_; ++i) {
+		out[bitrev_[i]] = complex_t(in[i], 0);
+	}
+	butterflies(out);
+}
+
+template <class T>
+void fft_plan_t<T>::transform_pair(complex_t* data, complex_t* first, complex_t* second, complex_t* work) const
+{
+	transform_in_place(data, work);
+	const size_t N = size_;
+	// Z = A + iB, so A[k] = (Z[k] + conj(Z[N-k])) / 2 and B[k] = (Z[k] - conj(Z[N-k])) / 2i
+	for (size_t k = 0; k <= N / 2; ++k) {
+		const complex_t z = data[k];
+		const complex_t zc = std::conj(data[k ? N - k : 0]);
+		first[k] = (z + zc) * static_cast<T>(0.5);
+		const complex_t d = (z - zc) * static_cast<T>(0.5);
+		second[k] = complex_t(d.imag(), -d.real());
+	}
+}
+
+template <class T>
+void fft_plan_t<T>::inverse_in_place(complex_t* data, complex_t* work) const
+{
+	// Inverse FFT is FFT of the data with swapped real and imaginary parts, swapped back
+	for (size_t i = 0; i < size_; ++i) {
+		data[i] = complex_t(data[i].imag(), data[i].real());
+	}
+	transform_in_place(data, work);
+	const T scale = static_cast<T>(1) / static_cast<T>(size_);
+	for (size_t i = 0; i < size_; ++i) {
+		data[i] = complex_t(data[i].imag() * scale, data[i].real() * scale);
+	}
+}
+
+template <class T>
+void fft_plan_t<T>::inverse(const complex_t* in, complex_t* out, complex_t* work) const
+{
+	if (algorithm_ == fft_algorithm_t::bluestein) {
+		std::copy(in, in + size_, out);
+		inverse_in_place(out, work);
+		return;
+	}
+	for (size_t i = 0; i < size_; ++i) {
+		out[bitrev_[i]] = complex_t(in[i].imag(), in[i].real());
+	}
+	butterflies(out);
+	const T scale = static_cast<T>(1) / static_cast<T>(size_);
+	for (size_t i = 0; i < size_; ++i) {
+		out[i] = complex_t(out[i].imag() * scale, out[i].real() * scale);
+	}
+}
+
+template <class T>
+void fft_plan_t<T>::butterflies(complex_t* data) const
+{
+	if (algorithm_ == fft_algorithm_t::mixed_radix) {
+		const size_t block_size = inner_->size();
+		if (block_size > 1) {
+			for (size_t block = 0; block < size_; block += block_size) {
+				inner_->butterflies(data + block);
+			}
+		}
+		for (const auto& stage: stages_) {
+			switch (stage.radix) {
+				case 3: odd_stage<3>(data, stage); break;
+				case 5: odd_stage<5>(data, stage); break;
+				default: odd_stage<7>(data, stage); break;
+			}
+		}
+		return;
+	}
+	if (vectorized_) {
+		// std::complex<T> is guaranteed to have the same layout as an array of two T
+		fft_kernels::vector_butterflies_t<T>::run(reinterpret_cast<T*>(data), size_, vector_twiddles_.data());
+		return;
+	}
+	const size_t N = size_;
+	if (radix2_) {
+		for (size_t i = 0; i < N; i += 2) {
+			const complex_t a = data[i];
+			const complex_t b = data[i + 1];
+			data[i] = a + b;
+			data[i + 1] = a - b;
+		}
+	}
+	const complex_t* twiddles = twiddles_.data();
+	for (size_t quarter = radix2_ ? 2 : 1; quarter * 4 <= N; quarter *= 4) {
+		// Two radix-2 stages merged into one pass over the data
+		for (size_t block = 0; block < N; block += 4 * quarter) {
+			complex_t* d = data + block;
+			for (size_t j = 0; j < quarter; ++j) {
+				const complex_t* w = twiddles + 3 * j;
+				const complex_t a0 = d[j];
+				const complex_t a1 = multiply(d[j + quarter], w[1]);
+				const complex_t a2 = multiply(d[j + 2 * quarter], w[0]);
+				const complex_t a3 = multiply(d[j + 3 * quarter], w[2]);
+				const complex_t s01 = a0 + a1;
+				const complex_t d01 = a0 - a1;
+				const complex_t s23 = a2 + a3;
+				// (a2 - a3) multiplied by -i
+				const complex_t d23(a2.imag() - a3.imag(), a3.real() - a2.real());
+				d[j] = s01 + s23;
+				d[j + quarter] = d01 + d23;
+				d[j + 2 * quarter] = s01 - s23;
+				d[j + 3 * quarter] = d01 - d23;
+			}
+		}
+		twiddles += 3 * quarter;
 	}
+}
 
-	return spectrum;
+template <class T>
+template <size_t R>
+void fft_plan_t<T>::odd_stage(complex_t* data, const radix_stage_t& stage) const
+{
+	typedef fft_kernels::vector_odd_radix_t<T> vector_odd_radix;
+	T* values = reinterpret_cast<T*>(data);
+	if (stage.vectorized) {
+		vector_odd_radix::template run<R>(values, size_, stage.span, vector_twiddles_.data() + stage.vector_twiddles,
+				stage.cos, stage.sin);
+		return;
+	}
+	// Short butterflies are vectorized across blocks, the remaining blocks use scalar code
+	const size_t processed = vector_odd_radix::template run_blocks<R>(values, size_ / (R * stage.span), stage.span,
+			reinterpret_cast<const T*>(twiddles_.data() + stage.twiddles), stage.cos, stage.sin);
+	radix_stage<R>(data, stage, processed);
+}
+
+template <class T>
+template <size_t R>
+void fft_plan_t<T>::radix_stage(complex_t* data, const radix_stage_t& stage, size_t first_block) const
+{
+	// Symmetric form of R-point DFT: X[k] and X[R-k] share sums of x[q] + x[R-q] and x[q] - x[R-q]
+	const size_t H = (R - 1) / 2;
+	T cos[H][H];
+	T sin[H][H];
+	for (size_t k = 0; k < H; ++k) {
+		for (size_t q = 0; q < H; ++q) {
+			cos[k][q] = stage.cos[k][q];
+			sin[k][q] = stage.sin[k][q];
+		}
+	}
+	const size_t span = stage.span;
+	const complex_t* twiddles = twiddles_.data() + stage.twiddles;
+	for (size_t block = first_block * R * span; block < size_; block += R * span) {
+		complex_t* d = data + block;
+		for (size_t j = 0; j < span; ++j) {
+			const complex_t* w = twiddles + (R - 1) * j;
+			T re[R];
+			T im[R];
+			re[0] = d[j].real();
+			im[0] = d[j].imag();
+			for (size_t q = 1; q < R; ++q) {
+				const complex_t x = multiply(d[j + q * span], w[q - 1]);
+				re[q] = x.real();
+				im[q] = x.imag();
+			}
+			T sum_re[H], sum_im[H], difference_re[H], difference_im[H];
+			T total_re = re[0];
+			T total_im = im[0];
+			for (size_t q = 1; q <= H; ++q) {
+				sum_re[q - 1] = re[q] + re[R - q];
+				sum_im[q - 1] = im[q] + im[R - q];
+				difference_re[q - 1] = re[q] - re[R - q];
+				difference_im[q - 1] = im[q] - im[R - q];
+				total_re += sum_re[q - 1];
+				total_im += sum_im[q - 1];
+			}
+			d[j] = complex_t(total_re, total_im);
+			for (size_t k = 0; k < H; ++k) {
+				T a_re = re[0];
+				T a_im = im[0];
+				T b_re = 0;
+				T b_im = 0;
+				for (size_t q = 0; q < H; ++q) {
+					a_re += sum_re[q] * cos[k][q];
+					a_im += sum_im[q] * cos[k][q];
+					b_re += difference_re[q] * sin[k][q];
+					b_im += difference_im[q] * sin[k][q];
+				}
+				// a - i*b and a + i*b
+				d[j + (k + 1) * span] = complex_t(a_re + b_im, a_im - b_re);
+				d[j + (R - k - 1) * span] = complex_t(a_re - b_im, a_im + b_re);
+			}
+		}
+	}
+}
+
+template <class T>
+void fft_plan_t<T>::bluestein(complex_t* data, complex_t* work) const
+{
+	// X[k] = c[k] * sum(x[n] * c[n] * conj(c[k-n])) with c[n] = exp(-i*pi*n^2/N), the sum is a convolution
+	const size_t M = inner_->size();
+	std::vector<complex_t> buffer;
+	if (!work) {
+		buffer.resize(M);
+		work = buffer.data();
+	}
+	for (size_t n = 0; n < size_; ++n) {
+		work[n] = multiply(data[n], chirp_[n]);
+	}
+	std::fill(work + size_, work + M, complex_t());
+	inner_->transform(work);
+	// Inverse transform as conjugate of a transform of the conjugate, the scale is included in the spectrum
+	for (size_t k = 0; k < M; ++k) {
+		work[k] = std::conj(multiply(work[k], chirp_spectrum_[k]));
+	}
+	inner_->transform(work);
+	for (size_t k = 0; k < size_; ++k) {
+		data[k] = multiply(std::conj(work[k]), chirp_[k]);
+	}
+}
+
+/**
+ * @brief Precomputed tables for FFT of real signals
+ *
+ * The signal is transformed as a complex signal of half the size (even samples in real parts,
+ * odd samples in imaginary parts), followed by a pass separating the spectra.
+ * It's roughly twice as fast as complex FFT of the same size. Only the non-redundant
+ * @em size()/2+1 bins are computed, the rest of the spectrum is their complex conjugate.
+ */
+template <class T>
+class real_fft_plan_t {
+public:
+	typedef std::complex<T> complex_t;
+
+	/**
+	 * @param size Number of points, has to be even (at least 2)
+	 */
+	explicit real_fft_plan_t(size_t size);
+
+	/// Returns number of points of the transform
+	size_t size() const { return size_; }
+
+	/// Returns number of output bins
+	size_t bins() const { return size_ / 2 + 1; }
+
+	/// Returns number of values in the scratch buffer used by the transforms (0 if they don't need any)
+	size_t work_size() const { return half_.work_size(); }
+
+	/**
+	 * @brief Computes FFT of real data
+	 * @param in Input array of @em size() values
+	 * @param out Output array of @em bins() values, must not overlap with @em in
+	 * @param work Scratch buffer of @em work_size() values, allocated by the transform if null
+	 */
+	void transform(const T* in, complex_t* out, complex_t* work = nullptr) const;
+
+	/**
+	 * @brief Computes inverse FFT of a Hermitian symmetric spectrum, giving real data
+	 *
+	 * The result is divided by @em size(), so inverse of a transform returns the original data.
+	 * @param in Input array of @em bins() values
+	 * @param out Output array of @em size() values, must not overlap with @em in
+	 * @param work Scratch buffer of @em work_size() values, allocated by the transform if null
+	 */
+	void inverse(const complex_t* in, T* out, complex_t* work = nullptr) const;
+
+private:
+	size_t size_;
+	fft_plan_t<T> half_;
+	/// Twiddles for separating the spectra, exp(-2i*pi*k/size) for k <= size/4
+	std::vector<complex_t> twiddles_;
+};
+
+template <class T>
+real_fft_plan_t<T>::real_fft_plan_t(size_t size):
+	size_(size),half_(size < 2 ? 0 : size / 2)
+{
+	if (size & 1) {
+		throw std::runtime_error("FFT Error: the number of samples for real FFT must be even!");
+	}
+	const double pi = 4.0 * std::atan(1.0);
+	for (size_t k = 0; k <= size / 4; ++k) {
+		const double angle = -2.0 * pi * k / size;
+		twiddles_.push_back(complex_t(static_cast<T>(std::cos(angle)), static_cast<T>(std::sin(angle))));
+	}
+}
+
+template <class T>
+void real_fft_plan_t<T>::transform(const T* in, complex_t* out, complex_t* work) const
+{
+	// Array of T can be accessed as an array of complex numbers with half the size
+	half_.transform(reinterpret_cast<const complex_t*>(in), out, work);
+	const size_t M = size_ / 2;
+	const T half = static_cast<T>(0.5);
+	const complex_t z0 = out[0];
+	out[0] = complex_t(z0.real() + z0.imag(), 0);
+	out[M] = complex_t(z0.real() - z0.imag(), 0);
+	// Bins k and M-k are computed from the same pair of values, so the pass can work in place
+	for (size_t k = 1; k <= M / 2; ++k) {
+		const complex_t z = out[k];
+		const complex_t zc = std::conj(out[M - k]);
+		const complex_t even = (z + zc) * half;
+		const complex_t d = (z - zc) * half;
+		// (z - zc) / 2i
+		const complex_t odd(d.imag(), -d.real());
+		const complex_t t = fft_plan_t<T>::multiply(twiddles_[k], odd);
+		out[k] = even + t;
+		out[M - k] = std::conj(even - t);
+	}
+}
+
+template <class T>
+void real_fft_plan_t<T>::inverse(const complex_t* in, T* out, complex_t* work) const
+{
+	// Reverses the separation of spectra, giving spectrum of the even samples in real parts
+	// and the odd samples in imaginary parts, which is transformed back by complex inverse FFT
+	complex_t* z = reinterpret_cast<complex_t*>(out);
+	const size_t M = size_ / 2;
+	const T half = static_cast<T>(0.5);
+	const complex_t a0 = in[0];
+	const complex_t b0 = std::conj(in[M]);
+	const complex_t even0 = (a0 + b0) * half;
+	const complex_t odd0 = (a0 - b0) * half;
+	z[0] = complex_t(even0.real() - odd0.imag(), even0.imag() + odd0.real());
+	// Value for M-k is conj(even) + i*conj(odd), where even and odd are the values for k
+	for (size_t k = 1; k <= M / 2; ++k) {
+		const complex_t a = in[k];
+		const complex_t b = std::conj(in[M - k]);
+		const complex_t even = (a + b) * half;
+		const complex_t odd = fft_plan_t<T>::multiply((a - b) * half, std::conj(twiddles_[k]));
+		z[k] = complex_t(even.real() - odd.imag(), even.imag() + odd.real());
+		z[M - k] = complex_t(even.real() + odd.imag(), odd.real() - even.imag());
+	}
+	half_.inverse_in_place(z, work);
 }
 
 template <class T>
@@ -38,6 +780,50 @@ public:
 
 	complexarray_t<T> DFT1D(const simplearray_t<T> &ab);
 	complexarray_t<T> FFT1D(const simplearray_t<T> &ab);
+	/**
+	 * @brief Computes FFT into a caller supplied array.
+	 *
+	 * Memory is allocated only when the size changes, so repeated calls don't allocate.
+	 * @param ab Input samples of any nonzero size
+	 * @param result Output array, resized to the size of the input
+	 */
+	void FFT1D(const simplearray_t<T> &ab, complexarray_t<T>& result);
+
+	/**
+	 * @brief Computes FFT of real samples, returning only the non-redundant @em N/2+1 bins.
+	 *
+	 * Roughly twice as fast as @em FFT1D. Repeated calls don't allocate memory.
+	 * @param ab Input samples, the number of samples must be even (at least 2)
+	 * @param result Output array, resized to N/2+1
+	 */
+	void RFFT1D(const simplearray_t<T> &ab, complexarray_t<T>& result);
+	complexarray_t<T> RFFT1D(const simplearray_t<T> &ab);
+
+	/**
+	 * @brief Computes inverse FFT, so that IFFT1D(FFT1D(x)) equals x.
+	 * @param ab Input coefficients of any nonzero size
+	 * @param result Output array, resized to the size of the input
+	 */
+	void IFFT1D(const complexarray_t<T> &ab, complexarray_t<T>& result);
+	complexarray_t<T> IFFT1D(const complexarray_t<T> &ab);
+
+	/**
+	 * @brief Computes inverse of @em RFFT1D, giving real samples.
+	 * @param ab Non-redundant N/2+1 coefficients, N is even (at least 2)
+	 * @param result Output array, resized to N
+	 */
+	void IRFFT1D(const complexarray_t<T> &ab, simplearray_t<T>& result);
+	simplearray_t<T> IRFFT1D(const complexarray_t<T> &ab);
+
+	/**
+	 * @brief Returns plan for FFT of given size. The plan is kept for following transforms of the same size.
+	 */
+	const fft_plan_t<T>& plan(size_t size);
+
+	/**
+	 * @brief Returns plan for FFT of real signals of given size, kept for following transforms of the same size.
+	 */
+	const real_fft_plan_t<T>& real_plan(size_t size);
 
 	void setWidth (int w)
 	{
@@ -45,11 +831,18 @@ public:
 	}
 
 	T hann(int k, int N);
+protected:
+	// Scratch buffer for the plans, large enough for both of them
+	complexarray_t<T> work_;
 private:
 	int window;
 	T pi;
 	// Precalculated coefficients for DFT (8x8)
 	matrix<std::complex<T> > M;
+	// Plan of the last transform
+	std::shared_ptr<const fft_plan_t<T>> plan_;
+	// Plan of the last real transform
+	std::shared_ptr<const real_fft_plan_t<T>> real_plan_;
 };
 
 
@@ -68,39 +861,79 @@ T FFT<T>::hann(int k, int N){
 	return x;
 }
 
+template <class T>
+const fft_plan_t<T>& FFT<T>::plan(size_t size) {
+	if (!plan_ || plan_->size() != size) {
+		plan_ = std::make_shared<fft_plan_t<T>>(size);
+		if (work_.size() < plan_->work_size()) work_.resize(plan_->work_size());
+	}
+	return *plan_;
+}
+
+template <class T>
+const real_fft_plan_t<T>& FFT<T>::real_plan(size_t size) {
+	if (!real_plan_ || real_plan_->size() != size) {
+		real_plan_ = std::make_shared<real_fft_plan_t<T>>(size);
+		if (work_.size() < real_plan_->work_size()) work_.resize(real_plan_->work_size());
+	}
+	return *real_plan_;
+}
+
 template <class T>
 complexarray_t<T> FFT<T>::FFT1D(const simplearray_t<T> &ab) {
-	const auto N = ab.size();
+	complexarray_t<T> result;
+	FFT1D(ab, result);
+	return result;
+}
 
-	if(N == 0 || (N & (N - 1))) {
-		throw std::runtime_error("FFT Error: the input number of samples must be a power of 2!");
-	} else if (N <= 8) {
-		return DFT1D(ab);
-	} else {
-		simplearray_t<T> samples_odd;
-		samples_odd.reserve(N / 2);
-		for(auto i = 0u; i < N; i += 2)
-			samples_odd.push_back(ab[i]);
-		auto coefficients_odd = FFT1D(samples_odd);
-
-		simplearray_t<T> samples_even;
-		samples_even.reserve(N / 2);
-		for(auto i = 1u; i < N; i += 2)
-			samples_even.push_back(ab[i]);
-		auto coefficients_even = FFT1D(samples_even);
-
-		complexarray_t<T> f;
-		for(auto n = 0u; n < N; n++) {
-			f.push_back(std::exp(pi * n / N * std::complex<T>(0, -2)));
-		}
+template <class T>
+void FFT<T>::FFT1D(const simplearray_t<T> &ab, complexarray_t<T>& result) {
+	const auto& fft_plan = plan(ab.size());
+	result.resize(ab.size());
+	fft_plan.transform(ab.data(), result.data(), work_.data());
+}
 
-		complexarray_t<T> result(N, 0);
-		for(auto i = 0u; i < N / 2; ++i) {
-			result[i] = coefficients_odd[i] + f[i] * coefficients_even[i];
-			result[i + N / 2] = coefficients_odd[i] + f[i + N / 2] * coefficients_even[i];
-		}
-		return result;
-	}
+template <class T>
+complexarray_t<T> FFT<T>::RFFT1D(const simplearray_t<T> &ab) {
+	complexarray_t<T> result;
+	RFFT1D(ab, result);
+	return result;
+}
+
+template <class T>
+void FFT<T>::RFFT1D(const simplearray_t<T> &ab, complexarray_t<T>& result) {
+	const auto& fft_plan = real_plan(ab.size());
+	result.resize(fft_plan.bins());
+	fft_plan.transform(ab.data(), result.data(), work_.data());
+}
+
+template <class T>
+complexarray_t<T> FFT<T>::IFFT1D(const complexarray_t<T> &ab) {
+	complexarray_t<T> result;
+	IFFT1D(ab, result);
+	return result;
+}
+
+template <class T>
+void FFT<T>::IFFT1D(const complexarray_t<T> &ab, complexarray_t<T>& result) {
+	const auto& fft_plan = plan(ab.size());
+	result.resize(ab.size());
+	fft_plan.inverse(ab.data(), result.data(), work_.data());
+}
+
+template <class T>
+simplearray_t<T> FFT<T>::IRFFT1D(const complexarray_t<T> &ab) {
+	simplearray_t<T> result;
+	IRFFT1D(ab, result);
+	return result;
+}
+
+template <class T>
+void FFT<T>::IRFFT1D(const complexarray_t<T> &ab, simplearray_t<T>& result) {
+	const size_t size = ab.size() < 2 ? 0 : 2 * (ab.size() - 1);
+	const auto& fft_plan = real_plan(size);
+	result.resize(size);
+	fft_plan.inverse(ab.data(), result.data(), work_.data());
 }
 
 }
@@ -0,0 +1,636 @@
+/**
+ * @file 	FFTKernels.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file defines vectorized FFT butterflies for float and double
+ */
+
+#ifndef INCLUDE_IIMAVLIB_FFTKERNELS_H_
+#define INCLUDE_IIMAVLIB_FFTKERNELS_H_
+
+#include "iimavlib/PlatformDefs.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#ifdef IIMAVLIB_AVX2
+#include <immintrin.h>
+#elif defined(IIMAVLIB_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace iimavlib {
+namespace fft_kernels {
+
+/*
+ * Each of the vector types provides loads, stores, arithmetic, minimum, maximum and square root
+ * of vectors of @em width values, conversion between interleaved complex numbers and split (real and imaginary) vectors
+ * and an in-place transposition of @em width x @em width matrix.
+ * Loads and stores don't require any alignment.
+ */
+
+#ifdef IIMAVLIB_SSE2
+struct sse_float {
+	typedef float scalar_t;
+	typedef __m128 vector_t;
+	static const size_t width = 4;
+	static const char* name() { return "SSE2"; }
+	static vector_t load(const float* p) { return _mm_loadu_ps(p); }
+	static void store(float* p, vector_t v) { _mm_storeu_ps(p, v); }
+	static vector_t set(float x) { return _mm_set1_ps(x); }
+	static vector_t add(vector_t a, vector_t b) { return _mm_add_ps(a, b); }
+	static vector_t sub(vector_t a, vector_t b) { return _mm_sub_ps(a, b); }
+	static vector_t mul(vector_t a, vector_t b) { return _mm_mul_ps(a, b); }
+	static vector_t div(vector_t a, vector_t b) { return _mm_div_ps(a, b); }
+	static vector_t min(vector_t a, vector_t b) { return _mm_min_ps(a, b); }
+	static vector_t max(vector_t a, vector_t b) { return _mm_max_ps(a, b); }
+	static vector_t sqrt(vector_t a) { return _mm_sqrt_ps(a); }
+	static void deinterleave(const float* p, vector_t& re, vector_t& im) {
+		const __m128 a = _mm_loadu_ps(p);
+		const __m128 b = _mm_loadu_ps(p + 4);
+		re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+	}
+	static void interleave(vector_t re, vector_t im, float* p) {
+		_mm_storeu_ps(p, _mm_unpacklo_ps(re, im));
+		_mm_storeu_ps(p + 4, _mm_unpackhi_ps(re, im));
+	}
+	static void transpose(vector_t* v) {
+		_MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+	}
+};
+
+struct sse_double {
+	typedef double scalar_t;
+	typedef __m128d vector_t;
+	static const size_t width = 2;
+	static const char* name() { return "SSE2"; }
+	static vector_t load(const double* p) { return _mm_loadu_pd(p); }
+	static void store(double* p, vector_t v) { _mm_storeu_pd(p, v); }
+	static vector_t set(double x) { return _mm_set1_pd(x); }
+	static vector_t add(vector_t a, vector_t b) { return _mm_add_pd(a, b); }
+	static vector_t sub(vector_t a, vector_t b) { return _mm_sub_pd(a, b); }
+	static vector_t mul(vector_t a, vector_t b) { return _mm_mul_pd(a, b); }
+	static vector_t div(vector_t a, vector_t b) { return _mm_div_pd(a, b); }
+	static vector_t min(vector_t a, vector_t b) { return _mm_min_pd(a, b); }
+	static vector_t max(vector_t a, vector_t b) { return _mm_max_pd(a, b); }
+	static vector_t sqrt(vector_t a) { return _mm_sqrt_pd(a); }
+	static void deinterleave(const double* p, vector_t& re, vector_t& im) {
+		const __m128d a = _mm_loadu_pd(p);
+		const __m128d b = _mm_loadu_pd(p + 2);
+		re = _mm_unpacklo_pd(a, b);
+		im = _mm_unpackhi_pd(a, b);
+	}
+	static void interleave(vector_t re, vector_t im, double* p) {
+		_mm_storeu_pd(p, _mm_unpacklo_pd(re, im));
+		_mm_storeu_pd(p + 2, _mm_unpackhi_pd(re, im));
+	}
+	static void transpose(vector_t* v) {
+		const __m128d t = _mm_unpacklo_pd(v[0], v[1]);
+		v[1] = _mm_unpackhi_pd(v[0], v[1]);
+		v[0] = t;
+	}
+};
+#endif
+
+#ifdef IIMAVLIB_AVX2
+struct avx_float {
+	typedef float scalar_t;
+	typedef __m256 vector_t;
+	static const size_t width = 8;
+	static const char* name() { return "AVX2"; }
+	static vector_t load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, vector_t v) { _mm256_storeu_ps(p, v); }
+	static vector_t set(float x) { return _mm256_set1_ps(x); }
+	static vector_t add(vector_t a, vector_t b) { return _mm256_add_ps(a, b); }
+	static vector_t sub(vector_t a, vector_t b) { return _mm256_sub_ps(a, b); }
+	static vector_t mul(vector_t a, vector_t b) { return _mm256_mul_ps(a, b); }
+	static vector_t div(vector_t a, vector_t b) { return _mm256_div_ps(a, b); }
+	static vector_t min(vector_t a, vector_t b) { return _mm256_min_ps(a, b); }
+	static vector_t max(vector_t a, vector_t b) { return _mm256_max_ps(a, b); }
+	static vector_t sqrt(vector_t a) { return _mm256_sqrt_ps(a); }
+	static void deinterleave(const float* p, vector_t& re, vector_t& im) {
+		const __m256 a = _mm256_loadu_ps(p);
+		const __m256 b = _mm256_loadu_ps(p + 8);
+		// The shuffles work within 128bit lanes, so the pairs of values have to be reordered
+		re = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(
+				_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+		im = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(
+				_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+	static void interleave(vector_t re, vector_t im, float* p) {
+		const __m256 lo = _mm256_unpacklo_ps(re, im);
+		const __m256 hi = _mm256_unpackhi_ps(re, im);
+		_mm256_storeu_ps(p, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(p + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+	static void transpose(vector_t* v) {
+		const __m256 t0 = _mm256_unpacklo_ps(v[0], v[1]);
+		const __m256 t1 = _mm256_unpackhi_ps(v[0], v[1]);
+		const __m256 t2 = _mm256_unpacklo_ps(v[2], v[3]);
+		const __m256 t3 = _mm256_unpackhi_ps(v[2], v[3]);
+		const __m256 t4 = _mm256_unpacklo_ps(v[4], v[5]);
+		const __m256 t5 = _mm256_unpackhi_ps(v[4], v[5]);
+		const __m256 t6 = _mm256_unpacklo_ps(v[6], v[7]);
+		const __m256 t7 = _mm256_unpackhi_ps(v[6], v[7]);
+		const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+		const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+		const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+		const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+		v[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+		v[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+		v[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+		v[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+		v[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+		v[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+		v[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+		v[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+	}
+};
+
+struct avx_double {
+	typedef double scalar_t;
+	typedef __m256d vector_t;
+	static const size_t width = 4;
+	static const char* name() { return "AVX2"; }
+	static vector_t load(const double* p) { return _mm256_loadu_pd(p); }
+	static void store(double* p, vector_t v) { _mm256_storeu_pd(p, v); }
+	static vector_t set(double x) { return _mm256_set1_pd(x); }
+	static vector_t add(vector_t a, vector_t b) { return _mm256_add_pd(a, b); }
+	static vector_t sub(vector_t a, vector_t b) { return _mm256_sub_pd(a, b); }
+	static vector_t mul(vector_t a, vector_t b) { return _mm256_mul_pd(a, b); }
+	static vector_t div(vector_t a, vector_t b) { return _mm256_div_pd(a, b); }
+	static vector_t min(vector_t a, vector_t b) { return _mm256_min_pd(a, b); }
+	static vector_t max(vector_t a, vector_t b) { return _mm256_max_pd(a, b); }
+	static vector_t sqrt(vector_t a) { return _mm256_sqrt_pd(a); }
+	static void deinterleave(const double* p, vector_t& re, vector_t& im) {
+		const __m256d a = _mm256_loadu_pd(p);
+		const __m256d b = _mm256_loadu_pd(p + 4);
+		re = _mm256_permute4x64_pd(_mm256_unpacklo_pd(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+		im = _mm256_permute4x64_pd(_mm256_unpackhi_pd(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+	}
+	static void interleave(vector_t re, vector_t im, double* p) {
+		const __m256d lo = _mm256_unpacklo_pd(re, im);
+		const __m256d hi = _mm256_unpackhi_pd(re, im);
+		_mm256_storeu_pd(p, _mm256_permute2f128_pd(lo, hi, 0x20));
+		_mm256_storeu_pd(p + 4, _mm256_permute2f128_pd(lo, hi, 0x31));
+	}
+	static void transpose(vector_t* v) {
+		const __m256d t0 = _mm256_unpacklo_pd(v[0], v[1]);
+		const __m256d t1 = _mm256_unpackhi_pd(v[0], v[1]);
+		const __m256d t2 = _mm256_unpacklo_pd(v[2], v[3]);
+		const __m256d t3 = _mm256_unpackhi_pd(v[2], v[3]);
+		v[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+		v[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+		v[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+		v[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+	}
+};
+#endif
+
+/// Vector type used for FFT of T, width 1 means there's no vectorized implementation
+template<class T>
+struct vector_ops_t {
+	static const size_t width = 1;
+	static const char* name() { return "scalar"; }
+};
+
+#if defined(IIMAVLIB_AVX2)
+template<> struct vector_ops_t<float>: avx_float {};
+template<> struct vector_ops_t<double>: avx_double {};
+#elif defined(IIMAVLIB_SSE2)
+template<> struct vector_ops_t<float>: sse_float {};
+template<> struct vector_ops_t<double>: sse_double {};
+#endif
+
+/// Vector type with a single float, used when there's no SIMD and for the remaining values
+struct scalar_float {
+	typedef float scalar_t;
+	typedef float vector_t;
+	static const size_t width = 1;
+	static const char* name() { return "scalar"; }
+	static vector_t load(const float* p) { return *p; }
+	static void store(float* p, vector_t v) { *p = v; }
+	static vector_t set(float x) { return x; }
+	static vector_t add(vector_t a, vector_t b) { return a + b; }
+	static vector_t sub(vector_t a, vector_t b) { return a - b; }
+	static vector_t mul(vector_t a, vector_t b) { return a * b; }
+	static vector_t div(vector_t a, vector_t b) { return a / b; }
+	static vector_t min(vector_t a, vector_t b) { return std::min(a, b); }
+	static vector_t max(vector_t a, vector_t b) { return std::max(a, b); }
+	static vector_t sqrt(vector_t a) { return std::sqrt(a); }
+	static void deinterleave(const float* p, vector_t& re, vector_t& im) {
+		re = p[0];
+		im = p[1];
+	}
+	static void interleave(vector_t re, vector_t im, float* p) {
+		p[0] = re;
+		p[1] = im;
+	}
+	static void transpose(vector_t*) {}
+};
+
+/// Widest vector type of floats, @em scalar_float when there's no SIMD
+typedef std::conditional<(vector_ops_t<float>::width > 1), vector_ops_t<float>, scalar_float>::type float_ops_t;
+
+/**
+ * @brief Vectorized radix-2/4 butterflies working on split real and imaginary vectors
+ *
+ * The data are expected in bit reversed order, as interleaved complex numbers.
+ * Every block of @em width consecutive complex numbers is converted to a vector of real parts
+ * followed by a vector of imaginary parts, so all stages with butterflies spanning at least
+ * @em width elements work on whole vectors. The first log2(width) levels (butterflies within the blocks)
+ * are computed for @em width blocks at once, after transposing them. The data are converted back
+ * to interleaved complex numbers at the end.
+ */
+template<class V>
+struct butterflies_t {
+	typedef typename V::scalar_t T;
+	typedef typename V::vector_t vector_t;
+
+	/// Smallest supported size of the transform
+	static size_t min_size() { return V::width * V::width; }
+
+	/**
+	 * @brief Computes twiddle factors for transform of given size
+	 *
+	 * Twiddles for the butterflies within blocks are stored as scalars,
+	 * twiddles for the following stages as vectors of real and imaginary parts.
+	 */
+	static void make_twiddles(size_t size, std::vector<T>& twiddles);
+
+	/**
+	 * @brief Computes the butterflies in place
+	 * @param data Bit reversed data, @em size complex numbers as an array of 2*size values
+	 */
+	static void run(T* data, size_t size, const T* twiddles);
+private:
+	static void push_twiddle(std::vector<T>& twiddles, double angle) {
+		twiddles.push_back(static_cast<T>(std::cos(angle)));
+		twiddles.push_back(static_cast<T>(std::sin(angle)));
+	}
+	/// Complex multiplication of vectors
+	static void multiply(vector_t& re, vector_t& im, vector_t wre, vector_t wim) {
+		const vector_t r = V::sub(V::mul(re, wre), V::mul(im, wim));
+		im = V::add(V::mul(re, wim), V::mul(im, wre));
+		re = r;
+	}
+};
+
+template<class V>
+void butterflies_t<V>::make_twiddles(size_t size, std::vector<T>& twiddles)
+{
+	const size_t width = V::width;
+	const double pi = 4.0 * std::atan(1.0);
+	twiddles.clear();
+	for (size_t half = 1; half < width; half *= 2) {
+		for (size_t j = 0; j < half; ++j) push_twiddle(twiddles, -pi * j / half);
+	}
+	size_t levels = 0;
+	while ((width << levels) < size) ++levels;
+	size_t quarter = width;
+	if (levels & 1) {
+		for (size_t j = 0; j < width; ++j) twiddles.push_back(static_cast<T>(std::cos(-pi * j / width)));
+		for (size_t j = 0; j < width; ++j) twiddles.push_back(static_cast<T>(std::sin(-pi * j / width)));
+		quarter *= 2;
+	}
+	for (; quarter * 4 <= size; quarter *= 4) {
+		for (size_t j0 = 0; j0 < quarter; j0 += width) {
+			for (int k = 1; k <= 3; ++k) {
+				for (size_t j = j0; j < j0 + width; ++j) twiddles.push_back(static_cast<T>(std::cos(-pi * k * j / (2 * quarter))));
+				for (size_t j = j0; j < j0 + width; ++j) twiddles.push_back(static_cast<T>(std::sin(-pi * k * j / (2 * quarter))));
+			}
+		}
+	}
+}
+
+template<class V>
+void butterflies_t<V>::run(T* data, size_t size, const T* twiddles)
+{
+	const size_t width = V::width;
+	// Butterflies within blocks, for width blocks at once
+	vector_t re[V::width], im[V::width];
+	for (size_t group = 0; group < size; group += width * width) {
+		T* d = data + 2 * group;
+		for (size_t b = 0; b < width; ++b) V::deinterleave(d + 2 * width * b, re[b], im[b]);
+		// After the transposition, re[i] and im[i] hold i-th element of each block
+		V::transpose(re);
+		V::transpose(im);
+		for (size_t half = 1; half < width; half *= 2) {
+			for (size_t start = 0; start < width; start += 2 * half) {
+				for (size_t j = 0; j < half; ++j) {
+					const size_t a = start + j;
+					const size_t b = a + half;
+					vector_t tre = re[b];
+					vector_t tim = im[b];
+					if (j) {
+						const T* w = twiddles + 2 * (half - 1 + j);
+						multiply(tre, tim, V::set(w[0]), V::set(w[1]));
+					}
+					re[b] = V::sub(re[a], tre);
+					im[b] = V::sub(im[a], tim);
+					re[a] = V::add(re[a], tre);
+					im[a] = V::add(im[a], tim);
+				}
+			}
+		}
+		V::transpose(re);
+		V::transpose(im);
+		for (size_t b = 0; b < width; ++b) {
+			V::store(d + 2 * width * b, re[b]);
+			V::store(d + 2 * width * b + width, im[b]);
+		}
+	}
+	const T* tw = twiddles + 2 * (width - 1);
+
+	// Element e is stored at d[2 * e] (real parts) and d[2 * e + width] (imaginary parts) for e divisible by width
+	size_t levels = 0;
+	while ((width << levels) < size) ++levels;
+	size_t quarter = width;
+	if (levels & 1) {
+		for (size_t block = 0; block < size; block += 2 * width) {
+			T* d0 = data + 2 * block;
+			T* d1 = d0 + 2 * width;
+			vector_t bre = V::load(d1);
+			vector_t bim = V::load(d1 + width);
+			multiply(bre, bim, V::load(tw), V::load(tw + width));
+			const vector_t are = V::load(d0);
+			const vector_t aim = V::load(d0 + width);
+			V::store(d0, V::add(are, bre));
+			V::store(d0 + width, V::add(aim, bim));
+			V::store(d1, V::sub(are, bre));
+			V::store(d1 + width, V::sub(aim, bim));
+		}
+		tw += 2 * width;
+		quarter *= 2;
+	}
+	for (; quarter * 4 <= size; quarter *= 4) {
+		for (size_t block = 0; block < size; block += 4 * quarter) {
+			for (size_t j = 0; j < quarter; j += width) {
+				T* d = data + 2 * (block + j);
+				const T* w = tw + 6 * j;
+				const vector_t a0re = V::load(d);
+				const vector_t a0im = V::load(d + width);
+				vector_t a1re = V::load(d + 2 * quarter);
+				vector_t a1im = V::load(d + 2 * quarter + width);
+				vector_t a2re = V::load(d + 4 * quarter);
+				vector_t a2im = V::load(d + 4 * quarter + width);
+				vector_t a3re = V::load(d + 6 * quarter);
+				vector_t a3im = V::load(d + 6 * quarter + width);
+				multiply(a1re, a1im, V::load(w + 2 * width), V::load(w + 3 * width));
+				multiply(a2re, a2im, V::load(w), V::load(w + width));
+				multiply(a3re, a3im, V::load(w + 4 * width), V::load(w + 5 * width));
+				const vector_t s01re = V::add(a0re, a1re);
+				const vector_t s01im = V::add(a0im, a1im);
+				const vector_t d01re = V::sub(a0re, a1re);
+				const vector_t d01im = V::sub(a0im, a1im);
+				const vector_t s23re = V::add(a2re, a3re);
+				const vector_t s23im = V::add(a2im, a3im);
+				// (a2 - a3) multiplied by -i
+				const vector_t d23re = V::sub(a2im, a3im);
+				const vector_t d23im = V::sub(a3re, a2re);
+				V::store(d, V::add(s01re, s23re));
+				V::store(d + width, V::add(s01im, s23im));
+				V::store(d + 2 * quarter, V::add(d01re, d23re));
+				V::store(d + 2 * quarter + width, V::add(d01im, d23im));
+				V::store(d + 4 * quarter, V::sub(s01re, s23re));
+				V::store(d + 4 * quarter + width, V::sub(s01im, s23im));
+				V::store(d + 6 * quarter, V::sub(d01re, d23re));
+				V::store(d + 6 * quarter + width, V::sub(d01im, d23im));
+			}
+		}
+		tw += 6 * quarter;
+	}
+
+	for (size_t block = 0; block < size; block += width) {
+		T* d = data + 2 * block;
+		V::interleave(V::load(d), V::load(d + width), d);
+	}
+}
+
+/**
+ * @brief Vectorized stage of mixed radix FFT with odd radix R (3, 5 or 7)
+ *
+ * Combines R transforms of @em span values into one. When @em span is a multiple of @em width,
+ * @em width consecutive butterflies are computed at once. Otherwise (stages following an odd number
+ * of values) @em width blocks are computed at once, with their values gathered to vectors.
+ * The R-point DFT uses the symmetry of the roots of unity: X[k] and X[R-k] share sums
+ * of x[q] + x[R-q] and x[q] - x[R-q].
+ */
+template<class V>
+struct odd_radix_t {
+	typedef typename V::scalar_t T;
+	typedef typename V::vector_t vector_t;
+
+	/// Returns true if the butterflies within a block can be vectorized
+	static bool supports(size_t span) { return span % V::width == 0; }
+
+	/**
+	 * @brief Computes twiddles for a stage, for every group of @em width butterflies
+	 * 		real parts of w^q followed by imaginary parts, for q from 1 to radix-1
+	 */
+	static void make_twiddles(size_t span, size_t radix, std::vector<T>& twiddles);
+
+	/**
+	 * @brief Computes the stage in place, @em span has to be supported
+	 * @param data @em size complex numbers as an array of 2*size values
+	 * @param twiddles Twiddles from @em make_twiddles
+	 * @param cos cos(2*pi*q*k/R) for k, q from 1 to (R-1)/2
+	 * @param sin sin(2*pi*q*k/R) for k, q from 1 to (R-1)/2
+	 */
+	template<size_t R>
+	static void run(T* data, size_t size, size_t span, const T* twiddles, const T (*cos)[3], const T (*sin)[3]);
+
+	/**
+	 * @brief Computes the stage for @em width blocks at once, for any @em span
+	 * @param data Complex numbers as an array of values
+	 * @param blocks Number of blocks, multiple of @em width
+	 * @param twiddles Twiddles as complex numbers, w^q for q from 1 to radix-1 for every butterfly
+	 * @return Number of processed blocks
+	 */
+	template<size_t R>
+	static size_t run_blocks(T* data, size_t blocks, size_t span, const T* twiddles, const T (*cos)[3], const T (*sin)[3]);
+private:
+	/// R-point DFT in place, with constants from @em init
+	template<size_t R>
+	static void dft(vector_t* re, vector_t* im, const vector_t (*c)[3], const vector_t (*s)[3]);
+	template<size_t R>
+	static void init(const T (*cos)[3], const T (*sin)[3], vector_t (*c)[3], vector_t (*s)[3]);
+	static void multiply(vector_t& re, vector_t& im, vector_t wre, vector_t wim) {
+		const vector_t r = V::sub(V::mul(re, wre), V::mul(im, wim));
+		im = V::add(V::mul(re, wim), V::mul(im, wre));
+		re = r;
+	}
+};
+
+template<class V>
+void odd_radix_t<V>::make_twiddles(size_t span, size_t radix, std::vector<T>& twiddles)
+{
+	const double pi = 4.0 * std::atan(1.0);
+	for (size_t j0 = 0; j0 < span; j0 += V::width) {
+		for (size_t q = 1; q < radix; ++q) {
+			for (size_t j = j0; j < j0 + V::width; ++j) twiddles.push_back(static_cast<T>(std::cos(-2.0 * pi * q * j / (span * radix))));
+			for (size_t j = j0; j < j0 + V::width; ++j) twiddles.push_back(static_cast<T>(std::sin(-2.0 * pi * q * j / (span * radix))));
+		}
+	}
+}
+
+template<class V>
+template<size_t R>
+void odd_radix_t<V>::init(const T (*cos)[3], const T (*sin)[3], vector_t (*c)[3], vector_t (*s)[3])
+{
+	const size_t H = (R - 1) / 2;
+	for (size_t k = 0; k < H; ++k) {
+		for (size_t q = 0; q < H; ++q) {
+			c[k][q] = V::set(cos[k][q]);
+			s[k][q] = V::set(sin[k][q]);
+		}
+	}
+}
+
+template<class V>
+template<size_t R>
+void odd_radix_t<V>::dft(vector_t* re, vector_t* im, const vector_t (*c)[3], const vector_t (*s)[3])
+{
+	const size_t H = (R - 1) / 2;
+	vector_t sum_re[H], sum_im[H], difference_re[H], difference_im[H];
+	vector_t total_re = re[0];
+	vector_t total_im = im[0];
+	for (size_t q = 1; q <= H; ++q) {
+		sum_re[q - 1] = V::add(re[q], re[R - q]);
+		sum_im[q - 1] = V::add(im[q], im[R - q]);
+		difference_re[q - 1] = V::sub(re[q], re[R - q]);
+		difference_im[q - 1] = V::sub(im[q], im[R - q]);
+		total_re = V::add(total_re, sum_re[q - 1]);
+		total_im = V::add(total_im, sum_im[q - 1]);
+	}
+	for (size_t k = 0; k < H; ++k) {
+		vector_t a_re = re[0];
+		vector_t a_im = im[0];
+		vector_t b_re = V::mul(difference_re[0], s[k][0]);
+		vector_t b_im = V::mul(difference_im[0], s[k][0]);
+		for (size_t q = 0; q < H; ++q) {
+			a_re = V::add(a_re, V::mul(sum_re[q], c[k][q]));
+			a_im = V::add(a_im, V::mul(sum_im[q], c[k][q]));
+		}
+		for (size_t q = 1; q < H; ++q) {
+			b_re = V::add(b_re, V::mul(difference_re[q], s[k][q]));
+			b_im = V::add(b_im, V::mul(difference_im[q], s[k][q]));
+		}
+		// a - i*b and a + i*b
+		re[k + 1] = V::add(a_re, b_im);
+		im[k + 1] = V::sub(a_im, b_re);
+		re[R - k - 1] = V::sub(a_re, b_im);
+		im[R - k - 1] = V::add(a_im, b_re);
+	}
+	re[0] = total_re;
+	im[0] = total_im;
+}
+
+template<class V>
+template<size_t R>
+void odd_radix_t<V>::run(T* data, size_t size, size_t span, const T* twiddles, const T (*cos)[3], const T (*sin)[3])
+{
+	const size_t width = V::width;
+	vector_t c[3][3];
+	vector_t s[3][3];
+	init<R>(cos, sin, c, s);
+	for (size_t block = 0; block < size; block += R * span) {
+		T* d = data + 2 * block;
+		const T* tw = twiddles;
+		for (size_t j = 0; j < span; j += width, tw += 2 * width * (R - 1)) {
+			vector_t re[R];
+			vector_t im[R];
+			V::deinterleave(d + 2 * j, re[0], im[0]);
+			for (size_t q = 1; q < R; ++q) {
+				V::deinterleave(d + 2 * (j + q * span), re[q], im[q]);
+				multiply(re[q], im[q], V::load(tw + 2 * width * (q - 1)), V::load(tw + 2 * width * (q - 1) + width));
+			}
+			dft<R>(re, im, c, s);
+			for (size_t q = 0; q < R; ++q) V::interleave(re[q], im[q], d + 2 * (j + q * span));
+		}
+	}
+}
+
+template<class V>
+template<size_t R>
+size_t odd_radix_t<V>::run_blocks(T* data, size_t blocks, size_t span, const T* twiddles, const T (*cos)[3], const T (*sin)[3])
+{
+	const size_t width = V::width;
+	vector_t c[3][3];
+	vector_t s[3][3];
+	init<R>(cos, sin, c, s);
+	const size_t stride = 2 * R * span;
+	T values[2 * width];
+	for (size_t block = 0; block + width <= blocks; block += width) {
+		T* d = data + block * stride;
+		for (size_t j = 0; j < span; ++j) {
+			const T* w = twiddles + 2 * (R - 1) * j;
+			vector_t re[R];
+			vector_t im[R];
+			for (size_t q = 0; q < R; ++q) {
+				// Value q of the butterfly from each of the blocks
+				const T* p = d + 2 * (j + q * span);
+				for (size_t l = 0; l < width; ++l) {
+					values[2 * l] = p[l * stride];
+					values[2 * l + 1] = p[l * stride + 1];
+				}
+				V::deinterleave(values, re[q], im[q]);
+				if (q) multiply(re[q], im[q], V::set(w[2 * (q - 1)]), V::set(w[2 * (q - 1) + 1]));
+			}
+			dft<R>(re, im, c, s);
+			for (size_t q = 0; q < R; ++q) {
+				V::interleave(re[q], im[q], values);
+				T* p = d + 2 * (j + q * span);
+				for (size_t l = 0; l < width; ++l) {
+					p[l * stride] = values[2 * l];
+					p[l * stride + 1] = values[2 * l + 1];
+				}
+			}
+		}
+	}
+	return blocks - blocks % width;
+}
+
+/**
+ * @brief Vectorized odd radix stages for T, if there's a vector type for it
+ */
+template<class T, bool vectorized = (vector_ops_t<T>::width > 1)>
+struct vector_odd_radix_t {
+	static bool supports(size_t) { return false; }
+	static void make_twiddles(size_t, size_t, std::vector<T>&) {}
+	template<size_t R>
+	static void run(T*, size_t, size_t, const T*, const T (*)[3], const T (*)[3]) {}
+	template<size_t R>
+	static size_t run_blocks(T*, size_t, size_t, const T*, const T (*)[3], const T (*)[3]) { return 0; }
+};
+
+template<class T>
+struct vector_odd_radix_t<T, true>: odd_radix_t<vector_ops_t<T> > {};
+
+/**
+ * @brief Vectorized butterflies for T, if there's a vector type for it
+ */
+template<class T, bool vectorized = (vector_ops_t<T>::width > 1)>
+struct vector_butterflies_t {
+	static const bool available = false;
+	static size_t min_size() { return 0; }
+	static void make_twiddles(size_t, std::vector<T>&) {}
+	static void run(T*, size_t, const T*) {}
+};
+
+template<class T>
+struct vector_butterflies_t<T, true>: butterflies_t<vector_ops_t<T> > {
+	static const bool available = true;
+};
+
+}
+}
+
+#endif /* INCLUDE_IIMAVLIB_FFTKERNELS_H_ */
@@ -0,0 +1,130 @@
+/**
+ * @file 	MappedWaveFile.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares read-only, memory mapped access to WAV files
+ */
+
+#ifndef MAPPEDWAVEFILE_H_
+#define MAPPEDWAVEFILE_H_
+
+#include "AudioTypes.h"
+#include "WaveFormat.h"
+#include "PlatformDefs.h"
+#include <string>
+#include <vector>
+
+namespace iimavlib {
+
+/*!
+ * @brief Hints about expected access pattern to a mapped file
+ */
+enum class access_hint_t: uint8_t {
+	normal,     //!< No special treatment
+	sequential, //!< Data will be read sequentially, aggressive read-ahead is welcome
+	random,     //!< Data will be read in random order, read-ahead is useless
+	will_need,  //!< Data will be needed soon, start loading them now
+	dont_need   //!< Data won't be needed in near future
+};
+
+/**
+ * @brief Read-only WAV file mapped to memory
+ *
+ * The PCM payload is accessible directly from the mapping without any copying.
+ * The mapping (and all views returned by this class) is valid until the object is destroyed.
+ */
+class EXPORT MappedWaveFile
+{
+public:
+	/**
+	 * @brief Maps a WAV file into memory and validates its header
+	 *
+	 * Throws std::runtime_error when the file doesn't exist, can't be mapped or the header is corrupted
+	 * @param filename Name of the file to map
+	 * @param hint Initial access hint for the data
+	 */
+	MappedWaveFile(const std::string& filename, access_hint_t hint = access_hint_t::normal);
+	~MappedWaveFile();
+#ifdef SYSTEM_LINUX
+	MappedWaveFile(const MappedWaveFile&) = delete;
+	MappedWaveFile& operator=(const MappedWaveFile&) = delete;
+#endif
+
+	/**
+	 * @brief Returns params corresponding to current file
+	 */
+	audio_params_t get_params() const;
+
+	/**
+	 * @brief Returns description of data in the file
+	 */
+	const wav_info_t& get_info() const { return info_; }
+
+	/**
+	 * @brief Returns number of channels in the file
+	 */
+	uint16_t get_channels() const { return info_.channels; }
+
+	/**
+	 * @brief Returns number of samples (frames) in the file
+	 */
+	size_t get_sample_count() const { return sample_count_; }
+
+	/**
+	 * @brief Returns true if the data can be accessed directly as @em audio_sample_t
+	 */
+	bool has_native_format() const;
+
+	/**
+	 * @brief Returns view of the samples in the file
+	 *
+	 * Available only for 16bit stereo files, as other formats have different layout than @em audio_sample_t.
+	 * Throws std::runtime_error for other files.
+	 */
+	array_view_t<const audio_sample_t> get_samples() const;
+
+	/**
+	 * @brief Returns view of raw PCM data, as described by @em get_info()
+	 */
+	array_view_t<const uint8_t> get_raw_data() const;
+
+	/**
+	 * @brief Copies samples to a buffer, converting them to 16bit stereo
+	 * @param data Output buffer
+	 * @param position Index of the first sample to copy
+	 * @param sample_count Maximal number of samples to copy. Set to 0 to fill the whole buffer.
+	 * @return Number of samples copied
+	 */
+	size_t read_data(std::vector<audio_sample_t>& data, size_t position, size_t sample_count = 0) const;
+
+	/**
+	 * @brief Advises the system about expected access pattern for the whole file
+	 * @return error_type_t::ok on success, error_type_t::unsupported if the platform doesn't support the hint.
+	 */
+	error_type_t advise(access_hint_t hint) const;
+
+	/**
+	 * @brief Advises the system about expected access pattern for a range of samples
+	 * @param hint Access hint
+	 * @param first Index of the first sample
+	 * @param count Number of samples
+	 */
+	error_type_t advise(access_hint_t hint, size_t first, size_t count) const;
+
+private:
+	const uint8_t* map_base_;
+	size_t map_size_;
+	void* map_handle_;
+	const uint8_t* pcm_;
+	size_t sample_count_;
+	wav_info_t info_;
+	audio_params_t params_;
+
+	void validate_header();
+	void unmap();
+};
+
+}
+
+#endif /* MAPPEDWAVEFILE_H_ */
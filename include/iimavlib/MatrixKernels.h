@@ -0,0 +1,255 @@
+/**
+ * @file 	MatrixKernels.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file defines cache blocked and vectorized matrix multiplications and transpositions
+ */
+
+#ifndef INCLUDE_IIMAVLIB_MATRIXKERNELS_H_
+#define INCLUDE_IIMAVLIB_MATRIXKERNELS_H_
+
+#include "iimavlib/FFTKernels.h"
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace iimavlib {
+namespace matrix_kernels {
+
+/*
+ * All the matrices are stored by rows, @em lda, @em ldb and @em ldc are distances
+ * between starts of two consecutive rows (in elements).
+ * The output may not overlap any of the inputs.
+ */
+
+/// Number of rows of B multiplied at once, so the block of B stays in cache for all rows of A
+const size_t block_depth = 256;
+/// Number of columns of B multiplied at once
+const size_t block_columns = 128;
+/// Size of the tiles copied by transpositions
+const size_t transpose_tile = 32;
+
+/**
+ * @brief Generic multiplication, working for any types with * and += (e.g. integers or complex numbers)
+ */
+template<class A, class B, class C>
+struct scalar_gemm_t {
+	/// C (m x n) = A (m x k) * B (k x n)
+	static void gemm(const A* a, size_t lda, const B* b, size_t ldb, C* c, size_t ldc, size_t m, size_t n, size_t k) {
+		for (size_t i = 0; i < m; ++i) std::fill(c + i * ldc, c + i * ldc + n, C());
+		for (size_t p0 = 0; p0 < k; p0 += block_depth) {
+			const size_t p1 = std::min(k, p0 + block_depth);
+			for (size_t j0 = 0; j0 < n; j0 += block_columns) {
+				const size_t j1 = std::min(n, j0 + block_columns);
+				for (size_t i = 0; i < m; ++i) {
+					C* row = c + i * ldc;
+					for (size_t p = p0; p < p1; ++p) {
+						const A value = a[i * lda + p];
+						const B* row_b = b + p * ldb;
+						for (size_t j = j0; j < j1; ++j) row[j] += value * row_b[j];
+					}
+				}
+			}
+		}
+	}
+	/// y (m) = A (m x n) * x (n)
+	static void gemv(const A* a, size_t lda, const B* x, C* y, size_t m, size_t n) {
+		for (size_t i = 0; i < m; ++i) {
+			C sum = C();
+			const A* row = a + i * lda;
+			for (size_t j = 0; j < n; ++j) sum += row[j] * x[j];
+			y[i] = sum;
+		}
+	}
+};
+
+/**
+ * @brief Multiplication of float or double matrices using vector type V
+ *
+ * GEMM computes blocks of 4 rows x 2 vectors of C in registers, broadcasting elements of A
+ * and loading rows of B. The depth and columns are blocked, so the rows of B are read from cache.
+ * GEMV computes dot products of 4 rows of A at once, so every vector of x is loaded only once for them.
+ */
+template<class V>
+struct vector_gemm_t {
+	typedef typename V::scalar_t T;
+	typedef typename V::vector_t vector_t;
+
+	static void gemm(const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc, size_t m, size_t n, size_t k) {
+		for (size_t i = 0; i < m; ++i) std::fill(c + i * ldc, c + i * ldc + n, T());
+		for (size_t p0 = 0; p0 < k; p0 += block_depth) {
+			const size_t p1 = std::min(k, p0 + block_depth);
+			for (size_t j0 = 0; j0 < n; j0 += block_columns) {
+				const size_t j1 = std::min(n, j0 + block_columns);
+				size_t i = 0;
+				for (; i + 4 <= m; i += 4) {
+					panel<4>(a + i * lda, lda, b, ldb, c + i * ldc, ldc, p0, p1, j0, j1);
+				}
+				for (; i < m; ++i) {
+					panel<1>(a + i * lda, lda, b, ldb, c + i * ldc, ldc, p0, p1, j0, j1);
+				}
+			}
+		}
+	}
+
+	static void gemv(const T* a, size_t lda, const T* x, T* y, size_t m, size_t n) {
+		const size_t width = V::width;
+		size_t i = 0;
+		for (; i + 4 <= m; i += 4) {
+			vector_t sums[4] = {V::set(0), V::set(0), V::set(0), V::set(0)};
+			size_t j = 0;
+			for (; j + width <= n; j += width) {
+				const vector_t value = V::load(x + j);
+				for (size_t r = 0; r < 4; ++r) {
+					sums[r] = V::add(sums[r], V::mul(V::load(a + r * lda + j), value));
+				}
+			}
+			for (size_t r = 0; r < 4; ++r) {
+				T sum = horizontal_sum(sums[r]);
+				for (size_t l = j; l < n; ++l) sum += a[r * lda + l] * x[l];
+				y[r] = sum;
+			}
+			a += 4 * lda;
+			y += 4;
+		}
+		for (; i < m; ++i, a += lda, ++y) {
+			vector_t sum = V::set(0);
+			size_t j = 0;
+			for (; j + width <= n; j += width) sum = V::add(sum, V::mul(V::load(a + j), V::load(x + j)));
+			T result = horizontal_sum(sum);
+			for (; j < n; ++j) result += a[j] * x[j];
+			*y = result;
+		}
+	}
+private:
+	static T horizontal_sum(vector_t v) {
+		T values[V::width];
+		V::store(values, v);
+		T sum = 0;
+		for (size_t i = 0; i < V::width; ++i) sum += values[i];
+		return sum;
+	}
+
+	/// Adds product of R rows of A (columns p0 to p1-1) and rows p0 to p1-1 of B to columns j0 to j1-1 of C
+	template<size_t R>
+	static void panel(const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+			size_t p0, size_t p1, size_t j0, size_t j1) {
+		const size_t width = V::width;
+		size_t j = j0;
+		for (; j + 2 * width <= j1; j += 2 * width) {
+			vector_t sums[R][2];
+			for (size_t r = 0; r < R; ++r) {
+				sums[r][0] = V::load(c + r * ldc + j);
+				sums[r][1] = V::load(c + r * ldc + j + width);
+			}
+			for (size_t p = p0; p < p1; ++p) {
+				const vector_t b0 = V::load(b + p * ldb + j);
+				const vector_t b1 = V::load(b + p * ldb + j + width);
+				for (size_t r = 0; r < R; ++r) {
+					const vector_t value = V::set(a[r * lda + p]);
+					sums[r][0] = V::add(sums[r][0], V::mul(value, b0));
+					sums[r][1] = V::add(sums[r][1], V::mul(value, b1));
+				}
+			}
+			for (size_t r = 0; r < R; ++r) {
+				V::store(c + r * ldc + j, sums[r][0]);
+				V::store(c + r * ldc + j + width, sums[r][1]);
+			}
+		}
+		for (; j + width <= j1; j += width) {
+			vector_t sums[R];
+			for (size_t r = 0; r < R; ++r) sums[r] = V::load(c + r * ldc + j);
+			for (size_t p = p0; p < p1; ++p) {
+				const vector_t row = V::load(b + p * ldb + j);
+				for (size_t r = 0; r < R; ++r) sums[r] = V::add(sums[r], V::mul(V::set(a[r * lda + p]), row));
+			}
+			for (size_t r = 0; r < R; ++r) V::store(c + r * ldc + j, sums[r]);
+		}
+		for (; j < j1; ++j) {
+			for (size_t r = 0; r < R; ++r) {
+				T sum = c[r * ldc + j];
+				for (size_t p = p0; p < p1; ++p) sum += a[r * lda + p] * b[p * ldb + j];
+				c[r * ldc + j] = sum;
+			}
+		}
+	}
+};
+
+/**
+ * @brief Multiplication of A by B into C, vectorized when all three types are the same float or double
+ */
+template<class A, class B, class C, bool vectorized = std::is_same<A, B>::value && std::is_same<A, C>::value
+		&& (fft_kernels::vector_ops_t<A>::width > 1)>
+struct gemm_t: scalar_gemm_t<A, B, C> {};
+
+template<class T>
+struct gemm_t<T, T, T, true>: vector_gemm_t<fft_kernels::vector_ops_t<T> > {};
+
+/// Copies transposition of @em in (rows x columns) to @em out (columns x rows), tile by tile
+template<class T>
+void transpose(const T* in, size_t ldin, T* out, size_t ldout, size_t rows, size_t columns)
+{
+	for (size_t i0 = 0; i0 < rows; i0 += transpose_tile) {
+		const size_t i1 = std::min(rows, i0 + transpose_tile);
+		for (size_t j0 = 0; j0 < columns; j0 += transpose_tile) {
+			const size_t j1 = std::min(columns, j0 + transpose_tile);
+			for (size_t i = i0; i < i1; ++i) {
+				for (size_t j = j0; j < j1; ++j) out[j * ldout + i] = in[i * ldin + j];
+			}
+		}
+	}
+}
+
+/// Transposes square matrix in place, swapping tiles above the diagonal with tiles below it
+template<class T>
+void transpose_square(T* data, size_t ld, size_t size)
+{
+	using std::swap;
+	for (size_t i0 = 0; i0 < size; i0 += transpose_tile) {
+		const size_t i1 = std::min(size, i0 + transpose_tile);
+		for (size_t j0 = i0; j0 < size; j0 += transpose_tile) {
+			const size_t j1 = std::min(size, j0 + transpose_tile);
+			for (size_t i = i0; i < i1; ++i) {
+				for (size_t j = std::max(j0, i + 1); j < j1; ++j) swap(data[i * ld + j], data[j * ld + i]);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Transposes contiguous rows x columns matrix in place
+ *
+ * Follows the cycles of the permutation, element at index i moves to i * rows mod (size - 1).
+ * Only a bit per element is allocated to mark the elements already moved.
+ */
+template<class T>
+void transpose_in_place(T* data, size_t rows, size_t columns)
+{
+	if (rows == columns) {
+		transpose_square(data, columns, rows);
+		return;
+	}
+	const size_t size = rows * columns;
+	if (rows < 2 || columns < 2) return;
+	using std::swap;
+	const size_t last = size - 1;
+	std::vector<bool> moved(size);
+	for (size_t start = 1; start < last; ++start) {
+		if (moved[start]) continue;
+		T value = std::move(data[start]);
+		size_t index = start;
+		do {
+			index = index * rows % last;
+			swap(value, data[index]);
+			moved[index] = true;
+		} while (index != start);
+	}
+}
+
+}
+}
+
+#endif /* INCLUDE_IIMAVLIB_MATRIXKERNELS_H_ */
@@ -0,0 +1,122 @@
+/**
+ * @file 	Oscillator.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares band-limited oscillators for generating periodic signals
+ */
+
+#ifndef INCLUDE_IIMAVLIB_OSCILLATOR_H_
+#define INCLUDE_IIMAVLIB_OSCILLATOR_H_
+
+#include "PlatformDefs.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace iimavlib {
+
+/*!
+ * @brief Shapes of the generated signals, all of them in interval <-1, 1> and in phase with sine
+ */
+enum class waveform_t: uint8_t {
+	/// Sine from a table with linear interpolation
+	sine,
+	/// Rising sawtooth, with the fall in the middle of the period
+	sawtooth,
+	/// Square, 1 in the first half of the period and -1 in the second
+	square,
+	/// Triangle with the maximum at 1/4 of the period
+	triangle,
+};
+
+/**
+ * @brief Oscillator with a phase accumulator
+ *
+ * The phase is kept in interval <0, 1) (in periods), so it doesn't lose precision over time
+ * and the frequency can be changed at any time without discontinuities.
+ * Discontinuities of sawtooth and square (and corners of triangle) are smoothed by PolyBLEP (PolyBLAMP)
+ * corrections, which removes most of the aliasing.
+ * Whole blocks are generated at once, using SIMD for several consecutive samples.
+ *
+ * The oscillator isn't thread safe, it should be used from a single thread (or with a lock).
+ */
+class EXPORT Oscillator {
+public:
+	/**
+	 * @param frequency Frequency in Hz, limited to interval <0, rate/2) while generating
+	 * @param phase Initial phase in periods
+	 */
+	Oscillator(waveform_t waveform = waveform_t::sine, double frequency = 440.0, double phase = 0.0);
+
+	void set_waveform(waveform_t waveform) { waveform_ = waveform; }
+	waveform_t get_waveform() const { return waveform_; }
+	/// Changes the frequency, the phase continues from its current value
+	void set_frequency(double frequency) { frequency_ = frequency; }
+	double get_frequency() const { return frequency_; }
+	/// Sets the phase in periods (any value, it's wrapped to interval <0, 1))
+	void set_phase(double phase);
+	double get_phase() const { return phase_; }
+
+	/**
+	 * @brief Generates next @em count samples in interval <-1, 1>
+	 * @param rate Sampling rate in Hz
+	 */
+	void generate(float* output, size_t count, double rate);
+	/// Adds next @em count samples multiplied by @em amplitude to @em output
+	void add(float* output, size_t count, double rate, float amplitude);
+private:
+	template<bool accumulate>
+	void run(float* output, size_t count, double rate, float amplitude);
+
+	waveform_t waveform_;
+	double frequency_;
+	double phase_;
+};
+
+/**
+ * @brief Bank of oscillators with the same waveform, generating sum of their signals
+ *
+ * Each oscillator has its own frequency, amplitude and phase. The oscillators are processed
+ * in SIMD lanes (e.g. four or eight at once), which is much faster than separate oscillators
+ * for additive synthesis, chords, or many voices.
+ */
+class EXPORT OscillatorBank {
+public:
+	/// Creates @em count oscillators with zero amplitude
+	OscillatorBank(size_t count, waveform_t waveform = waveform_t::sine);
+
+	size_t size() const { return count_; }
+	waveform_t get_waveform() const { return waveform_; }
+	/// Sets frequency (in Hz) of an oscillator, throws std::out_of_range for invalid index
+	void set_frequency(size_t index, double frequency);
+	void set_amplitude(size_t index, float amplitude);
+	void set_phase(size_t index, double phase);
+	double get_frequency(size_t index) const;
+	float get_amplitude(size_t index) const;
+
+	/// Generates next @em count samples of the sum of all the oscillators
+	void generate(float* output, size_t count, double rate);
+	/// Adds next @em count samples of the sum of all the oscillators to @em output
+	void add(float* output, size_t count, double rate);
+private:
+	void check_index(size_t index) const;
+
+	waveform_t waveform_;
+	size_t count_;
+	/*
+	 * Per oscillator values, padded to multiple of the vector width (the padding has zero amplitude)
+	 */
+	std::vector<double> frequencies_;
+	std::vector<float> amplitudes_;
+	std::vector<double> phases_;
+	/// Phases used while generating, reloaded from @em phases_ regularly, so the rounding errors don't accumulate
+	std::vector<float> lane_phases_;
+	/// Phase increments per sample for the current sampling rate and their inverse values
+	std::vector<float> increments_;
+	std::vector<float> inverse_increments_;
+};
+
+}
+
+#endif /* INCLUDE_IIMAVLIB_OSCILLATOR_H_ */
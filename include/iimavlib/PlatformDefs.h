@@ -58,4 +58,14 @@
 #endif
 #endif
 
+// SSE2 is part of every x86_64 CPU, the vectorized code paths use it when the compiler does.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IIMAVLIB_SSE2 1
+#endif
+
+// AVX2 isn't available on every x86_64 CPU, so it has to be enabled explicitly (option USE_AVX2 or -mavx2)
+#if defined(__AVX2__)
+#define IIMAVLIB_AVX2 1
+#endif
+
 #endif
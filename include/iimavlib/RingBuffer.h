@@ -0,0 +1,356 @@
+/**
+ * @file 	RingBuffer.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file defines lock-free queues and buffers for passing data between threads
+ */
+
+#ifndef RINGBUFFER_H_
+#define RINGBUFFER_H_
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace iimavlib {
+
+/*!
+ * @brief Lock-free single producer, single consumer ring buffer
+ *
+ * One thread may call @em push, another thread may call @em pop concurrently,
+ * without any locking. Neither of the operations allocates memory,
+ * so the producer can be a real-time (audio) thread.
+ * @tparam T Type of the stored values, should be trivially copyable
+ */
+template<typename T>
+class spsc_ring_t {
+public:
+	/*!
+	 * @param capacity Minimal number of elements the ring can hold. Rounded up to a power of 2.
+	 */
+	spsc_ring_t(std::size_t capacity):head_(0),tail_(0)
+	{
+		std::size_t size = 1;
+		while (size < capacity) size <<= 1;
+		data_.resize(size);
+		mask_ = size - 1;
+	}
+
+	/// Maximal number of elements in the ring
+	std::size_t capacity() const { return data_.size(); }
+
+	/// Number of elements currently available for reading
+	std::size_t size() const {
+		return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+	}
+
+	/// Number of elements that can be pushed
+	std::size_t free_space() const { return capacity() - size(); }
+
+	/*!
+	 * @brief Stores @em count elements to the ring. Should be called only from the producer thread.
+	 *
+	 * The data are stored either completely, or not at all.
+	 * @return true if the data were stored, false if there wasn't enough space
+	 */
+	bool push(const T* src, std::size_t count) {
+		const std::size_t head = head_.load(std::memory_order_relaxed);
+		const std::size_t tail = tail_.load(std::memory_order_acquire);
+		if (capacity() - (head - tail) < count) return false;
+		copy_in(head, src, count);
+		head_.store(head + count, std::memory_order_release);
+		return true;
+	}
+
+	/*!
+	 * @brief Reads up to @em max_count elements from the ring. Should be called only from the consumer thread.
+	 * @return Number of elements read
+	 */
+	std::size_t pop(T* dst, std::size_t max_count) {
+		const std::size_t tail = tail_.load(std::memory_order_relaxed);
+		const std::size_t head = head_.load(std::memory_order_acquire);
+		const std::size_t count = std::min(max_count, head - tail);
+		const std::size_t first = tail & mask_;
+		const std::size_t part1 = std::min(count, capacity() - first);
+		std::copy(data_.begin() + first, data_.begin() + first + part1, dst);
+		std::copy(data_.begin(), data_.begin() + (count - part1), dst + part1);
+		tail_.store(tail + count, std::memory_order_release);
+		return count;
+	}
+
+	/*!
+	 * @brief Discards all elements in the ring. Should be called only from the consumer thread.
+	 */
+	void clear() {
+		tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+	}
+
+private:
+	void copy_in(std::size_t head, const T* src, std::size_t count) {
+		const std::size_t first = head & mask_;
+		const std::size_t part1 = std::min(count, capacity() - first);
+		std::copy(src, src + part1, data_.begin() + first);
+		std::copy(src + part1, src + count, data_.begin());
+	}
+
+	std::vector<T> data_;
+	std::size_t mask_;
+	/// Position of the next write, modified only by the producer.
+	std::atomic<std::size_t> head_;
+	/// Padding to keep producer and consumer indices in separate cache lines
+	char padding_[64];
+	/// Position of the next read, modified only by the consumer.
+	std::atomic<std::size_t> tail_;
+};
+
+/*!
+ * @brief Lock-free bounded queue for multiple producers and multiple consumers
+ *
+ * Any thread may call @em push or @em pop at any time. Neither of the operations
+ * allocates memory or blocks, so they can be used from real-time threads.
+ * Based on the bounded MPMC queue by Dmitry Vyukov.
+ * @tparam T Type of the stored values, has to be default constructible and copyable
+ */
+template<typename T>
+class mpmc_queue_t {
+public:
+	/*!
+	 * @param capacity Minimal number of elements the queue can hold. Rounded up to a power of 2.
+	 */
+	mpmc_queue_t(std::size_t capacity):enqueue_pos_(0),dequeue_pos_(0)
+	{
+		std::size_t size = 2;
+		while (size < capacity) size <<= 1;
+		cells_.reset(new cell_t[size]);
+		for (std::size_t i = 0; i < size; ++i) cells_[i].sequence.store(i, std::memory_order_relaxed);
+		mask_ = size - 1;
+	}
+
+	/// Maximal number of elements in the queue
+	std::size_t capacity() const { return mask_ + 1; }
+
+	/*!
+	 * @brief Adds a value to the queue
+	 * @return false if the queue is full
+	 */
+	bool push(const T& value) {
+		cell_t* cell;
+		std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+		while (true) {
+			cell = &cells_[pos & mask_];
+			const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+			const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+			if (diff == 0) {
+				if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = enqueue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+		cell->data = value;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*!
+	 * @brief Removes the oldest value from the queue
+	 * @return false if the queue is empty
+	 */
+	bool pop(T& value) {
+		cell_t* cell;
+		std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+		while (true) {
+			cell = &cells_[pos & mask_];
+			const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+			const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+			if (diff == 0) {
+				if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			} else if (diff < 0) {
+				return false;
+			} else {
+				pos = dequeue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+		value = cell->data;
+		cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	struct cell_t {
+		std::atomic<std::size_t> sequence;
+		T data;
+	};
+	std::unique_ptr<cell_t[]> cells_;
+	std::size_t mask_;
+	char padding0_[64];
+	std::atomic<std::size_t> enqueue_pos_;
+	char padding1_[64];
+	std::atomic<std::size_t> dequeue_pos_;
+};
+
+/*!
+ * @brief Queue of events scheduled to sample frames, passed to a real-time (audio) thread
+ *
+ * Any thread may call @em push, a single consumer takes the events in the order of their frames
+ * (events with the same frame in the order they were pushed).
+ * Pushed events go through a lock-free @em mpmc_queue_t and the consumer sorts them to a list
+ * with preallocated capacity, so none of the operations allocates memory or blocks.
+ * @tparam T Type of the event data, has to be default constructible and copyable
+ */
+template<typename T>
+class event_queue_t {
+public:
+	struct event_t {
+		/// Index of the sample at which the event happens
+		uint64_t frame;
+		T data;
+	};
+
+	/*!
+	 * @param capacity Minimal number of events waiting in the queue. Rounded up to a power of 2.
+	 */
+	event_queue_t(std::size_t capacity):incoming_(capacity),dropped_(0)
+	{
+		pending_.reserve(incoming_.capacity());
+	}
+
+	/*!
+	 * @brief Schedules an event, can be called from any thread
+	 *
+	 * Events scheduled to frames that were already processed happen as soon as possible.
+	 * @return false if the queue is full
+	 */
+	bool push(uint64_t frame, const T& data) {
+		event_t event;
+		event.frame = frame;
+		event.data = data;
+		if (incoming_.push(event)) return true;
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	/*!
+	 * @brief Removes the earliest event happening before @em frame. Should be called only from the consumer thread.
+	 * @return false if there's no such event
+	 */
+	bool pop(uint64_t frame, event_t& event) {
+		collect();
+		if (pending_.empty() || pending_.back().frame >= frame) return false;
+		event = pending_.back();
+		pending_.pop_back();
+		return true;
+	}
+
+	/// Frame of the earliest event, or maximal value when there's none. Should be called only from the consumer thread.
+	uint64_t next_frame() {
+		collect();
+		return pending_.empty() ? std::numeric_limits<uint64_t>::max() : pending_.back().frame;
+	}
+
+	/// Number of samples from @em frame to the earliest event, at most @em count. Should be called only from the consumer thread.
+	std::size_t distance(uint64_t frame, std::size_t count) {
+		const uint64_t next = next_frame();
+		if (next <= frame) return 0;
+		return static_cast<std::size_t>(std::min<uint64_t>(next - frame, count));
+	}
+
+	/// Removes all the events. Should be called only from the consumer thread.
+	void clear() {
+		collect();
+		pending_.clear();
+	}
+
+	/// Number of events dropped because the queue was full
+	uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+	/// Moves the pushed events to @em pending_, sorted by descending frames, so the earliest event is at the end
+	void collect() {
+		event_t event;
+		while (incoming_.pop(event)) {
+			if (pending_.size() == pending_.capacity()) {
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			// Before the events with the same frame, which were pushed earlier
+			const auto position = std::lower_bound(pending_.begin(), pending_.end(), event,
+					[](const event_t& a, const event_t& b) { return a.frame > b.frame; });
+			pending_.insert(position, event);
+		}
+	}
+
+	mpmc_queue_t<event_t> incoming_;
+	std::vector<event_t> pending_;
+	std::atomic<uint64_t> dropped_;
+};
+
+/*!
+ * @brief Lock-free triple buffer for publishing snapshots of data
+ *
+ * A single writer fills the back buffer and publishes it, a single reader
+ * picks up the latest published buffer. The writer never waits for the reader,
+ * so it can be a real-time (audio) thread, and the reader never sees a partially written value.
+ * Values published between two updates of the reader are skipped.
+ * @tparam T Type of the stored values
+ */
+template<typename T>
+class triple_buffer_t {
+public:
+	/*!
+	 * @param initial Initial value of all three buffers (e.g. a preallocated vector)
+	 */
+	triple_buffer_t(const T& initial = T()):back_(0),front_(1),state_(2)
+	{
+		for (auto& buffer: buffers_) buffer = initial;
+	}
+
+	/// Buffer for the writer to fill. Should be called only from the writer thread.
+	T& back() { return buffers_[back_]; }
+
+	/*!
+	 * @brief Publishes the back buffer. Should be called only from the writer thread.
+	 *
+	 * The writer gets a different buffer to fill, possibly with older data.
+	 */
+	void publish() {
+		back_ = state_.exchange(back_ | fresh_flag, std::memory_order_acq_rel) & index_mask;
+	}
+
+	/*!
+	 * @brief Switches the front buffer to the latest published one. Should be called only from the reader thread.
+	 * @return true if there was a new value published since the last update
+	 */
+	bool update() {
+		if (!(state_.load(std::memory_order_relaxed) & fresh_flag)) return false;
+		front_ = state_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+		return true;
+	}
+
+	/// Buffer for the reader, valid until the next call to @em update. Should be called only from the reader thread.
+	const T& front() const { return buffers_[front_]; }
+
+private:
+	static const uint8_t index_mask = 3;
+	static const uint8_t fresh_flag = 4;
+	T buffers_[3];
+	/// Index of buffer used by the writer
+	uint8_t back_;
+	/// Padding to keep writer's and reader's indices in separate cache lines
+	char padding0_[64];
+	/// Index of buffer used by the reader
+	uint8_t front_;
+	char padding1_[64];
+	/// Index of the buffer in the middle, with flag whether it holds a value not seen by the reader
+	std::atomic<uint8_t> state_;
+};
+
+}
+
+#endif /* RINGBUFFER_H_ */
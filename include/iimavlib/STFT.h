@@ -0,0 +1,117 @@
+/**
+ * @file 	STFT.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares streaming short-time Fourier transform
+ */
+
+#ifndef STFT_H_
+#define STFT_H_
+
+#include "AudioTypes.h"
+#include "FFT.h"
+#include "RingBuffer.h"
+#include "PlatformDefs.h"
+#include <atomic>
+#include <functional>
+#include <vector>
+
+namespace iimavlib {
+
+/**
+ * @brief Short-time Fourier transform of an audio stream
+ *
+ * Samples (average of both channels) are pushed incrementally, e.g. from @em AudioFilter::do_process.
+ * Every time @em hop new samples arrive, last @em size samples are windowed and transformed
+ * to a frame of magnitudes. So the cost of the analysis depends only on the audio rate,
+ * not on how often the frames are read.
+ *
+ * The magnitudes are normalized, so a full scale sine wave has a peak of magnitude 1
+ * (spread over several bins for windows other than rectangular).
+ * The latest frame is published through a lock-free triple buffer and can be read by another thread.
+ */
+class EXPORT STFT
+{
+public:
+	/// Callback receiving magnitudes of every frame (@em get_bins() values)
+	typedef std::function<void(const float* magnitudes, size_t bins)> frame_callback_t;
+
+	/**
+	 * @param size Number of samples in a frame, has to be even (at least 2)
+	 * @param hop Number of new samples between two frames, larger than 0
+	 * @param window Window function applied to the frames
+	 *
+	 * Throws std::runtime_error for invalid size or hop.
+	 */
+	STFT(size_t size, size_t hop, window_type_t window = window_type_t::hann);
+#ifdef SYSTEM_LINUX
+	STFT(const STFT&) = delete;
+	STFT& operator=(const STFT&) = delete;
+#endif
+
+	/**
+	 * @brief Consumes samples and computes frames for every complete hop
+	 *
+	 * Should be called from a single thread. Doesn't allocate any memory, so it's real-time safe
+	 * (as long as the callback is).
+	 * @return Number of frames computed
+	 */
+	size_t push(const audio_sample_t* samples, size_t count);
+
+	/**
+	 * @brief Consumes valid samples of a buffer
+	 */
+	size_t push(const audio_buffer_t& buffer) { return push(buffer.data.data(), buffer.valid_samples); }
+
+	/**
+	 * @brief Sets a callback called for every frame from the thread calling @em push
+	 *
+	 * Should be set before pushing any samples.
+	 */
+	void set_callback(frame_callback_t callback) { callback_ = callback; }
+
+	/**
+	 * @brief Copies the latest frame. Lock-free, should be called from a single thread.
+	 * @param magnitudes Output vector, resized to @em get_bins(). Left untouched if there's no new frame.
+	 * @return true if a new frame was available since the last call
+	 */
+	bool read_frame(std::vector<float>& magnitudes);
+
+	/// Returns number of samples in a frame
+	size_t get_size() const { return size_; }
+	/// Returns number of samples between frames
+	size_t get_hop() const { return hop_; }
+	/// Returns number of magnitudes in a frame (size/2+1, from DC to Nyquist frequency)
+	size_t get_bins() const { return plan_.bins(); }
+	/// Returns number of frames computed so far. Can be called from any thread.
+	uint64_t get_frame_count() const { return frame_count_.load(std::memory_order_relaxed); }
+
+private:
+	void compute_frame();
+
+	size_t size_;
+	size_t hop_;
+	real_fft_plan_t<float> plan_;
+	simplearray_t<float> window_;
+	/// Normalization of the magnitudes
+	float scale_;
+	/// Last @em size_ samples, circular
+	std::vector<float> history_;
+	/// Position of the next sample in @em history_
+	size_t position_;
+	/// Number of samples received since the last frame
+	size_t pending_;
+	/// Windowed samples of the current frame
+	simplearray_t<float> frame_;
+	complexarray_t<float> spectrum_;
+	/// Scratch buffer of the transform (for sizes using Bluestein's algorithm)
+	complexarray_t<float> work_;
+	triple_buffer_t<std::vector<float>> magnitudes_;
+	frame_callback_t callback_;
+	std::atomic<uint64_t> frame_count_;
+};
+
+}
+
+#endif /* STFT_H_ */
@@ -0,0 +1,315 @@
+/**
+ * @file 	SampleBank.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares shared storage of audio samples loaded from files
+ */
+
+#ifndef SAMPLEBANK_H_
+#define SAMPLEBANK_H_
+
+#include "AudioTypes.h"
+#include "MappedWaveFile.h"
+#include "PlatformDefs.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace iimavlib {
+
+/*!
+ * @brief State of a sample in the bank
+ */
+enum class sample_state_t: uint8_t {
+	loading,  //!< Sample is waiting for the loader thread
+	ready,    //!< Data are available
+	failed    //!< The file couldn't be loaded
+};
+
+class CompressedFile;
+
+/**
+ * @brief Sequential reader of samples from a WAV or compressed (.iac) file
+ *
+ * Used to stream the parts of samples that aren't kept in memory.
+ * WAV files are read through a mapping with sequential read-ahead.
+ */
+class EXPORT SampleReader
+{
+public:
+	/**
+	 * @brief Opens a file for reading
+	 *
+	 * Throws std::runtime_error when the file doesn't exist or has unsupported format.
+	 */
+	SampleReader(const std::string& filename);
+	~SampleReader();
+#ifdef SYSTEM_LINUX
+	SampleReader(const SampleReader&) = delete;
+	SampleReader& operator=(const SampleReader&) = delete;
+#endif
+
+	/**
+	 * @brief Reads samples, converting them to 16bit stereo
+	 * @param data Output buffer
+	 * @param sample_count Maximal number of samples to read. Set to 0 to fill the whole buffer.
+	 * @return Number of samples read, 0 at the end of the file or on error
+	 */
+	size_t read_data(std::vector<audio_sample_t>& data, size_t sample_count = 0);
+
+	/**
+	 * @brief Sets read position
+	 */
+	error_type_t seek(uint64_t position);
+
+	/// Returns params of the file
+	audio_params_t get_params() const { return params_; }
+	/// Returns number of samples in the file
+	uint64_t get_sample_count() const { return sample_count_; }
+	/// Returns index of the next sample to read
+	uint64_t get_position() const { return position_; }
+private:
+	std::unique_ptr<MappedWaveFile> mapped_;
+	std::unique_ptr<CompressedFile> compressed_;
+	audio_params_t params_;
+	uint64_t sample_count_;
+	uint64_t position_;
+};
+
+/**
+ * @brief Single sample stored in a SampleBank
+ *
+ * 16bit stereo WAV files are mapped to memory, other WAV formats and compressed files (.iac)
+ * are decoded to memory. The data stay valid as long as there's a handle (@em pBankSample) to the sample.
+ *
+ * Streamed samples keep only the beginning (preload) in memory, the rest has to be read
+ * with a @em SampleReader. For these samples @em get_length is larger than size of @em data.
+ */
+class EXPORT BankSample
+{
+public:
+	/**
+	 * @param filename Name of the file to load
+	 * @param clock Clock of the bank, used to order uses of the samples
+	 * @param preload_time Length (in seconds) of the beginning kept in memory, 0 to keep the whole sample
+	 */
+	BankSample(const std::string& filename, const std::shared_ptr<std::atomic<uint64_t>>& clock,
+			double preload_time = 0.0);
+#ifdef SYSTEM_LINUX
+	BankSample(const BankSample&) = delete;
+	BankSample& operator=(const BankSample&) = delete;
+#endif
+
+	/// Returns name of the file the sample was loaded from
+	const std::string& get_filename() const { return filename_; }
+	/// Returns current state of the sample
+	sample_state_t get_state() const { return state_.load(std::memory_order_acquire); }
+	/// Returns true if the data are available. Real-time safe.
+	bool ready() const { return get_state() == sample_state_t::ready; }
+	/**
+	 * @brief Returns the samples, or an empty view if the sample isn't loaded yet.
+	 *
+	 * Real-time safe.
+	 */
+	array_view_t<const audio_sample_t> data() const {
+		return ready() ? view_ : array_view_t<const audio_sample_t>();
+	}
+	/// Returns params of the sample (valid when the sample is ready)
+	audio_params_t get_params() const { return params_; }
+	/**
+	 * @brief Returns number of samples in the file (valid when the sample is ready). Real-time safe.
+	 *
+	 * Equal to size of @em data, unless the sample is streamed.
+	 */
+	uint64_t get_length() const { return length_; }
+	/// Returns true if only the beginning of the sample is kept in memory (valid when the sample is ready)
+	bool streamed() const { return length_ > view_.size(); }
+	/// Returns the preload time the sample was requested with
+	double get_preload_time() const { return preload_time_; }
+	/// Returns number of bytes of memory occupied by the sample
+	size_t get_memory_usage() const { return memory_; }
+	/**
+	 * @brief Marks the sample as recently used, so it's evicted last. Real-time safe.
+	 */
+	void touch() { last_use_.store(clock_->fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed); }
+	/// Returns value of bank's clock when the sample was used last time
+	uint64_t get_last_use() const { return last_use_.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief Loads the data. Called by the bank's loader thread.
+	 */
+	void load();
+private:
+	std::string filename_;
+	std::atomic<sample_state_t> state_;
+	std::shared_ptr<std::atomic<uint64_t>> clock_;
+	std::atomic<uint64_t> last_use_;
+	std::unique_ptr<MappedWaveFile> mapped_;
+	std::vector<audio_sample_t> decoded_;
+	array_view_t<const audio_sample_t> view_;
+	audio_params_t params_;
+	uint64_t length_;
+	double preload_time_;
+	size_t memory_;
+};
+
+typedef std::shared_ptr<BankSample> pBankSample;
+
+/**
+ * @brief Storage of samples shared by several filters
+ *
+ * Each file is loaded only once, no matter how many filters use it.
+ * Files are loaded lazily in a background thread, the handles returned by @em get
+ * are usable immediately and become ready when the data are loaded.
+ * When the memory used by the samples exceeds the budget, the least recently used samples
+ * that aren't referenced by any handle are evicted.
+ *
+ * Releasing the last handle to a sample frees its memory, so audio threads shouldn't own handles.
+ * Use @em SampleSlot to pass samples to an audio thread.
+ */
+class EXPORT SampleBank
+{
+public:
+	/**
+	 * @brief Creates the bank and starts the loader thread
+	 * @param memory_budget Memory (in bytes) the loaded samples should fit into.
+	 * 		Samples referenced by a handle are never evicted, so the usage may exceed the budget.
+	 */
+	SampleBank(size_t memory_budget = default_memory_budget);
+	~SampleBank();
+#ifdef SYSTEM_LINUX
+	SampleBank(const SampleBank&) = delete;
+	SampleBank& operator=(const SampleBank&) = delete;
+#endif
+
+	/**
+	 * @brief Returns handle to a sample, scheduling it for loading if it's not in the bank yet
+	 *
+	 * The call doesn't wait for the data, use @em wait or check @em BankSample::ready.
+	 * Streamed and fully loaded variants of the same file are stored separately.
+	 * Samples that failed to load aren't kept in the bank, so the next call tries to load the file again.
+	 * @param filename Name of the file to load
+	 * @param preload_time Length (in seconds) of the beginning kept in memory, rest of the sample
+	 * 		is streamed from the file. Set to 0 to load the whole sample.
+	 */
+	pBankSample get(const std::string& filename, double preload_time = 0.0);
+
+	/**
+	 * @brief Returns handle to a sample, waiting until it's loaded
+	 *
+	 * Throws std::runtime_error when the file can't be loaded.
+	 * @param filename Name of the file to load
+	 * @param preload_time Length (in seconds) of the beginning kept in memory, 0 to load the whole sample
+	 */
+	pBankSample load(const std::string& filename, double preload_time = 0.0);
+
+	/**
+	 * @brief Waits until a sample is loaded (or fails to load)
+	 * @return true if the sample is ready
+	 */
+	bool wait(const pBankSample& sample);
+
+	/**
+	 * @brief Sets the memory budget and evicts samples over it
+	 */
+	void set_memory_budget(size_t memory_budget);
+
+	/**
+	 * @brief Returns memory occupied by all loaded samples
+	 */
+	size_t get_memory_usage() const;
+
+	/**
+	 * @brief Returns number of samples in the bank
+	 */
+	size_t get_sample_count() const;
+
+	/**
+	 * @brief Evicts least recently used unreferenced samples until the memory usage fits the budget
+	 */
+	void trim();
+
+	/// Default memory budget
+	static const size_t default_memory_budget = 256*1024*1024;
+
+private:
+	void loader_thread();
+	void do_trim();
+
+	mutable std::mutex mutex_;
+	std::condition_variable queue_cond_;
+	std::condition_variable loaded_cond_;
+	/// Samples indexed by filename and a flag whether they're streamed
+	std::map<std::pair<std::string, bool>, pBankSample> samples_;
+	std::deque<pBankSample> queue_;
+	size_t memory_budget_;
+	/// Logical clock used to order sample uses, shared with the samples
+	std::shared_ptr<std::atomic<uint64_t>> clock_;
+	bool running_;
+	std::thread thread_;
+};
+
+typedef std::shared_ptr<SampleBank> pSampleBank;
+
+/**
+ * @brief Holder of a sample used by an audio thread, allowing to swap the sample in real-time safe way.
+ *
+ * A control thread calls @em set, the audio thread calls @em acquire at the beginning of every
+ * processed buffer. The previous sample is released (by the control thread) only after the audio thread
+ * acquires the new one, so the audio thread never frees any memory.
+ */
+class EXPORT SampleSlot
+{
+public:
+	SampleSlot();
+#ifdef SYSTEM_LINUX
+	SampleSlot(const SampleSlot&) = delete;
+	SampleSlot& operator=(const SampleSlot&) = delete;
+#endif
+
+	/**
+	 * @brief Sets new sample for the slot. Should be called from a control thread.
+	 */
+	void set(const pBankSample& sample);
+
+	/**
+	 * @brief Returns current sample, or nullptr if the slot is empty. Real-time safe.
+	 *
+	 * Should be called from a single (audio) thread, the returned sample is valid
+	 * until the next call to @em acquire.
+	 */
+	BankSample* acquire();
+
+	/**
+	 * @brief Releases samples replaced by @em set, which the audio thread doesn't use anymore.
+	 *
+	 * Called automatically by @em set, can be called periodically by the control thread.
+	 */
+	void collect();
+
+	/**
+	 * @brief Returns number of replaced samples not released yet
+	 */
+	size_t get_retired_count() const;
+
+private:
+	mutable std::mutex mutex_;
+	pBankSample owned_;
+	/// Replaced samples with the version that replaced them
+	std::vector<std::pair<uint64_t, pBankSample>> retired_;
+	std::atomic<BankSample*> current_;
+	std::atomic<uint64_t> version_;
+	/// Last version seen by the audio thread
+	std::atomic<uint64_t> seen_;
+};
+
+}
+
+#endif /* SAMPLEBANK_H_ */
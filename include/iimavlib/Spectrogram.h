@@ -0,0 +1,130 @@
+/**
+ * @file 	Spectrogram.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares batch computation of spectrograms of recorded audio
+ */
+
+#ifndef SPECTROGRAM_H_
+#define SPECTROGRAM_H_
+
+#include "AudioTypes.h"
+#include "FFT.h"
+#include "PlatformDefs.h"
+#include <atomic>
+#include <vector>
+
+namespace iimavlib {
+
+class WaveFile;
+
+/**
+ * @brief Parameters of a spectrogram
+ */
+struct spectrogram_params_t {
+	/// Number of samples in a frame, has to be even (at least 2)
+	size_t size;
+	/// Number of samples between starts of two frames, larger than 0
+	size_t hop;
+	/// Window function applied to the frames
+	window_type_t window;
+	/// Number of threads computing the frames, 0 for one thread per core
+	size_t threads;
+
+	spectrogram_params_t(size_t size = 2048, size_t hop = 512, window_type_t window = window_type_t::hann, size_t threads = 0):
+		size(size),hop(hop),window(window),threads(threads) {}
+};
+
+/**
+ * @brief Magnitudes of all frames of a spectrogram, stored frame after frame in a single array
+ */
+struct spectrogram_t {
+	/// Number of frames
+	size_t frames;
+	/// Number of magnitudes in a frame (size/2+1, from DC to Nyquist frequency)
+	size_t bins;
+	/// @em frames * @em bins magnitudes
+	std::vector<float> data;
+	/// Time spent computing the frames, in seconds
+	double seconds;
+
+	spectrogram_t():frames(0),bins(0),seconds(0.0) {}
+
+	/// Returns magnitudes of a frame
+	array_view_t<const float> frame(size_t index) const { return array_view_t<const float>(&data[index * bins], bins); }
+	/// Returns number of frames computed per second
+	double frames_per_second() const { return seconds > 0.0 ? frames / seconds : 0.0; }
+};
+
+/**
+ * @brief Computes spectrograms of recorded audio using several threads
+ *
+ * Frame @em i covers samples from @em i*hop to @em i*hop+size-1 (only complete frames are computed).
+ * The magnitudes are computed from average of both channels and normalized the same way as in @em STFT,
+ * so a full scale sine wave has a peak of magnitude 1.
+ *
+ * The frames are split to chunks of @em chunk_frames, which are taken by a pool of worker threads
+ * from a shared counter, so the load is balanced without any locking. All the threads share a single FFT plan
+ * and write directly to the output array.
+ * Files are read in segments, the next segment is read while the frames of the current one are computed,
+ * so the memory used for samples doesn't depend on length of the file. The workers are started once per file
+ * and wait on a condition variable for the following segment.
+ */
+class EXPORT Spectrogram
+{
+public:
+	/**
+	 * Throws std::runtime_error for invalid size or hop.
+	 */
+	explicit Spectrogram(const spectrogram_params_t& params = spectrogram_params_t());
+#ifdef SYSTEM_LINUX
+	Spectrogram(const Spectrogram&) = delete;
+	Spectrogram& operator=(const Spectrogram&) = delete;
+#endif
+
+	/**
+	 * @brief Computes spectrogram of samples in memory
+	 * @param samples Input samples (e.g. from MappedWaveFile::get_samples)
+	 * @param result Output spectrogram, its memory is reused when computing several spectrograms of the same size
+	 */
+	void compute(array_view_t<const audio_sample_t> samples, spectrogram_t& result) const;
+	spectrogram_t compute(array_view_t<const audio_sample_t> samples) const;
+
+	/**
+	 * @brief Computes spectrogram of the samples remaining in a file opened for reading
+	 *
+	 * Throws std::runtime_error when reading fails.
+	 */
+	void compute(WaveFile& file, spectrogram_t& result) const;
+	spectrogram_t compute(WaveFile& file) const;
+
+	/// Returns number of complete frames in @em samples samples
+	size_t get_frame_count(size_t samples) const;
+	/// Returns number of magnitudes in a frame
+	size_t get_bins() const { return plan_.bins(); }
+	/// Returns number of worker threads
+	size_t get_threads() const { return threads_; }
+
+	/// Number of frames computed by a worker at once
+	static const size_t chunk_frames = 64;
+	/// Approximate number of samples in a segment read from a file
+	static const size_t segment_samples = 1 << 20;
+private:
+	/// Computes chunks of @em frames frames starting at @em samples, until there are no chunks left
+	void work(const audio_sample_t* samples, size_t frames, float* output, std::atomic<size_t>& next) const;
+	/// Computes frames @em first to @em last-1, @em output points to magnitudes of the frame @em first
+	void compute_frames(const audio_sample_t* samples, size_t first, size_t last, float* output) const;
+
+	size_t size_;
+	size_t hop_;
+	size_t threads_;
+	real_fft_plan_t<float> plan_;
+	simplearray_t<float> window_;
+	/// Normalization of the magnitudes
+	float scale_;
+};
+
+}
+
+#endif /* SPECTROGRAM_H_ */
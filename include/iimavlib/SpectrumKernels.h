@@ -0,0 +1,83 @@
+/**
+ * @file 	SpectrumKernels.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares vectorized computation of magnitude, power and decibel spectra
+ */
+
+#ifndef INCLUDE_IIMAVLIB_SPECTRUMKERNELS_H_
+#define INCLUDE_IIMAVLIB_SPECTRUMKERNELS_H_
+
+#include "AudioTypes.h"
+#include "PlatformDefs.h"
+#include <complex>
+#include <vector>
+
+namespace iimavlib {
+
+/*
+ * The functions write @em bins values to @em output, which has to be allocated by the caller.
+ * The spectrum is either interleaved (std::complex, as returned by the FFT plans)
+ * or split to arrays of real and imaginary parts. The spectrum is multiplied by @em scale first.
+ * Decibels are relative to 1.0 (so a full scale sine wave normalized like in STFT has 0 dB),
+ * values below @em floor_db are replaced by @em floor_db.
+ */
+
+/// Computes |scale * X|
+EXPORT void spectrum_magnitudes(const std::complex<float>* spectrum, float* output, size_t bins, float scale = 1.0f);
+EXPORT void spectrum_magnitudes(const float* real, const float* imag, float* output, size_t bins, float scale = 1.0f);
+
+/// Computes |scale * X|^2
+EXPORT void spectrum_powers(const std::complex<float>* spectrum, float* output, size_t bins, float scale = 1.0f);
+EXPORT void spectrum_powers(const float* real, const float* imag, float* output, size_t bins, float scale = 1.0f);
+
+/// Computes 20 * log10(|scale * X|)
+EXPORT void spectrum_decibels(const std::complex<float>* spectrum, float* output, size_t bins,
+		float scale = 1.0f, float floor_db = -120.0f);
+EXPORT void spectrum_decibels(const float* real, const float* imag, float* output, size_t bins,
+		float scale = 1.0f, float floor_db = -120.0f);
+
+/// Converts magnitudes (e.g. from STFT) to decibels, @em output may be the same as @em magnitudes
+EXPORT void magnitudes_to_decibels(const float* magnitudes, float* output, size_t bins, float floor_db = -120.0f);
+
+/**
+ * @brief Smoothing and peak hold of consecutive spectra for displaying
+ *
+ * The smoothed value follows increases of a bin by @em attack of the difference per frame
+ * and decreases by @em release of the difference, so bars rise fast and fall slowly.
+ * The peaks keep the maximal values, falling by @em peak_falloff per frame
+ * (in units of the spectrum, e.g. decibels).
+ * All the bins are updated by a single vectorized pass without any allocation.
+ */
+class EXPORT SpectrumSmoother {
+public:
+	/**
+	 * Throws std::runtime_error when @em attack or @em release is not in interval (0, 1>
+	 * or @em peak_falloff is negative.
+	 */
+	SpectrumSmoother(size_t bins, float attack = 1.0f, float release = 0.2f, float peak_falloff = 0.5f);
+
+	/**
+	 * @brief Updates the state with a new spectrum
+	 *
+	 * The first spectrum (and a spectrum of different size) resets the state to the spectrum.
+	 */
+	void update(array_view_t<const float> spectrum);
+	/// Forgets all the previous spectra
+	void reset();
+
+	const std::vector<float>& get_values() const { return values_; }
+	const std::vector<float>& get_peaks() const { return peaks_; }
+private:
+	float attack_;
+	float release_;
+	float peak_falloff_;
+	bool empty_;
+	std::vector<float> values_;
+	std::vector<float> peaks_;
+};
+
+}
+
+#endif /* INCLUDE_IIMAVLIB_SPECTRUMKERNELS_H_ */
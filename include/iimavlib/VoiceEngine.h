@@ -0,0 +1,294 @@
+/**
+ * @file 	VoiceEngine.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares polyphonic sample playback engine
+ */
+
+#ifndef VOICEENGINE_H_
+#define VOICEENGINE_H_
+
+#include "AudioFilter.h"
+#include "SampleBank.h"
+#include "RingBuffer.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace iimavlib {
+
+/// Identifier of a triggered voice, 0 is never used for a valid voice
+typedef uint32_t voice_id_t;
+
+/*!
+ * @brief Which voice is replaced when a new one is triggered and all voices are busy
+ */
+enum class steal_policy_t: uint8_t {
+	oldest,    //!< Voice that was triggered first
+	quietest,  //!< Voice with the lowest gain
+	none       //!< New voice is rejected
+};
+
+/*!
+ * @brief Statistics of a voice engine
+ */
+struct voice_stats_t {
+	/// Number of voices playing during the last processed buffer
+	size_t active_voices;
+	/// Maximal number of voices playing at once
+	size_t peak_voices;
+	/// Number of voices replaced by newer ones
+	uint64_t stolen_voices;
+	/// Number of triggers rejected because all voices were busy (with steal_policy_t::none)
+	uint64_t rejected_voices;
+	/// Number of events lost because the event queue was full
+	uint64_t dropped_events;
+	/// Number of streams in use during the last processed buffer
+	size_t active_streams;
+	/// Number of times a streamed voice ran out of data during a buffer
+	uint64_t starved_blocks;
+	/// Number of samples of silence inserted because streamed data weren't available
+	uint64_t starved_samples;
+	/// Number of streamed voices that played only the preloaded part (no free stream or read error)
+	uint64_t stream_failures;
+};
+
+/**
+ * @brief Polyphonic sample player
+ *
+ * Plays samples from a table of @em SampleSlot, using a preallocated pool of voices.
+ * Each voice has its own gain, pan and pitch, changes of these are interpolated over one buffer.
+ * Triggers and other events are passed through a lock-free queue, so they can be sent
+ * from any thread (keyboard, mouse or MIDI handlers) without blocking the audio thread.
+ *
+ * When the filter has a child, the voices are mixed into the child's output,
+ * otherwise the filter works as a generator.
+ *
+ * Streamed samples (see @em SampleBank::get) are played from the preloaded beginning,
+ * while a prefetch thread reads the rest of the file into a ring buffer of the voice.
+ * Streaming has to be enabled by @em enable_streaming. When the prefetch thread
+ * doesn't keep up, the voice waits for the data (outputs silence) and the starvation is counted in the stats.
+ */
+class EXPORT VoiceEngine: public AudioFilter
+{
+public:
+	/**
+	 * @param child Child filter, can be empty
+	 * @param max_voices Number of voices in the pool
+	 * @param max_samples Number of sample slots
+	 * @param policy Voice stealing policy
+	 */
+	VoiceEngine(const pAudioFilter& child, size_t max_voices = default_max_voices,
+			size_t max_samples = default_max_samples, steal_policy_t policy = steal_policy_t::oldest);
+	virtual ~VoiceEngine();
+
+	/**
+	 * @brief Sets sample for a slot. Should be called from a control thread.
+	 *
+	 * Voices playing the previous sample switch to the new one.
+	 * @return error_type_t::invalid if the index is out of range
+	 */
+	error_type_t set_sample(size_t index, const pBankSample& sample);
+
+	/**
+	 * @brief Starts a new voice. Lock-free, can be called from any thread.
+	 * @param sample Index of the sample slot
+	 * @param gain Gain of the voice
+	 * @param pan Position in stereo field (-1.0 left, 0.0 center, 1.0 right)
+	 * @param pitch Playback speed (1.0 for original pitch)
+	 * @return Identifier of the new voice, or 0 if the event queue is full.
+	 */
+	voice_id_t trigger(size_t sample, float gain = 1.0f, float pan = 0.0f, float pitch = 1.0f);
+
+	/**
+	 * @brief Changes parameters of a playing voice. Lock-free, can be called from any thread.
+	 *
+	 * The change is interpolated over one buffer. Events for voices that already ended are ignored.
+	 */
+	bool set_voice(voice_id_t voice, float gain, float pan, float pitch);
+
+	/**
+	 * @brief Fades out a voice. Lock-free, can be called from any thread.
+	 */
+	bool release(voice_id_t voice);
+
+	/**
+	 * @brief Fades out all voices. Lock-free, can be called from any thread.
+	 */
+	bool release_all();
+
+	/**
+	 * @brief Sets voice stealing policy
+	 */
+	void set_steal_policy(steal_policy_t policy);
+
+	/**
+	 * @brief Returns statistics of the engine. Can be called from any thread.
+	 */
+	voice_stats_t get_stats() const;
+
+	/**
+	 * @brief Enables playback of streamed samples and starts the prefetch thread
+	 *
+	 * Has to be called before the engine starts processing.
+	 * @param max_streams Maximal number of voices streaming at once
+	 * @param buffer_time Length (in seconds) of the ring buffer of each stream.
+	 * 		Should be shorter than the preload time of the samples.
+	 * 		Streamed voices are limited to pitch 4.0.
+	 * @return error_type_t::busy if the streaming is already enabled
+	 */
+	error_type_t enable_streaming(size_t max_streams, double buffer_time = 0.5);
+
+	/// Default number of voices
+	static const size_t default_max_voices = 256;
+	/// Default number of sample slots
+	static const size_t default_max_samples = 128;
+	/// Maximal number of samples processed at once, longer buffers are split
+	static const size_t block_size = 512;
+	/// Capacity of the event queue
+	static const size_t event_queue_size = 1024;
+	/// Number of samples read by the prefetch thread at once
+	static const size_t stream_chunk_size = 4096;
+
+private:
+	enum class event_type_t: uint8_t {
+		trigger, set, release, release_all
+	};
+	struct event_t {
+		event_type_t type;
+		voice_id_t voice;
+		uint32_t sample;
+		float gain;
+		float pan;
+		float pitch;
+	};
+	enum class voice_state_t: uint8_t {
+		free, playing, releasing
+	};
+	/*
+	 * Streams are started (idle -> starting) and stopped (-> stopping) by the audio thread,
+	 * the prefetch thread opens them (-> streaming), marks their end (-> ended, failed)
+	 * and confirms the stop (stopping -> stopped), after which the audio thread empties the ring (-> idle).
+	 */
+	enum class stream_state_t: uint8_t {
+		idle, starting, streaming, ended, failed, stopping, stopped
+	};
+	struct stream_t {
+		stream_t(size_t ring_size);
+		spsc_ring_t<audio_sample_t> ring;
+		std::atomic<stream_state_t> state;
+		/// Request written by the audio thread before switching to stream_state_t::starting
+		BankSample* sample;
+		uint32_t slot;
+		uint64_t start;
+		/// Used only by the prefetch thread
+		pBankSample owned;
+		std::unique_ptr<SampleReader> reader;
+		/// Contiguous copy of the samples around current position, used only by the audio thread
+		std::vector<audio_sample_t> window;
+		uint64_t window_first;
+		size_t window_count;
+		/// True once the window was filled from the preloaded part and continues with the ring
+		bool windowed;
+	};
+	/// Range of samples available for rendering a voice
+	struct source_t {
+		const audio_sample_t* data;
+		/// Index of the sample @em data points to
+		uint64_t first;
+		/// Index after the last available sample
+		uint64_t end;
+		/// Length of the whole sample
+		uint64_t length;
+	};
+	static const size_t no_stream = static_cast<size_t>(-1);
+	struct voice_t {
+		voice_state_t state;
+		voice_id_t id;
+		uint32_t sample;
+		/// Order in which the voices were triggered
+		uint64_t age;
+		/// Position in the sample as 32.32 fixed point number
+		uint64_t position;
+		/// Current and target increment of position (32.32 fixed point)
+		uint64_t step, target_step;
+		/// Current and target gains of both channels
+		float gain_left, gain_right;
+		float target_left, target_right;
+		/// Requested pitch (without correction of sampling rate)
+		float pitch;
+		/// True if the voice wasn't processed yet, so the target values are used directly
+		bool fresh;
+		/// Index of the stream used by the voice, or @em no_stream
+		size_t stream;
+		/// Sample being streamed, the voice ends if the slot changes to a different sample
+		BankSample* stream_sample;
+		/// True if a stream couldn't be started, so only the preloaded part is played
+		bool stream_failed;
+	};
+
+	virtual error_type_t do_process(audio_buffer_t& buffer);
+	bool push_event(const event_t& event);
+	void handle_event(const event_t& event);
+	voice_t* find_voice(voice_id_t id);
+	voice_t* allocate_voice();
+	void free_voice(size_t index);
+	/// Stops the stream used by a voice
+	void stop_stream(voice_t& voice);
+	/// Moves stopped streams back to the free list
+	void collect_streams();
+	/// Prepares source of a streamed voice, returns false if the voice can't continue
+	bool prepare_stream(voice_t& voice, BankSample* sample, size_t count, source_t& source);
+	void prefetch_thread();
+	/// Serves a single stream in the prefetch thread, returns true if any work was done
+	bool prefetch(stream_t& stream, std::vector<audio_sample_t>& buffer);
+	void set_targets(voice_t& voice, float gain, float pan, float pitch);
+	/// Renders a voice into @em mix_, returns false when the voice ended
+	bool render_voice(voice_t& voice, size_t count);
+
+	std::vector<voice_t> voices_;
+	/// Indices of active voices in @em voices_
+	std::vector<size_t> active_;
+	/// Indices of free voices in @em voices_
+	std::vector<size_t> free_;
+	std::unique_ptr<SampleSlot[]> slots_;
+	size_t slot_count_;
+	mpmc_queue_t<event_t> events_;
+	/// Interleaved stereo mix buffer
+	std::vector<float> mix_;
+	std::atomic<steal_policy_t> policy_;
+	std::atomic<voice_id_t> next_id_;
+	uint64_t next_age_;
+	/// Sampling rate of the output, used to correct pitch of samples with different rates
+	uint32_t rate_;
+	/// True if the voices are mixed into output of a child filter
+	bool has_child_;
+
+	std::vector<std::unique_ptr<stream_t>> streams_;
+	/// Indices of streams not used by any voice
+	std::vector<size_t> free_streams_;
+	/// Indices of streams waiting for the prefetch thread to stop them
+	std::vector<size_t> stopping_streams_;
+	/// Samples set to the slots, used by the prefetch thread to keep streamed samples alive
+	std::vector<pBankSample> stream_samples_;
+	std::mutex stream_mutex_;
+	std::atomic<bool> streaming_;
+	std::thread stream_thread_;
+
+	std::atomic<size_t> active_count_;
+	std::atomic<size_t> peak_voices_;
+	std::atomic<uint64_t> stolen_voices_;
+	std::atomic<uint64_t> rejected_voices_;
+	std::atomic<uint64_t> dropped_events_;
+	std::atomic<size_t> active_streams_;
+	std::atomic<uint64_t> starved_blocks_;
+	std::atomic<uint64_t> starved_samples_;
+	std::atomic<uint64_t> stream_failures_;
+};
+
+}
+
+#endif /* VOICEENGINE_H_ */
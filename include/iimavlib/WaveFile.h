@@ -11,6 +11,7 @@
 #define WAVEFILE_H_
 
 #include "AudioTypes.h"
+#include "WaveFormat.h"
 #include "PlatformDefs.h"
 #include <fstream>
 #include <string>
@@ -21,12 +22,24 @@ enum class read_mode_t {
 	read, write
 };
 
+/**
+ * @brief Header of WAV files written by the library
+ *
+ * The header reserves space for a ds64 chunk (as a JUNK chunk), so the file can be
+ * upgraded to RF64 in place, when the data grow over 4GB.
+ */
 PACKED_PRE
 struct wav_header_t
 {
 	char cID[4];
 	uint32_t cSize;
 	char wavID[4];
+	char ds64ID[4];
+	uint32_t ds64Size;
+	uint64_t riffSize64;
+	uint64_t dataSize64;
+	uint64_t sampleCount64;
+	uint32_t tableLength;
 	char subID[4];
 	uint32_t subSize;
 	uint16_t fmt;
@@ -38,7 +51,7 @@ struct wav_header_t
 	char dataID[4];
 	uint32_t dataSize;
 	wav_header_t(uint16_t channels=2,uint32_t rate=44100,uint16_t bps=16,bool le=true):
-			cSize(0),
+			cSize(sizeof(wav_header_t)-8),ds64Size(28),riffSize64(0),dataSize64(0),sampleCount64(0),tableLength(0),
 			subSize(16),fmt(1),channels(channels),rate(rate),
 			byte_rate((rate*channels*bps)>>3),block_align((channels*bps)>>3),bps(bps),
 			dataSize(0)
@@ -48,11 +61,35 @@ struct wav_header_t
 		std::copy_n("RIFF",4,cID);
 		if (!le) cID[3]='X';
 		std::copy_n("WAVE",4,wavID);
+		std::copy_n("JUNK",4,ds64ID);
 		std::copy_n("fmt ",4,subID);
 		std::copy_n("data",4,dataID);
 	}
-	void add_size(uint32_t size) { dataSize+=size;cSize=36+dataSize; }
-
+	/// Returns true if the header describes RF64 file
+	bool is_rf64() const { return std::equal(cID, cID+4, "RF64"); }
+	/// Returns size of the data in bytes
+	uint64_t data_size() const { return is_rf64()?dataSize64:dataSize; }
+	/**
+	 * @brief Adds @em size bytes to the size of data.
+	 *
+	 * Switches the header to RF64, when the size of the file doesn't fit to 32 bits.
+	 */
+	void add_size(uint64_t size) {
+		const uint64_t new_size = data_size() + size;
+		const uint64_t riff_size = sizeof(wav_header_t) - 8 + new_size;
+		if (is_rf64() || riff_size > 0xFFFFFFFFull) {
+			std::copy_n("RF64",4,cID);
+			std::copy_n("ds64",4,ds64ID);
+			cSize = 0xFFFFFFFFu;
+			dataSize = 0xFFFFFFFFu;
+			riffSize64 = riff_size;
+			dataSize64 = new_size;
+			sampleCount64 = block_align?new_size/block_align:0;
+		} else {
+			cSize = static_cast<uint32_t>(riff_size);
+			dataSize = static_cast<uint32_t>(new_size);
+		}
+	}
 } PACKED;
 
 
@@ -74,11 +111,53 @@ public:
 	/**
 	 * @brief Constructor for reading a WAV file
 	 *
-	 * Throws std::runtime_exception when the file doesn't exist or the header is corrupted
+	 * Supports 8, 16, 24 and 32 bit integer and 32 bit float data with any number of channels.
+	 * The data are converted to 16bit stereo when read.
+	 * Throws std::runtime_exception when the file doesn't exist, the header is corrupted
+	 * or the format isn't supported.
 	 * @param filename Name of the file to read
 	 */
 	WaveFile(const std::string& filename);
 
+	/**
+	 * @brief Destructor, writes out buffered data and finalizes the header
+	 */
+	~WaveFile();
+
+	/**
+	 * @brief Sets size of the write buffer
+	 *
+	 * Data are written to the disk in blocks of this size, aligned to @em write_alignment bytes in the file.
+	 * @param size Size of the buffer in bytes. Set to 0 to disable buffering.
+	 */
+	void set_buffer_size(size_t size);
+
+	/**
+	 * @brief Sets how often is the header updated during writing
+	 *
+	 * The header is always updated when the file is closed. Files that weren't closed properly
+	 * have their sizes recovered when opened for reading.
+	 * @param interval Minimal amount of data (in bytes) written between header updates.
+	 * 		Set to 0 to update the header only when closing the file.
+	 */
+	void set_header_interval(size_t interval);
+
+	/**
+	 * @brief Writes all buffered data to the disk and updates the header
+	 * @return Returns error_type_t::ok when written successfully
+	 */
+	error_type_t flush();
+
+	/**
+	 * @brief Reserves space on the disk for data that will be written later
+	 *
+	 * The size of the file doesn't change, only the disk blocks are allocated,
+	 * so subsequent writes don't have to wait for the filesystem to allocate them.
+	 * Unused reserved space is released when the file is closed.
+	 * @param data_size Number of data bytes to reserve (counted from the beginning of data)
+	 * @return error_type_t::ok on success, error_type_t::unsupported when the platform or filesystem doesn't support it.
+	 */
+	error_type_t preallocate(uint64_t data_size);
 
 	/**
 	 * @brief Adds data to the WAV file
@@ -90,10 +169,10 @@ public:
 	error_type_t store_data(const std::vector<audio_sample_t>& data, size_t sample_count = 0);
 
 	/**
-	 * @brief
-	 * @param data
-	 * @param sample_count
-	 * @return
+	 * @brief Reads data from the WAV file
+	 * @param data Buffer to store the samples to
+	 * @param sample_count Number of samples to read. Contains number of samples actually read after the call.
+	 * @return Returns error_type_t::ok when read successfully
 	 */
 
 	error_type_t read_data(std::vector<audio_sample_t>& data, size_t& sample_count);
@@ -103,14 +182,45 @@ public:
 	 */
 	audio_params_t get_params() const;
 
+	/**
+	 * @brief Returns description of data in the file
+	 */
+	const wav_info_t& get_info() const;
+
+	/**
+	 * @brief Returns number of samples in the file (including buffered ones when writing)
+	 */
+	size_t get_sample_count() const;
+
+	/// Default size of the write buffer
+	static const size_t default_buffer_size = 256*1024;
+	/// Default interval between header updates
+	static const size_t default_header_interval = 4*1024*1024;
+	/// Alignment of the blocks written to the disk
+	static const size_t write_alignment = 4096;
+
 private:
 	wav_header_t header_;
 	audio_params_t	params_;
+	std::string filename_;
 	std::fstream file_;
-	bool mono_source_;
-	std::vector<int16_t> mono_buffer_;
-
-	void update(size_t new_data_size = 0);
+	wav_info_t info_;
+	/// Raw data read from the file before conversion
+	std::vector<uint8_t> read_buffer_;
+	bool write_mode_;
+	/// Buffered data not written to the file yet
+	std::vector<char> write_buffer_;
+	size_t buffer_size_;
+	size_t header_interval_;
+	/// Bytes written to the file since the last header update
+	size_t since_header_;
+	/// Data bytes remaining to be read
+	uint64_t data_remaining_;
+	/// True if there's reserved space beyond the end of file
+	bool preallocated_;
+
+	void update();
+	error_type_t write_buffer(bool aligned_only);
 
 };
 
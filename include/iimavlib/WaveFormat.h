@@ -0,0 +1,107 @@
+/**
+ * @file 	WaveFormat.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares parser of RIFF/WAVE headers and conversions of PCM data
+ */
+
+#ifndef WAVEFORMAT_H_
+#define WAVEFORMAT_H_
+
+#include "AudioTypes.h"
+#include "PlatformDefs.h"
+#include <cstdint>
+#include <istream>
+
+namespace iimavlib {
+
+/*!
+ * @brief Encodings of PCM data supported by the library
+ */
+enum class pcm_format_t: uint8_t {
+	unknown,
+	uint8,   //!< 8 bit unsigned integer
+	int16,   //!< 16 bit signed integer
+	int24,   //!< 24 bit signed integer (packed in 3 bytes)
+	int32,   //!< 32 bit signed integer
+	float32  //!< 32 bit IEEE float in range <-1.0, 1.0>
+};
+
+/*!
+ * @brief Returns size of one value in bytes
+ */
+EXPORT size_t pcm_format_size(pcm_format_t format);
+
+/*!
+ * @brief Description of data in a WAV file
+ */
+struct wav_info_t {
+	/// Encoding of the samples
+	pcm_format_t format;
+	/// Number of interleaved channels
+	uint16_t channels;
+	/// Sampling rate in Hz
+	uint32_t rate;
+	/// Size of one frame (all channels) in bytes
+	uint16_t block_align;
+	/// Offset of the first sample in the file
+	uint64_t data_offset;
+	/// Size of the data in bytes
+	uint64_t data_size;
+	/// True if the size of data was recovered from the file size
+	bool recovered;
+
+	wav_info_t():format(pcm_format_t::unknown),channels(0),rate(0),block_align(0),
+			data_offset(0),data_size(0),recovered(false) {}
+	/// Number of frames in the file
+	uint64_t frames() const { return block_align?data_size/block_align:0; }
+};
+
+/*!
+ * @brief Parses headers of a RIFF/WAVE file
+ *
+ * Walks through all the chunks in the file, so @em fmt and @em data chunks are found
+ * anywhere in the file. Supports PCM, IEEE float and WAVE_FORMAT_EXTENSIBLE files,
+ * including RF64 files larger than 4GB.
+ * Size of the data of files that weren't finalized properly is recovered from the file size.
+ *
+ * Throws std::runtime_error if the file is not a valid WAV file or has unsupported format.
+ * @param stream Stream to read from. Position in the stream is undefined after the call.
+ * @param file_size Size of the file in bytes
+ * @return Description of the data
+ */
+EXPORT wav_info_t parse_wav_header(std::istream& stream, uint64_t file_size);
+
+/*!
+ * @brief Parses headers of a RIFF/WAVE file stored in memory
+ * @param data Pointer to beginning of the file
+ * @param size Size of the file in bytes
+ * @return Description of the data
+ */
+EXPORT wav_info_t parse_wav_header(const uint8_t* data, uint64_t size);
+
+/*!
+ * @brief Converts PCM values to 16bit signed integers
+ * @param src Source data
+ * @param format Encoding of the source data
+ * @param dst Destination buffer, has to have space for @em count values
+ * @param count Number of values to convert
+ */
+EXPORT void convert_pcm_to_int16(const uint8_t* src, pcm_format_t format, int16_t* dst, size_t count);
+
+/*!
+ * @brief Converts frames from a WAV file to samples in library's processing format
+ *
+ * Mono data are duplicated to both channels, only first two channels are used
+ * from data with more channels.
+ * @param src Source data
+ * @param info Description of the source data
+ * @param dst Destination buffer, has to have space for @em frames samples
+ * @param frames Number of frames to convert
+ */
+EXPORT void convert_pcm_to_samples(const uint8_t* src, const wav_info_t& info, audio_sample_t* dst, size_t frames);
+
+}
+
+#endif /* WAVEFORMAT_H_ */
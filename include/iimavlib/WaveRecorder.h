@@ -0,0 +1,95 @@
+/**
+ * @file 	WaveRecorder.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares filter recording audio to a WAV file in a background thread
+ */
+
+#ifndef WAVERECORDER_H_
+#define WAVERECORDER_H_
+
+#include "AudioFilter.h"
+#include "WaveFile.h"
+#include "RingBuffer.h"
+#include <atomic>
+#include <thread>
+#include <string>
+
+namespace iimavlib {
+
+/*!
+ * @brief Statistics of a running recorder
+ */
+struct recorder_stats_t {
+	/// Capacity of the ring buffer in samples
+	size_t ring_size;
+	/// Maximal number of samples waiting in the ring buffer so far
+	size_t high_water;
+	/// Number of buffers that didn't fit into the ring and were dropped
+	uint64_t dropped_blocks;
+	/// Number of samples in the dropped buffers
+	uint64_t dropped_samples;
+	/// Number of samples passed to the file
+	uint64_t written_samples;
+	/// True if writing to the file failed
+	bool write_failed;
+};
+
+/**
+ * @brief Filter recording passing audio to a WAV file
+ *
+ * Unlike WaveSink, the filter never touches the disk from the audio thread.
+ * The samples are copied to a lock-free ring buffer and written to the disk
+ * in large, aligned blocks by a separate writer thread.
+ * When the writer falls behind and the ring is full, whole buffers are dropped
+ * (and counted in the statistics) instead of blocking the audio thread.
+ */
+class EXPORT WaveRecorder: public AudioFilter
+{
+public:
+	/**
+	 * @brief Creates the WAV file and starts the writer thread
+	 *
+	 * Throws std::runtime_error when the file can't be created
+	 * @param child Child filter
+	 * @param filename Name of the file to write
+	 * @param buffer_time Length of the ring buffer in seconds
+	 * @param preallocate_time Disk space for this many seconds of audio is reserved in advance.
+	 * 		Set to 0 to disable preallocation.
+	 */
+	WaveRecorder(const pAudioFilter& child, const std::string& filename,
+			double buffer_time = 2.0, double preallocate_time = 60.0);
+	/**
+	 * @brief Stops the writer thread and writes out all remaining samples
+	 */
+	virtual ~WaveRecorder();
+
+	/**
+	 * @brief Returns current statistics. Can be called from any thread.
+	 */
+	recorder_stats_t get_stats() const;
+
+	/// Maximal number of samples written to the file at once
+	static const size_t block_size = 65536;
+private:
+	virtual error_type_t do_process(audio_buffer_t& buffer);
+	void writer_thread();
+	void stop();
+
+	WaveFile file_;
+	spsc_ring_t<audio_sample_t> ring_;
+	/// Number of bytes reserved in advance
+	uint64_t preallocate_size_;
+	std::atomic<bool> running_;
+	std::atomic<size_t> high_water_;
+	std::atomic<uint64_t> dropped_blocks_;
+	std::atomic<uint64_t> dropped_samples_;
+	std::atomic<uint64_t> written_samples_;
+	std::atomic<bool> write_failed_;
+	std::thread thread_;
+};
+
+}
+
+#endif /* WAVERECORDER_H_ */
@@ -12,19 +12,51 @@
 #define WAVESOURCE_H_
 
 #include "WaveFile.h"
+#include "MappedWaveFile.h"
 #include "AudioFilter.h"
+#include <memory>
 #include <string>
 
 namespace iimavlib {
 class EXPORT WaveSource: public AudioFilter {
 public:
+	/**
+	 * @brief Creates source reading the file using stream I/O
+	 * @param filename Name of the file to read
+	 */
 	WaveSource(const std::string filename);
+	/**
+	 * @brief Creates source reading the file through a memory mapping
+	 *
+	 * Mapped source can hand out views of the data (see @em get_view) instead of copying them.
+	 * @param filename Name of the file to read
+	 * @param hint Expected access pattern
+	 */
+	WaveSource(const std::string filename, access_hint_t hint);
 	virtual ~WaveSource();
 
+	/**
+	 * @brief Returns view of next samples in the file and advances read position
+	 *
+	 * Available only for mapped 16bit stereo files, returns empty view otherwise
+	 * or when the end of file was reached.
+	 * @param max_samples Maximal number of samples to return
+	 */
+	array_view_t<const audio_sample_t> get_view(size_t max_samples);
+
+	/**
+	 * @brief Sets read position for mapped files
+	 * @param position Index of the next sample to read
+	 * @return error_type_t::unsupported for non-mapped files
+	 */
+	error_type_t seek(size_t position);
+
 private:
 	virtual error_type_t do_process(audio_buffer_t& buffer);
 	virtual audio_params_t do_get_params() const;
-	WaveFile file_;
+	std::unique_ptr<WaveFile> file_;
+	std::unique_ptr<MappedWaveFile> mapped_file_;
+	size_t position_;
 };
 
 }
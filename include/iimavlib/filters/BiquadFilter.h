@@ -0,0 +1,164 @@
+/**
+ * @file 	BiquadFilter.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares biquad IIR filters (equalizers, filter banks)
+ */
+
+#ifndef BIQUADFILTER_H_
+#define BIQUADFILTER_H_
+
+#include "../AudioFilter.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace iimavlib {
+
+/*!
+ * @brief Types of biquad filters (from Audio EQ Cookbook by R. Bristow-Johnson)
+ */
+enum class biquad_type_t: uint8_t {
+	lowpass,
+	highpass,
+	/// Band pass with 0 dB gain at the center frequency
+	bandpass,
+	notch,
+	low_shelf,
+	high_shelf,
+	peaking,
+};
+
+/*!
+ * @brief Parameters of a single biquad section
+ */
+struct biquad_params_t {
+	biquad_type_t type;
+	/// Cutoff or center frequency in Hz, limited to slightly below the Nyquist frequency
+	double frequency;
+	/// Quality factor (0.7071 for Butterworth lowpass and highpass)
+	double q;
+	/// Gain in decibels, used only by shelves and peaking filters
+	double gain_db;
+
+	biquad_params_t(biquad_type_t type = biquad_type_t::lowpass, double frequency = 1000.0, double q = 0.7071, double gain_db = 0.0):
+		type(type),frequency(frequency),q(q),gain_db(gain_db) {}
+};
+
+/*!
+ * @brief Normalized coefficients of a biquad section, y = b0 x + b1 x[-1] + b2 x[-2] - a1 y[-1] - a2 y[-2]
+ */
+struct biquad_coefficients_t {
+	float b0, b1, b2, a1, a2;
+
+	biquad_coefficients_t():b0(1.0f),b1(0.0f),b2(0.0f),a1(0.0f),a2(0.0f) {}
+	/**
+	 * @brief Computes coefficients for given parameters
+	 *
+	 * Throws std::runtime_error for non-positive frequency or q.
+	 */
+	static biquad_coefficients_t design(const biquad_params_t& params, double sampling_rate);
+};
+
+/**
+ * @brief Bank of independent cascades of biquad sections, processing floats
+ *
+ * Each lane (e.g. a channel, or a band of an analyzer) has its own cascade of @em sections sections
+ * with its own coefficients. The lanes are processed in parallel using SIMD, each vector
+ * holds the same section of several lanes. The sections use transposed direct form II.
+ *
+ * New coefficients are reached by linear interpolation over the next processed block, so the parameters
+ * can be changed for every block without clicks. Denormal numbers are flushed to zero while processing.
+ *
+ * Banks with fewer lanes than the vector width (e.g. stereo) don't waste the padding lanes of vectors,
+ * they're processed by scalar code computing the lanes together. Other numbers of lanes that aren't
+ * a multiple of the vector width are copied through a padded buffer for every block.
+ */
+class EXPORT BiquadBank {
+public:
+	/**
+	 * Creates bank with all the sections passing the signal unchanged.
+	 * Throws std::runtime_error when there are no lanes or sections.
+	 */
+	BiquadBank(size_t lanes, size_t sections);
+
+	/**
+	 * @brief Sets coefficients of a section of a lane, interpolated during the next block
+	 *
+	 * Coefficients set before the first processed block (or after reset) are used immediately.
+	 */
+	void set(size_t lane, size_t section, const biquad_coefficients_t& coefficients);
+	/// Clears the state of all the filters and stops the interpolation
+	void reset();
+
+	/**
+	 * @brief Filters interleaved samples in place
+	 * @param data @em samples frames of @em lanes values
+	 */
+	void process(float* data, size_t samples);
+	/**
+	 * @brief Filters a single signal by all the lanes
+	 * @param input @em samples values
+	 * @param output @em samples frames of @em lanes values
+	 */
+	void process(const float* input, float* output, size_t samples);
+
+	size_t get_lanes() const { return lanes_; }
+	size_t get_sections() const { return sections_; }
+private:
+	/// Filters @em samples frames of @em padded_ values in place
+	void run(float* data, size_t samples);
+
+	size_t lanes_;
+	size_t sections_;
+	/// Number of lanes rounded up to the vector width (unless there are fewer lanes than the width)
+	size_t padded_;
+	/// Coefficients b0, b1, b2, a1, a2 of each section for all the lanes
+	std::vector<float> coefficients_;
+	std::vector<float> targets_;
+	/// Per sample changes of the coefficients during the interpolation
+	std::vector<float> steps_;
+	/// Two state variables of each section for all the lanes
+	std::vector<float> state_;
+	/// Frames padded to @em padded_ values, used when the number of lanes isn't a multiple of the vector width
+	std::vector<float> scratch_;
+	bool interpolate_;
+	bool started_;
+};
+
+/**
+ * @brief Filter processing both channels by the same cascade of biquad sections (e.g. a parametric equalizer)
+ *
+ * The sections can be changed from any thread, the change takes effect in the next processed buffer.
+ * The audio thread never waits for the lock guarding the sections, when it's held by @em set_section,
+ * the previous coefficients are kept for one more buffer.
+ */
+class EXPORT BiquadFilter: public AudioFilter {
+public:
+	/**
+	 * Throws std::runtime_error when @em sections is empty or the parameters aren't valid.
+	 */
+	BiquadFilter(const pAudioFilter& child, const std::vector<biquad_params_t>& sections);
+	virtual ~BiquadFilter();
+
+	/// Changes parameters of a section, throws std::runtime_error for invalid index or parameters
+	void set_section(size_t index, const biquad_params_t& params);
+	std::vector<biquad_params_t> get_sections() const;
+private:
+	virtual error_type_t do_process(audio_buffer_t& buffer);
+
+	BiquadBank bank_;
+	mutable std::mutex mutex_;
+	std::vector<biquad_params_t> sections_;
+	std::atomic<bool> changed_;
+	/// Copy of @em sections_ used by the audio thread
+	std::vector<biquad_params_t> current_;
+	/// Sampling rate the coefficients were computed for
+	double rate_;
+	std::vector<float> samples_;
+};
+
+}
+
+#endif /* BIQUADFILTER_H_ */
@@ -0,0 +1,150 @@
+/**
+ * @file 	ConvolutionReverb.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares filter convolving the samples with an impulse response
+ */
+
+#ifndef CONVOLUTIONREVERB_H_
+#define CONVOLUTIONREVERB_H_
+
+#include "../AudioFilter.h"
+#include "../FFT.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace iimavlib {
+
+/*!
+ * @brief Statistics of a convolution reverb
+ */
+struct convolution_stats_t {
+	/// Delay of the reverberated signal in samples (the dry signal isn't delayed)
+	size_t latency;
+	/// Number of different partition sizes
+	size_t stages;
+	/// Total number of partitions of the impulse response
+	size_t partitions;
+	/// Size of the largest partitions
+	size_t max_partition;
+	/// Number of processed blocks
+	uint64_t blocks;
+	/// Average time spent processing a block, relative to duration of the block
+	double average_load;
+	/// Maximal time spent processing a block, relative to duration of the block
+	double peak_load;
+};
+
+/**
+ * @brief Filter convolving the samples with an impulse response (e.g. of a room)
+ *
+ * Uses non-uniformly partitioned convolution in frequency domain. The beginning of the impulse response
+ * is split to partitions of @em block_size samples, processed for every block. Later parts
+ * are split to partitions four times larger (up to @em max_partition), which are processed less often.
+ * Multiplications by older partitions are spread over the blocks between two transforms,
+ * so the work done for a block is bounded by a few FFTs, regardless of length of the impulse response.
+ *
+ * Left channel of the samples is convolved with the left channel of the impulse response, right with right.
+ * Both channels of the impulse response are scaled equally, so that the louder one has unit energy.
+ */
+class EXPORT ConvolutionReverb: public AudioFilter {
+public:
+	/**
+	 * @brief Constructor loading the impulse response from a file
+	 *
+	 * Throws std::runtime_error when the file can't be read or the sizes aren't valid.
+	 * @param child Child filter
+	 * @param filename WAV or compressed (.iac) file with the impulse response
+	 * @param wet Gain of the reverberated signal
+	 * @param dry Gain of the original signal
+	 * @param block_size Size of the smallest partitions, which is also the latency. Has to be a power of 2.
+	 * @param max_partition Size of the largest partitions, a power of 2 not smaller than @em block_size
+	 */
+	ConvolutionReverb(const pAudioFilter& child, const std::string& filename, double wet = 0.3, double dry = 1.0,
+			size_t block_size = default_block_size, size_t max_partition = default_max_partition);
+
+	/**
+	 * @brief Constructor with the impulse response as samples (with the full scale 1.0)
+	 */
+	ConvolutionReverb(const pAudioFilter& child, const std::vector<float>& left, const std::vector<float>& right,
+			double wet = 0.3, double dry = 1.0,
+			size_t block_size = default_block_size, size_t max_partition = default_max_partition);
+	virtual ~ConvolutionReverb();
+
+	/**
+	 * @brief Returns statistics of the filter. Can be called from any thread.
+	 */
+	convolution_stats_t get_stats() const;
+
+	/// Default size of the smallest partitions
+	static const size_t default_block_size = 256;
+	/// Default size of the largest partitions
+	static const size_t default_max_partition = 8192;
+private:
+	/// Partitions of a single size
+	struct stage_t {
+		stage_t(size_t size, size_t offset, size_t count, size_t block_size);
+		/// Size of the partitions
+		size_t size;
+		/// Position of the first partition in the impulse response
+		size_t offset;
+		/// Number of partitions
+		size_t count;
+		/// Number of blocks between two transforms
+		size_t period;
+		/// Number of partitions accumulated in a block
+		size_t partitions_per_block;
+		real_fft_plan_t<float> plan;
+		/// Spectra of the partitions for both channels, real parts of all bins followed by imaginary parts
+		std::vector<float> filters;
+		/// Spectra of last @em count inputs, in the same layout as @em filters
+		std::vector<float> inputs;
+		/// Index of the newest input spectrum
+		size_t head;
+		/// Spectrum of the next output for both channels
+		std::vector<float> accumulator;
+		/// Next partition to multiply with its input
+		size_t next_partition;
+		/// Scratch buffers for the transforms
+		simplearray_t<float> time;
+		complexarray_t<float> spectrum;
+	};
+
+	void init(const std::vector<float>& left, const std::vector<float>& right, size_t max_partition);
+	virtual error_type_t do_process(audio_buffer_t& buffer);
+	/// Processes a complete block of input samples
+	void process_block();
+	/// Multiplies partitions with their inputs, accumulating the result
+	void accumulate(stage_t& stage, size_t first, size_t last);
+	/// Transforms new input and adds the output of a stage to @em output_
+	void transform(stage_t& stage);
+
+	double wet_;
+	double dry_;
+	size_t block_size_;
+	std::vector<std::unique_ptr<stage_t>> stages_;
+	/// Position within the current block
+	size_t position_;
+	/// Number of samples processed in complete blocks
+	uint64_t time_;
+	/// Samples of the current block for both channels
+	std::vector<float> input_block_[2];
+	/// Reverberated samples for the current block
+	std::vector<float> output_block_[2];
+	/// Past input samples, circular
+	std::vector<float> history_[2];
+	/// Future output samples, circular
+	std::vector<float> output_[2];
+
+	std::atomic<uint64_t> blocks_;
+	std::atomic<uint64_t> total_time_;
+	std::atomic<uint64_t> peak_time_;
+	std::atomic<uint32_t> rate_;
+};
+
+}
+
+#endif /* CONVOLUTIONREVERB_H_ */
@@ -0,0 +1,125 @@
+/**
+ * @file 	FDNReverb.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares algorithmic reverb based on a feedback delay network
+ */
+
+#ifndef FDNREVERB_H_
+#define FDNREVERB_H_
+
+#include "../AudioFilter.h"
+#include "../DelayLine.h"
+#include <atomic>
+#include <vector>
+
+namespace iimavlib {
+
+/*!
+ * @brief Matrices mixing outputs of the delay lines back to their inputs
+ */
+enum class fdn_matrix_t: uint8_t {
+	/// I - 2/N * ones, the cheapest, but each line feeds mostly itself
+	householder,
+	/// Normalized Hadamard matrix, each line feeds all the lines equally
+	hadamard,
+};
+
+/*!
+ * @brief Parameters of FDNReverb
+ */
+struct fdn_params_t {
+	/// Number of delay lines, 8 or 16
+	size_t lines;
+	fdn_matrix_t matrix;
+	/// Time (in seconds) in which low frequencies decay by 60 dB
+	double decay_time;
+	/// Decay time of the highest frequencies relative to @em decay_time, in interval (0, 1>
+	double damping;
+	/// Scales lengths of the delay lines, 1.0 for delays between 30 and 90 ms
+	double size;
+	/// Maximal change of the delays in milliseconds, 0 disables the modulation
+	double modulation_depth;
+	/// Frequency of the modulation in Hz
+	double modulation_rate;
+	/// Gain of the reverberated signal
+	double wet;
+	/// Gain of the original signal
+	double dry;
+
+	fdn_params_t(size_t lines = 8, double decay_time = 2.0, double damping = 0.5, double wet = 0.3, double dry = 1.0):
+		lines(lines),matrix(fdn_matrix_t::hadamard),decay_time(decay_time),damping(damping),size(1.0),
+		modulation_depth(0.3),modulation_rate(0.7),wet(wet),dry(dry) {}
+};
+
+/**
+ * @brief Reverb filter using a feedback delay network
+ *
+ * Both channels are spread to 8 or 16 delay lines of mutually prime lengths, whose outputs are
+ * attenuated, low pass filtered (so high frequencies decay faster) and fed back to their inputs
+ * through an orthogonal mixing matrix. Left output is taken from the even lines, right from the odd ones.
+ * The delays are slowly modulated (each line with a different phase), which removes metallic ringing.
+ * The interpolation of the modulated delays slightly damps the highest frequencies.
+ *
+ * The attenuation, filtering, mixing and modulation work on vectors of the lines using SIMD,
+ * so the cost per sample is fixed and small, regardless of the decay time.
+ */
+class EXPORT FDNReverb: public AudioFilter {
+public:
+	/**
+	 * Throws std::runtime_error for invalid parameters.
+	 */
+	FDNReverb(const pAudioFilter& child, const fdn_params_t& params = fdn_params_t());
+	virtual ~FDNReverb();
+
+	/// Silences the reverb. Can be called from any thread, takes effect in the next buffer.
+	void reset();
+	/// Parameters of the reverb, @em get_params() returns parameters of the audio
+	const fdn_params_t& get_reverb_params() const { return params_; }
+private:
+	virtual error_type_t do_process(audio_buffer_t& buffer);
+	/// Computes delays and gains for a sampling rate, clearing all the lines
+	void configure(double rate);
+	/// Mixes @em values by the feedback matrix
+	void mix(const float* values, float* output);
+
+	fdn_params_t params_;
+	double rate_;
+	std::vector<delay_line_t<float>> lines_;
+	/*
+	 * Per line values, in arrays of params_.lines floats
+	 */
+	/// Lengths of the lines in samples
+	std::vector<float> delays_;
+	/// Modulation depth in samples
+	std::vector<float> depths_;
+	/// Gain of the damping filters at zero frequency, multiplied by (1 - pole)
+	std::vector<float> gains_;
+	std::vector<float> poles_;
+	/// States of the damping filters
+	std::vector<float> damping_state_;
+	/// Gains of left and right input and output
+	std::vector<float> input_left_;
+	std::vector<float> input_right_;
+	std::vector<float> output_left_;
+	std::vector<float> output_right_;
+	/// Sine and cosine of the modulation phases and their changes per sample
+	std::vector<float> sines_;
+	std::vector<float> cosines_;
+	std::vector<float> sine_steps_;
+	std::vector<float> cosine_steps_;
+	/// Mixing matrix, used only for fdn_matrix_t::hadamard
+	std::vector<float> matrix_;
+	/// Scratch values for a single sample
+	std::vector<float> outputs_;
+	std::vector<float> feedback_;
+	/// Fractional parts of the modulated delays and values around them (for all the lines y[-1], then y[0], ...)
+	std::vector<float> fractions_;
+	std::vector<float> taps_;
+	std::atomic<bool> reset_;
+};
+
+}
+
+#endif /* FDNREVERB_H_ */
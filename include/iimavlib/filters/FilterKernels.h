@@ -0,0 +1,46 @@
+/**
+ * @file 	FilterKernels.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file defines helpers shared by the floating point filters
+ */
+
+#ifndef INCLUDE_IIMAVLIB_FILTERS_FILTERKERNELS_H_
+#define INCLUDE_IIMAVLIB_FILTERS_FILTERKERNELS_H_
+
+#include "iimavlib/PlatformDefs.h"
+#include <algorithm>
+#include <cstdint>
+#ifdef IIMAVLIB_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace iimavlib {
+namespace filter_kernels {
+
+/**
+ * Sets flush-to-zero and denormals-are-zero modes for its lifetime,
+ * so decaying states of recursive filters don't slow down the processing.
+ */
+struct denormal_guard_t {
+#ifdef IIMAVLIB_SSE2
+	denormal_guard_t():mxcsr(_mm_getcsr()) { _mm_setcsr(mxcsr | 0x8040); }
+	~denormal_guard_t() { _mm_setcsr(mxcsr); }
+	unsigned int mxcsr;
+#else
+	denormal_guard_t() {}
+	~denormal_guard_t() {}
+#endif
+};
+
+/// Converts a float to 16bit sample, clamping values out of range
+inline int16_t to_sample(float value)
+{
+	return static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, value)));
+}
+
+}
+}
+
+#endif /* INCLUDE_IIMAVLIB_FILTERS_FILTERKERNELS_H_ */
@@ -12,16 +12,28 @@
 #define ECHO_H_
 
 #include "../AudioFilter.h"
+#include "../DelayLine.h"
+#include <atomic>
 namespace iimavlib {
+/**
+ * Echo with feedback, output = decay * (output delayed by @em delay seconds) + (1 - decay) * input.
+ * The cost of processing a buffer doesn't depend on the delay.
+ */
 class EXPORT SimpleEchoFilter: public AudioFilter {
 public:
 	SimpleEchoFilter(const pAudioFilter& child, double delay=0.3, double decay=0.5);
 	virtual ~SimpleEchoFilter();
+	/// Forgets all the previous samples. Can be called from any thread, takes effect in the next buffer.
+	void reset();
 private:
 	virtual error_type_t do_process(audio_buffer_t& buffer);
-	std::vector<audio_sample_t> old_samples_;
+	/// Previous output samples
+	delay_line_t<audio_sample_t> line_;
 	double delay_;
 	double decay_;
+	/// Delay in samples the line was allocated for
+	size_t delay_samples_;
+	std::atomic<bool> reset_;
 };
 
 }
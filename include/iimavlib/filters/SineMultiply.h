@@ -12,6 +12,8 @@
 #define SINEMULTIPLY_H_
 
 #include "../AudioFilter.h"
+#include "../Oscillator.h"
+#include <vector>
 namespace iimavlib {
 class EXPORT SineMultiply: public AudioFilter {
 public:
@@ -19,8 +21,8 @@ public:
 	virtual ~SineMultiply();
 private:
 	virtual error_type_t do_process(audio_buffer_t& buffer);
-	double frequency_;
-	double time_;
+	Oscillator oscillator_;
+	std::vector<float> gains_;
 };
 
 }
@@ -0,0 +1,131 @@
+/**
+ * @file 	WavetableOscillator.h
+ *
+ * @copyright GNU Public License 3.0
+ *
+ * This file declares oscillator playing band-limited single-cycle waveforms
+ */
+
+#ifndef WAVETABLEOSCILLATOR_H_
+#define WAVETABLEOSCILLATOR_H_
+
+#include "../AudioFilter.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace iimavlib {
+
+/**
+ * @brief Single period of a waveform, band-limited to several levels
+ *
+ * Each level is a table of @em table_size samples, containing the waveform without harmonics
+ * above @em max_harmonics / 2^level (computed by FFT), so there's one level per octave of the pitch.
+ * The tables are followed by a copy of their first sample, so interpolation doesn't have to wrap.
+ * DC component of the waveform is removed.
+ */
+class EXPORT Wavetable {
+public:
+	/// Number of samples in a single level
+	static const size_t table_size = 2048;
+	/// Number of harmonics in the first level, table_size / 4, so the linear interpolation is precise enough
+	static const size_t max_harmonics = 512;
+
+	/**
+	 * @brief Creates levels from a single period of the waveform (of any length, with the full scale 1.0)
+	 *
+	 * Throws std::runtime_error for periods shorter than 2 samples.
+	 */
+	Wavetable(const std::vector<float>& period);
+	/**
+	 * @brief Loads a single period from a WAV or compressed (.iac) file, using its left channel
+	 *
+	 * Throws std::runtime_error when the file can't be read.
+	 */
+	Wavetable(const std::string& filename);
+
+	size_t levels() const { return levels_; }
+	/// Returns the table of a level, with @em table_size + 1 values
+	const float* get_level(size_t level) const { return tables_.data() + level * (table_size + 1); }
+	/// Returns all the tables, one after another
+	const float* data() const { return tables_.data(); }
+private:
+	void init(const std::vector<float>& period);
+
+	size_t levels_;
+	std::vector<float> tables_;
+};
+
+typedef std::shared_ptr<const Wavetable> pWavetable;
+
+/**
+ * @brief Filter generating a waveform from a @em Wavetable with several voices
+ *
+ * For each voice, the levels are chosen by its pitch, so that no harmonic exceeds half of the sampling rate,
+ * and the two nearest levels are crossfaded, so the timbre doesn't change abruptly between the octaves.
+ * The voices are processed in SIMD lanes, each sample is a linearly interpolated lookup in the tables
+ * (using gathers with AVX2).
+ *
+ * When the filter has a child, the waveform is added to its samples, otherwise the samples are overwritten.
+ * Both channels get the same signal.
+ */
+class EXPORT WavetableOscillator: public AudioFilter {
+public:
+	/**
+	 * @brief Constructor loading the waveform from a file
+	 *
+	 * Throws std::runtime_error when the file can't be read.
+	 * @param voices Number of voices, all of them are silent at the beginning
+	 */
+	WavetableOscillator(const pAudioFilter& child, const std::string& filename, size_t voices = 8);
+	WavetableOscillator(const pAudioFilter& child, const pWavetable& table, size_t voices = 8);
+	virtual ~WavetableOscillator();
+
+	size_t voices() const { return voices_; }
+	/**
+	 * @brief Sets frequency (in Hz) and amplitude (1.0 for the full scale) of a voice
+	 *
+	 * Can be called from any thread, takes effect in the next buffer (or the one after it, when the audio
+	 * thread finds the values locked by another setter, as it never waits). The phase of the voice continues.
+	 * Throws std::out_of_range for invalid index.
+	 */
+	void set_voice(size_t voice, double frequency, float amplitude);
+	void set_frequency(size_t voice, double frequency);
+	void set_amplitude(size_t voice, float amplitude);
+private:
+	virtual error_type_t do_process(audio_buffer_t& buffer);
+	/// Chooses levels of the voices for a sampling rate
+	void update_voices(double rate);
+
+	pWavetable table_;
+	size_t voices_;
+	/// Values set by set_voice, guarded by @em mutex_
+	std::vector<double> pending_frequencies_;
+	std::vector<float> pending_amplitudes_;
+	std::mutex mutex_;
+	std::atomic<bool> changed_;
+	/*
+	 * Per voice values, padded to multiple of the vector width (the padding has zero amplitude)
+	 */
+	std::vector<double> frequencies_;
+	std::vector<float> amplitudes_;
+	std::vector<double> phases_;
+	/// Phases used while generating, reloaded from @em phases_ regularly, so the rounding errors don't accumulate
+	std::vector<float> lane_phases_;
+	std::vector<float> increments_;
+	/// Offsets of the crossfaded levels in the tables
+	std::vector<int32_t> lower_offsets_;
+	std::vector<int32_t> upper_offsets_;
+	/// Amplitudes of the crossfaded levels
+	std::vector<float> lower_gains_;
+	std::vector<float> upper_gains_;
+	/// Generated samples of the current buffer
+	std::vector<float> values_;
+	double rate_;
+};
+
+}
+
+#endif /* WAVETABLEOSCILLATOR_H_ */
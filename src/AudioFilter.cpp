@@ -8,6 +8,7 @@
  */
 
 #include "iimavlib/AudioFilter.h"
+#include <algorithm>
 
 namespace iimavlib {
 
@@ -22,6 +23,8 @@ AudioFilter::~AudioFilter()
 
 error_type_t AudioFilter::process(audio_buffer_t& buffer)
 {
+	const size_t length = do_split(buffer.params, buffer.valid_samples);
+	if (length < buffer.valid_samples) return process_parts(buffer, std::max<size_t>(length, 1));
 	error_type_t ret = error_type_t::ok;
 
 	if (child_) {
@@ -48,5 +51,32 @@ audio_params_t AudioFilter::do_get_params() const
 	}
 	return audio_params_t();
 }
+size_t AudioFilter::do_split(const audio_params_t& /*params*/, size_t count)
+{
+	return count;
+}
+error_type_t AudioFilter::process_parts(audio_buffer_t& buffer, size_t length)
+{
+	const size_t total = buffer.valid_samples;
+	part_.params = buffer.params;
+	size_t offset = 0;
+	while (true) {
+		part_.data.assign(buffer.data.begin() + offset, buffer.data.begin() + offset + length);
+		part_.valid_samples = length;
+		error_type_t ret = error_type_t::ok;
+		if (child_) ret = child_->process(part_);
+		if (ret == error_type_t::ok) ret = do_process(part_);
+		if (ret != error_type_t::ok) return ret;
+		const size_t count = std::min(part_.valid_samples, length);
+		std::copy_n(part_.data.begin(), count, buffer.data.begin() + offset);
+		buffer.params = part_.params;
+		offset += count;
+		// A source may return fewer samples than requested, e.g. at the end of a file
+		if (count < length || offset >= total) break;
+		length = std::max<size_t>(1, std::min(do_split(buffer.params, total - offset), total - offset));
+	}
+	buffer.valid_samples = offset;
+	return error_type_t::ok;
+}
 
 }
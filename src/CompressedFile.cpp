@@ -0,0 +1,588 @@
+/**
+ * @file 	CompressedFile.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/CompressedFile.h"
+#include "iimavlib/Utils.h"
+#include <stdexcept>
+#include <cstdlib>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace iimavlib {
+
+namespace {
+
+/// Stereo decorrelation modes
+enum channel_mode_t: uint8_t {
+	left_right = 0,
+	left_side = 1,
+	side_right = 2,
+	mid_side = 3
+};
+
+/// Number of residuals sharing one Rice parameter
+const size_t partition_size = 256;
+/// Highest order of the predictors
+const int max_order = 4;
+/// Highest Rice parameter, enough for residuals of 17bit side channel
+const uint32_t max_rice = 24;
+/// Order field marking a channel with constant value
+const uint32_t constant_channel = 7;
+/// Bits used to store value of a constant channel (zigzag encoded 17bit value)
+const int constant_bits = 18;
+/// Longest unary code accepted by the decoder, longer ones mean corrupted data
+const uint32_t max_unary = 1 << 25;
+
+inline uint32_t zigzag(int32_t value)
+{
+	return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t unzigzag(uint32_t value)
+{
+	return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+inline int count_leading_zeros(uint64_t value)
+{
+#if defined(__GNUC__)
+	return __builtin_clzll(value);
+#elif defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return 63 - static_cast<int>(index);
+#else
+	int count = 0;
+	while (!(value & 0x8000000000000000ull)) { value <<= 1; ++count; }
+	return count;
+#endif
+}
+
+/**
+ * Writes bits MSB first
+ */
+class bit_writer_t {
+public:
+	bit_writer_t(std::vector<uint8_t>& out):out_(out),cache_(0),bits_(0) {}
+	/// Writes @em count (up to 32) lowest bits of @em value
+	void put(uint32_t value, int count) {
+		cache_ = (cache_ << count) | (value & ((1ull << count) - 1));
+		bits_ += count;
+		while (bits_ >= 8) {
+			bits_ -= 8;
+			out_.push_back(static_cast<uint8_t>(cache_ >> bits_));
+		}
+	}
+	/// Writes @em value zeros followed by a one
+	void put_unary(uint32_t value) {
+		while (value >= 32) {
+			put(0, 32);
+			value -= 32;
+		}
+		put(1, value + 1);
+	}
+	void put_rice(uint32_t value, uint32_t k) {
+		put_unary(value >> k);
+		if (k) put(value, k);
+	}
+	/// Pads the output to whole bytes
+	void finish() {
+		if (bits_) put(0, 8 - bits_);
+	}
+private:
+	std::vector<uint8_t>& out_;
+	uint64_t cache_;
+	int bits_;
+};
+
+/**
+ * Reads bits MSB first. Reading past the end of data returns zeros and sets @em overrun.
+ */
+class bit_reader_t {
+public:
+	bit_reader_t(const uint8_t* data, size_t size):data_(data),size_(size),pos_(0),cache_(0),bits_(0) { refill(); }
+	uint32_t get(uint32_t count) {
+		if (!count) return 0;
+		if (bits_ < static_cast<int>(count)) refill();
+		const uint32_t value = static_cast<uint32_t>(cache_ >> (64 - count));
+		cache_ <<= count;
+		bits_ -= count;
+		return value;
+	}
+	/// Returns number of zeros before the next one, or max_unary on corrupted data
+	uint32_t get_unary() {
+		uint32_t value = 0;
+		while (!cache_) {
+			value += bits_;
+			bits_ = 0;
+			if (value >= max_unary || overrun()) return max_unary;
+			refill();
+		}
+		const int zeros = count_leading_zeros(cache_);
+		cache_ = (cache_ << zeros) << 1;
+		bits_ -= zeros + 1;
+		if (bits_ < 32) refill();
+		return value + zeros;
+	}
+	uint32_t get_rice(uint32_t k) {
+		const uint32_t high = get_unary();
+		return (high << k) | get(k);
+	}
+	/// Returns true if more bits were read than available
+	bool overrun() const { return pos_ * 8 - bits_ > size_ * 8; }
+private:
+	void refill() {
+		if (pos_ + 8 <= size_) {
+			// Fast path, load whole bytes up to the capacity of the cache
+			while (bits_ <= 56) {
+				cache_ |= static_cast<uint64_t>(data_[pos_++]) << (56 - bits_);
+				bits_ += 8;
+			}
+			return;
+		}
+		while (bits_ <= 56) {
+			const uint64_t byte = pos_ < size_ ? data_[pos_] : 0;
+			++pos_;
+			cache_ |= byte << (56 - bits_);
+			bits_ += 8;
+		}
+	}
+	const uint8_t* data_;
+	size_t size_;
+	size_t pos_;
+	uint64_t cache_;
+	int bits_;
+};
+
+/**
+ * Returns prediction error of a channel for all the fixed predictors
+ */
+void estimate_orders(const int32_t* x, size_t count, uint64_t (&errors)[max_order + 1])
+{
+	std::fill(errors, errors + max_order + 1, 0);
+	if (count <= max_order) {
+		errors[0] = 1;
+		return;
+	}
+	int32_t e1p = x[3] - x[2];
+	int32_t e2p = e1p - (x[2] - x[1]);
+	int32_t e3p = e2p - ((x[2] - x[1]) - (x[1] - x[0]));
+	for (size_t i = max_order; i < count; ++i) {
+		const int32_t e0 = x[i];
+		const int32_t e1 = e0 - x[i-1];
+		const int32_t e2 = e1 - e1p;
+		const int32_t e3 = e2 - e2p;
+		const int32_t e4 = e3 - e3p;
+		errors[0] += std::abs(e0);
+		errors[1] += std::abs(e1);
+		errors[2] += std::abs(e2);
+		errors[3] += std::abs(e3);
+		errors[4] += std::abs(e4);
+		e1p = e1; e2p = e2; e3p = e3;
+	}
+}
+
+int best_order(const int32_t* x, size_t count, uint64_t& error)
+{
+	uint64_t errors[max_order + 1];
+	estimate_orders(x, count, errors);
+	int order = 0;
+	for (int i = 1; i <= max_order; ++i) {
+		if (errors[i] < errors[order]) order = i;
+	}
+	error = errors[order];
+	return order;
+}
+
+inline int32_t predict(const int32_t* x, size_t i, int order)
+{
+	switch (order) {
+		case 1: return x[i-1];
+		case 2: return 2*x[i-1] - x[i-2];
+		case 3: return 3*x[i-1] - 3*x[i-2] + x[i-3];
+		case 4: return 4*x[i-1] - 6*x[i-2] + 4*x[i-3] - x[i-4];
+		default: return 0;
+	}
+}
+
+/**
+ * Computes residuals. First samples use lower orders, so no warm-up samples have to be stored.
+ */
+void compute_residual(const int32_t* x, size_t count, int order, uint32_t* residual)
+{
+	for (size_t i = 0; i < count; ++i) {
+		residual[i] = zigzag(x[i] - predict(x, i, std::min<int>(order, static_cast<int>(i))));
+	}
+}
+
+/**
+ * Restores the signal in place from residuals
+ */
+template<int Order>
+void restore_signal(int32_t* x, size_t count)
+{
+	const size_t warm_up = std::min<size_t>(Order, count);
+	for (size_t i = 0; i < warm_up; ++i) {
+		x[i] += predict(x, i, static_cast<int>(i));
+	}
+	for (size_t i = warm_up; i < count; ++i) {
+		switch (Order) {
+			case 1: x[i] += x[i-1]; break;
+			case 2: x[i] += 2*x[i-1] - x[i-2]; break;
+			case 3: x[i] += 3*(x[i-1] - x[i-2]) + x[i-3]; break;
+			case 4: x[i] += 4*(x[i-1] + x[i-3]) - 6*x[i-2] - x[i-4]; break;
+			default: break;
+		}
+	}
+}
+
+uint32_t rice_parameter(const uint32_t* values, size_t count)
+{
+	uint64_t sum = 0;
+	for (size_t i = 0; i < count; ++i) sum += values[i];
+	// Largest k with count * 2^k <= sum is close to the optimum, check its neighbours as well
+	uint32_t k = 0;
+	while (k < max_rice && (static_cast<uint64_t>(count) << (k + 1)) <= sum) ++k;
+	uint32_t best = k;
+	uint64_t best_cost = ~0ull;
+	for (uint32_t candidate = k ? k - 1 : 0; candidate <= std::min(k + 1, max_rice); ++candidate) {
+		uint64_t cost = count * (candidate + 1);
+		for (size_t i = 0; i < count; ++i) cost += values[i] >> candidate;
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = candidate;
+		}
+	}
+	return best;
+}
+
+void encode_channel(bit_writer_t& writer, const int32_t* x, size_t count, int order, uint32_t* residual)
+{
+	if (std::find_if(x, x + count, [x](int32_t v){return v != x[0];}) == x + count) {
+		// Silence (or any other constant signal) is stored as a single value
+		writer.put(constant_channel, 3);
+		writer.put(zigzag(x[0]), constant_bits);
+		return;
+	}
+	compute_residual(x, count, order, residual);
+	writer.put(order, 3);
+	for (size_t start = 0; start < count; start += partition_size) {
+		const size_t length = std::min(partition_size, count - start);
+		const uint32_t k = rice_parameter(residual + start, length);
+		writer.put(k, 5);
+		for (size_t i = start; i < start + length; ++i) writer.put_rice(residual[i], k);
+	}
+}
+
+bool decode_channel(bit_reader_t& reader, int32_t* x, size_t count)
+{
+	const uint32_t order = reader.get(3);
+	if (order == constant_channel) {
+		std::fill(x, x + count, unzigzag(reader.get(constant_bits)));
+		return !reader.overrun();
+	}
+	if (order > max_order) return false;
+	for (size_t start = 0; start < count; start += partition_size) {
+		const size_t end = std::min(start + partition_size, count);
+		const uint32_t k = reader.get(5);
+		if (k > max_rice) return false;
+		for (size_t i = start; i < end; ++i) x[i] = unzigzag(reader.get_rice(k));
+		if (reader.overrun()) return false;
+	}
+	switch (order) {
+		case 1: restore_signal<1>(x, count); break;
+		case 2: restore_signal<2>(x, count); break;
+		case 3: restore_signal<3>(x, count); break;
+		case 4: restore_signal<4>(x, count); break;
+		default: break;
+	}
+	return true;
+}
+
+/**
+ * Encodes a frame
+ * @param samples Input samples
+ * @param count Number of samples
+ * @param out Output data
+ * @param scratch Temporary storage for 5 * @em count values
+ * @return Channel mode used
+ */
+uint8_t encode_frame(const audio_sample_t* samples, size_t count, std::vector<uint8_t>& out, int32_t* scratch)
+{
+	int32_t* left = scratch;
+	int32_t* right = left + count;
+	int32_t* mid = right + count;
+	int32_t* side = mid + count;
+	uint32_t* residual = reinterpret_cast<uint32_t*>(side + count);
+	for (size_t i = 0; i < count; ++i) {
+		left[i] = samples[i].left;
+		right[i] = samples[i].right;
+		mid[i] = (left[i] + right[i]) >> 1;
+		side[i] = left[i] - right[i];
+	}
+	uint64_t error_left, error_right, error_mid, error_side;
+	const int order_left = best_order(left, count, error_left);
+	const int order_right = best_order(right, count, error_right);
+	const int order_mid = best_order(mid, count, error_mid);
+	const int order_side = best_order(side, count, error_side);
+
+	const uint64_t costs[] = {error_left + error_right, error_left + error_side,
+			error_side + error_right, error_mid + error_side};
+	const uint8_t mode = static_cast<uint8_t>(std::min_element(costs, costs + 4) - costs);
+
+	bit_writer_t writer(out);
+	switch (mode) {
+		case left_side:
+			encode_channel(writer, left, count, order_left, residual);
+			encode_channel(writer, side, count, order_side, residual);
+			break;
+		case side_right:
+			encode_channel(writer, side, count, order_side, residual);
+			encode_channel(writer, right, count, order_right, residual);
+			break;
+		case mid_side:
+			encode_channel(writer, mid, count, order_mid, residual);
+			encode_channel(writer, side, count, order_side, residual);
+			break;
+		default:
+			encode_channel(writer, left, count, order_left, residual);
+			encode_channel(writer, right, count, order_right, residual);
+			break;
+	}
+	writer.finish();
+	return mode;
+}
+
+/**
+ * Decodes a frame
+ * @param scratch Temporary storage for 2 * @em count values
+ * @return false if the data are corrupted
+ */
+bool decode_frame(const uint8_t* data, size_t size, uint8_t mode, audio_sample_t* samples, size_t count, int32_t* scratch)
+{
+	if (mode > mid_side) return false;
+	int32_t* first = scratch;
+	int32_t* second = scratch + count;
+	bit_reader_t reader(data, size);
+	if (!decode_channel(reader, first, count) || !decode_channel(reader, second, count)) return false;
+	switch (mode) {
+		case left_side:
+			for (size_t i = 0; i < count; ++i) {
+				samples[i] = audio_sample_t(static_cast<int16_t>(first[i]), static_cast<int16_t>(first[i] - second[i]));
+			}
+			break;
+		case side_right:
+			for (size_t i = 0; i < count; ++i) {
+				samples[i] = audio_sample_t(static_cast<int16_t>(first[i] + second[i]), static_cast<int16_t>(second[i]));
+			}
+			break;
+		case mid_side:
+			for (size_t i = 0; i < count; ++i) {
+				// The lowest bit of mid was lost, but it's the same as the lowest bit of side
+				const int32_t mid = first[i] * 2 + (second[i] & 1);
+				samples[i] = audio_sample_t(static_cast<int16_t>((mid + second[i]) >> 1),
+											static_cast<int16_t>((mid - second[i]) >> 1));
+			}
+			break;
+		default:
+			for (size_t i = 0; i < count; ++i) {
+				samples[i] = audio_sample_t(static_cast<int16_t>(first[i]), static_cast<int16_t>(second[i]));
+			}
+			break;
+	}
+	return true;
+}
+
+}
+
+CompressedFile::CompressedFile(const std::string& filename, audio_params_t params, size_t frame_size)
+:header_(convert_rate_to_int(params.rate), static_cast<uint32_t>(std::min<size_t>(std::max<size_t>(frame_size, partition_size), 65535))),
+ params_(params),io_buffer_(io_buffer_size),write_mode_(true),frame_position_(0),next_frame_(0),position_(0)
+{
+	file_.rdbuf()->pubsetbuf(&io_buffer_[0], io_buffer_.size());
+	file_.open(filename,std::ios::binary | std::ios::out | std::ios::trunc);
+	if (!file_.is_open()) throw std::runtime_error("Failed to open the output file");
+	file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+	samples_.reserve(header_.frame_size * 2);
+	scratch_.resize(header_.frame_size * 5);
+}
+
+CompressedFile::CompressedFile(const std::string& filename)
+:io_buffer_(io_buffer_size),write_mode_(false),frame_position_(0),next_frame_(0),position_(0)
+{
+	file_.rdbuf()->pubsetbuf(&io_buffer_[0], io_buffer_.size());
+	file_.open(filename,std::ios::binary | std::ios::in);
+	if (!file_.is_open()) throw std::runtime_error("Failed to open the input file");
+	file_.seekg(0,std::ios::end);
+	const uint64_t file_size = static_cast<uint64_t>(file_.tellg());
+	file_.seekg(0,std::ios::beg);
+	file_.read(reinterpret_cast<char*>(&header_), sizeof(header_));
+	if (!file_ || !header_.valid() || !header_.frame_size) throw std::runtime_error("Not a compressed audio file");
+	params_.rate = convert_int_to_rate(header_.rate);
+
+	const uint64_t frames = (header_.sample_count + header_.frame_size - 1) / header_.frame_size;
+	if (header_.seek_table && header_.seek_table + frames * sizeof(uint64_t) <= file_size) {
+		frame_offsets_.resize(static_cast<size_t>(frames));
+		file_.seekg(static_cast<std::streamoff>(header_.seek_table),std::ios::beg);
+		if (frames) file_.read(reinterpret_cast<char*>(&frame_offsets_[0]), frames * sizeof(uint64_t));
+		if (!file_) throw std::runtime_error("Failed to read seek table");
+	} else {
+		scan_frames(file_size);
+		logger[log_level::info] << "[CompressedFile] " << filename << " wasn't finalized, recovered "
+				<< header_.sample_count << " samples";
+	}
+	file_.clear();
+	scratch_.resize(header_.frame_size * 2);
+	// Forces seek to the first frame
+	next_frame_ = frame_offsets_.size();
+}
+
+CompressedFile::~CompressedFile()
+{
+	if (!write_mode_ || !file_.is_open()) return;
+	header_.sample_count = get_sample_count();
+	if (!samples_.empty()) write_frame(&samples_[0], samples_.size());
+	header_.seek_table = static_cast<uint64_t>(file_.tellp());
+	if (!frame_offsets_.empty()) {
+		file_.write(reinterpret_cast<const char*>(&frame_offsets_[0]), frame_offsets_.size() * sizeof(uint64_t));
+	}
+	file_.seekp(0,std::ios::beg);
+	file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+	file_.close();
+}
+
+void CompressedFile::scan_frames(uint64_t file_size)
+{
+	uint64_t offset = sizeof(compressed_header_t);
+	uint64_t samples = 0;
+	compressed_frame_header_t frame;
+	while (offset + sizeof(frame) <= file_size) {
+		file_.seekg(static_cast<std::streamoff>(offset),std::ios::beg);
+		if (!file_.read(reinterpret_cast<char*>(&frame), sizeof(frame))) break;
+		if (!frame.samples || frame.samples > header_.frame_size) break;
+		if (offset + sizeof(frame) + frame.size > file_size) break;
+		frame_offsets_.push_back(offset);
+		samples += frame.samples;
+		offset += sizeof(frame) + frame.size;
+		// Only the last frame can be shorter
+		if (frame.samples != header_.frame_size) break;
+	}
+	header_.sample_count = samples;
+}
+
+error_type_t CompressedFile::write_frame(const audio_sample_t* samples, size_t count)
+{
+	frame_data_.clear();
+	compressed_frame_header_t frame;
+	frame.samples = static_cast<uint16_t>(count);
+	frame.channel_mode = encode_frame(samples, count, frame_data_, &scratch_[0]);
+	frame.reserved = 0;
+	frame.size = static_cast<uint32_t>(frame_data_.size());
+	frame_offsets_.push_back(static_cast<uint64_t>(file_.tellp()));
+	file_.write(reinterpret_cast<const char*>(&frame), sizeof(frame));
+	file_.write(reinterpret_cast<const char*>(&frame_data_[0]), frame_data_.size());
+	if (!file_) return error_type_t::failed;
+	return error_type_t::ok;
+}
+
+error_type_t CompressedFile::store_data(const std::vector<audio_sample_t>& data, size_t sample_count)
+{
+	if (!write_mode_) return error_type_t::invalid;
+	if (!sample_count) sample_count = data.size();
+	samples_.insert(samples_.end(), data.begin(), data.begin() + std::min(sample_count, data.size()));
+	size_t written = 0;
+	error_type_t ret = error_type_t::ok;
+	while (samples_.size() - written >= header_.frame_size) {
+		if (write_frame(&samples_[written], header_.frame_size) != error_type_t::ok) ret = error_type_t::failed;
+		written += header_.frame_size;
+	}
+	samples_.erase(samples_.begin(), samples_.begin() + written);
+	return ret;
+}
+
+error_type_t CompressedFile::read_frame(size_t index)
+{
+	if (index != next_frame_) {
+		file_.clear();
+		file_.seekg(static_cast<std::streamoff>(frame_offsets_[index]),std::ios::beg);
+	}
+	next_frame_ = index + 1;
+	compressed_frame_header_t frame;
+	file_.read(reinterpret_cast<char*>(&frame), sizeof(frame));
+	// Bound of the size protects against allocating huge buffers for corrupted frames
+	if (!file_ || !frame.samples || frame.samples > header_.frame_size || frame.size > header_.frame_size * 16u + 64) {
+		next_frame_ = frame_offsets_.size();
+		return error_type_t::failed;
+	}
+	frame_data_.resize(frame.size);
+	if (frame.size) file_.read(reinterpret_cast<char*>(&frame_data_[0]), frame.size);
+	samples_.resize(frame.samples);
+	if (!file_ || !decode_frame(frame_data_.empty()?nullptr:&frame_data_[0], frame_data_.size(),
+					frame.channel_mode, &samples_[0], samples_.size(), &scratch_[0])) {
+		samples_.clear();
+		next_frame_ = frame_offsets_.size();
+		return error_type_t::failed;
+	}
+	return error_type_t::ok;
+}
+
+error_type_t CompressedFile::read_data(std::vector<audio_sample_t>& data, size_t& sample_count)
+{
+	if (write_mode_) return error_type_t::invalid;
+	sample_count = std::min(sample_count, data.size());
+	size_t done = 0;
+	while (done < sample_count) {
+		if (frame_position_ >= samples_.size()) {
+			const uint64_t index = position_ / header_.frame_size;
+			if (index >= frame_offsets_.size()) break;
+			if (read_frame(static_cast<size_t>(index)) != error_type_t::ok) {
+				sample_count = done;
+				return error_type_t::failed;
+			}
+			frame_position_ = static_cast<size_t>(position_ - index * header_.frame_size);
+			if (frame_position_ >= samples_.size()) break;
+		}
+		const size_t count = std::min(sample_count - done, samples_.size() - frame_position_);
+		std::copy(samples_.begin() + frame_position_, samples_.begin() + frame_position_ + count, data.begin() + done);
+		frame_position_ += count;
+		position_ += count;
+		done += count;
+	}
+	sample_count = done;
+	return error_type_t::ok;
+}
+
+error_type_t CompressedFile::seek(uint64_t position)
+{
+	if (write_mode_) return error_type_t::invalid;
+	position = std::min(position, header_.sample_count);
+	const uint64_t current_start = position_ - frame_position_;
+	if (!samples_.empty() && position >= current_start && position < current_start + samples_.size()) {
+		// Still in the decoded frame
+		frame_position_ = static_cast<size_t>(position - current_start);
+	} else {
+		samples_.clear();
+		frame_position_ = 0;
+	}
+	position_ = position;
+	return error_type_t::ok;
+}
+
+audio_params_t CompressedFile::get_params() const
+{
+	return params_;
+}
+
+uint64_t CompressedFile::get_sample_count() const
+{
+	if (!write_mode_) return header_.sample_count;
+	// All the frames written so far are full
+	return frame_offsets_.size() * static_cast<uint64_t>(header_.frame_size) + samples_.size();
+}
+
+}
@@ -0,0 +1,47 @@
+/**
+ * @file 	CompressedSink.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/CompressedSink.h"
+#include "iimavlib/Utils.h"
+namespace iimavlib {
+
+CompressedSink::CompressedSink(const pAudioFilter& child, const std::string& filename):
+		AudioSink(child),file_(filename,get_params())
+{
+	logger[log_level::info] << "Opened compressed file with sampling rate " << sampling_rate_string(file_.get_params().rate);
+}
+CompressedSink::CompressedSink(const pAudioFilter& child, const std::string& filename, const audio_params_t& params):
+		AudioSink(child),file_(filename,params)
+{
+
+}
+CompressedSink::~CompressedSink()
+{
+}
+error_type_t CompressedSink::do_run()
+{
+	const size_t buffer_size=CompressedFile::default_frame_size;
+	audio_buffer_t buffer;
+	buffer.params = file_.get_params();
+	buffer.data.resize(buffer_size);
+	while (still_running()) {
+		buffer.valid_samples = buffer_size;
+		if (process(buffer)!=error_type_t::ok) {
+			stop();
+			break;
+		}
+	}
+	return error_type_t::ok;
+}
+
+error_type_t CompressedSink::do_process(audio_buffer_t& buffer)
+{
+	if (!buffer.valid_samples) return error_type_t::ok;
+	return file_.store_data(buffer.data,buffer.valid_samples);
+}
+
+}
@@ -0,0 +1,43 @@
+/**
+ * @file 	CompressedSource.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/CompressedSource.h"
+namespace iimavlib {
+
+CompressedSource::CompressedSource(const std::string filename):AudioFilter(pAudioFilter()),
+		file_(filename)
+{
+
+}
+
+CompressedSource::~CompressedSource()
+{
+
+}
+
+error_type_t CompressedSource::seek(uint64_t position)
+{
+	return file_.seek(position);
+}
+
+uint64_t CompressedSource::get_sample_count() const
+{
+	return file_.get_sample_count();
+}
+
+error_type_t CompressedSource::do_process(audio_buffer_t& buffer)
+{
+	const error_type_t ret = file_.read_data(buffer.data,buffer.valid_samples);
+	if (buffer.valid_samples==0) return error_type_t::failed;
+	return ret;
+}
+
+audio_params_t CompressedSource::do_get_params() const {
+	return file_.get_params();
+}
+
+}
@@ -0,0 +1,180 @@
+/**
+ * @file 	MappedWaveFile.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/MappedWaveFile.h"
+#include "iimavlib/Utils.h"
+#include <cstring>
+#include <stdexcept>
+
+#ifdef SYSTEM_WINDOWS
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace iimavlib {
+
+namespace {
+#ifndef SYSTEM_WINDOWS
+int hint_to_advice(access_hint_t hint)
+{
+	switch (hint) {
+		case access_hint_t::sequential: return MADV_SEQUENTIAL;
+		case access_hint_t::random: return MADV_RANDOM;
+		case access_hint_t::will_need: return MADV_WILLNEED;
+		case access_hint_t::dont_need: return MADV_DONTNEED;
+		default: break;
+	}
+	return MADV_NORMAL;
+}
+#endif
+}
+
+MappedWaveFile::MappedWaveFile(const std::string& filename, access_hint_t hint)
+:map_base_(nullptr),map_size_(0),map_handle_(nullptr),pcm_(nullptr),
+ sample_count_(0)
+{
+#ifdef SYSTEM_WINDOWS
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to open the input file");
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || !size.QuadPart) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of the input file");
+	}
+	HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping) throw std::runtime_error("Failed to map the input file");
+	const void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!base) {
+		CloseHandle(mapping);
+		throw std::runtime_error("Failed to map the input file");
+	}
+	map_handle_ = mapping;
+	map_size_ = static_cast<size_t>(size.QuadPart);
+#else
+	const int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) throw std::runtime_error("Failed to open the input file");
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+		::close(fd);
+		throw std::runtime_error("Failed to get size of the input file");
+	}
+	map_size_ = static_cast<size_t>(st.st_size);
+	void* base = ::mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping keeps its own reference to the file
+	::close(fd);
+	if (base == MAP_FAILED) throw std::runtime_error("Failed to map the input file");
+#endif
+	map_base_ = static_cast<const uint8_t*>(base);
+	try {
+		validate_header();
+	}
+	catch (...) {
+		unmap();
+		throw;
+	}
+	advise(hint);
+}
+
+MappedWaveFile::~MappedWaveFile()
+{
+	unmap();
+}
+
+void MappedWaveFile::unmap()
+{
+	if (!map_base_) return;
+#ifdef SYSTEM_WINDOWS
+	UnmapViewOfFile(map_base_);
+	CloseHandle(static_cast<HANDLE>(map_handle_));
+	map_handle_ = nullptr;
+#else
+	::munmap(const_cast<uint8_t*>(map_base_), map_size_);
+#endif
+	map_base_ = nullptr;
+	map_size_ = 0;
+}
+
+void MappedWaveFile::validate_header()
+{
+	info_ = parse_wav_header(map_base_, map_size_);
+	if (info_.recovered) {
+		logger[log_level::debug] << "[MappedWaveFile] Data chunk size recovered to " << info_.data_size << " bytes";
+	}
+	params_.rate = convert_int_to_rate(info_.rate);
+	pcm_ = map_base_ + info_.data_offset;
+	sample_count_ = static_cast<size_t>(info_.frames());
+}
+
+audio_params_t MappedWaveFile::get_params() const
+{
+	return params_;
+}
+
+bool MappedWaveFile::has_native_format() const
+{
+	return info_.format == pcm_format_t::int16 && info_.channels == 2 && info_.block_align == sizeof(audio_sample_t)
+			&& (info_.data_offset % sizeof(int16_t)) == 0;
+}
+
+array_view_t<const audio_sample_t> MappedWaveFile::get_samples() const
+{
+	if (!has_native_format()) throw std::runtime_error("Direct access to samples is supported only for 16bit stereo files");
+	return array_view_t<const audio_sample_t>(reinterpret_cast<const audio_sample_t*>(pcm_), sample_count_);
+}
+
+array_view_t<const uint8_t> MappedWaveFile::get_raw_data() const
+{
+	return array_view_t<const uint8_t>(pcm_, sample_count_ * info_.block_align);
+}
+
+size_t MappedWaveFile::read_data(std::vector<audio_sample_t>& data, size_t position, size_t sample_count) const
+{
+	if (!sample_count || sample_count > data.size()) sample_count = data.size();
+	if (position >= sample_count_) return 0;
+	sample_count = std::min(sample_count, sample_count_ - position);
+	if (has_native_format()) {
+		std::memcpy(&data[0], pcm_ + position * sizeof(audio_sample_t), sample_count * sizeof(audio_sample_t));
+	} else {
+		convert_pcm_to_samples(pcm_ + position * info_.block_align, info_, &data[0], sample_count);
+	}
+	return sample_count;
+}
+
+error_type_t MappedWaveFile::advise(access_hint_t hint) const
+{
+	return advise(hint, 0, sample_count_);
+}
+
+error_type_t MappedWaveFile::advise(access_hint_t hint, size_t first, size_t count) const
+{
+	if (!map_base_) return error_type_t::invalid;
+#ifdef SYSTEM_WINDOWS
+	(void)hint; (void)first; (void)count;
+	return error_type_t::unsupported;
+#else
+	const size_t frame_size = info_.block_align;
+	first = std::min(first, sample_count_);
+	count = std::min(count, sample_count_ - first);
+	// madvise requires page aligned start address
+	static const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+	const size_t start = (pcm_ - map_base_) + first * frame_size;
+	const size_t aligned_start = start - (start % page_size);
+	const size_t length = start - aligned_start + count * frame_size;
+	if (!length) return error_type_t::ok;
+	if (::madvise(const_cast<uint8_t*>(map_base_) + aligned_start, length, hint_to_advice(hint)) != 0)
+		return error_type_t::failed;
+	return error_type_t::ok;
+#endif
+}
+
+}
@@ -0,0 +1,385 @@
+/**
+ * @file 	Oscillator.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/Oscillator.h"
+#include "iimavlib/FFTKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace iimavlib {
+
+namespace {
+typedef fft_kernels::float_ops_t vector_ops;
+
+/*
+ * Integral parts of non-negative numbers
+ */
+#if defined(IIMAVLIB_AVX2)
+__m256 truncate(__m256 x)
+{
+	return _mm256_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+#elif defined(IIMAVLIB_SSE2)
+__m128 truncate(__m128 x)
+{
+	return _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+}
+#endif
+float truncate(float x)
+{
+	return static_cast<float>(static_cast<int32_t>(x));
+}
+
+/// Table of a single period of sine, with a copy of the first value at the end
+struct sine_table_t {
+	static const size_t size = 4096;
+	float values[size + 1];
+	sine_table_t() {
+		for (size_t i = 0; i <= size; ++i) {
+			values[i] = static_cast<float>(std::sin(2.0 * 3.14159265358979323846 * i / size));
+		}
+	}
+	/// Sine of a phase in interval <0, 1), absolute error below 3e-7
+	float lookup(float phase) const {
+		const float position = phase * static_cast<float>(size);
+		const size_t index = static_cast<size_t>(position);
+		const float fraction = position - static_cast<float>(index);
+		return values[index] + fraction * (values[index + 1] - values[index]);
+	}
+};
+
+const sine_table_t sine_table;
+
+/*
+ * Sines of phases in interval <0, 1), interpolated from sine_table like sine_table_t::lookup
+ */
+#if defined(IIMAVLIB_AVX2)
+__m256 sine_lookup(__m256 phase)
+{
+	const __m256 position = _mm256_mul_ps(phase, _mm256_set1_ps(static_cast<float>(sine_table_t::size)));
+	const __m256i index = _mm256_cvttps_epi32(position);
+	const __m256 fraction = _mm256_sub_ps(position, _mm256_cvtepi32_ps(index));
+	const __m256 a = _mm256_i32gather_ps(sine_table.values, index, 4);
+	const __m256 b = _mm256_i32gather_ps(sine_table.values + 1, index, 4);
+	return _mm256_add_ps(a, _mm256_mul_ps(fraction, _mm256_sub_ps(b, a)));
+}
+#elif defined(IIMAVLIB_SSE2)
+__m128 sine_lookup(__m128 phase)
+{
+	// There are no gathers in SSE2, so the table is read per lane
+	float values[4];
+	_mm_storeu_ps(values, phase);
+	for (size_t i = 0; i < 4; ++i) values[i] = sine_table.lookup(values[i]);
+	return _mm_loadu_ps(values);
+}
+#endif
+float sine_lookup(float phase)
+{
+	return sine_table.lookup(phase);
+}
+
+/// Moves non-negative phases to interval <0, 1)
+template<class V>
+typename V::vector_t wrap(typename V::vector_t phase)
+{
+	return V::sub(phase, truncate(phase));
+}
+
+/**
+ * Two point PolyBLEP residual of a fall by 2 at phase 0, (1 - (1 - t) / dt)^2 - (1 - t / dt)^2
+ * with both terms limited to the samples closer than @em dt to the discontinuity.
+ */
+template<class V>
+typename V::vector_t blep(typename V::vector_t t, typename V::vector_t inverse_dt)
+{
+	const typename V::vector_t one = V::set(1.0f);
+	const typename V::vector_t after = V::sub(one, V::min(V::mul(t, inverse_dt), one));
+	const typename V::vector_t before = V::sub(one, V::min(V::mul(V::sub(one, t), inverse_dt), one));
+	return V::sub(V::mul(before, before), V::mul(after, after));
+}
+
+/// PolyBLAMP residual of a corner at phase 0, in multiples of dt / 6 per unit change of the slope
+template<class V>
+typename V::vector_t blamp(typename V::vector_t t, typename V::vector_t inverse_dt)
+{
+	const typename V::vector_t one = V::set(1.0f);
+	const typename V::vector_t after = V::sub(one, V::min(V::mul(t, inverse_dt), one));
+	const typename V::vector_t before = V::sub(one, V::min(V::mul(V::sub(one, t), inverse_dt), one));
+	return V::add(V::mul(V::mul(after, after), after), V::mul(V::mul(before, before), before));
+}
+
+/*
+ * Waveforms, computing values for phases @em t and phase increments @em dt
+ */
+struct sine_shape {
+	template<class V>
+	static typename V::vector_t value(typename V::vector_t t, typename V::vector_t, typename V::vector_t) {
+		return sine_lookup(t);
+	}
+};
+
+struct sawtooth_shape {
+	template<class V>
+	static typename V::vector_t value(typename V::vector_t t, typename V::vector_t, typename V::vector_t inverse_dt) {
+		const typename V::vector_t u = wrap<V>(V::add(t, V::set(0.5f)));
+		return V::sub(V::sub(V::add(u, u), V::set(1.0f)), blep<V>(u, inverse_dt));
+	}
+};
+
+struct square_shape {
+	template<class V>
+	static typename V::vector_t value(typename V::vector_t t, typename V::vector_t, typename V::vector_t inverse_dt) {
+		const typename V::vector_t shifted = wrap<V>(V::add(t, V::set(0.5f)));
+		// 2 * (shifted - t) is 1 in the first half of the period and -1 in the second one
+		const typename V::vector_t naive = V::mul(V::sub(shifted, t), V::set(2.0f));
+		return V::add(naive, V::sub(blep<V>(t, inverse_dt), blep<V>(shifted, inverse_dt)));
+	}
+};
+
+struct triangle_shape {
+	template<class V>
+	static typename V::vector_t value(typename V::vector_t t, typename V::vector_t dt, typename V::vector_t inverse_dt) {
+		// u is 0 in the minimum and 0.5 in the maximum
+		const typename V::vector_t u = wrap<V>(V::add(t, V::set(0.25f)));
+		const typename V::vector_t shifted = wrap<V>(V::add(u, V::set(0.5f)));
+		const typename V::vector_t centered = V::sub(u, V::set(0.5f));
+		const typename V::vector_t absolute = V::max(centered, V::sub(V::set(0.0f), centered));
+		const typename V::vector_t naive = V::sub(V::set(1.0f), V::mul(V::set(4.0f), absolute));
+		// The slope changes by 8 in both corners
+		const typename V::vector_t corners = V::sub(blamp<V>(u, inverse_dt), blamp<V>(shifted, inverse_dt));
+		return V::add(naive, V::mul(V::mul(dt, V::set(8.0f / 6.0f)), corners));
+	}
+};
+
+/// Phase increment per sample, limited so the corrections of both edges don't overlap too much
+double phase_increment(double frequency, double rate)
+{
+	return std::max(0.0, std::min(frequency / rate, 0.499));
+}
+
+/**
+ * Generates whole vectors of consecutive samples, returning number of the generated samples.
+ * Phases of the lanes are computed from @em phase in each step, so the errors don't accumulate.
+ */
+template<class V, class Shape, bool accumulate>
+size_t generate_samples(float* output, size_t count, double& phase, double increment, float amplitude)
+{
+	typedef typename V::vector_t vector_t;
+	const size_t width = V::width;
+	float offsets[width];
+	for (size_t i = 0; i < width; ++i) offsets[i] = static_cast<float>(i * increment);
+	const vector_t lanes = V::load(offsets);
+	const float dt = std::max(static_cast<float>(increment), 1e-9f);
+	const vector_t dt_vector = V::set(dt);
+	const vector_t inverse_dt = V::set(1.0f / dt);
+	const vector_t gain = V::set(amplitude);
+	const double step = width * increment;
+	size_t i = 0;
+	for (; i + width <= count; i += width) {
+		const vector_t t = wrap<V>(V::add(V::set(static_cast<float>(phase)), lanes));
+		vector_t value = V::mul(Shape::template value<V>(t, dt_vector, inverse_dt), gain);
+		if (accumulate) value = V::add(value, V::load(output + i));
+		V::store(output + i, value);
+		phase += step;
+		phase -= std::floor(phase);
+	}
+	return i;
+}
+
+template<class Shape, bool accumulate>
+void generate_shape(float* output, size_t count, double& phase, double increment, float amplitude)
+{
+	const size_t done = generate_samples<vector_ops, Shape, accumulate>(output, count, phase, increment, amplitude);
+	generate_samples<fft_kernels::scalar_float, Shape, accumulate>(output + done, count - done, phase, increment, amplitude);
+}
+
+/// Number of samples generated by OscillatorBank before reloading the phases
+const size_t bank_block = 256;
+
+/**
+ * Adds sum of the oscillators in lanes of the vectors to @em output. Each group of lanes produces vectors
+ * for several consecutive samples, which are transposed, so the lanes are summed without horizontal sums.
+ */
+template<class V, class Shape>
+void add_bank(float* output, size_t count, size_t oscillators, float* phases,
+		const float* increments, const float* inverse_increments, const float* amplitudes)
+{
+	typedef typename V::vector_t vector_t;
+	const size_t width = V::width;
+	size_t i = 0;
+	for (; i + width <= count; i += width) {
+		vector_t sums[width];
+		for (size_t k = 0; k < width; ++k) sums[k] = V::set(0.0f);
+		for (size_t j = 0; j < oscillators; j += width) {
+			vector_t t = V::load(phases + j);
+			const vector_t dt = V::load(increments + j);
+			const vector_t inverse_dt = V::load(inverse_increments + j);
+			const vector_t gain = V::load(amplitudes + j);
+			for (size_t k = 0; k < width; ++k) {
+				sums[k] = V::add(sums[k], V::mul(Shape::template value<V>(t, dt, inverse_dt), gain));
+				t = wrap<V>(V::add(t, dt));
+			}
+			V::store(phases + j, t);
+		}
+		V::transpose(sums);
+		vector_t value = V::load(output + i);
+		for (size_t k = 0; k < width; ++k) value = V::add(value, sums[k]);
+		V::store(output + i, value);
+	}
+	// Remaining samples, summing the lanes one by one
+	for (; i < count; ++i) {
+		vector_t sum = V::set(0.0f);
+		for (size_t j = 0; j < oscillators; j += width) {
+			const vector_t t = V::load(phases + j);
+			const vector_t dt = V::load(increments + j);
+			sum = V::add(sum, V::mul(Shape::template value<V>(t, dt, V::load(inverse_increments + j)), V::load(amplitudes + j)));
+			V::store(phases + j, wrap<V>(V::add(t, dt)));
+		}
+		float values[width];
+		V::store(values, sum);
+		for (size_t k = 0; k < width; ++k) output[i] += values[k];
+	}
+}
+
+}
+
+Oscillator::Oscillator(waveform_t waveform, double frequency, double phase):
+	waveform_(waveform),frequency_(frequency),phase_(0.0)
+{
+	set_phase(phase);
+}
+
+void Oscillator::set_phase(double phase)
+{
+	phase_ = phase - std::floor(phase);
+	if (phase_ >= 1.0) phase_ = 0.0;
+}
+
+void Oscillator::generate(float* output, size_t count, double rate)
+{
+	run<false>(output, count, rate, 1.0f);
+}
+
+void Oscillator::add(float* output, size_t count, double rate, float amplitude)
+{
+	run<true>(output, count, rate, amplitude);
+}
+
+template<bool accumulate>
+void Oscillator::run(float* output, size_t count, double rate, float amplitude)
+{
+	const double increment = phase_increment(frequency_, rate);
+	switch (waveform_) {
+		case waveform_t::sine:
+			generate_shape<sine_shape, accumulate>(output, count, phase_, increment, amplitude);
+			break;
+		case waveform_t::sawtooth:
+			generate_shape<sawtooth_shape, accumulate>(output, count, phase_, increment, amplitude);
+			break;
+		case waveform_t::square:
+			generate_shape<square_shape, accumulate>(output, count, phase_, increment, amplitude);
+			break;
+		case waveform_t::triangle:
+			generate_shape<triangle_shape, accumulate>(output, count, phase_, increment, amplitude);
+			break;
+	}
+}
+
+
+OscillatorBank::OscillatorBank(size_t count, waveform_t waveform):
+	waveform_(waveform),count_(count)
+{
+	const size_t width = vector_ops::width;
+	const size_t padded = (count + width - 1) / width * width;
+	frequencies_.assign(padded, 0.0);
+	amplitudes_.assign(padded, 0.0f);
+	phases_.assign(padded, 0.0);
+	lane_phases_.assign(padded, 0.0f);
+	increments_.assign(padded, 0.0f);
+	inverse_increments_.assign(padded, 0.0f);
+}
+
+void OscillatorBank::check_index(size_t index) const
+{
+	if (index >= count_) throw std::out_of_range("OscillatorBank Error: oscillator index out of range");
+}
+
+void OscillatorBank::set_frequency(size_t index, double frequency)
+{
+	check_index(index);
+	frequencies_[index] = frequency;
+}
+
+void OscillatorBank::set_amplitude(size_t index, float amplitude)
+{
+	check_index(index);
+	amplitudes_[index] = amplitude;
+}
+
+void OscillatorBank::set_phase(size_t index, double phase)
+{
+	check_index(index);
+	phases_[index] = phase - std::floor(phase);
+	if (phases_[index] >= 1.0) phases_[index] = 0.0;
+}
+
+double OscillatorBank::get_frequency(size_t index) const
+{
+	check_index(index);
+	return frequencies_[index];
+}
+
+float OscillatorBank::get_amplitude(size_t index) const
+{
+	check_index(index);
+	return amplitudes_[index];
+}
+
+void OscillatorBank::generate(float* output, size_t count, double rate)
+{
+	std::fill(output, output + count, 0.0f);
+	add(output, count, rate);
+}
+
+void OscillatorBank::add(float* output, size_t count, double rate)
+{
+	for (size_t i = 0; i < frequencies_.size(); ++i) {
+		const float dt = static_cast<float>(phase_increment(frequencies_[i], rate));
+		increments_[i] = dt;
+		inverse_increments_[i] = 1.0f / std::max(dt, 1e-9f);
+	}
+	const size_t oscillators = phases_.size();
+	float* phases = lane_phases_.data();
+	const float* increments = increments_.data();
+	const float* inverse_increments = inverse_increments_.data();
+	const float* amplitudes = amplitudes_.data();
+	for (size_t position = 0; position < count; position += bank_block) {
+		const size_t length = std::min(bank_block, count - position);
+		for (size_t i = 0; i < oscillators; ++i) phases[i] = static_cast<float>(phases_[i]);
+		switch (waveform_) {
+			case waveform_t::sine:
+				add_bank<vector_ops, sine_shape>(output + position, length, oscillators, phases, increments, inverse_increments, amplitudes);
+				break;
+			case waveform_t::sawtooth:
+				add_bank<vector_ops, sawtooth_shape>(output + position, length, oscillators, phases, increments, inverse_increments, amplitudes);
+				break;
+			case waveform_t::square:
+				add_bank<vector_ops, square_shape>(output + position, length, oscillators, phases, increments, inverse_increments, amplitudes);
+				break;
+			case waveform_t::triangle:
+				add_bank<vector_ops, triangle_shape>(output + position, length, oscillators, phases, increments, inverse_increments, amplitudes);
+				break;
+		}
+		for (size_t i = 0; i < oscillators; ++i) {
+			phases_[i] += length * static_cast<double>(increments[i]);
+			phases_[i] -= std::floor(phases_[i]);
+		}
+	}
+}
+
+}
@@ -0,0 +1,87 @@
+/**
+ * @file 	STFT.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/STFT.h"
+#include "iimavlib/SpectrumKernels.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace iimavlib {
+
+namespace {
+/// Largest magnitude of 16bit samples
+const float full_scale = 32768.0f;
+
+size_t checked_size(size_t size, size_t hop)
+{
+	if (size < 2 || (size & 1)) throw std::runtime_error("STFT Error: frame size has to be even");
+	if (hop == 0) throw std::runtime_error("STFT Error: hop has to be larger than 0");
+	return size;
+}
+}
+
+STFT::STFT(size_t size, size_t hop, window_type_t window):
+	size_(checked_size(size, hop)),hop_(hop),plan_(size),window_(make_window<float>(window, size)),
+	history_(size, 0.0f),position_(0),pending_(0),frame_(size),spectrum_(plan_.bins()),work_(plan_.work_size()),
+	magnitudes_(std::vector<float>(plan_.bins(), 0.0f)),frame_count_(0)
+{
+	// Peak of a sine wave with amplitude A is A * sum(window) / 2
+	scale_ = 2.0f / (std::accumulate(window_.begin(), window_.end(), 0.0f) * full_scale);
+}
+
+size_t STFT::push(const audio_sample_t* samples, size_t count)
+{
+	size_t frames = 0;
+	while (count) {
+		const size_t chunk = std::min(count, hop_ - pending_);
+		for (size_t i = 0; i < chunk; ++i) {
+			history_[position_] = 0.5f * (static_cast<float>(samples[i].left) + static_cast<float>(samples[i].right));
+			if (++position_ == size_) position_ = 0;
+		}
+		samples += chunk;
+		count -= chunk;
+		pending_ += chunk;
+		if (pending_ == hop_) {
+			compute_frame();
+			pending_ = 0;
+			++frames;
+		}
+	}
+	return frames;
+}
+
+bool STFT::read_frame(std::vector<float>& magnitudes)
+{
+	if (!magnitudes_.update()) return false;
+	magnitudes = magnitudes_.front();
+	return true;
+}
+
+void STFT::compute_frame()
+{
+	// The oldest sample is at the position of the next write
+	const size_t older = size_ - position_;
+	for (size_t i = 0; i < older; ++i) {
+		frame_[i] = history_[position_ + i] * window_[i];
+	}
+	for (size_t i = older; i < size_; ++i) {
+		frame_[i] = history_[i - older] * window_[i];
+	}
+	plan_.transform(frame_.data(), spectrum_.data(), work_.data());
+	std::vector<float>& magnitudes = magnitudes_.back();
+	const size_t bins = spectrum_.size();
+	spectrum_magnitudes(spectrum_.data(), magnitudes.data(), bins, scale_);
+	// DC and Nyquist bins don't have their mirror images
+	magnitudes[0] *= 0.5f;
+	magnitudes[bins - 1] *= 0.5f;
+	if (callback_) callback_(magnitudes.data(), bins);
+	magnitudes_.publish();
+	frame_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,282 @@
+/**
+ * @file 	SampleBank.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/SampleBank.h"
+#include "iimavlib/CompressedFile.h"
+#include "iimavlib/Utils.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace iimavlib {
+
+namespace {
+bool is_compressed(const std::string& filename)
+{
+	return filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".iac") == 0;
+}
+}
+
+SampleReader::SampleReader(const std::string& filename)
+:sample_count_(0),position_(0)
+{
+	if (is_compressed(filename)) {
+		compressed_.reset(new CompressedFile(filename));
+		params_ = compressed_->get_params();
+		sample_count_ = compressed_->get_sample_count();
+	} else {
+		mapped_.reset(new MappedWaveFile(filename, access_hint_t::sequential));
+		params_ = mapped_->get_params();
+		sample_count_ = mapped_->get_sample_count();
+	}
+}
+
+SampleReader::~SampleReader()
+{
+}
+
+size_t SampleReader::read_data(std::vector<audio_sample_t>& data, size_t sample_count)
+{
+	if (!sample_count || sample_count > data.size()) sample_count = data.size();
+	if (mapped_) {
+		sample_count = mapped_->read_data(data, static_cast<size_t>(position_), sample_count);
+	} else if (compressed_->read_data(data, sample_count) != error_type_t::ok) {
+		return 0;
+	}
+	position_ += sample_count;
+	return sample_count;
+}
+
+error_type_t SampleReader::seek(uint64_t position)
+{
+	position = std::min(position, sample_count_);
+	if (compressed_) {
+		const error_type_t ret = compressed_->seek(position);
+		if (ret != error_type_t::ok) return ret;
+	} else {
+		// Data before the position won't be read, so there's no reason to prefetch them
+		mapped_->advise(access_hint_t::sequential, static_cast<size_t>(position),
+				static_cast<size_t>(sample_count_ - position));
+	}
+	position_ = position;
+	return error_type_t::ok;
+}
+
+BankSample::BankSample(const std::string& filename, const std::shared_ptr<std::atomic<uint64_t>>& clock,
+		double preload_time)
+:filename_(filename),state_(sample_state_t::loading),clock_(clock),last_use_(0),length_(0),
+ preload_time_(preload_time),memory_(0)
+{
+	touch();
+}
+
+void BankSample::load()
+{
+	try {
+		if (preload_time_ > 0.0) {
+			// Only the beginning is decoded, rest of the sample will be streamed
+			SampleReader reader(filename_);
+			params_ = reader.get_params();
+			const uint64_t preload = static_cast<uint64_t>(preload_time_ * convert_rate_to_int(params_.rate));
+			decoded_.resize(static_cast<size_t>(std::min(preload, reader.get_sample_count())));
+			const size_t count = decoded_.empty() ? 0 : reader.read_data(decoded_);
+			if (count != decoded_.size()) throw std::runtime_error("Failed to read data");
+			length_ = reader.get_sample_count();
+		} else if (is_compressed(filename_)) {
+			CompressedFile file(filename_);
+			params_ = file.get_params();
+			decoded_.resize(static_cast<size_t>(file.get_sample_count()));
+			size_t count = decoded_.size();
+			if (file.read_data(decoded_, count) != error_type_t::ok) throw std::runtime_error("Corrupted data");
+			decoded_.resize(count);
+		} else {
+			std::unique_ptr<MappedWaveFile> mapped(new MappedWaveFile(filename_, access_hint_t::random));
+			params_ = mapped->get_params();
+			if (mapped->has_native_format()) {
+				// The samples can be used directly from the mapping, just make sure they're in memory
+				mapped->advise(access_hint_t::will_need);
+				view_ = mapped->get_samples();
+				mapped_ = std::move(mapped);
+			} else {
+				decoded_.resize(mapped->get_sample_count());
+				if (!decoded_.empty()) mapped->read_data(decoded_, 0);
+			}
+		}
+		if (!mapped_) view_ = array_view_t<const audio_sample_t>(decoded_);
+		if (preload_time_ <= 0.0) length_ = view_.size();
+		memory_ = view_.size() * sizeof(audio_sample_t);
+		state_.store(sample_state_t::ready, std::memory_order_release);
+	}
+	catch (std::exception& e) {
+		logger[log_level::info] << "[SampleBank] Failed to load " << filename_ << " (" << e.what() << ")";
+		state_.store(sample_state_t::failed, std::memory_order_release);
+	}
+}
+
+SampleBank::SampleBank(size_t memory_budget)
+:memory_budget_(memory_budget),clock_(std::make_shared<std::atomic<uint64_t>>(0)),running_(true)
+{
+	thread_ = std::thread(&SampleBank::loader_thread, this);
+}
+
+SampleBank::~SampleBank()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		running_ = false;
+	}
+	queue_cond_.notify_all();
+	thread_.join();
+}
+
+pBankSample SampleBank::get(const std::string& filename, double preload_time)
+{
+	const auto key = std::make_pair(filename, preload_time > 0.0);
+	std::unique_lock<std::mutex> lock(mutex_);
+	auto it = samples_.find(key);
+	// Failed samples are loaded again, the file may have been created since
+	if (it != samples_.end() && it->second->get_state() != sample_state_t::failed) {
+		it->second->touch();
+		return it->second;
+	}
+	auto sample = std::make_shared<BankSample>(filename, clock_, preload_time);
+	samples_[key] = sample;
+	queue_.push_back(sample);
+	lock.unlock();
+	queue_cond_.notify_one();
+	return sample;
+}
+
+pBankSample SampleBank::load(const std::string& filename, double preload_time)
+{
+	auto sample = get(filename, preload_time);
+	if (!wait(sample)) throw std::runtime_error("Failed to load " + filename);
+	return sample;
+}
+
+bool SampleBank::wait(const pBankSample& sample)
+{
+	if (!sample) return false;
+	std::unique_lock<std::mutex> lock(mutex_);
+	loaded_cond_.wait(lock, [&sample](){return sample->get_state() != sample_state_t::loading;});
+	return sample->ready();
+}
+
+void SampleBank::set_memory_budget(size_t memory_budget)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	memory_budget_ = memory_budget;
+	do_trim();
+}
+
+size_t SampleBank::get_memory_usage() const
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	size_t usage = 0;
+	for (const auto& it: samples_) usage += it.second->get_memory_usage();
+	return usage;
+}
+
+size_t SampleBank::get_sample_count() const
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	return samples_.size();
+}
+
+void SampleBank::trim()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	do_trim();
+}
+
+void SampleBank::do_trim()
+{
+	size_t usage = 0;
+	for (const auto& it: samples_) usage += it.second->get_memory_usage();
+	while (usage > memory_budget_) {
+		// Find the least recently used sample, that is referenced only by the bank
+		auto victim = samples_.end();
+		for (auto it = samples_.begin(); it != samples_.end(); ++it) {
+			const auto& sample = it->second;
+			if (sample.use_count() > 1 || sample->get_state() == sample_state_t::loading) continue;
+			if (victim == samples_.end() || sample->get_last_use() < victim->second->get_last_use()) victim = it;
+		}
+		if (victim == samples_.end()) break;
+		logger[log_level::debug] << "[SampleBank] Evicting " << victim->second->get_filename();
+		usage -= victim->second->get_memory_usage();
+		samples_.erase(victim);
+	}
+}
+
+void SampleBank::loader_thread()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (true) {
+		queue_cond_.wait(lock, [this](){return !running_ || !queue_.empty();});
+		if (!running_) break;
+		pBankSample sample = queue_.front();
+		queue_.pop_front();
+		lock.unlock();
+		sample->load();
+		lock.lock();
+		// Failed samples are dropped from the bank, the handles still report the failure
+		if (sample->get_state() == sample_state_t::failed) {
+			for (auto it = samples_.begin(); it != samples_.end(); ++it) {
+				if (it->second == sample) {
+					samples_.erase(it);
+					break;
+				}
+			}
+		}
+		// Release our reference before trimming, so the sample can be evicted if nobody else wants it
+		sample.reset();
+		do_trim();
+		loaded_cond_.notify_all();
+	}
+}
+
+SampleSlot::SampleSlot():current_(nullptr),version_(0),seen_(0)
+{
+}
+
+void SampleSlot::set(const pBankSample& sample)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	const uint64_t version = version_.load(std::memory_order_relaxed) + 1;
+	if (owned_) retired_.push_back(std::make_pair(version, owned_));
+	owned_ = sample;
+	current_.store(sample.get(), std::memory_order_release);
+	// Published after the pointer, so the audio thread seeing this version has to see the new sample
+	version_.store(version, std::memory_order_release);
+	lock.unlock();
+	collect();
+}
+
+BankSample* SampleSlot::acquire()
+{
+	const uint64_t version = version_.load(std::memory_order_acquire);
+	BankSample* sample = current_.load(std::memory_order_acquire);
+	seen_.store(version, std::memory_order_release);
+	if (sample) sample->touch();
+	return sample;
+}
+
+void SampleSlot::collect()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	const uint64_t seen = seen_.load(std::memory_order_acquire);
+	retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+			[seen](const std::pair<uint64_t, pBankSample>& r){return r.first <= seen;}),
+			retired_.end());
+}
+
+size_t SampleSlot::get_retired_count() const
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	return retired_.size();
+}
+
+}
@@ -0,0 +1,238 @@
+/**
+ * @file 	Spectrogram.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/Spectrogram.h"
+#include "iimavlib/SpectrumKernels.h"
+#include "iimavlib/WaveFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+namespace iimavlib {
+
+namespace {
+/// Largest magnitude of 16bit samples
+const float full_scale = 32768.0f;
+
+size_t checked_size(const spectrogram_params_t& params)
+{
+	if (params.size < 2 || (params.size & 1)) throw std::runtime_error("Spectrogram Error: frame size has to be even");
+	if (params.hop == 0) throw std::runtime_error("Spectrogram Error: hop has to be larger than 0");
+	return params.size;
+}
+
+size_t thread_count(size_t threads)
+{
+	if (threads) return threads;
+	return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+}
+
+Spectrogram::Spectrogram(const spectrogram_params_t& params):
+	size_(checked_size(params)),hop_(params.hop),threads_(thread_count(params.threads)),
+	plan_(params.size),window_(make_window<float>(params.window, params.size))
+{
+	// Peak of a sine wave with amplitude A is A * sum(window) / 2, the channels are summed
+	scale_ = 2.0f / (std::accumulate(window_.begin(), window_.end(), 0.0f) * 2.0f * full_scale);
+}
+
+size_t Spectrogram::get_frame_count(size_t samples) const
+{
+	return samples < size_ ? 0 : (samples - size_) / hop_ + 1;
+}
+
+spectrogram_t Spectrogram::compute(array_view_t<const audio_sample_t> samples) const
+{
+	spectrogram_t result;
+	compute(samples, result);
+	return result;
+}
+
+void Spectrogram::compute(array_view_t<const audio_sample_t> samples, spectrogram_t& result) const
+{
+	const auto start = std::chrono::steady_clock::now();
+	result.frames = get_frame_count(samples.size());
+	result.bins = get_bins();
+	result.data.resize(result.frames * result.bins);
+
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> workers;
+	const size_t chunk = chunk_frames;
+	const size_t chunks = (result.frames + chunk - 1) / chunk;
+	for (size_t i = 1; i < std::min(threads_, chunks); ++i) {
+		workers.emplace_back([&](){ work(samples.data(), result.frames, result.data.data(), next); });
+	}
+	work(samples.data(), result.frames, result.data.data(), next);
+	for (auto& worker: workers) worker.join();
+	result.seconds = seconds_since(start);
+}
+
+spectrogram_t Spectrogram::compute(WaveFile& file) const
+{
+	spectrogram_t result;
+	compute(file, result);
+	return result;
+}
+
+void Spectrogram::compute(WaveFile& file, spectrogram_t& result) const
+{
+	const auto start = std::chrono::steady_clock::now();
+	result.frames = 0;
+	result.bins = get_bins();
+	// Upper bound, as some of the samples may have been read already
+	result.data.resize(get_frame_count(file.get_sample_count()) * result.bins);
+
+	// Static constants can't be passed by reference
+	const size_t chunk = chunk_frames;
+	const size_t segment_frames = std::max(chunk, segment_samples / hop_);
+	const size_t segment_size = (segment_frames - 1) * hop_ + size_;
+	std::vector<audio_sample_t> current, next(segment_size), buffer(segment_size);
+	size_t filled = 0;
+	// Number of samples between the frames of the current segment and the next one (when hop is larger than size)
+	size_t skipped = 0;
+	// Fills @em next from @em filled on, stops at the end of file
+	auto read = [&]() {
+		while (skipped) {
+			size_t count = std::min(skipped, buffer.size());
+			if (file.read_data(buffer, count) != error_type_t::ok) {
+				throw std::runtime_error("Spectrogram Error: failed to read the file");
+			}
+			if (!count) return;
+			skipped -= count;
+		}
+		while (filled < segment_size) {
+			size_t count = segment_size - filled;
+			if (file.read_data(buffer, count) != error_type_t::ok) {
+				throw std::runtime_error("Spectrogram Error: failed to read the file");
+			}
+			if (!count) break;
+			std::copy(buffer.begin(), buffer.begin() + count, next.begin() + filled);
+			filled += count;
+		}
+	};
+
+	// The same workers compute all the segments. A segment is handed to them by increasing @em generation,
+	// the last worker finishing it wakes the reading thread.
+	std::mutex mutex;
+	std::condition_variable segment_ready, segment_done;
+	uint64_t generation = 0;
+	size_t busy = 0;
+	bool finished = false;
+	const audio_sample_t* segment = nullptr;
+	size_t segment_frame_count = 0;
+	float* segment_output = nullptr;
+	std::atomic<size_t> next_chunk(0);
+	std::vector<std::thread> workers;
+	auto stop_workers = [&]() {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			segment_done.wait(lock, [&](){ return busy == 0; });
+			finished = true;
+		}
+		segment_ready.notify_all();
+		for (auto& worker: workers) worker.join();
+	};
+	try {
+		for (size_t i = 0; i < threads_; ++i) {
+			workers.emplace_back([&](){
+				uint64_t seen = 0;
+				std::unique_lock<std::mutex> lock(mutex);
+				while (true) {
+					segment_ready.wait(lock, [&](){ return finished || generation != seen; });
+					if (finished) break;
+					seen = generation;
+					const audio_sample_t* samples = segment;
+					const size_t frames = segment_frame_count;
+					float* output = segment_output;
+					lock.unlock();
+					work(samples, frames, output, next_chunk);
+					lock.lock();
+					if (--busy == 0) segment_done.notify_one();
+				}
+			});
+		}
+		read();
+		while (true) {
+			current.swap(next);
+			const size_t frames = std::min(get_frame_count(filled), result.data.size() / result.bins - result.frames);
+			if (!frames) break;
+			// The workers compute frames of the current segment, while the next one is read
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				segment = current.data();
+				segment_frame_count = frames;
+				segment_output = result.data.data() + result.frames * result.bins;
+				next_chunk = 0;
+				busy = workers.size();
+				++generation;
+			}
+			segment_ready.notify_all();
+			// The next segment starts with the samples of the current one, which weren't used by all frames
+			const size_t used = frames * hop_;
+			const size_t kept = std::min(used, filled);
+			skipped = used - kept;
+			next.resize(segment_size);
+			filled -= kept;
+			std::copy(current.begin() + kept, current.begin() + kept + filled, next.begin());
+			read();
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				segment_done.wait(lock, [&](){ return busy == 0; });
+			}
+			result.frames += frames;
+		}
+	} catch (...) {
+		stop_workers();
+		throw;
+	}
+	stop_workers();
+	result.data.resize(result.frames * result.bins);
+	result.seconds = seconds_since(start);
+}
+
+void Spectrogram::work(const audio_sample_t* samples, size_t frames, float* output, std::atomic<size_t>& next) const
+{
+	const size_t bins = get_bins();
+	const size_t chunk = chunk_frames;
+	while (true) {
+		const size_t first = next.fetch_add(chunk);
+		if (first >= frames) break;
+		const size_t last = std::min(frames, first + chunk);
+		compute_frames(samples, first, last, output + first * bins);
+	}
+}
+
+void Spectrogram::compute_frames(const audio_sample_t* samples, size_t first, size_t last, float* output) const
+{
+	simplearray_t<float> frame(size_);
+	complexarray_t<float> spectrum(plan_.bins());
+	complexarray_t<float> work(plan_.work_size());
+	const size_t bins = spectrum.size();
+	for (size_t index = first; index < last; ++index, output += bins) {
+		const audio_sample_t* s = samples + index * hop_;
+		for (size_t i = 0; i < size_; ++i) {
+			frame[i] = (static_cast<float>(s[i].left) + static_cast<float>(s[i].right)) * window_[i];
+		}
+		plan_.transform(frame.data(), spectrum.data(), work.data());
+		spectrum_magnitudes(spectrum.data(), output, bins, scale_);
+		// DC and Nyquist bins don't have their mirror images
+		output[0] *= 0.5f;
+		output[bins - 1] *= 0.5f;
+	}
+}
+
+}
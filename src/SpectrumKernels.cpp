@@ -0,0 +1,256 @@
+/**
+ * @file 	SpectrumKernels.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/SpectrumKernels.h"
+#include "iimavlib/FFTKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace iimavlib {
+
+namespace {
+/// 10 * log10(2), converts log2 of power to decibels
+const float decibels_per_octave = 3.01029996f;
+
+typedef fft_kernels::vector_ops_t<float> vector_ops;
+
+#if defined(IIMAVLIB_AVX2)
+/// Splits x to exponent and mantissa in interval <sqrt(0.5), sqrt(2))
+__m256 split_exponent(__m256 x, __m256& mantissa)
+{
+	const __m256i offset = _mm256_set1_epi32(0x3f3504f3);
+	const __m256i bits = _mm256_sub_epi32(_mm256_castps_si256(x), offset);
+	mantissa = _mm256_castsi256_ps(_mm256_add_epi32(_mm256_and_si256(bits, _mm256_set1_epi32(0x7fffff)), offset));
+	return _mm256_cvtepi32_ps(_mm256_srai_epi32(bits, 23));
+}
+#elif defined(IIMAVLIB_SSE2)
+__m128 split_exponent(__m128 x, __m128& mantissa)
+{
+	const __m128i offset = _mm_set1_epi32(0x3f3504f3);
+	const __m128i bits = _mm_sub_epi32(_mm_castps_si128(x), offset);
+	mantissa = _mm_castsi128_ps(_mm_add_epi32(_mm_and_si128(bits, _mm_set1_epi32(0x7fffff)), offset));
+	return _mm_cvtepi32_ps(_mm_srai_epi32(bits, 23));
+}
+#endif
+
+/**
+ * Logarithm of positive normal numbers, absolute error below 1e-6.
+ * log2(m) = 2 / ln(2) * atanh(t), where t = (m - 1) / (m + 1) is at most 0.172,
+ * so four terms of the series of atanh are enough.
+ */
+template<class V>
+typename V::vector_t vector_log2(typename V::vector_t x)
+{
+	typedef typename V::vector_t vector_t;
+	vector_t mantissa;
+	const vector_t exponent = split_exponent(x, mantissa);
+	const vector_t one = V::set(1.0f);
+	const vector_t t = V::div(V::sub(mantissa, one), V::add(mantissa, one));
+	const vector_t t2 = V::mul(t, t);
+	vector_t series = V::add(V::set(1.0f / 5.0f), V::mul(t2, V::set(1.0f / 7.0f)));
+	series = V::add(V::set(1.0f / 3.0f), V::mul(t2, series));
+	series = V::add(one, V::mul(t2, series));
+	return V::add(exponent, V::mul(V::mul(t, series), V::set(2.8853900817779268f)));
+}
+
+/*
+ * Inputs, returning squared magnitudes of the bins
+ */
+struct interleaved_t {
+	const std::complex<float>* data;
+	float power(size_t i) const { return data[i].real() * data[i].real() + data[i].imag() * data[i].imag(); }
+	template<class V>
+	typename V::vector_t power(size_t i) const {
+		typename V::vector_t re, im;
+		V::deinterleave(reinterpret_cast<const float*>(data + i), re, im);
+		return V::add(V::mul(re, re), V::mul(im, im));
+	}
+};
+
+struct split_t {
+	const float* real;
+	const float* imag;
+	float power(size_t i) const { return real[i] * real[i] + imag[i] * imag[i]; }
+	template<class V>
+	typename V::vector_t power(size_t i) const {
+		const typename V::vector_t re = V::load(real + i);
+		const typename V::vector_t im = V::load(imag + i);
+		return V::add(V::mul(re, re), V::mul(im, im));
+	}
+};
+
+struct magnitudes_t {
+	const float* data;
+	float power(size_t i) const { return data[i] * data[i]; }
+	template<class V>
+	typename V::vector_t power(size_t i) const {
+		const typename V::vector_t value = V::load(data + i);
+		return V::mul(value, value);
+	}
+};
+
+/*
+ * Outputs, computed from the squared magnitudes
+ */
+struct magnitude_op {
+	float scale;
+	float operator()(float power) const { return std::sqrt(power) * scale; }
+	template<class V>
+	typename V::vector_t apply(typename V::vector_t power) const { return V::mul(V::sqrt(power), V::set(scale)); }
+};
+
+struct power_op {
+	float scale;
+	float operator()(float power) const { return power * scale; }
+	template<class V>
+	typename V::vector_t apply(typename V::vector_t power) const { return V::mul(power, V::set(scale)); }
+};
+
+struct decibels_op {
+	float scale;
+	/// Power of @em floor_db, but at least the smallest normal number
+	float floor_power;
+	float floor_db;
+	decibels_op(float scale, float floor):
+		scale(scale),
+		floor_power(std::max(std::pow(10.0f, floor / 10.0f), std::numeric_limits<float>::min())),
+		floor_db(floor) {}
+	float operator()(float power) const {
+		return std::max(10.0f * std::log10(std::max(power * scale, floor_power)), floor_db);
+	}
+	template<class V>
+	typename V::vector_t apply(typename V::vector_t power) const {
+		const typename V::vector_t value = V::max(V::mul(power, V::set(scale)), V::set(floor_power));
+		return V::max(V::mul(vector_log2<V>(value), V::set(decibels_per_octave)), V::set(floor_db));
+	}
+};
+
+template<class Input, class Op, class V = vector_ops, bool vectorized = (V::width > 1)>
+struct kernel_t {
+	static void run(const Input& input, const Op& op, float* output, size_t bins) {
+		for (size_t i = 0; i < bins; ++i) output[i] = op(input.power(i));
+	}
+};
+
+template<class Input, class Op, class V>
+struct kernel_t<Input, Op, V, true> {
+	static void run(const Input& input, const Op& op, float* output, size_t bins) {
+		const size_t width = V::width;
+		size_t i = 0;
+		for (; i + width <= bins; i += width) {
+			V::store(output + i, op.template apply<V>(input.template power<V>(i)));
+		}
+		for (; i < bins; ++i) output[i] = op(input.power(i));
+	}
+};
+
+template<class Input, class Op>
+void run(const Input& input, const Op& op, float* output, size_t bins)
+{
+	kernel_t<Input, Op>::run(input, op, output, bins);
+}
+
+/// Updates smoothed values and peaks
+template<class V = vector_ops, bool vectorized = (V::width > 1)>
+struct smoother_t {
+	static void update(const float* spectrum, float* values, float* peaks, size_t bins,
+			float attack, float release, float falloff) {
+		for (size_t i = 0; i < bins; ++i) {
+			const float difference = spectrum[i] - values[i];
+			values[i] += difference * (difference > 0.0f ? attack : release);
+			peaks[i] = std::max(spectrum[i], peaks[i] - falloff);
+		}
+	}
+};
+
+template<class V>
+struct smoother_t<V, true> {
+	static void update(const float* spectrum, float* values, float* peaks, size_t bins,
+			float attack, float release, float falloff) {
+		typedef typename V::vector_t vector_t;
+		const size_t width = V::width;
+		const vector_t zero = V::set(0.0f);
+		size_t i = 0;
+		for (; i + width <= bins; i += width) {
+			const vector_t value = V::load(spectrum + i);
+			const vector_t old = V::load(values + i);
+			// Increases and decreases are separated without comparisons
+			const vector_t difference = V::sub(value, old);
+			const vector_t change = V::add(V::mul(V::max(difference, zero), V::set(attack)),
+					V::mul(V::min(difference, zero), V::set(release)));
+			V::store(values + i, V::add(old, change));
+			V::store(peaks + i, V::max(value, V::sub(V::load(peaks + i), V::set(falloff))));
+		}
+		smoother_t<V, false>::update(spectrum + i, values + i, peaks + i, bins - i, attack, release, falloff);
+	}
+};
+}
+
+void spectrum_magnitudes(const std::complex<float>* spectrum, float* output, size_t bins, float scale)
+{
+	run(interleaved_t{spectrum}, magnitude_op{std::abs(scale)}, output, bins);
+}
+
+void spectrum_magnitudes(const float* real, const float* imag, float* output, size_t bins, float scale)
+{
+	run(split_t{real, imag}, magnitude_op{std::abs(scale)}, output, bins);
+}
+
+void spectrum_powers(const std::complex<float>* spectrum, float* output, size_t bins, float scale)
+{
+	run(interleaved_t{spectrum}, power_op{scale * scale}, output, bins);
+}
+
+void spectrum_powers(const float* real, const float* imag, float* output, size_t bins, float scale)
+{
+	run(split_t{real, imag}, power_op{scale * scale}, output, bins);
+}
+
+void spectrum_decibels(const std::complex<float>* spectrum, float* output, size_t bins, float scale, float floor_db)
+{
+	run(interleaved_t{spectrum}, decibels_op(scale * scale, floor_db), output, bins);
+}
+
+void spectrum_decibels(const float* real, const float* imag, float* output, size_t bins, float scale, float floor_db)
+{
+	run(split_t{real, imag}, decibels_op(scale * scale, floor_db), output, bins);
+}
+
+void magnitudes_to_decibels(const float* magnitudes, float* output, size_t bins, float floor_db)
+{
+	run(magnitudes_t{magnitudes}, decibels_op(1.0f, floor_db), output, bins);
+}
+
+SpectrumSmoother::SpectrumSmoother(size_t bins, float attack, float release, float peak_falloff):
+	attack_(attack),release_(release),peak_falloff_(peak_falloff),empty_(true),values_(bins),peaks_(bins)
+{
+	if (!(attack > 0.0f && attack <= 1.0f) || !(release > 0.0f && release <= 1.0f)) {
+		throw std::runtime_error("SpectrumSmoother Error: attack and release have to be in interval (0, 1>");
+	}
+	if (!(peak_falloff >= 0.0f)) throw std::runtime_error("SpectrumSmoother Error: peak falloff can't be negative");
+}
+
+void SpectrumSmoother::update(array_view_t<const float> spectrum)
+{
+	if (empty_ || spectrum.size() != values_.size()) {
+		values_.assign(spectrum.begin(), spectrum.end());
+		peaks_ = values_;
+		empty_ = false;
+		return;
+	}
+	smoother_t<>::update(spectrum.data(), values_.data(), peaks_.data(), values_.size(),
+			attack_, release_, peak_falloff_);
+}
+
+void SpectrumSmoother::reset()
+{
+	empty_ = true;
+}
+
+}
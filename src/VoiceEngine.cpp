@@ -0,0 +1,578 @@
+/**
+ * @file 	VoiceEngine.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/VoiceEngine.h"
+#include "iimavlib/Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#ifdef IIMAVLIB_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace iimavlib {
+
+namespace {
+
+const uint64_t fixed_one = 1ull << 32;
+const uint64_t fixed_fraction = fixed_one - 1;
+/// Maximal pitch of streamed voices, limits the rate data are read from the ring buffers
+const double max_stream_pitch = 4.0;
+/// How long the prefetch thread sleeps when all rings are full
+const std::chrono::milliseconds prefetch_interval(2);
+
+inline uint64_t to_fixed(double value)
+{
+	return static_cast<uint64_t>(value * static_cast<double>(fixed_one) + 0.5);
+}
+
+/**
+ * Adds samples to an interleaved float buffer, with gains interpolated linearly
+ * @param src Source samples
+ * @param mix Interleaved mix buffer
+ * @param count Number of samples
+ * @param gain_left Gain of the left channel for the first sample
+ * @param delta_left Increment of left gain per sample
+ */
+void accumulate_samples(const audio_sample_t* src, float* mix, size_t count,
+		float gain_left, float delta_left, float gain_right, float delta_right)
+{
+	size_t i = 0;
+#ifdef IIMAVLIB_SSE2
+	const __m128 delta4 = _mm_set_ps(4 * delta_right, 4 * delta_left, 4 * delta_right, 4 * delta_left);
+	__m128 gain_a = _mm_set_ps(gain_right + delta_right, gain_left + delta_left, gain_right, gain_left);
+	__m128 gain_b = _mm_add_ps(gain_a, _mm_set_ps(2 * delta_right, 2 * delta_left, 2 * delta_right, 2 * delta_left));
+	for (; i + 4 <= count; i += 4) {
+		// 4 stereo samples, widened to 32 bits with sign extension
+		const __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		const __m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16));
+		const __m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16));
+		_mm_storeu_ps(mix + 2 * i,     _mm_add_ps(_mm_loadu_ps(mix + 2 * i),     _mm_mul_ps(a, gain_a)));
+		_mm_storeu_ps(mix + 2 * i + 4, _mm_add_ps(_mm_loadu_ps(mix + 2 * i + 4), _mm_mul_ps(b, gain_b)));
+		gain_a = _mm_add_ps(gain_a, delta4);
+		gain_b = _mm_add_ps(gain_b, delta4);
+	}
+#endif
+	for (; i < count; ++i) {
+		mix[2 * i]     += src[i].left  * (gain_left  + delta_left  * i);
+		mix[2 * i + 1] += src[i].right * (gain_right + delta_right * i);
+	}
+}
+
+/**
+ * Converts samples to interleaved floats
+ */
+void samples_to_float(const audio_sample_t* src, float* dst, size_t count)
+{
+	size_t i = 0;
+#ifdef IIMAVLIB_SSE2
+	for (; i + 4 <= count; i += 4) {
+		const __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_ps(dst + 2 * i,     _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16)));
+		_mm_storeu_ps(dst + 2 * i + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16)));
+	}
+#endif
+	for (; i < count; ++i) {
+		dst[2 * i] = src[i].left;
+		dst[2 * i + 1] = src[i].right;
+	}
+}
+
+/**
+ * Converts interleaved floats to samples, with saturation
+ */
+void float_to_samples(const float* src, audio_sample_t* dst, size_t count)
+{
+	size_t i = 0;
+#ifdef IIMAVLIB_SSE2
+	const __m128 low = _mm_set1_ps(-32768.0f);
+	const __m128 high = _mm_set1_ps(32767.0f);
+	for (; i + 4 <= count; i += 4) {
+		// Clamping is needed, out of range values would convert to INT_MIN
+		const __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + 2 * i), low), high);
+		const __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + 2 * i + 4), low), high);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+	}
+#endif
+	for (; i < count; ++i) {
+		dst[i].left  = static_cast<int16_t>(std::lrint(std::min(std::max(src[2 * i],     -32768.0f), 32767.0f)));
+		dst[i].right = static_cast<int16_t>(std::lrint(std::min(std::max(src[2 * i + 1], -32768.0f), 32767.0f)));
+	}
+}
+
+}
+
+VoiceEngine::stream_t::stream_t(size_t ring_size)
+:ring(ring_size),state(stream_state_t::idle),sample(nullptr),slot(0),start(0),
+ window(static_cast<size_t>(block_size * max_stream_pitch) + 4),window_first(0),window_count(0),windowed(false)
+{
+}
+
+VoiceEngine::VoiceEngine(const pAudioFilter& child, size_t max_voices, size_t max_samples, steal_policy_t policy)
+:AudioFilter(child),voices_(std::max<size_t>(max_voices, 1)),slots_(new SampleSlot[max_samples]),
+ slot_count_(max_samples),events_(event_queue_size),mix_(2 * block_size),policy_(policy),next_id_(1),
+ next_age_(0),rate_(convert_rate_to_int(get_params().rate)),has_child_(static_cast<bool>(child)),
+ stream_samples_(max_samples),streaming_(false),
+ active_count_(0),peak_voices_(0),stolen_voices_(0),rejected_voices_(0),dropped_events_(0),
+ active_streams_(0),starved_blocks_(0),starved_samples_(0),stream_failures_(0)
+{
+	active_.reserve(voices_.size());
+	free_.reserve(voices_.size());
+	for (size_t i = voices_.size(); i > 0; --i) {
+		voices_[i - 1].state = voice_state_t::free;
+		voices_[i - 1].stream = no_stream;
+		free_.push_back(i - 1);
+	}
+}
+
+VoiceEngine::~VoiceEngine()
+{
+	streaming_ = false;
+	if (stream_thread_.joinable()) stream_thread_.join();
+}
+
+error_type_t VoiceEngine::set_sample(size_t index, const pBankSample& sample)
+{
+	if (index >= slot_count_) return error_type_t::invalid;
+	{
+		std::unique_lock<std::mutex> lock(stream_mutex_);
+		stream_samples_[index] = sample;
+	}
+	slots_[index].set(sample);
+	return error_type_t::ok;
+}
+
+error_type_t VoiceEngine::enable_streaming(size_t max_streams, double buffer_time)
+{
+	if (streaming_ || !max_streams) return streaming_ ? error_type_t::busy : error_type_t::invalid;
+	const size_t ring_size = std::max(static_cast<size_t>(buffer_time * rate_), 2 * stream_chunk_size);
+	streams_.reserve(max_streams);
+	free_streams_.reserve(max_streams);
+	stopping_streams_.reserve(max_streams);
+	for (size_t i = 0; i < max_streams; ++i) {
+		streams_.push_back(std::unique_ptr<stream_t>(new stream_t(ring_size)));
+		free_streams_.push_back(max_streams - i - 1);
+	}
+	streaming_ = true;
+	stream_thread_ = std::thread(&VoiceEngine::prefetch_thread, this);
+	return error_type_t::ok;
+}
+
+bool VoiceEngine::push_event(const event_t& event)
+{
+	if (events_.push(event)) return true;
+	dropped_events_.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+voice_id_t VoiceEngine::trigger(size_t sample, float gain, float pan, float pitch)
+{
+	voice_id_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+	// Skip 0 when the counter wraps around
+	if (!id) id = next_id_.fetch_add(1, std::memory_order_relaxed);
+	const event_t event = {event_type_t::trigger, id, static_cast<uint32_t>(sample), gain, pan, pitch};
+	return push_event(event) ? id : 0;
+}
+
+bool VoiceEngine::set_voice(voice_id_t voice, float gain, float pan, float pitch)
+{
+	const event_t event = {event_type_t::set, voice, 0, gain, pan, pitch};
+	return push_event(event);
+}
+
+bool VoiceEngine::release(voice_id_t voice)
+{
+	const event_t event = {event_type_t::release, voice, 0, 0.0f, 0.0f, 0.0f};
+	return push_event(event);
+}
+
+bool VoiceEngine::release_all()
+{
+	const event_t event = {event_type_t::release_all, 0, 0, 0.0f, 0.0f, 0.0f};
+	return push_event(event);
+}
+
+void VoiceEngine::set_steal_policy(steal_policy_t policy)
+{
+	policy_ = policy;
+}
+
+voice_stats_t VoiceEngine::get_stats() const
+{
+	voice_stats_t stats;
+	stats.active_voices = active_count_;
+	stats.peak_voices = peak_voices_;
+	stats.stolen_voices = stolen_voices_;
+	stats.rejected_voices = rejected_voices_;
+	stats.dropped_events = dropped_events_;
+	stats.active_streams = active_streams_;
+	stats.starved_blocks = starved_blocks_;
+	stats.starved_samples = starved_samples_;
+	stats.stream_failures = stream_failures_;
+	return stats;
+}
+
+void VoiceEngine::set_targets(voice_t& voice, float gain, float pan, float pitch)
+{
+	// Balance law, the center position keeps both channels at full gain
+	pan = std::min(std::max(pan, -1.0f), 1.0f);
+	voice.target_left = gain * std::min(1.0f, 1.0f - pan);
+	voice.target_right = gain * std::min(1.0f, 1.0f + pan);
+	voice.pitch = std::max(pitch, 0.0f);
+}
+
+VoiceEngine::voice_t* VoiceEngine::find_voice(voice_id_t id)
+{
+	for (auto index: active_) {
+		if (voices_[index].id == id) return &voices_[index];
+	}
+	return nullptr;
+}
+
+VoiceEngine::voice_t* VoiceEngine::allocate_voice()
+{
+	if (!free_.empty()) {
+		const size_t index = free_.back();
+		free_.pop_back();
+		active_.push_back(index);
+		return &voices_[index];
+	}
+	// All voices are busy, voices that are fading out are replaced first
+	const steal_policy_t policy = policy_;
+	voice_t* victim = nullptr;
+	for (auto index: active_) {
+		voice_t& voice = voices_[index];
+		if (!victim) {
+			victim = &voice;
+			continue;
+		}
+		const bool releasing = voice.state == voice_state_t::releasing;
+		const bool victim_releasing = victim->state == voice_state_t::releasing;
+		if (releasing != victim_releasing) {
+			if (releasing) victim = &voice;
+			continue;
+		}
+		if (policy == steal_policy_t::quietest) {
+			if (voice.target_left + voice.target_right < victim->target_left + victim->target_right) victim = &voice;
+		} else if (voice.age < victim->age) {
+			victim = &voice;
+		}
+	}
+	if (policy == steal_policy_t::none && victim && victim->state != voice_state_t::releasing) victim = nullptr;
+	if (!victim) {
+		rejected_voices_.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	stolen_voices_.fetch_add(1, std::memory_order_relaxed);
+	stop_stream(*victim);
+	return victim;
+}
+
+void VoiceEngine::free_voice(size_t active_index)
+{
+	const size_t index = active_[active_index];
+	voices_[index].state = voice_state_t::free;
+	stop_stream(voices_[index]);
+	active_[active_index] = active_.back();
+	active_.pop_back();
+	free_.push_back(index);
+}
+
+void VoiceEngine::handle_event(const event_t& event)
+{
+	switch (event.type) {
+		case event_type_t::trigger: {
+				if (event.sample >= slot_count_) break;
+				voice_t* voice = allocate_voice();
+				if (!voice) break;
+				voice->state = voice_state_t::playing;
+				voice->id = event.voice;
+				voice->sample = event.sample;
+				voice->age = next_age_++;
+				voice->position = 0;
+				voice->fresh = true;
+				voice->stream_sample = nullptr;
+				voice->stream_failed = false;
+				set_targets(*voice, event.gain, event.pan, event.pitch);
+			} break;
+		case event_type_t::set: {
+				voice_t* voice = find_voice(event.voice);
+				if (voice && voice->state == voice_state_t::playing) set_targets(*voice, event.gain, event.pan, event.pitch);
+			} break;
+		case event_type_t::release: {
+				voice_t* voice = find_voice(event.voice);
+				if (voice) {
+					voice->state = voice_state_t::releasing;
+					voice->target_left = voice->target_right = 0.0f;
+				}
+			} break;
+		case event_type_t::release_all:
+			for (auto index: active_) {
+				voices_[index].state = voice_state_t::releasing;
+				voices_[index].target_left = voices_[index].target_right = 0.0f;
+			}
+			break;
+	}
+}
+
+void VoiceEngine::stop_stream(voice_t& voice)
+{
+	if (voice.stream == no_stream) return;
+	streams_[voice.stream]->state.store(stream_state_t::stopping, std::memory_order_release);
+	stopping_streams_.push_back(voice.stream);
+	voice.stream = no_stream;
+}
+
+void VoiceEngine::collect_streams()
+{
+	for (size_t i = 0; i < stopping_streams_.size(); ) {
+		stream_t& stream = *streams_[stopping_streams_[i]];
+		if (stream.state.load(std::memory_order_acquire) != stream_state_t::stopped) {
+			++i;
+			continue;
+		}
+		// The prefetch thread doesn't write to the ring anymore, so it can be emptied safely
+		stream.ring.clear();
+		stream.window_count = 0;
+		stream.windowed = false;
+		stream.state.store(stream_state_t::idle, std::memory_order_release);
+		free_streams_.push_back(stopping_streams_[i]);
+		stopping_streams_[i] = stopping_streams_.back();
+		stopping_streams_.pop_back();
+	}
+}
+
+bool VoiceEngine::prepare_stream(voice_t& voice, BankSample* sample, size_t count, source_t& source)
+{
+	// The slot was changed to a different sample, that can't continue from the stream
+	if (voice.stream_sample && voice.stream_sample != sample) return false;
+	const uint64_t head = source.end;
+	if (voice.stream == no_stream) {
+		if (voice.stream_failed) {
+			source.length = head;
+			return true;
+		}
+		if (free_streams_.empty()) {
+			stream_failures_.fetch_add(1, std::memory_order_relaxed);
+			voice.stream_failed = true;
+			source.length = head;
+			return true;
+		}
+		voice.stream = free_streams_.back();
+		free_streams_.pop_back();
+		voice.stream_sample = sample;
+		stream_t& stream = *streams_[voice.stream];
+		stream.sample = sample;
+		stream.slot = voice.sample;
+		stream.start = head;
+		stream.window_count = 0;
+		stream.windowed = false;
+		stream.state.store(stream_state_t::starting, std::memory_order_release);
+	}
+	stream_t& stream = *streams_[voice.stream];
+	const stream_state_t state = stream.state.load(std::memory_order_acquire);
+	const uint64_t position = voice.position >> 32;
+	if (!stream.windowed) {
+		// Playing from the preloaded part, until the interpolation needs samples beyond it.
+		// The window may drain later while waiting for the ring, but it always continues where the ring does
+		const uint64_t step = std::max(voice.step, voice.target_step);
+		const uint64_t needed = position + ((step * count) >> 32) + 2;
+		if (needed < head) return true;
+		const uint64_t first = std::min(position, head);
+		std::copy(source.data + first, source.data + head, stream.window.begin());
+		stream.window_first = first;
+		stream.window_count = static_cast<size_t>(head - first);
+		stream.windowed = true;
+	} else if (position > stream.window_first) {
+		// Drop samples that were already played
+		const size_t played = static_cast<size_t>(std::min<uint64_t>(position - stream.window_first, stream.window_count));
+		std::memmove(&stream.window[0], &stream.window[played], (stream.window_count - played) * sizeof(audio_sample_t));
+		stream.window_first += played;
+		stream.window_count -= played;
+	}
+	stream.window_count += stream.ring.pop(&stream.window[stream.window_count], stream.window.size() - stream.window_count);
+	source.data = &stream.window[0];
+	source.first = stream.window_first;
+	source.end = stream.window_first + stream.window_count;
+	if (state == stream_state_t::failed) {
+		if (!voice.stream_failed) stream_failures_.fetch_add(1, std::memory_order_relaxed);
+		voice.stream_failed = true;
+		source.length = source.end;
+	}
+	return true;
+}
+
+bool VoiceEngine::render_voice(voice_t& voice, size_t count)
+{
+	BankSample* sample = slots_[voice.sample].acquire();
+	if (!sample) return false;
+	const auto data = sample->data();
+	if (data.empty()) return false;
+	source_t source = {&data[0], 0, data.size(), sample->get_length()};
+
+	// Samples with different sampling rate are resampled by adjusting the step
+	const double ratio = static_cast<double>(convert_rate_to_int(sample->get_params().rate)) / rate_;
+	const bool streamed = source.length > source.end;
+	voice.target_step = to_fixed(streamed ? std::min(voice.pitch * ratio, max_stream_pitch) : voice.pitch * ratio);
+	if (voice.fresh) {
+		voice.gain_left = voice.target_left;
+		voice.gain_right = voice.target_right;
+		voice.step = voice.target_step;
+		voice.fresh = false;
+	}
+	if (streamed && !prepare_stream(voice, sample, count, source)) return false;
+	const float delta_left = (voice.target_left - voice.gain_left) / count;
+	const float delta_right = (voice.target_right - voice.gain_right) / count;
+	bool finished = false;
+	// Number of samples at the end of the block without data (while waiting for a stream)
+	size_t starved = 0;
+
+	if (voice.step == fixed_one && voice.target_step == fixed_one && !(voice.position & fixed_fraction)) {
+		// Original pitch, samples can be accumulated directly
+		const uint64_t position = voice.position >> 32;
+		const size_t available = static_cast<size_t>(std::min<uint64_t>(count, source.end - std::min(position, source.end)));
+		if (available) {
+			accumulate_samples(source.data + (position - source.first), &mix_[0], available,
+					voice.gain_left, delta_left, voice.gain_right, delta_right);
+		}
+		voice.position += static_cast<uint64_t>(available) << 32;
+		finished = (voice.position >> 32) >= source.length;
+		if (!finished && available < count) starved = count - available;
+	} else {
+		// Resampling with linear interpolation, the step is interpolated over the block as well
+		const double step_delta = (static_cast<double>(voice.target_step) - static_cast<double>(voice.step)) / count;
+		double step = static_cast<double>(voice.step);
+		float gain_left = voice.gain_left;
+		float gain_right = voice.gain_right;
+		uint64_t position = voice.position;
+		float* mix = &mix_[0];
+		for (size_t i = 0; i < count; ++i) {
+			const uint64_t index = position >> 32;
+			if (index >= source.length) {
+				finished = true;
+				break;
+			}
+			const uint64_t next = index + 1;
+			if (index >= source.end || (next >= source.end && next < source.length)) {
+				starved = count - i;
+				break;
+			}
+			const float fraction = static_cast<float>(position & fixed_fraction) * (1.0f / fixed_one);
+			const audio_sample_t& s0 = source.data[index - source.first];
+			const audio_sample_t& s1 = next < source.length ? source.data[next - source.first] : s0;
+			mix[2 * i]     += (s0.left  + (s1.left  - s0.left)  * fraction) * gain_left;
+			mix[2 * i + 1] += (s0.right + (s1.right - s0.right) * fraction) * gain_right;
+			gain_left += delta_left;
+			gain_right += delta_right;
+			position += static_cast<uint64_t>(step);
+			step += step_delta;
+		}
+		voice.position = position;
+		if ((position >> 32) >= source.length) finished = true;
+	}
+	if (starved) {
+		starved_blocks_.fetch_add(1, std::memory_order_relaxed);
+		starved_samples_.fetch_add(starved, std::memory_order_relaxed);
+	}
+	voice.gain_left = voice.target_left;
+	voice.gain_right = voice.target_right;
+	voice.step = voice.target_step;
+	// Released voices end after fading out over one block
+	if (voice.state == voice_state_t::releasing) return false;
+	return !finished;
+}
+
+error_type_t VoiceEngine::do_process(audio_buffer_t& buffer)
+{
+	rate_ = convert_rate_to_int(buffer.params.rate);
+	if (!stopping_streams_.empty()) collect_streams();
+	event_t event;
+	while (events_.pop(event)) handle_event(event);
+
+	const size_t total = buffer.valid_samples;
+	for (size_t offset = 0; offset < total; offset += block_size) {
+		const size_t count = std::min(block_size, total - offset);
+		if (has_child_) samples_to_float(&buffer.data[offset], &mix_[0], count);
+		else std::fill(mix_.begin(), mix_.begin() + 2 * count, 0.0f);
+		for (size_t i = 0; i < active_.size(); ) {
+			if (render_voice(voices_[active_[i]], count)) ++i;
+			else free_voice(i);
+		}
+		float_to_samples(&mix_[0], &buffer.data[offset], count);
+	}
+
+	active_count_.store(active_.size(), std::memory_order_relaxed);
+	active_streams_.store(streams_.size() - free_streams_.size(), std::memory_order_relaxed);
+	if (active_.size() > peak_voices_.load(std::memory_order_relaxed)) peak_voices_.store(active_.size(), std::memory_order_relaxed);
+	return error_type_t::ok;
+}
+
+void VoiceEngine::prefetch_thread()
+{
+	std::vector<audio_sample_t> buffer(stream_chunk_size);
+	while (streaming_) {
+		bool busy = false;
+		for (auto& stream: streams_) {
+			if (prefetch(*stream, buffer)) busy = true;
+		}
+		if (!busy) std::this_thread::sleep_for(prefetch_interval);
+	}
+	for (auto& stream: streams_) {
+		stream->reader.reset();
+		stream->owned.reset();
+	}
+}
+
+bool VoiceEngine::prefetch(stream_t& stream, std::vector<audio_sample_t>& buffer)
+{
+	stream_state_t state = stream.state.load(std::memory_order_acquire);
+	switch (state) {
+		case stream_state_t::starting: {
+				// The sample is accessed only through a handle, that is valid only if the slot still contains it
+				{
+					std::unique_lock<std::mutex> lock(stream_mutex_);
+					if (stream_samples_[stream.slot].get() == stream.sample) stream.owned = stream_samples_[stream.slot];
+				}
+				stream_state_t next = stream_state_t::failed;
+				if (stream.owned) {
+					try {
+						stream.reader.reset(new SampleReader(stream.owned->get_filename()));
+						if (stream.reader->seek(stream.start) == error_type_t::ok) next = stream_state_t::streaming;
+					}
+					catch (std::exception& e) {
+						logger[log_level::info] << "[VoiceEngine] Failed to stream " << stream.owned->get_filename() << " (" << e.what() << ")";
+					}
+				}
+				// The audio thread may have stopped the stream in the meantime
+				stream.state.compare_exchange_strong(state, next, std::memory_order_acq_rel);
+			} return true;
+		case stream_state_t::streaming: {
+				const size_t free_space = stream.ring.free_space();
+				const uint64_t remaining = stream.reader->get_sample_count() - stream.reader->get_position();
+				const size_t count = static_cast<size_t>(std::min<uint64_t>(std::min(free_space, stream_chunk_size), remaining));
+				// Read only full chunks, unless it's the end of the sample
+				if (count < stream_chunk_size && count < remaining) return false;
+				const size_t read = count ? stream.reader->read_data(buffer, count) : 0;
+				if (read) stream.ring.push(&buffer[0], read);
+				if (read < count || stream.reader->get_position() >= stream.reader->get_sample_count()) {
+					stream.state.compare_exchange_strong(state, read < count ? stream_state_t::failed : stream_state_t::ended,
+							std::memory_order_acq_rel);
+				}
+			} return true;
+		case stream_state_t::stopping:
+			stream.reader.reset();
+			stream.owned.reset();
+			stream.state.store(stream_state_t::stopped, std::memory_order_release);
+			return true;
+		default:
+			return false;
+	}
+}
+
+}
@@ -10,45 +10,130 @@
 #include "iimavlib/WaveFile.h"
 #include "iimavlib/Utils.h"
 #include <stdexcept>
+#ifdef SYSTEM_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 namespace iimavlib {
 
 WaveFile::WaveFile(const std::string& filename, audio_params_t params)
-:params_(params),mono_source_(false)
+:params_(params),filename_(filename),write_mode_(true),buffer_size_(0),
+ header_interval_(default_header_interval),since_header_(0),data_remaining_(0),
+ preallocated_(false)
 {
 	file_.open(filename,std::ios::binary | std::ios::out | std::ios::trunc);
 	if (!file_.is_open()) throw std::runtime_error("Failed to open the output file");
 	header_ = wav_header_t(number_of_channels,
 								convert_rate_to_int(params_.rate),
 								16);//params_.sample_size()*8);
-	update(0);
+	info_.format = pcm_format_t::int16;
+	info_.channels = header_.channels;
+	info_.rate = header_.rate;
+	info_.block_align = header_.block_align;
+	info_.data_offset = sizeof(wav_header_t);
+	set_buffer_size(default_buffer_size);
+	update();
 }
 
-WaveFile::WaveFile(const std::string& filename):mono_source_(false)
+WaveFile::WaveFile(const std::string& filename):filename_(filename),write_mode_(false),
+		buffer_size_(0),header_interval_(0),since_header_(0),data_remaining_(0),
+		preallocated_(false)
 {
 	file_.open(filename,std::ios::binary | std::ios::in);
 	if (!file_.is_open()) throw std::runtime_error("Failed to open the input file");
-	file_.read(reinterpret_cast<char*>(&header_),sizeof(wav_header_t));
-	if (file_.gcount()!=sizeof(wav_header_t))
-		throw std::runtime_error("Failed to read wav header");
-	params_.rate = convert_int_to_rate(header_.rate);
-	if (header_.bps != 16) {
-		throw std::runtime_error("Only 16bit depths supported");
+	file_.seekg(0,std::ios::end);
+	const uint64_t file_size = static_cast<uint64_t>(file_.tellg());
+	info_ = parse_wav_header(file_, file_size);
+	params_.rate = convert_int_to_rate(info_.rate);
+	if (info_.recovered) {
+		logger[log_level::info] << "[WaveFile] Header of " << filename << " doesn't match the file size, recovered "
+				<< info_.data_size << " bytes of data";
 	}
-	if (header_.channels != 2 ) {
-		if (header_.channels == 1) {
-			mono_source_ = true;
-		} else {
-			throw std::runtime_error("Only mono or stereo samples are supported");
+	file_.clear();
+	file_.seekg(static_cast<std::streamoff>(info_.data_offset),std::ios::beg);
+	data_remaining_ = info_.data_size;
+}
+
+WaveFile::~WaveFile()
+{
+	if (!write_mode_ || !file_.is_open()) return;
+	flush();
+	if (preallocated_) {
+		file_.close();
+#ifdef SYSTEM_LINUX
+		// Release the reserved blocks that weren't used
+		if (::truncate(filename_.c_str(), static_cast<off_t>(sizeof(wav_header_t) + header_.data_size())) != 0) {
+			logger[log_level::debug] << "[WaveFile] Failed to release reserved space in " << filename_;
 		}
+#endif
 	}
 }
 
-void WaveFile::update(size_t new_data_size)
+void WaveFile::set_buffer_size(size_t size)
+{
+	if (size < write_buffer_.size()) write_buffer(false);
+	buffer_size_ = size;
+	write_buffer_.reserve(buffer_size_ + write_alignment);
+}
+
+void WaveFile::set_header_interval(size_t interval)
+{
+	header_interval_ = interval;
+}
+
+void WaveFile::update()
 {
-	header_.add_size(static_cast<uint32_t>(new_data_size));
 	file_.seekp(0,std::ios::beg);
 	file_.write(reinterpret_cast<char*>(&header_),sizeof(header_));
 	file_.seekp(0,std::ios::end);
+	since_header_ = 0;
+}
+
+error_type_t WaveFile::write_buffer(bool aligned_only)
+{
+	size_t count = write_buffer_.size();
+	if (!count) return error_type_t::ok;
+	if (aligned_only) {
+		// Keep the tail of the buffer, so the next write starts at an aligned position in the file
+		const size_t excess = static_cast<size_t>((sizeof(wav_header_t) + header_.data_size() + count) % write_alignment);
+		if (excess < count) count -= excess;
+	}
+	file_.write(&write_buffer_[0], count);
+	if (!file_) return error_type_t::failed;
+	header_.add_size(count);
+	write_buffer_.erase(write_buffer_.begin(), write_buffer_.begin() + count);
+	since_header_ += count;
+	if (header_interval_ && since_header_ >= header_interval_) update();
+	return error_type_t::ok;
+}
+
+error_type_t WaveFile::flush()
+{
+	if (!write_mode_) return error_type_t::invalid;
+	const error_type_t ret = write_buffer(false);
+	update();
+	file_.flush();
+	if (!file_) return error_type_t::failed;
+	return ret;
+}
+
+error_type_t WaveFile::preallocate(uint64_t data_size)
+{
+	if (!write_mode_) return error_type_t::invalid;
+#ifdef SYSTEM_LINUX
+	const int fd = ::open(filename_.c_str(), O_WRONLY);
+	if (fd < 0) return error_type_t::failed;
+	const int ret = ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(sizeof(wav_header_t) + data_size));
+	const int err = errno;
+	::close(fd);
+	if (ret != 0) return err == EOPNOTSUPP?error_type_t::unsupported:error_type_t::failed;
+	preallocated_ = true;
+	return error_type_t::ok;
+#else
+	(void)data_size;
+	return error_type_t::unsupported;
+#endif
 }
 
 audio_params_t WaveFile::get_params() const
@@ -56,13 +141,25 @@ audio_params_t WaveFile::get_params() const
 	return params_;
 }
 
+const wav_info_t& WaveFile::get_info() const
+{
+	return info_;
+}
+
+size_t WaveFile::get_sample_count() const
+{
+	if (!write_mode_) return static_cast<size_t>(info_.frames());
+	return static_cast<size_t>((header_.data_size() + write_buffer_.size()) / header_.block_align);
+}
+
 error_type_t WaveFile::store_data(const std::vector<audio_sample_t>& data, size_t sample_count)
 {
 	if (!sample_count) sample_count = data.size();
 	const size_t data_size = sample_count*params_.sample_size();
 	if (data_size) {
-		update(data_size);
-		file_.write(reinterpret_cast<const char*>(&data[0]),data_size);
+		const char* ptr = reinterpret_cast<const char*>(&data[0]);
+		write_buffer_.insert(write_buffer_.end(), ptr, ptr + data_size);
+		if (write_buffer_.size() >= buffer_size_) return write_buffer(buffer_size_ != 0);
 	}
 	return error_type_t::ok;
 }
@@ -71,15 +168,19 @@ error_type_t WaveFile::read_data(std::vector<audio_sample_t>& data, size_t& samp
 {
 	size_t max_samples = data.size();
 	if (sample_count > max_samples) sample_count = max_samples;
-	if (!mono_source_) {
+	sample_count = static_cast<size_t>(std::min<uint64_t>(sample_count, data_remaining_ / info_.block_align));
+	if (!sample_count) return error_type_t::ok;
+	if (info_.format == pcm_format_t::int16 && info_.channels == 2) {
+		// Native format, no conversion needed
 		file_.read(reinterpret_cast<char*>(&data[0]),sample_count*params_.sample_size());
 		sample_count = file_.gcount() / params_.sample_size();
 	} else {
-		mono_buffer_.resize(sample_count);
-		file_.read(reinterpret_cast<char*>(&mono_buffer_[0]),sample_count*sizeof(int16_t));
-		sample_count = file_.gcount() / sizeof(int16_t);
-		std::copy(mono_buffer_.begin(), mono_buffer_.begin() + sample_count, data.begin());
+		read_buffer_.resize(sample_count * info_.block_align);
+		file_.read(reinterpret_cast<char*>(&read_buffer_[0]),read_buffer_.size());
+		sample_count = file_.gcount() / info_.block_align;
+		convert_pcm_to_samples(&read_buffer_[0], info_, &data[0], sample_count);
 	}
+	data_remaining_ -= sample_count * info_.block_align;
 
 	return error_type_t::ok;
 }
@@ -0,0 +1,354 @@
+/**
+ * @file 	WaveFormat.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/WaveFormat.h"
+#include "iimavlib/Utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef IIMAVLIB_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace iimavlib {
+
+namespace {
+
+const uint16_t wave_format_pcm = 0x0001;
+const uint16_t wave_format_float = 0x0003;
+const uint16_t wave_format_extensible = 0xFFFE;
+
+uint16_t read_le16(const uint8_t* p)
+{
+	return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t read_le32(const uint8_t* p)
+{
+	return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+			(static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t read_le64(const uint8_t* p)
+{
+	return static_cast<uint64_t>(read_le32(p)) | (static_cast<uint64_t>(read_le32(p + 4)) << 32);
+}
+
+/*
+ * Readers providing random access to the file for the chunk walker
+ */
+struct stream_reader_t {
+	std::istream& stream;
+	stream_reader_t(std::istream& stream):stream(stream) {}
+	bool read(uint64_t offset, uint8_t* dst, size_t size) {
+		stream.clear();
+		stream.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+		stream.read(reinterpret_cast<char*>(dst), size);
+		return static_cast<size_t>(stream.gcount()) == size;
+	}
+};
+
+struct memory_reader_t {
+	const uint8_t* data;
+	uint64_t size;
+	memory_reader_t(const uint8_t* data, uint64_t size):data(data),size(size) {}
+	bool read(uint64_t offset, uint8_t* dst, size_t count) {
+		if (offset > size || size - offset < count) return false;
+		std::memcpy(dst, data + offset, count);
+		return true;
+	}
+};
+
+void parse_fmt_chunk(const uint8_t* fmt, size_t size, wav_info_t& info)
+{
+	if (size < 16) throw std::runtime_error("Corrupted fmt chunk");
+	uint16_t tag 		= read_le16(fmt);
+	info.channels 		= read_le16(fmt + 2);
+	info.rate 			= read_le32(fmt + 4);
+	info.block_align 	= read_le16(fmt + 12);
+	const uint16_t bits = read_le16(fmt + 14);
+	if (tag == wave_format_extensible) {
+		if (size < 40) throw std::runtime_error("Corrupted WAVE_FORMAT_EXTENSIBLE header");
+		// First two bytes of SubFormat GUID contain the actual format tag
+		tag = read_le16(fmt + 24);
+	}
+	info.format = pcm_format_t::unknown;
+	if (tag == wave_format_pcm) {
+		switch (bits) {
+			case 8: info.format = pcm_format_t::uint8; break;
+			case 16: info.format = pcm_format_t::int16; break;
+			case 24: info.format = pcm_format_t::int24; break;
+			case 32: info.format = pcm_format_t::int32; break;
+			default: break;
+		}
+	} else if (tag == wave_format_float && bits == 32) {
+		info.format = pcm_format_t::float32;
+	}
+	if (info.format == pcm_format_t::unknown) throw std::runtime_error("Unsupported sample format");
+	if (!info.channels || info.channels > 256) throw std::runtime_error("Invalid number of channels");
+	if (info.block_align < info.channels * pcm_format_size(info.format))
+		throw std::runtime_error("Invalid block align");
+}
+
+template<class Reader>
+wav_info_t parse_chunks(Reader& reader, uint64_t file_size)
+{
+	uint8_t riff[12];
+	if (!reader.read(0, riff, sizeof(riff))) throw std::runtime_error("Failed to read wav header");
+	// RF64 (and BW64) files store sizes larger than 4GB in ds64 chunk
+	const bool rf64 = !std::memcmp(riff, "RF64", 4) || !std::memcmp(riff, "BW64", 4);
+	if ((std::memcmp(riff, "RIFF", 4) && !rf64) || std::memcmp(riff + 8, "WAVE", 4))
+		throw std::runtime_error("Not a RIFF/WAVE file");
+	uint64_t riff_end = 8 + static_cast<uint64_t>(read_le32(riff + 4));
+	uint64_t ds64_data_size = 0;
+	bool have_ds64 = false;
+
+	wav_info_t info;
+	bool have_fmt = false;
+	bool have_data = false;
+	uint64_t declared_size = 0;
+	uint64_t position = sizeof(riff);
+	// The walk isn't limited by the RIFF size, as it may not be updated in files that weren't closed properly
+	while (position + 8 <= file_size && !(have_fmt && have_data)) {
+		uint8_t chunk[8];
+		if (!reader.read(position, chunk, sizeof(chunk))) break;
+		uint64_t chunk_size = read_le32(chunk + 4);
+		if (!std::memcmp(chunk, "ds64", 4) && rf64) {
+			uint8_t ds64[24];
+			if (chunk_size < sizeof(ds64) || !reader.read(position + 8, ds64, sizeof(ds64)))
+				throw std::runtime_error("Corrupted ds64 chunk");
+			riff_end = 8 + read_le64(ds64);
+			ds64_data_size = read_le64(ds64 + 8);
+			have_ds64 = true;
+		} else if (!std::memcmp(chunk, "fmt ", 4)) {
+			uint8_t fmt[40];
+			const size_t fmt_size = static_cast<size_t>(std::min<uint64_t>(chunk_size, sizeof(fmt)));
+			if (!reader.read(position + 8, fmt, fmt_size)) throw std::runtime_error("Failed to read fmt chunk");
+			parse_fmt_chunk(fmt, fmt_size, info);
+			have_fmt = true;
+		} else if (!std::memcmp(chunk, "data", 4)) {
+			if (rf64 && chunk_size == 0xFFFFFFFFu) {
+				if (!have_ds64) throw std::runtime_error("Missing ds64 chunk in RF64 file");
+				chunk_size = ds64_data_size;
+			}
+			info.data_offset = position + 8;
+			declared_size = chunk_size;
+			have_data = true;
+		}
+		// Chunks are padded to even sizes
+		position += 8 + chunk_size + (chunk_size & 1);
+	}
+	if (!have_fmt) throw std::runtime_error("Missing fmt chunk");
+	if (!have_data) throw std::runtime_error("Missing data chunk");
+
+	const uint64_t available = file_size > info.data_offset ? file_size - info.data_offset : 0;
+	info.data_size = declared_size;
+	if (declared_size > available) {
+		// Truncated file
+		info.data_size = available;
+		info.recovered = true;
+	} else if (info.data_offset + declared_size >= riff_end && available > declared_size) {
+		// Data chunk is the last one, but sizes weren't updated after the last write
+		info.data_size = available;
+		info.recovered = true;
+	}
+	info.data_size -= info.data_size % info.block_align;
+	return info;
+}
+
+/*
+ * Conversion kernels. All of them convert @em count values from @em src to @em dst.
+ */
+void convert_uint8(const uint8_t* src, int16_t* dst, size_t count)
+{
+	size_t i = 0;
+#ifdef IIMAVLIB_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+	for (; i + 16 <= count; i += 16) {
+		// x ^ 0x80 converts offset binary to signed, unpacking to the upper byte multiplies by 256
+		const __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), sign);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(zero, v));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(zero, v));
+	}
+#endif
+	for (; i < count; ++i) {
+		dst[i] = static_cast<int16_t>((static_cast<int>(src[i]) - 128) * 256);
+	}
+}
+
+#ifdef IIMAVLIB_SSE2
+/// Moves four 24bit values from the lower 12 bytes of @em v to the upper three bytes of 32bit lanes
+__m128i int24_lanes(__m128i v)
+{
+	// Value k starts at byte 3k, so lane k (byte 4k) is taken from @em v shifted by k + 1 bytes
+	const __m128i lane0 = _mm_setr_epi32(-1, 0, 0, 0);
+	const __m128i lane1 = _mm_setr_epi32(0, -1, 0, 0);
+	const __m128i lane2 = _mm_setr_epi32(0, 0, -1, 0);
+	const __m128i lane3 = _mm_setr_epi32(0, 0, 0, -1);
+	return _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_si128(v, 1), lane0), _mm_and_si128(_mm_slli_si128(v, 2), lane1)),
+			_mm_or_si128(_mm_and_si128(_mm_slli_si128(v, 3), lane2), _mm_and_si128(_mm_slli_si128(v, 4), lane3)));
+}
+#endif
+
+void convert_int24(const uint8_t* src, int16_t* dst, size_t count)
+{
+	size_t i = 0;
+#ifdef IIMAVLIB_SSE2
+	// There's no byte shuffle in SSE2, so the values are moved to their lanes by whole register shifts.
+	// The second load starts 8 bytes in, so it doesn't read past the 24 bytes of the 8 values.
+	for (; i + 8 <= count; i += 8) {
+		const __m128i a = int24_lanes(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i)));
+		const __m128i b = int24_lanes(_mm_srli_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i + 8)), 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16)));
+	}
+#endif
+	// Upper two bytes of a 24bit value are the 16bit value
+	for (; i < count; ++i) {
+		dst[i] = static_cast<int16_t>(src[3 * i + 1] | (src[3 * i + 2] << 8));
+	}
+}
+
+void convert_int32(const uint8_t* src, int16_t* dst, size_t count)
+{
+	size_t i = 0;
+#ifdef IIMAVLIB_SSE2
+	for (; i + 8 <= count; i += 8) {
+		const __m128i a = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i)), 16);
+		const __m128i b = _mm_srai_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i + 16)), 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+	}
+#endif
+	for (; i < count; ++i) {
+		int32_t v;
+		std::memcpy(&v, src + 4 * i, sizeof(v));
+		dst[i] = static_cast<int16_t>(v >> 16);
+	}
+}
+
+void convert_float32(const uint8_t* src, int16_t* dst, size_t count)
+{
+	const float scale = 32767.0f;
+	size_t i = 0;
+#ifdef IIMAVLIB_SSE2
+	const __m128 vscale = _mm_set1_ps(scale);
+	const __m128 low = _mm_set1_ps(-32768.0f);
+	const __m128 high = _mm_set1_ps(32767.0f);
+	// Clamped like the scalar code before the conversion, which would turn infinities to -32768.
+	// _mm_min_ps returns its second operand for NaN, so NaN gives 32767 as std::min does.
+	auto convert = [&](const uint8_t* p) {
+		const __m128 v = _mm_mul_ps(_mm_loadu_ps(reinterpret_cast<const float*>(p)), vscale);
+		return _mm_cvtps_epi32(_mm_max_ps(_mm_min_ps(v, high), low));
+	};
+	for (; i + 8 <= count; i += 8) {
+		// Conversion rounds to nearest
+		const __m128i a = convert(src + 4 * i);
+		const __m128i b = convert(src + 4 * i + 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+	}
+#endif
+	for (; i < count; ++i) {
+		float v;
+		std::memcpy(&v, src + 4 * i, sizeof(v));
+		v = std::max(-32768.0f, std::min(32767.0f, v * scale));
+		dst[i] = static_cast<int16_t>(std::lrint(v));
+	}
+}
+
+void expand_mono(const int16_t* src, int16_t* dst, size_t frames)
+{
+	size_t i = 0;
+#ifdef IIMAVLIB_SSE2
+	for (; i + 8 <= frames; i += 8) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), _mm_unpacklo_epi16(v, v));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i + 8), _mm_unpackhi_epi16(v, v));
+	}
+#endif
+	for (; i < frames; ++i) {
+		dst[2 * i] = dst[2 * i + 1] = src[i];
+	}
+}
+
+}
+
+size_t pcm_format_size(pcm_format_t format)
+{
+	switch (format) {
+		case pcm_format_t::uint8: return 1;
+		case pcm_format_t::int16: return 2;
+		case pcm_format_t::int24: return 3;
+		case pcm_format_t::int32: return 4;
+		case pcm_format_t::float32: return 4;
+		default: break;
+	}
+	return 0;
+}
+
+wav_info_t parse_wav_header(std::istream& stream, uint64_t file_size)
+{
+	stream_reader_t reader(stream);
+	return parse_chunks(reader, file_size);
+}
+
+wav_info_t parse_wav_header(const uint8_t* data, uint64_t size)
+{
+	memory_reader_t reader(data, size);
+	return parse_chunks(reader, size);
+}
+
+void convert_pcm_to_int16(const uint8_t* src, pcm_format_t format, int16_t* dst, size_t count)
+{
+	switch (format) {
+		case pcm_format_t::uint8: convert_uint8(src, dst, count); break;
+		case pcm_format_t::int16: std::memcpy(dst, src, count * sizeof(int16_t)); break;
+		case pcm_format_t::int24: convert_int24(src, dst, count); break;
+		case pcm_format_t::int32: convert_int32(src, dst, count); break;
+		case pcm_format_t::float32: convert_float32(src, dst, count); break;
+		default: throw std::runtime_error("Unsupported sample format");
+	}
+}
+
+void convert_pcm_to_samples(const uint8_t* src, const wav_info_t& info, audio_sample_t* dst, size_t frames)
+{
+	int16_t* out = reinterpret_cast<int16_t*>(dst);
+	const size_t value_size = pcm_format_size(info.format);
+	const bool packed = info.block_align == info.channels * value_size;
+	if (info.channels == 2 && packed) {
+		// Layout of stereo data matches audio_sample_t
+		convert_pcm_to_int16(src, info.format, out, frames * 2);
+		return;
+	}
+	// Other layouts are converted in blocks through a temporary buffer
+	int16_t scratch[4096];
+	const size_t block = std::max<size_t>(1, sizeof(scratch) / sizeof(int16_t) / info.channels);
+	while (frames) {
+		const size_t count = std::min(frames, block);
+		if (packed) {
+			convert_pcm_to_int16(src, info.format, scratch, count * info.channels);
+		} else {
+			for (size_t i = 0; i < count; ++i) {
+				convert_pcm_to_int16(src + i * info.block_align, info.format, scratch + i * info.channels, info.channels);
+			}
+		}
+		if (info.channels == 1) {
+			expand_mono(scratch, out, count);
+		} else {
+			for (size_t i = 0; i < count; ++i) {
+				out[2 * i] = scratch[i * info.channels];
+				out[2 * i + 1] = scratch[i * info.channels + 1];
+			}
+		}
+		src += count * info.block_align;
+		out += count * 2;
+		frames -= count;
+	}
+}
+
+}
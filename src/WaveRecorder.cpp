@@ -0,0 +1,105 @@
+/**
+ * @file 	WaveRecorder.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/WaveRecorder.h"
+#include "iimavlib/Utils.h"
+#include <chrono>
+
+namespace iimavlib {
+
+namespace {
+/// How long the writer sleeps when there are no data in the ring
+const std::chrono::milliseconds poll_interval(10);
+}
+
+WaveRecorder::WaveRecorder(const pAudioFilter& child, const std::string& filename,
+		double buffer_time, double preallocate_time)
+:AudioFilter(child),file_(filename,get_params()),
+ ring_(std::max<size_t>(static_cast<size_t>(buffer_time*convert_rate_to_int(file_.get_params().rate)), block_size)),
+ preallocate_size_(static_cast<uint64_t>(preallocate_time*convert_rate_to_int(file_.get_params().rate))*sizeof(audio_sample_t)),
+ running_(true),high_water_(0),dropped_blocks_(0),dropped_samples_(0),written_samples_(0),
+ write_failed_(false)
+{
+	// The writer thread already writes large blocks, so the file doesn't need bigger buffer
+	file_.set_buffer_size(block_size*sizeof(audio_sample_t));
+	if (preallocate_size_ && file_.preallocate(preallocate_size_) != error_type_t::ok) {
+		logger[log_level::debug] << "[WaveRecorder] Preallocation not supported for " << filename;
+		preallocate_size_ = 0;
+	}
+	thread_ = std::thread(&WaveRecorder::writer_thread, this);
+	logger[log_level::info] << "[WaveRecorder] Recording to " << filename << " with "
+			<< ring_.capacity() << " samples long buffer";
+}
+
+WaveRecorder::~WaveRecorder()
+{
+	stop();
+	const recorder_stats_t stats = get_stats();
+	logger[log_level::info] << "[WaveRecorder] Recorded " << stats.written_samples << " samples, buffer high-water mark "
+			<< stats.high_water << "/" << stats.ring_size << ", dropped " << stats.dropped_blocks << " blocks ("
+			<< stats.dropped_samples << " samples)";
+}
+
+void WaveRecorder::stop()
+{
+	running_ = false;
+	if (thread_.joinable()) thread_.join();
+	file_.flush();
+}
+
+recorder_stats_t WaveRecorder::get_stats() const
+{
+	recorder_stats_t stats;
+	stats.ring_size = ring_.capacity();
+	stats.high_water = high_water_;
+	stats.dropped_blocks = dropped_blocks_;
+	stats.dropped_samples = dropped_samples_;
+	stats.written_samples = written_samples_;
+	stats.write_failed = write_failed_;
+	return stats;
+}
+
+error_type_t WaveRecorder::do_process(audio_buffer_t& buffer)
+{
+	if (!buffer.valid_samples) return error_type_t::ok;
+	if (!ring_.push(&buffer.data[0], buffer.valid_samples)) {
+		dropped_blocks_.fetch_add(1, std::memory_order_relaxed);
+		dropped_samples_.fetch_add(buffer.valid_samples, std::memory_order_relaxed);
+		return error_type_t::ok;
+	}
+	// The high-water mark is updated only from this thread, so no CAS loop is needed
+	const size_t used = ring_.size();
+	if (used > high_water_.load(std::memory_order_relaxed)) high_water_.store(used, std::memory_order_relaxed);
+	return error_type_t::ok;
+}
+
+void WaveRecorder::writer_thread()
+{
+	std::vector<audio_sample_t> block(block_size);
+	uint64_t reserved = preallocate_size_;
+	uint64_t written_bytes = 0;
+	while (true) {
+		// Read the flag before emptying the ring, so no samples are left behind when stopping
+		const bool running = running_;
+		const size_t count = ring_.pop(&block[0], block_size);
+		if (count) {
+			if (file_.store_data(block, count) != error_type_t::ok) write_failed_ = true;
+			written_samples_.fetch_add(count, std::memory_order_relaxed);
+			written_bytes += count * sizeof(audio_sample_t);
+			// Extend the reserved space well before the writes reach its end
+			if (preallocate_size_ && written_bytes + preallocate_size_ / 2 > reserved) {
+				reserved += preallocate_size_;
+				file_.preallocate(reserved);
+			}
+			continue;
+		}
+		if (!running) break;
+		std::this_thread::sleep_for(poll_interval);
+	}
+}
+
+}
@@ -12,7 +12,14 @@
 #include "iimavlib/Utils.h"
 namespace iimavlib {
 
-WaveSource::WaveSource(const std::string filename):AudioFilter(pAudioFilter()),file_(filename)
+WaveSource::WaveSource(const std::string filename):AudioFilter(pAudioFilter()),
+		file_(new WaveFile(filename)),position_(0)
+{
+
+}
+
+WaveSource::WaveSource(const std::string filename, access_hint_t hint):AudioFilter(pAudioFilter()),
+		mapped_file_(new MappedWaveFile(filename, hint)),position_(0)
 {
 
 }
@@ -21,18 +28,42 @@ WaveSource::~WaveSource()
 {
 
 }
+
+array_view_t<const audio_sample_t> WaveSource::get_view(size_t max_samples)
+{
+	if (!mapped_file_ || !mapped_file_->has_native_format()) return array_view_t<const audio_sample_t>();
+	auto view = mapped_file_->get_samples().subview(position_, max_samples);
+	position_ += view.size();
+	return view;
+}
+
+error_type_t WaveSource::seek(size_t position)
+{
+	if (!mapped_file_) return error_type_t::unsupported;
+	position_ = std::min(position, mapped_file_->get_sample_count());
+	return error_type_t::ok;
+}
+
 error_type_t WaveSource::do_process(audio_buffer_t& buffer)
 {
 //	logger[log_level::debug] << "[WaveSource] Processing buffer";
-	error_type_t ret = file_.read_data(buffer.data,buffer.valid_samples);
+	error_type_t ret = error_type_t::ok;
+	if (mapped_file_) {
+		if (buffer.valid_samples) {
+			buffer.valid_samples = mapped_file_->read_data(buffer.data, position_, buffer.valid_samples);
+			position_ += buffer.valid_samples;
+		}
+	} else {
+		ret = file_->read_data(buffer.data,buffer.valid_samples);
+	}
 	if (buffer.valid_samples==0) return error_type_t::failed;
 	return ret;
 }
 
 audio_params_t WaveSource::do_get_params() const {
-	return file_.get_params();
+	if (mapped_file_) return mapped_file_->get_params();
+	return file_->get_params();
 }
 
 }
 
-
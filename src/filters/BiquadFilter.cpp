@@ -0,0 +1,369 @@
+/**
+ * @file 	BiquadFilter.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/filters/BiquadFilter.h"
+#include "iimavlib/FFTKernels.h"
+#include "iimavlib/Utils.h"
+#include "iimavlib/filters/FilterKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace iimavlib {
+
+namespace {
+using filter_kernels::denormal_guard_t;
+using filter_kernels::to_sample;
+
+/// Number of coefficients of a section
+const size_t coefficient_count = 5;
+/// States smaller than this are flushed to zero after each block
+const float denormal_threshold = 1e-25f;
+
+typedef fft_kernels::float_ops_t vector_ops;
+
+/**
+ * Filters @em samples frames by a single section of @em V::width lanes.
+ * @param data First lane of the first frame, frames are @em stride values apart
+ * @param coefficients b0 of the first lane, following coefficients are @em stride values apart
+ * @param steps Changes of the coefficients per sample (in the same layout), used only when interpolating
+ * @param state Two state variables, @em stride values apart
+ */
+template<class V, bool interpolate>
+void filter_section(float* data, size_t stride, size_t samples, float* coefficients, const float* steps, float* state)
+{
+	typedef typename V::vector_t vector_t;
+	vector_t b0 = V::load(coefficients);
+	vector_t b1 = V::load(coefficients + stride);
+	vector_t b2 = V::load(coefficients + 2 * stride);
+	vector_t a1 = V::load(coefficients + 3 * stride);
+	vector_t a2 = V::load(coefficients + 4 * stride);
+	vector_t z1 = V::load(state);
+	vector_t z2 = V::load(state + stride);
+	vector_t d0 = b0, d1 = b1, d2 = b2, d3 = a1, d4 = a2;
+	if (interpolate) {
+		d0 = V::load(steps);
+		d1 = V::load(steps + stride);
+		d2 = V::load(steps + 2 * stride);
+		d3 = V::load(steps + 3 * stride);
+		d4 = V::load(steps + 4 * stride);
+	}
+	for (size_t i = 0; i < samples; ++i, data += stride) {
+		if (interpolate) {
+			b0 = V::add(b0, d0);
+			b1 = V::add(b1, d1);
+			b2 = V::add(b2, d2);
+			a1 = V::add(a1, d3);
+			a2 = V::add(a2, d4);
+		}
+		const vector_t x = V::load(data);
+		const vector_t y = V::add(V::mul(b0, x), z1);
+		z1 = V::add(V::sub(V::mul(b1, x), V::mul(a1, y)), z2);
+		z2 = V::sub(V::mul(b2, x), V::mul(a2, y));
+		V::store(data, y);
+	}
+	V::store(state, z1);
+	V::store(state + stride, z2);
+}
+
+/**
+ * Filters @em samples frames of @em L lanes by a single section, for banks too narrow to fill a vector.
+ * The lanes are independent, so their computations overlap in the loop. Same layout as @em filter_section.
+ */
+template<size_t L, bool interpolate>
+void filter_lanes(float* data, size_t stride, size_t samples, float* coefficients, const float* steps, float* state)
+{
+	float c[coefficient_count][L], d[coefficient_count][L], z1[L], z2[L];
+	for (size_t lane = 0; lane < L; ++lane) {
+		for (size_t k = 0; k < coefficient_count; ++k) {
+			c[k][lane] = coefficients[k * stride + lane];
+			d[k][lane] = interpolate ? steps[k * stride + lane] : 0.0f;
+		}
+		z1[lane] = state[lane];
+		z2[lane] = state[stride + lane];
+	}
+	for (size_t i = 0; i < samples; ++i, data += stride) {
+		for (size_t lane = 0; lane < L; ++lane) {
+			if (interpolate) {
+				for (size_t k = 0; k < coefficient_count; ++k) c[k][lane] += d[k][lane];
+			}
+			const float x = data[lane];
+			const float y = c[0][lane] * x + z1[lane];
+			z1[lane] = c[1][lane] * x - c[3][lane] * y + z2[lane];
+			z2[lane] = c[2][lane] * x - c[4][lane] * y;
+			data[lane] = y;
+		}
+	}
+	for (size_t lane = 0; lane < L; ++lane) {
+		state[lane] = z1[lane];
+		state[stride + lane] = z2[lane];
+	}
+}
+
+template<bool interpolate>
+void filter_narrow(float* data, size_t lanes, size_t samples, float* coefficients, const float* steps, float* state)
+{
+	switch (lanes) {
+		case 2: filter_lanes<2, interpolate>(data, lanes, samples, coefficients, steps, state); break;
+		case 3: filter_lanes<3, interpolate>(data, lanes, samples, coefficients, steps, state); break;
+		case 4: filter_lanes<4, interpolate>(data, lanes, samples, coefficients, steps, state); break;
+		default:
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				filter_lanes<1, interpolate>(data + lane, lanes, samples, coefficients + lane, steps + lane, state + lane);
+			}
+	}
+}
+
+void check_params(const biquad_params_t& params)
+{
+	if (!(params.frequency > 0.0)) throw std::runtime_error("Biquad Error: frequency has to be positive");
+	if (!(params.q > 0.0)) throw std::runtime_error("Biquad Error: q has to be positive");
+}
+}
+
+biquad_coefficients_t biquad_coefficients_t::design(const biquad_params_t& params, double sampling_rate)
+{
+	check_params(params);
+	const double pi = 4.0 * std::atan(1.0);
+	const double frequency = std::min(params.frequency, 0.499 * sampling_rate);
+	const double w0 = 2.0 * pi * frequency / sampling_rate;
+	const double cos_w0 = std::cos(w0);
+	const double alpha = std::sin(w0) / (2.0 * params.q);
+	const double A = std::pow(10.0, params.gain_db / 40.0);
+	const double shelf = 2.0 * std::sqrt(A) * alpha;
+
+	double b0 = 1.0, b1 = 0.0, b2 = 0.0, a0 = 1.0, a1 = 0.0, a2 = 0.0;
+	switch (params.type) {
+		case biquad_type_t::lowpass:
+			b0 = b2 = (1.0 - cos_w0) / 2.0;
+			b1 = 1.0 - cos_w0;
+			a0 = 1.0 + alpha; a1 = -2.0 * cos_w0; a2 = 1.0 - alpha;
+			break;
+		case biquad_type_t::highpass:
+			b0 = b2 = (1.0 + cos_w0) / 2.0;
+			b1 = -(1.0 + cos_w0);
+			a0 = 1.0 + alpha; a1 = -2.0 * cos_w0; a2 = 1.0 - alpha;
+			break;
+		case biquad_type_t::bandpass:
+			b0 = alpha; b1 = 0.0; b2 = -alpha;
+			a0 = 1.0 + alpha; a1 = -2.0 * cos_w0; a2 = 1.0 - alpha;
+			break;
+		case biquad_type_t::notch:
+			b0 = b2 = 1.0;
+			b1 = -2.0 * cos_w0;
+			a0 = 1.0 + alpha; a1 = -2.0 * cos_w0; a2 = 1.0 - alpha;
+			break;
+		case biquad_type_t::peaking:
+			b0 = 1.0 + alpha * A; b1 = -2.0 * cos_w0; b2 = 1.0 - alpha * A;
+			a0 = 1.0 + alpha / A; a1 = -2.0 * cos_w0; a2 = 1.0 - alpha / A;
+			break;
+		case biquad_type_t::low_shelf:
+			b0 = A * ((A + 1.0) - (A - 1.0) * cos_w0 + shelf);
+			b1 = 2.0 * A * ((A - 1.0) - (A + 1.0) * cos_w0);
+			b2 = A * ((A + 1.0) - (A - 1.0) * cos_w0 - shelf);
+			a0 = (A + 1.0) + (A - 1.0) * cos_w0 + shelf;
+			a1 = -2.0 * ((A - 1.0) + (A + 1.0) * cos_w0);
+			a2 = (A + 1.0) + (A - 1.0) * cos_w0 - shelf;
+			break;
+		case biquad_type_t::high_shelf:
+			b0 = A * ((A + 1.0) + (A - 1.0) * cos_w0 + shelf);
+			b1 = -2.0 * A * ((A - 1.0) + (A + 1.0) * cos_w0);
+			b2 = A * ((A + 1.0) + (A - 1.0) * cos_w0 - shelf);
+			a0 = (A + 1.0) - (A - 1.0) * cos_w0 + shelf;
+			a1 = 2.0 * ((A - 1.0) - (A + 1.0) * cos_w0);
+			a2 = (A + 1.0) - (A - 1.0) * cos_w0 - shelf;
+			break;
+	}
+	biquad_coefficients_t result;
+	result.b0 = static_cast<float>(b0 / a0);
+	result.b1 = static_cast<float>(b1 / a0);
+	result.b2 = static_cast<float>(b2 / a0);
+	result.a1 = static_cast<float>(a1 / a0);
+	result.a2 = static_cast<float>(a2 / a0);
+	return result;
+}
+
+BiquadBank::BiquadBank(size_t lanes, size_t sections):
+	lanes_(lanes),sections_(sections),
+	padded_(lanes < vector_ops::width ? lanes : (lanes + vector_ops::width - 1) / vector_ops::width * vector_ops::width),
+	coefficients_(sections * coefficient_count * padded_, 0.0f),targets_(coefficients_.size()),
+	steps_(coefficients_.size()),state_(sections * 2 * padded_, 0.0f),interpolate_(false),started_(false)
+{
+	if (!lanes || !sections) throw std::runtime_error("Biquad Error: the bank needs at least one lane and one section");
+	// All the sections pass the signal unchanged (b0 = 1)
+	for (size_t section = 0; section < sections; ++section) {
+		std::fill_n(coefficients_.begin() + section * coefficient_count * padded_, padded_, 1.0f);
+	}
+	targets_ = coefficients_;
+}
+
+void BiquadBank::set(size_t lane, size_t section, const biquad_coefficients_t& coefficients)
+{
+	if (lane >= lanes_ || section >= sections_) throw std::runtime_error("Biquad Error: wrong lane or section");
+	float* target = &targets_[section * coefficient_count * padded_ + lane];
+	target[0] = coefficients.b0;
+	target[padded_] = coefficients.b1;
+	target[2 * padded_] = coefficients.b2;
+	target[3 * padded_] = coefficients.a1;
+	target[4 * padded_] = coefficients.a2;
+	if (started_) {
+		interpolate_ = true;
+	} else {
+		coefficients_ = targets_;
+	}
+}
+
+void BiquadBank::reset()
+{
+	std::fill(state_.begin(), state_.end(), 0.0f);
+	coefficients_ = targets_;
+	interpolate_ = false;
+	started_ = false;
+}
+
+void BiquadBank::process(float* data, size_t samples)
+{
+	if (!samples) return;
+	if (lanes_ == padded_) {
+		run(data, samples);
+		return;
+	}
+	scratch_.resize(samples * padded_);
+	for (size_t i = 0; i < samples; ++i) {
+		std::copy_n(data + i * lanes_, lanes_, &scratch_[i * padded_]);
+	}
+	run(scratch_.data(), samples);
+	for (size_t i = 0; i < samples; ++i) {
+		std::copy_n(&scratch_[i * padded_], lanes_, data + i * lanes_);
+	}
+}
+
+void BiquadBank::process(const float* input, float* output, size_t samples)
+{
+	if (!samples) return;
+	float* data = output;
+	if (lanes_ != padded_) {
+		scratch_.resize(samples * padded_);
+		data = scratch_.data();
+	}
+	for (size_t i = 0; i < samples; ++i) {
+		std::fill_n(data + i * padded_, padded_, input[i]);
+	}
+	run(data, samples);
+	if (data == output) return;
+	for (size_t i = 0; i < samples; ++i) {
+		std::copy_n(&scratch_[i * padded_], lanes_, output + i * lanes_);
+	}
+}
+
+void BiquadBank::run(float* data, size_t samples)
+{
+	denormal_guard_t guard;
+	started_ = true;
+	if (interpolate_) {
+		const float scale = 1.0f / samples;
+		for (size_t i = 0; i < steps_.size(); ++i) steps_[i] = (targets_[i] - coefficients_[i]) * scale;
+	}
+	for (size_t section = 0; section < sections_; ++section) {
+		float* coefficients = &coefficients_[section * coefficient_count * padded_];
+		const float* steps = &steps_[section * coefficient_count * padded_];
+		float* state = &state_[section * 2 * padded_];
+		if (padded_ < vector_ops::width) {
+			// Too few lanes to fill a vector (e.g. stereo), padding them would waste most of the vector
+			if (interpolate_) {
+				filter_narrow<true>(data, padded_, samples, coefficients, steps, state);
+			} else {
+				filter_narrow<false>(data, padded_, samples, coefficients, steps, state);
+			}
+			continue;
+		}
+		for (size_t lane = 0; lane < padded_; lane += vector_ops::width) {
+			if (interpolate_) {
+				filter_section<vector_ops, true>(data + lane, padded_, samples, coefficients + lane, steps + lane, state + lane);
+			} else {
+				filter_section<vector_ops, false>(data + lane, padded_, samples, coefficients + lane, steps + lane, state + lane);
+			}
+		}
+	}
+	if (interpolate_) {
+		coefficients_ = targets_;
+		interpolate_ = false;
+	}
+	// Decaying states would reach denormal numbers without the flush-to-zero mode
+	for (auto& value: state_) {
+		if (std::abs(value) < denormal_threshold) value = 0.0f;
+	}
+}
+
+BiquadFilter::BiquadFilter(const pAudioFilter& child, const std::vector<biquad_params_t>& sections):
+	AudioFilter(child),bank_(2, std::max<size_t>(1, sections.size())),sections_(sections),changed_(true),
+	current_(sections),rate_(0.0)
+{
+	if (sections.empty()) throw std::runtime_error("Biquad Error: the filter needs at least one section");
+	for (const auto& params: sections) check_params(params);
+}
+
+BiquadFilter::~BiquadFilter()
+{
+}
+
+void BiquadFilter::set_section(size_t index, const biquad_params_t& params)
+{
+	check_params(params);
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (index >= sections_.size()) throw std::runtime_error("Biquad Error: wrong section index");
+	sections_[index] = params;
+	changed_ = true;
+}
+
+std::vector<biquad_params_t> BiquadFilter::get_sections() const
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	return sections_;
+}
+
+error_type_t BiquadFilter::do_process(audio_buffer_t& buffer)
+{
+	if (buffer.valid_samples == 0) return error_type_t::ok;
+	const double rate = convert_rate_to_int(buffer.params.rate);
+	if (rate != rate_) {
+		// Coefficients for the previous rate are useless, so the new ones are used immediately
+		bank_.reset();
+		rate_ = rate;
+		changed_ = true;
+	}
+	if (changed_.exchange(false)) {
+		// The audio thread doesn't wait for set_section, the change is picked up in a following buffer instead
+		std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+		if (lock.owns_lock()) {
+			std::copy(sections_.begin(), sections_.end(), current_.begin());
+			lock.unlock();
+		} else {
+			changed_ = true;
+		}
+		for (size_t section = 0; section < current_.size(); ++section) {
+			const auto coefficients = biquad_coefficients_t::design(current_[section], rate_);
+			bank_.set(0, section, coefficients);
+			bank_.set(1, section, coefficients);
+		}
+	}
+
+	const size_t count = buffer.valid_samples;
+	samples_.resize(2 * count);
+	for (size_t i = 0; i < count; ++i) {
+		samples_[2 * i] = buffer.data[i].left;
+		samples_[2 * i + 1] = buffer.data[i].right;
+	}
+	bank_.process(samples_.data(), count);
+	for (size_t i = 0; i < count; ++i) {
+		buffer.data[i].left = to_sample(samples_[2 * i]);
+		buffer.data[i].right = to_sample(samples_[2 * i + 1]);
+	}
+	return error_type_t::ok;
+}
+
+}
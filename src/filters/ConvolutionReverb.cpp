@@ -0,0 +1,312 @@
+/**
+ * @file 	ConvolutionReverb.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/filters/ConvolutionReverb.h"
+#include "iimavlib/SampleBank.h"
+#include "iimavlib/Utils.h"
+#include "iimavlib/filters/FilterKernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#ifdef IIMAVLIB_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace iimavlib {
+
+namespace {
+using filter_kernels::to_sample;
+
+bool is_power_of_2(size_t value)
+{
+	return value && !(value & (value - 1));
+}
+
+size_t next_power_of_2(size_t value)
+{
+	size_t result = 1;
+	while (result < value) result <<= 1;
+	return result;
+}
+
+/**
+ * Multiplies two spectra and adds the result to @em acc.
+ * All spectra have real parts of @em bins values followed by imaginary parts.
+ */
+void multiply_accumulate(float* acc, const float* x, const float* h, size_t bins)
+{
+	float* acc_im = acc + bins;
+	const float* x_im = x + bins;
+	const float* h_im = h + bins;
+	size_t k = 0;
+#ifdef IIMAVLIB_SSE2
+	for (; k + 4 <= bins; k += 4) {
+		const __m128 xr = _mm_loadu_ps(x + k);
+		const __m128 xi = _mm_loadu_ps(x_im + k);
+		const __m128 hr = _mm_loadu_ps(h + k);
+		const __m128 hi = _mm_loadu_ps(h_im + k);
+		_mm_storeu_ps(acc + k, _mm_add_ps(_mm_loadu_ps(acc + k), _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi))));
+		_mm_storeu_ps(acc_im + k, _mm_add_ps(_mm_loadu_ps(acc_im + k), _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr))));
+	}
+#endif
+	for (; k < bins; ++k) {
+		acc[k] += x[k] * h[k] - x_im[k] * h_im[k];
+		acc_im[k] += x[k] * h_im[k] + x_im[k] * h[k];
+	}
+}
+
+}
+
+ConvolutionReverb::stage_t::stage_t(size_t size, size_t offset, size_t count, size_t block_size):
+	size(size),offset(offset),count(count),period(size / block_size),
+	partitions_per_block((count - 1 + period - 1) / period),plan(2 * size),
+	filters(2 * count * 2 * (size + 1), 0.0f),inputs(filters.size(), 0.0f),head(0),
+	accumulator(2 * 2 * (size + 1), 0.0f),next_partition(1),time(2 * size),spectrum(size + 1)
+{
+}
+
+ConvolutionReverb::ConvolutionReverb(const pAudioFilter& child, const std::string& filename, double wet, double dry,
+		size_t block_size, size_t max_partition)
+:AudioFilter(child),wet_(wet),dry_(dry),block_size_(block_size),position_(0),time_(0),
+ blocks_(0),total_time_(0),peak_time_(0),rate_(0)
+{
+	SampleReader reader(filename);
+	std::vector<audio_sample_t> samples(static_cast<size_t>(reader.get_sample_count()));
+	size_t read = 0;
+	std::vector<audio_sample_t> chunk(65536);
+	while (size_t count = reader.read_data(chunk)) {
+		std::copy_n(chunk.begin(), std::min(count, samples.size() - read), samples.begin() + read);
+		read += count;
+		if (read >= samples.size()) break;
+	}
+	std::vector<float> left(samples.size()), right(samples.size());
+	for (size_t i = 0; i < samples.size(); ++i) {
+		left[i] = samples[i].left / 32768.0f;
+		right[i] = samples[i].right / 32768.0f;
+	}
+	if (reader.get_params().rate != get_params().rate) {
+		logger[log_level::info] << "[ConvolutionReverb] Sampling rate of " << filename << " differs from the input, the reverb will be "
+				<< (convert_rate_to_int(reader.get_params().rate) < convert_rate_to_int(get_params().rate) ? "shorter" : "longer");
+	}
+	init(left, right, max_partition);
+	logger[log_level::debug] << "[ConvolutionReverb] Loaded " << samples.size() << " samples long impulse response from " << filename
+			<< " (" << stages_.size() << " partition sizes)";
+}
+
+ConvolutionReverb::ConvolutionReverb(const pAudioFilter& child, const std::vector<float>& left, const std::vector<float>& right,
+		double wet, double dry, size_t block_size, size_t max_partition)
+:AudioFilter(child),wet_(wet),dry_(dry),block_size_(block_size),position_(0),time_(0),
+ blocks_(0),total_time_(0),peak_time_(0),rate_(0)
+{
+	init(left, right, max_partition);
+}
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+
+}
+
+void ConvolutionReverb::init(const std::vector<float>& left, const std::vector<float>& right, size_t max_partition)
+{
+	if (!is_power_of_2(block_size_) || !is_power_of_2(max_partition) || max_partition < block_size_) {
+		throw std::runtime_error("Partition sizes of convolution have to be powers of 2");
+	}
+	const size_t length = std::max(left.size(), right.size());
+	if (!length) throw std::runtime_error("Empty impulse response");
+
+	const std::vector<float>* ir[2] = {&left, &right};
+	double energy = 0.0;
+	for (const auto channel: ir) {
+		double sum = 0.0;
+		for (const auto value: *channel) sum += static_cast<double>(value) * value;
+		energy = std::max(energy, sum);
+	}
+	const float scale = energy > 0.0 ? static_cast<float>(1.0 / std::sqrt(energy)) : 0.0f;
+
+	/*
+	 * The stage with partitions of size S gets the input when S samples are collected,
+	 * so it can produce output for positions of the impulse response from S - block_size on.
+	 * Each stage has enough partitions to cover the response until the next stage can start.
+	 */
+	size_t offset = 0;
+	size_t size = block_size_;
+	size_t max_size = block_size_;
+	while (offset < length) {
+		size_t count = (length - offset + size - 1) / size;
+		size_t next = size;
+		if (size < max_partition) {
+			next = std::min(size * 4, max_partition);
+			count = std::min(count, std::max<size_t>(1, (next - block_size_ - offset + size - 1) / size));
+		}
+		stages_.emplace_back(new stage_t(size, offset, count, block_size_));
+		offset += count * size;
+		max_size = size;
+		size = next;
+	}
+
+	for (auto& stage: stages_) {
+		const size_t bins = stage->size + 1;
+		for (size_t channel = 0; channel < 2; ++channel) {
+			const std::vector<float>& response = *ir[channel];
+			for (size_t p = 0; p < stage->count; ++p) {
+				const size_t first = stage->offset + p * stage->size;
+				for (size_t i = 0; i < 2 * stage->size; ++i) {
+					const size_t index = first + i;
+					stage->time[i] = (i < stage->size && index < response.size()) ? response[index] * scale : 0.0f;
+				}
+				stage->plan.transform(stage->time.data(), stage->spectrum.data());
+				float* filter = &stage->filters[(channel * stage->count + p) * 2 * bins];
+				for (size_t k = 0; k < bins; ++k) {
+					filter[k] = stage->spectrum[k].real();
+					filter[bins + k] = stage->spectrum[k].imag();
+				}
+			}
+		}
+	}
+
+	size_t output_size = 0;
+	for (const auto& stage: stages_) output_size = std::max(output_size, stage->offset + stage->size + block_size_);
+	for (size_t channel = 0; channel < 2; ++channel) {
+		input_block_[channel].assign(block_size_, 0.0f);
+		output_block_[channel].assign(block_size_, 0.0f);
+		history_[channel].assign(next_power_of_2(2 * max_size), 0.0f);
+		output_[channel].assign(next_power_of_2(output_size), 0.0f);
+	}
+}
+
+convolution_stats_t ConvolutionReverb::get_stats() const
+{
+	convolution_stats_t stats;
+	stats.latency = block_size_;
+	stats.stages = stages_.size();
+	stats.partitions = 0;
+	stats.max_partition = 0;
+	for (const auto& stage: stages_) {
+		stats.partitions += stage->count;
+		stats.max_partition = std::max(stats.max_partition, stage->size);
+	}
+	stats.blocks = blocks_.load(std::memory_order_relaxed);
+	const uint32_t rate = rate_.load(std::memory_order_relaxed);
+	const double block_time = rate ? 1e9 * block_size_ / rate : 0.0;
+	stats.average_load = (stats.blocks && rate) ? total_time_.load(std::memory_order_relaxed) / block_time / stats.blocks : 0.0;
+	stats.peak_load = rate ? peak_time_.load(std::memory_order_relaxed) / block_time : 0.0;
+	return stats;
+}
+
+error_type_t ConvolutionReverb::do_process(audio_buffer_t& buffer)
+{
+	if (buffer.valid_samples == 0) return error_type_t::ok;
+	rate_.store(convert_rate_to_int(buffer.params.rate), std::memory_order_relaxed);
+
+	const float wet = static_cast<float>(wet_);
+	const float dry = static_cast<float>(dry_);
+	for (size_t i = 0; i < buffer.valid_samples; ++i) {
+		audio_sample_t& sample = buffer.data[i];
+		input_block_[0][position_] = sample.left;
+		input_block_[1][position_] = sample.right;
+		sample.left = to_sample(dry * sample.left + wet * output_block_[0][position_]);
+		sample.right = to_sample(dry * sample.right + wet * output_block_[1][position_]);
+		if (++position_ == block_size_) {
+			process_block();
+			position_ = 0;
+		}
+	}
+	return error_type_t::ok;
+}
+
+void ConvolutionReverb::process_block()
+{
+	const auto start = std::chrono::steady_clock::now();
+	const size_t history_mask = history_[0].size() - 1;
+	for (size_t channel = 0; channel < 2; ++channel) {
+		for (size_t i = 0; i < block_size_; ++i) {
+			history_[channel][(time_ + i) & history_mask] = input_block_[channel][i];
+		}
+	}
+	time_ += block_size_;
+
+	for (auto& stage_ptr: stages_) {
+		stage_t& stage = *stage_ptr;
+		if (time_ % stage.size == 0) transform(stage);
+		// Older partitions for the next transform are processed a few at a time
+		if (stage.next_partition < stage.count) {
+			const size_t last = std::min(stage.count, stage.next_partition + stage.partitions_per_block);
+			accumulate(stage, stage.next_partition, last);
+			stage.next_partition = last;
+		}
+	}
+
+	const size_t output_mask = output_[0].size() - 1;
+	for (size_t channel = 0; channel < 2; ++channel) {
+		for (size_t i = 0; i < block_size_; ++i) {
+			float& value = output_[channel][(time_ - block_size_ + i) & output_mask];
+			output_block_[channel][i] = value;
+			value = 0.0f;
+		}
+	}
+
+	const uint64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	total_time_.fetch_add(duration, std::memory_order_relaxed);
+	if (duration > peak_time_.load(std::memory_order_relaxed)) peak_time_.store(duration, std::memory_order_relaxed);
+	blocks_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ConvolutionReverb::accumulate(stage_t& stage, size_t first, size_t last)
+{
+	const size_t stride = 2 * (stage.size + 1);
+	for (size_t p = first; p < last; ++p) {
+		// Partition p is multiplied with the input p transforms older than the next one
+		const size_t slot = (stage.head + 1 + stage.count - p) % stage.count;
+		for (size_t channel = 0; channel < 2; ++channel) {
+			multiply_accumulate(&stage.accumulator[channel * stride],
+					&stage.inputs[(channel * stage.count + slot) * stride],
+					&stage.filters[(channel * stage.count + p) * stride], stage.size + 1);
+		}
+	}
+}
+
+void ConvolutionReverb::transform(stage_t& stage)
+{
+	accumulate(stage, stage.next_partition, stage.count);
+	stage.head = (stage.head + 1) % stage.count;
+
+	const size_t size = stage.size;
+	const size_t bins = size + 1;
+	const size_t stride = 2 * bins;
+	const size_t history_mask = history_[0].size() - 1;
+	const size_t output_mask = output_[0].size() - 1;
+	for (size_t channel = 0; channel < 2; ++channel) {
+		// Overlap-save, the transform covers the new input and the previous one
+		for (size_t i = 0; i < 2 * size; ++i) {
+			stage.time[i] = history_[channel][(time_ - 2 * size + i) & history_mask];
+		}
+		stage.plan.transform(stage.time.data(), stage.spectrum.data());
+		float* input = &stage.inputs[(channel * stage.count + stage.head) * stride];
+		for (size_t k = 0; k < bins; ++k) {
+			input[k] = stage.spectrum[k].real();
+			input[bins + k] = stage.spectrum[k].imag();
+		}
+		float* acc = &stage.accumulator[channel * stride];
+		multiply_accumulate(acc, input, &stage.filters[channel * stage.count * stride], bins);
+		for (size_t k = 0; k < bins; ++k) {
+			stage.spectrum[k] = std::complex<float>(acc[k], acc[bins + k]);
+		}
+		stage.plan.inverse(stage.spectrum.data(), stage.time.data());
+		// Only the second half is free of circular aliasing
+		const uint64_t first = time_ - size + stage.offset;
+		std::vector<float>& output = output_[channel];
+		for (size_t i = 0; i < size; ++i) {
+			output[(first + i) & output_mask] += stage.time[size + i];
+		}
+		std::fill(acc, acc + stride, 0.0f);
+	}
+	stage.next_partition = 1;
+}
+
+}
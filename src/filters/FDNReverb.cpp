@@ -0,0 +1,298 @@
+/**
+ * @file 	FDNReverb.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/filters/FDNReverb.h"
+#include "iimavlib/FFTKernels.h"
+#include "iimavlib/Utils.h"
+#include "iimavlib/filters/FilterKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace iimavlib {
+
+namespace {
+using filter_kernels::denormal_guard_t;
+using filter_kernels::to_sample;
+
+/// Lengths of the delay lines (for size 1.0) in seconds
+const double shortest_delay = 0.030;
+const double longest_delay = 0.090;
+
+typedef fft_kernels::float_ops_t vector_ops;
+
+bool is_prime(size_t value)
+{
+	if (value < 2) return false;
+	for (size_t divisor = 2; divisor * divisor <= value; ++divisor) {
+		if (value % divisor == 0) return false;
+	}
+	return true;
+}
+
+/// Sum of the values in a vector
+float horizontal_sum(vector_ops::vector_t v)
+{
+	float values[vector_ops::width];
+	vector_ops::store(values, v);
+	float sum = 0.0f;
+	for (size_t i = 0; i < vector_ops::width; ++i) sum += values[i];
+	return sum;
+}
+
+
+/**
+ * Multiplies @em values by symmetric @em lines x @em lines matrix, as a sum of the columns
+ * multiplied by the values, so there are no horizontal sums. The columns are the same as the rows.
+ * Even and odd columns are summed separately, so the additions don't wait for each other.
+ */
+template<class V, size_t lines>
+void matrix_product(const float* matrix, const float* values, float* output)
+{
+	typedef typename V::vector_t vector_t;
+	const size_t vectors = lines / V::width;
+	vector_t even[vectors], odd[vectors];
+	for (size_t k = 0; k < vectors; ++k) {
+		even[k] = V::set(0.0f);
+		odd[k] = V::set(0.0f);
+	}
+	for (size_t j = 0; j < lines; j += 2, matrix += 2 * lines) {
+		const vector_t value0 = V::set(values[j]);
+		const vector_t value1 = V::set(values[j + 1]);
+		for (size_t k = 0; k < vectors; ++k) {
+			even[k] = V::add(even[k], V::mul(V::load(matrix + k * V::width), value0));
+			odd[k] = V::add(odd[k], V::mul(V::load(matrix + lines + k * V::width), value1));
+		}
+	}
+	for (size_t k = 0; k < vectors; ++k) V::store(output + k * V::width, V::add(even[k], odd[k]));
+}
+}
+
+FDNReverb::FDNReverb(const pAudioFilter& child, const fdn_params_t& params):
+	AudioFilter(child),params_(params),rate_(0.0),reset_(false)
+{
+	if (params.lines != 8 && params.lines != 16) throw std::runtime_error("FDNReverb Error: number of lines has to be 8 or 16");
+	if (!(params.decay_time > 0.0)) throw std::runtime_error("FDNReverb Error: decay time has to be positive");
+	if (!(params.damping > 0.0 && params.damping <= 1.0)) throw std::runtime_error("FDNReverb Error: damping has to be in interval (0, 1>");
+	if (!(params.size > 0.0 && params.size <= 10.0)) throw std::runtime_error("FDNReverb Error: size has to be in interval (0, 10>");
+	if (!(params.modulation_depth >= 0.0) || !(params.modulation_rate >= 0.0)) {
+		throw std::runtime_error("FDNReverb Error: modulation can't be negative");
+	}
+
+	const size_t lines = params.lines;
+	for (auto vector: {&delays_, &depths_, &gains_, &poles_, &damping_state_, &input_left_, &input_right_,
+			&output_left_, &output_right_, &sines_, &cosines_, &sine_steps_, &cosine_steps_, &outputs_, &feedback_, &fractions_}) {
+		vector->assign(lines, 0.0f);
+	}
+	taps_.assign(4 * lines, 0.0f);
+	lines_.resize(lines);
+
+	// Left channel feeds and reads the even lines, right the odd ones. The alternating signs decorrelate the outputs.
+	const float input_gain = 1.0f / std::sqrt(lines / 2.0f);
+	for (size_t i = 0; i < lines; ++i) {
+		const float sign = (i / 2) % 2 ? -1.0f : 1.0f;
+		(i % 2 ? input_right_ : input_left_)[i] = input_gain * sign;
+		(i % 2 ? output_right_ : output_left_)[i] = sign;
+	}
+
+	if (params.matrix == fdn_matrix_t::hadamard) {
+		// Sylvester construction, element (i, j) is -1 when i & j has odd number of bits
+		matrix_.resize(lines * lines);
+		const float scale = 1.0f / std::sqrt(static_cast<float>(lines));
+		for (size_t i = 0; i < lines; ++i) {
+			for (size_t j = 0; j < lines; ++j) {
+				size_t bits = i & j;
+				bool odd = false;
+				for (; bits; bits &= bits - 1) odd = !odd;
+				matrix_[i * lines + j] = odd ? -scale : scale;
+			}
+		}
+	}
+}
+
+FDNReverb::~FDNReverb()
+{
+}
+
+void FDNReverb::reset()
+{
+	reset_.store(true);
+}
+
+void FDNReverb::configure(double rate)
+{
+	const size_t lines = params_.lines;
+	const double shortest = shortest_delay * params_.size * rate;
+	const double longest = longest_delay * params_.size * rate;
+	size_t previous = 0;
+	for (size_t i = 0; i < lines; ++i) {
+		// Exponentially distributed lengths, rounded up to distinct primes, so the echoes don't coincide
+		size_t length = static_cast<size_t>(shortest * std::pow(longest / shortest, i / (lines - 1.0)));
+		length = std::max(length, previous + 1);
+		while (!is_prime(length)) ++length;
+		previous = length;
+
+		// The interpolation reads one value before the modulated delay, which has to stay at least 1 for short lines
+		const double depth = std::min(params_.modulation_depth * rate / 1000.0, std::min(length / 4.0, std::max(0.0, length - 3.0)));
+		lines_[i].resize(length + static_cast<size_t>(std::ceil(depth)) + 4);
+		delays_[i] = static_cast<float>(length);
+		depths_[i] = static_cast<float>(depth);
+
+		// Attenuation by 60 dB per decay time, high frequencies by 60 dB per damping * decay time
+		const double gain = std::pow(10.0, -3.0 * length / (params_.decay_time * rate));
+		const double gain_high = std::pow(10.0, -3.0 * length / (params_.damping * params_.decay_time * rate));
+		const double ratio = gain_high / gain;
+		const double pole = (1.0 - ratio) / (1.0 + ratio);
+		gains_[i] = static_cast<float>(gain * (1.0 - pole));
+		poles_[i] = static_cast<float>(pole);
+
+		// Each line is modulated with different phase and slightly different frequency
+		const double pi2 = 8.0 * std::atan(1.0);
+		const double phase = pi2 * i / lines;
+		const double step = pi2 * params_.modulation_rate * (0.8 + 0.4 * i / (lines - 1.0)) / rate;
+		sines_[i] = static_cast<float>(std::sin(phase));
+		cosines_[i] = static_cast<float>(std::cos(phase));
+		sine_steps_[i] = static_cast<float>(std::sin(step));
+		cosine_steps_[i] = static_cast<float>(std::cos(step));
+	}
+	std::fill(damping_state_.begin(), damping_state_.end(), 0.0f);
+	rate_ = rate;
+}
+
+void FDNReverb::mix(const float* values, float* output)
+{
+	typedef vector_ops V;
+	const size_t lines = params_.lines;
+	const size_t width = V::width;
+	if (params_.matrix == fdn_matrix_t::hadamard) {
+		if (lines == 8) matrix_product<V, 8>(matrix_.data(), values, output);
+		else matrix_product<V, 16>(matrix_.data(), values, output);
+		return;
+	}
+	// Householder reflection, values - 2 / N * sum(values)
+	V::vector_t sum = V::set(0.0f);
+	for (size_t i = 0; i < lines; i += width) sum = V::add(sum, V::load(values + i));
+	const V::vector_t correction = V::set(-2.0f / lines * horizontal_sum(sum));
+	for (size_t i = 0; i < lines; i += width) V::store(output + i, V::add(V::load(values + i), correction));
+}
+
+error_type_t FDNReverb::do_process(audio_buffer_t& buffer)
+{
+	if (buffer.valid_samples == 0) return error_type_t::ok;
+	const double rate = convert_rate_to_int(buffer.params.rate);
+	const bool reset = reset_.exchange(false);
+	if (rate != rate_) {
+		configure(rate);
+	} else if (reset) {
+		for (auto& line: lines_) line.clear();
+		std::fill(damping_state_.begin(), damping_state_.end(), 0.0f);
+	}
+
+	typedef vector_ops V;
+	typedef V::vector_t vector_t;
+	const size_t lines = params_.lines;
+	const size_t width = V::width;
+	const bool modulated = params_.modulation_depth > 0.0;
+	const float wet = static_cast<float>(params_.wet);
+	const float dry = static_cast<float>(params_.dry);
+	float* outputs = outputs_.data();
+	float* feedback = feedback_.data();
+	float* fractions = fractions_.data();
+	float* taps = taps_.data();
+	// The vector stores may alias anything, so the pointers are kept in local variables instead of reloading them
+	float* sines = sines_.data();
+	float* cosines = cosines_.data();
+	float* state = damping_state_.data();
+	const float* sine_steps = sine_steps_.data();
+	const float* cosine_steps = cosine_steps_.data();
+	const float* delays = delays_.data();
+	const float* depths = depths_.data();
+	const float* gains = gains_.data();
+	const float* poles = poles_.data();
+	const float* input_left = input_left_.data();
+	const float* input_right = input_right_.data();
+	const float* output_left = output_left_.data();
+	const float* output_right = output_right_.data();
+	delay_line_t<float>* delay_lines = lines_.data();
+	denormal_guard_t guard;
+
+	for (size_t sample = 0; sample < buffer.valid_samples; ++sample) {
+		audio_sample_t& value = buffer.data[sample];
+		if (modulated) {
+			// Rotates the phases of the modulation and computes the modulated delays
+			for (size_t i = 0; i < lines; i += width) {
+				const vector_t s = V::load(sines + i);
+				const vector_t c = V::load(cosines + i);
+				const vector_t ds = V::load(sine_steps + i);
+				const vector_t dc = V::load(cosine_steps + i);
+				V::store(sines + i, V::add(V::mul(s, dc), V::mul(c, ds)));
+				V::store(cosines + i, V::sub(V::mul(c, dc), V::mul(s, ds)));
+				V::store(feedback + i, V::add(V::load(delays + i), V::mul(V::load(depths + i), s)));
+			}
+			// Four neighbouring values of each line, interpolated by cubic Hermite spline for all the lines at once
+			for (size_t i = 0; i < lines; ++i) {
+				const size_t whole = static_cast<size_t>(feedback[i]);
+				fractions[i] = feedback[i] - whole;
+				taps[i] = delay_lines[i].read(whole - 1);
+				taps[i + lines] = delay_lines[i].read(whole);
+				taps[i + 2 * lines] = delay_lines[i].read(whole + 1);
+				taps[i + 3 * lines] = delay_lines[i].read(whole + 2);
+			}
+			const vector_t half = V::set(0.5f);
+			for (size_t i = 0; i < lines; i += width) {
+				const vector_t t = V::load(fractions + i);
+				const vector_t y0 = V::load(taps + i);
+				const vector_t y1 = V::load(taps + lines + i);
+				const vector_t y2 = V::load(taps + 2 * lines + i);
+				const vector_t y3 = V::load(taps + 3 * lines + i);
+				const vector_t c1 = V::mul(V::sub(y2, y0), half);
+				const vector_t c2 = V::sub(V::add(y0, V::mul(y2, V::set(2.0f))), V::add(V::mul(y1, V::set(2.5f)), V::mul(y3, half)));
+				const vector_t c3 = V::add(V::mul(V::sub(y3, y0), half), V::mul(V::sub(y1, y2), V::set(1.5f)));
+				V::store(outputs + i, V::add(y1, V::mul(V::add(V::mul(V::add(V::mul(c3, t), c2), t), c1), t)));
+			}
+		} else {
+			for (size_t i = 0; i < lines; ++i) outputs[i] = delay_lines[i].read(static_cast<size_t>(delays[i]));
+		}
+
+		// Attenuation and damping, y = g (1 - p) x + p y[-1]
+		vector_t left = V::set(0.0f);
+		vector_t right = V::set(0.0f);
+		for (size_t i = 0; i < lines; i += width) {
+			const vector_t damped = V::add(V::mul(V::load(gains + i), V::load(outputs + i)),
+					V::mul(V::load(poles + i), V::load(state + i)));
+			V::store(state + i, damped);
+			left = V::add(left, V::mul(damped, V::load(output_left + i)));
+			right = V::add(right, V::mul(damped, V::load(output_right + i)));
+		}
+
+		// Feedback through the matrix, with the new input added
+		mix(state, feedback);
+		const vector_t left_sample = V::set(value.left);
+		const vector_t right_sample = V::set(value.right);
+		for (size_t i = 0; i < lines; i += width) {
+			const vector_t input = V::add(V::mul(left_sample, V::load(input_left + i)),
+					V::mul(right_sample, V::load(input_right + i)));
+			V::store(feedback + i, V::add(V::load(feedback + i), input));
+		}
+		for (size_t i = 0; i < lines; ++i) delay_lines[i].write(feedback[i]);
+
+		value.left = to_sample(dry * value.left + wet * horizontal_sum(left));
+		value.right = to_sample(dry * value.right + wet * horizontal_sum(right));
+	}
+
+	if (modulated) {
+		// Keeps the rotating phases on the unit circle despite the rounding errors
+		for (size_t i = 0; i < lines; ++i) {
+			const float norm = 1.0f / std::sqrt(sines_[i] * sines_[i] + cosines_[i] * cosines_[i]);
+			sines_[i] *= norm;
+			cosines_[i] *= norm;
+		}
+	}
+	return error_type_t::ok;
+}
+
+}
@@ -8,29 +8,24 @@
  */
 
 #include "iimavlib/filters/SineMultiply.h"
-#include <cmath>
-#include <cassert>
 namespace iimavlib {
 
 SineMultiply::SineMultiply(const pAudioFilter& child, double frequency)
-:AudioFilter(child),frequency_(frequency),time_(0.0)
+:AudioFilter(child),oscillator_(waveform_t::sine, frequency)
 {
 
 }
 SineMultiply::~SineMultiply()
 {
 
-}
-namespace {
-const double pi2 = 8*std::atan(1.0);
 }
 error_type_t SineMultiply::do_process(audio_buffer_t& buffer)
 {
 	const audio_params_t& params = buffer.params;
-	const double step = 1.0/convert_rate_to_int(params.rate);
-	for (auto& sample: buffer.data) {
-		sample = sample * std::sin(time_*frequency_*pi2);
-		time_=time_+ step;
+	gains_.resize(buffer.data.size());
+	oscillator_.generate(gains_.data(), gains_.size(), convert_rate_to_int(params.rate));
+	for (size_t i = 0; i < buffer.data.size(); ++i) {
+		buffer.data[i] = buffer.data[i] * gains_[i];
 	}
 	return error_type_t::ok;
 }
@@ -0,0 +1,304 @@
+/**
+ * @file 	WavetableOscillator.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/filters/WavetableOscillator.h"
+#include "iimavlib/FFT.h"
+#include "iimavlib/FFTKernels.h"
+#include "iimavlib/SampleBank.h"
+#include "iimavlib/Utils.h"
+#include "iimavlib/filters/FilterKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace iimavlib {
+
+namespace {
+using filter_kernels::to_sample;
+
+/// Number of samples generated before reloading the phases
+const size_t phase_block = 256;
+
+typedef fft_kernels::float_ops_t vector_ops;
+
+/*
+ * Table lookups for vectors of vector_ops. Integral parts of the positions are added to offsets of the tables,
+ * values at the offsets and the next ones are interpolated by the fractional parts.
+ */
+#if defined(IIMAVLIB_AVX2)
+struct lookup_ops {
+	typedef __m256i index_t;
+	static index_t load(const int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+	static __m256 truncate(__m256 x) { return _mm256_round_ps(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+	static __m256 interpolate(const float* tables, index_t offsets, __m256 position) {
+		const __m256i index = _mm256_cvttps_epi32(position);
+		const __m256 fraction = _mm256_sub_ps(position, _mm256_cvtepi32_ps(index));
+		const __m256i first = _mm256_add_epi32(offsets, index);
+		const __m256 a = _mm256_i32gather_ps(tables, first, 4);
+		const __m256 b = _mm256_i32gather_ps(tables + 1, first, 4);
+		return _mm256_add_ps(a, _mm256_mul_ps(fraction, _mm256_sub_ps(b, a)));
+	}
+};
+#elif defined(IIMAVLIB_SSE2)
+struct lookup_ops {
+	typedef __m128i index_t;
+	static index_t load(const int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+	static __m128 truncate(__m128 x) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(x)); }
+	static __m128 interpolate(const float* tables, index_t offsets, __m128 position) {
+		const __m128i index = _mm_cvttps_epi32(position);
+		const __m128 fraction = _mm_sub_ps(position, _mm_cvtepi32_ps(index));
+		// There are no gathers in SSE2, so the values are read per lane
+		int32_t first[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(first), _mm_add_epi32(offsets, index));
+		const __m128 a = _mm_setr_ps(tables[first[0]], tables[first[1]], tables[first[2]], tables[first[3]]);
+		const __m128 b = _mm_setr_ps(tables[first[0] + 1], tables[first[1] + 1], tables[first[2] + 1], tables[first[3] + 1]);
+		return _mm_add_ps(a, _mm_mul_ps(fraction, _mm_sub_ps(b, a)));
+	}
+};
+#else
+struct lookup_ops {
+	typedef int32_t index_t;
+	static index_t load(const int32_t* p) { return *p; }
+	static float truncate(float x) { return static_cast<float>(static_cast<int32_t>(x)); }
+	static float interpolate(const float* tables, index_t offset, float position) {
+		const int32_t index = static_cast<int32_t>(position);
+		const float fraction = position - static_cast<float>(index);
+		const float* values = tables + offset + index;
+		return values[0] + fraction * (values[1] - values[0]);
+	}
+};
+#endif
+
+/// Moves non-negative phases to interval <0, 1)
+vector_ops::vector_t wrap(vector_ops::vector_t phase)
+{
+	return vector_ops::sub(phase, lookup_ops::truncate(phase));
+}
+
+/**
+ * Adds sum of the voices to @em output. Each group of lanes produces vectors for several consecutive samples,
+ * which are transposed, so the lanes are summed without horizontal sums.
+ */
+void add_voices(float* output, size_t count, size_t voices, float* phases, const float* increments,
+		const int32_t* lower_offsets, const int32_t* upper_offsets, const float* lower_gains, const float* upper_gains,
+		const float* tables)
+{
+	typedef vector_ops V;
+	typedef V::vector_t vector_t;
+	typedef lookup_ops::index_t index_t;
+	const size_t width = V::width;
+	const vector_t size = V::set(static_cast<float>(Wavetable::table_size));
+	size_t i = 0;
+	for (; i + width <= count; i += width) {
+		vector_t sums[width];
+		for (size_t k = 0; k < width; ++k) sums[k] = V::set(0.0f);
+		for (size_t j = 0; j < voices; j += width) {
+			vector_t t = V::load(phases + j);
+			const vector_t dt = V::load(increments + j);
+			const vector_t lower_gain = V::load(lower_gains + j);
+			const vector_t upper_gain = V::load(upper_gains + j);
+			const index_t lower = lookup_ops::load(lower_offsets + j);
+			const index_t upper = lookup_ops::load(upper_offsets + j);
+			for (size_t k = 0; k < width; ++k) {
+				const vector_t position = V::mul(t, size);
+				const vector_t value = V::add(V::mul(lookup_ops::interpolate(tables, lower, position), lower_gain),
+						V::mul(lookup_ops::interpolate(tables, upper, position), upper_gain));
+				sums[k] = V::add(sums[k], value);
+				t = wrap(V::add(t, dt));
+			}
+			V::store(phases + j, t);
+		}
+		V::transpose(sums);
+		vector_t value = V::load(output + i);
+		for (size_t k = 0; k < width; ++k) value = V::add(value, sums[k]);
+		V::store(output + i, value);
+	}
+	// Remaining samples, summing the lanes one by one
+	for (; i < count; ++i) {
+		vector_t sum = V::set(0.0f);
+		for (size_t j = 0; j < voices; j += width) {
+			const vector_t t = V::load(phases + j);
+			const vector_t position = V::mul(t, size);
+			sum = V::add(sum, V::add(
+					V::mul(lookup_ops::interpolate(tables, lookup_ops::load(lower_offsets + j), position), V::load(lower_gains + j)),
+					V::mul(lookup_ops::interpolate(tables, lookup_ops::load(upper_offsets + j), position), V::load(upper_gains + j))));
+			V::store(phases + j, wrap(V::add(t, V::load(increments + j))));
+		}
+		float values[width];
+		V::store(values, sum);
+		for (size_t k = 0; k < width; ++k) output[i] += values[k];
+	}
+}
+}
+
+Wavetable::Wavetable(const std::vector<float>& period):levels_(0)
+{
+	init(period);
+}
+
+Wavetable::Wavetable(const std::string& filename):levels_(0)
+{
+	SampleReader reader(filename);
+	std::vector<audio_sample_t> samples(static_cast<size_t>(reader.get_sample_count()));
+	std::vector<float> period;
+	while (size_t count = reader.read_data(samples)) {
+		for (size_t i = 0; i < count && period.size() < samples.size(); ++i) period.push_back(samples[i].left / 32768.0f);
+		if (period.size() >= samples.size()) break;
+	}
+	init(period);
+	logger[log_level::debug] << "[Wavetable] Loaded " << period.size() << " samples long period from " << filename;
+}
+
+void Wavetable::init(const std::vector<float>& period)
+{
+	if (period.size() < 2) throw std::runtime_error("Wavetable Error: the period has to have at least 2 samples");
+	const size_t length = period.size();
+	const size_t size = table_size;
+	std::vector<std::complex<float>> spectrum(length);
+	fft_plan_t<float>(length).transform(period.data(), spectrum.data());
+	// Harmonics below the Nyquist frequency of the period
+	const size_t available = (length - 1) / 2;
+
+	for (size_t harmonics = max_harmonics; harmonics > 0; harmonics /= 2) ++levels_;
+	tables_.assign(levels_ * (size + 1), 0.0f);
+	real_fft_plan_t<float> plan(size);
+	std::vector<std::complex<float>> bins(plan.bins());
+	const float scale = static_cast<float>(size) / static_cast<float>(length);
+	for (size_t level = 0; level < levels_; ++level) {
+		const size_t harmonics = std::min(static_cast<size_t>(max_harmonics >> level), available);
+		std::fill(bins.begin(), bins.end(), std::complex<float>());
+		for (size_t h = 1; h <= harmonics; ++h) bins[h] = spectrum[h] * scale;
+		float* table = tables_.data() + level * (size + 1);
+		plan.inverse(bins.data(), table);
+		table[size] = table[0];
+	}
+}
+
+
+WavetableOscillator::WavetableOscillator(const pAudioFilter& child, const std::string& filename, size_t voices):
+	WavetableOscillator(child, std::make_shared<Wavetable>(filename), voices)
+{
+}
+
+WavetableOscillator::WavetableOscillator(const pAudioFilter& child, const pWavetable& table, size_t voices):
+	AudioFilter(child),table_(table),voices_(voices),changed_(false),rate_(0.0)
+{
+	if (!table_) throw std::runtime_error("WavetableOscillator Error: no wavetable");
+	const size_t width = vector_ops::width;
+	const size_t padded = (voices + width - 1) / width * width;
+	pending_frequencies_.assign(voices, 0.0);
+	pending_amplitudes_.assign(voices, 0.0f);
+	frequencies_.assign(padded, 0.0);
+	amplitudes_.assign(padded, 0.0f);
+	phases_.assign(padded, 0.0);
+	lane_phases_.assign(padded, 0.0f);
+	increments_.assign(padded, 0.0f);
+	lower_offsets_.assign(padded, 0);
+	upper_offsets_.assign(padded, 0);
+	lower_gains_.assign(padded, 0.0f);
+	upper_gains_.assign(padded, 0.0f);
+}
+
+WavetableOscillator::~WavetableOscillator()
+{
+}
+
+void WavetableOscillator::set_voice(size_t voice, double frequency, float amplitude)
+{
+	if (voice >= voices_) throw std::out_of_range("WavetableOscillator Error: voice index out of range");
+	std::unique_lock<std::mutex> lock(mutex_);
+	pending_frequencies_[voice] = frequency;
+	pending_amplitudes_[voice] = amplitude;
+	changed_ = true;
+}
+
+void WavetableOscillator::set_frequency(size_t voice, double frequency)
+{
+	if (voice >= voices_) throw std::out_of_range("WavetableOscillator Error: voice index out of range");
+	std::unique_lock<std::mutex> lock(mutex_);
+	pending_frequencies_[voice] = frequency;
+	changed_ = true;
+}
+
+void WavetableOscillator::set_amplitude(size_t voice, float amplitude)
+{
+	if (voice >= voices_) throw std::out_of_range("WavetableOscillator Error: voice index out of range");
+	std::unique_lock<std::mutex> lock(mutex_);
+	pending_amplitudes_[voice] = amplitude;
+	changed_ = true;
+}
+
+void WavetableOscillator::update_voices(double rate)
+{
+	const size_t size = Wavetable::table_size;
+	const double top = static_cast<double>(table_->levels() - 1);
+	// Level with the highest harmonic at (1/4, 1/2) of the sampling rate, the next one has it two times lower
+	const double first_level = std::log2(4.0 * Wavetable::max_harmonics);
+	for (size_t i = 0; i < frequencies_.size(); ++i) {
+		const double increment = std::max(0.0, std::min(frequencies_[i] / rate, 0.499));
+		increments_[i] = static_cast<float>(increment);
+		const double position = increment > 0.0 ? std::max(0.0, std::min(std::log2(increment) + first_level, top)) : 0.0;
+		const size_t lower = static_cast<size_t>(position);
+		const size_t upper = std::min(lower + 1, table_->levels() - 1);
+		const float fraction = static_cast<float>(position - lower);
+		lower_offsets_[i] = static_cast<int32_t>(lower * (size + 1));
+		upper_offsets_[i] = static_cast<int32_t>(upper * (size + 1));
+		lower_gains_[i] = amplitudes_[i] * (1.0f - fraction);
+		upper_gains_[i] = amplitudes_[i] * fraction;
+	}
+}
+
+error_type_t WavetableOscillator::do_process(audio_buffer_t& buffer)
+{
+	const double rate = convert_rate_to_int(buffer.params.rate);
+	bool update = rate != rate_;
+	if (changed_.exchange(false)) {
+		// The audio thread doesn't wait for the setters, the change is picked up in a following buffer instead
+		std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+		if (lock.owns_lock()) {
+			std::copy(pending_frequencies_.begin(), pending_frequencies_.end(), frequencies_.begin());
+			std::copy(pending_amplitudes_.begin(), pending_amplitudes_.end(), amplitudes_.begin());
+			update = true;
+		} else {
+			changed_ = true;
+		}
+	}
+	if (update) {
+		rate_ = rate;
+		update_voices(rate);
+	}
+
+	const size_t count = buffer.valid_samples;
+	values_.assign(count, 0.0f);
+	const size_t voices = phases_.size();
+	float* phases = lane_phases_.data();
+	for (size_t position = 0; position < count; position += phase_block) {
+		const size_t length = std::min(phase_block, count - position);
+		for (size_t i = 0; i < voices; ++i) phases[i] = static_cast<float>(phases_[i]);
+		add_voices(values_.data() + position, length, voices, phases, increments_.data(),
+				lower_offsets_.data(), upper_offsets_.data(), lower_gains_.data(), upper_gains_.data(), table_->data());
+		for (size_t i = 0; i < voices; ++i) {
+			phases_[i] += length * static_cast<double>(increments_[i]);
+			phases_[i] -= std::floor(phases_[i]);
+		}
+	}
+
+	const bool has_child = static_cast<bool>(get_child());
+	for (size_t i = 0; i < count; ++i) {
+		const float value = values_[i] * 32767.0f;
+		audio_sample_t& sample = buffer.data[i];
+		if (has_child) {
+			sample.left = to_sample(sample.left + value);
+			sample.right = to_sample(sample.right + value);
+		} else {
+			sample.left = sample.right = to_sample(value);
+		}
+	}
+	return error_type_t::ok;
+}
+
+}
@@ -0,0 +1,202 @@
+/**
+ * @file 	test_biquad.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/filters/BiquadFilter.h"
+#include <cmath>
+#include <complex>
+#include <random>
+
+namespace iimavlib {
+
+namespace {
+const double rate = 44100.0;
+const double pi = 4.0 * std::atan(1.0);
+
+/// Gain of a section at given frequency, in decibels
+double response_db(const biquad_coefficients_t& c, double frequency)
+{
+	const std::complex<double> z = std::polar(1.0, -2.0 * pi * frequency / rate);
+	const double b0 = c.b0, b1 = c.b1, b2 = c.b2, a1 = c.a1, a2 = c.a2;
+	const std::complex<double> h = (b0 + b1 * z + b2 * z * z) / (1.0 + a1 * z + a2 * z * z);
+	return 20.0 * std::log10(std::abs(h));
+}
+
+double response_db(biquad_type_t type, double frequency, double at, double q = 0.7071, double gain = 0.0)
+{
+	return response_db(biquad_coefficients_t::design(biquad_params_t(type, frequency, q, gain), rate), at);
+}
+
+/// Reference section in double precision, transposed direct form II (as the bank, so it matches when interpolating)
+struct reference_t {
+	double z1, z2;
+	reference_t():z1(0),z2(0) {}
+	double process(const biquad_coefficients_t& c, double x) {
+		const double y = c.b0 * x + z1;
+		z1 = c.b1 * x - c.a1 * y + z2;
+		z2 = c.b2 * x - c.a2 * y;
+		return y;
+	}
+};
+
+biquad_coefficients_t interpolate(const biquad_coefficients_t& a, const biquad_coefficients_t& b, double t)
+{
+	biquad_coefficients_t result;
+	result.b0 = static_cast<float>(a.b0 + (b.b0 - a.b0) * t);
+	result.b1 = static_cast<float>(a.b1 + (b.b1 - a.b1) * t);
+	result.b2 = static_cast<float>(a.b2 + (b.b2 - a.b2) * t);
+	result.a1 = static_cast<float>(a.a1 + (b.a1 - a.a1) * t);
+	result.a2 = static_cast<float>(a.a2 + (b.a2 - a.a2) * t);
+	return result;
+}
+}
+
+TEST_CASE("Biquad") {
+	SECTION("design") {
+		REQUIRE(std::abs(response_db(biquad_type_t::lowpass, 1000.0, 10.0)) < 0.01);
+		REQUIRE(response_db(biquad_type_t::lowpass, 1000.0, 1000.0) == Approx(-3.01).epsilon(0.01));
+		REQUIRE(response_db(biquad_type_t::lowpass, 1000.0, 10000.0) < -35.0);
+		REQUIRE(std::abs(response_db(biquad_type_t::highpass, 1000.0, 20000.0)) < 0.01);
+		REQUIRE(response_db(biquad_type_t::highpass, 1000.0, 100.0) < -35.0);
+		REQUIRE(std::abs(response_db(biquad_type_t::bandpass, 2000.0, 2000.0, 2.0)) < 0.01);
+		REQUIRE(response_db(biquad_type_t::bandpass, 2000.0, 200.0, 2.0) < -25.0);
+		REQUIRE(response_db(biquad_type_t::notch, 3000.0, 3000.0, 5.0) < -60.0);
+		REQUIRE(std::abs(response_db(biquad_type_t::notch, 3000.0, 300.0, 5.0)) < 0.1);
+		REQUIRE(response_db(biquad_type_t::peaking, 500.0, 500.0, 1.0, 6.0) == Approx(6.0).epsilon(0.001));
+		REQUIRE(std::abs(response_db(biquad_type_t::peaking, 500.0, 15000.0, 1.0, 6.0)) < 0.1);
+		REQUIRE(response_db(biquad_type_t::low_shelf, 200.0, 10.0, 0.7071, -9.0) == Approx(-9.0).epsilon(0.01));
+		REQUIRE(std::abs(response_db(biquad_type_t::low_shelf, 200.0, 15000.0, 0.7071, -9.0)) < 0.1);
+		REQUIRE(response_db(biquad_type_t::high_shelf, 5000.0, 21000.0, 0.7071, 4.0) == Approx(4.0).epsilon(0.01));
+		REQUIRE(std::abs(response_db(biquad_type_t::high_shelf, 5000.0, 50.0, 0.7071, 4.0)) < 0.01);
+		// Frequencies above Nyquist are limited
+		REQUIRE(std::abs(response_db(biquad_type_t::lowpass, 30000.0, 1000.0)) < 0.01);
+		REQUIRE_THROWS(biquad_coefficients_t::design(biquad_params_t(biquad_type_t::lowpass, 0.0), rate));
+		REQUIRE_THROWS(biquad_coefficients_t::design(biquad_params_t(biquad_type_t::lowpass, 100.0, -1.0), rate));
+	}
+
+	std::mt19937 generator(11);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	const biquad_type_t types[] = {biquad_type_t::lowpass, biquad_type_t::highpass, biquad_type_t::bandpass,
+			biquad_type_t::notch, biquad_type_t::low_shelf, biquad_type_t::high_shelf, biquad_type_t::peaking};
+
+	SECTION("bank") {
+		// Numbers of lanes not divisible by the vector width (stereo narrower than a vector), every section of every lane is different
+		const size_t sections = 3, samples = 1000;
+		for (const size_t lanes: {2, 3, 7}) {
+			BiquadBank bank(lanes, sections);
+			std::vector<std::vector<biquad_coefficients_t>> coefficients(lanes);
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				for (size_t section = 0; section < sections; ++section) {
+					const biquad_params_t params(types[(lane + section) % 7], 100.0 + 1500.0 * lane + 400.0 * section,
+							0.5 + 0.3 * section, 6.0 - 2.0 * lane);
+					coefficients[lane].push_back(biquad_coefficients_t::design(params, rate));
+					bank.set(lane, section, coefficients[lane].back());
+				}
+			}
+			std::vector<float> data(samples * lanes), input(samples), shared(samples * lanes);
+			for (auto& value: input) value = distribution(generator);
+			for (size_t i = 0; i < samples; ++i) std::fill_n(&data[i * lanes], lanes, input[i]);
+			// Two blocks, so the state is carried over
+			bank.process(data.data(), 400);
+			bank.process(data.data() + 400 * lanes, samples - 400);
+			BiquadBank bank2(lanes, sections);
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				for (size_t section = 0; section < sections; ++section) bank2.set(lane, section, coefficients[lane][section]);
+			}
+			bank2.process(input.data(), shared.data(), samples);
+
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				std::vector<reference_t> reference(sections);
+				for (size_t i = 0; i < samples; ++i) {
+					double value = input[i];
+					for (size_t section = 0; section < sections; ++section) {
+						value = reference[section].process(coefficients[lane][section], value);
+					}
+					REQUIRE(std::abs(data[i * lanes + lane] - value) < 1e-4);
+					REQUIRE(shared[i * lanes + lane] == data[i * lanes + lane]);
+				}
+			}
+			REQUIRE_THROWS(bank.set(lanes, 0, biquad_coefficients_t()));
+			REQUIRE_THROWS(bank.set(0, sections, biquad_coefficients_t()));
+			REQUIRE_THROWS((BiquadBank{0, 1}));
+		}
+	}
+	SECTION("interpolation") {
+		const size_t lanes = 4, samples = 256;
+		BiquadBank bank(lanes, 1);
+		const auto from = biquad_coefficients_t::design(biquad_params_t(biquad_type_t::lowpass, 500.0), rate);
+		const auto to = biquad_coefficients_t::design(biquad_params_t(biquad_type_t::lowpass, 5000.0), rate);
+		for (size_t lane = 0; lane < lanes; ++lane) bank.set(lane, 0, from);
+		std::vector<float> input(3 * samples), data(3 * samples * lanes);
+		for (auto& value: input) value = distribution(generator);
+		bank.process(input.data(), data.data(), samples);
+		for (size_t lane = 0; lane < lanes; ++lane) bank.set(lane, 0, to);
+		bank.process(input.data() + samples, data.data() + samples * lanes, samples);
+		bank.process(input.data() + 2 * samples, data.data() + 2 * samples * lanes, samples);
+
+		reference_t reference;
+		for (size_t i = 0; i < input.size(); ++i) {
+			// The coefficients change during the second block, reaching the target at its last sample
+			const double t = i < samples ? 0.0 : std::min(1.0, (i - samples + 1.0) / samples);
+			const double expected = reference.process(interpolate(from, to, t), input[i]);
+			for (size_t lane = 0; lane < lanes; ++lane) {
+				REQUIRE(std::abs(data[i * lanes + lane] - expected) < 1e-4);
+			}
+		}
+	}
+	SECTION("denormals") {
+		BiquadBank bank(1, 1);
+		bank.set(0, 0, biquad_coefficients_t::design(biquad_params_t(biquad_type_t::lowpass, 100.0), rate));
+		std::vector<float> data(20000, 0.0f);
+		data[0] = 1.0f;
+		for (size_t i = 0; i < data.size(); i += 500) bank.process(data.data() + i, 500);
+		REQUIRE(data.back() == 0.0f);
+		for (const auto value: data) REQUIRE((value == 0.0f || std::abs(value) >= 1e-30f));
+	}
+	SECTION("filter") {
+		// Stereo sine at 8 kHz through two lowpass sections at 1 kHz
+		std::vector<audio_sample_t> samples(4410);
+		for (size_t i = 0; i < samples.size(); ++i) {
+			const auto value = static_cast<int16_t>(10000.0 * std::sin(2.0 * pi * 8000.0 * i / rate));
+			samples[i] = audio_sample_t(value, value / 2);
+		}
+		std::vector<biquad_params_t> sections(2, biquad_params_t(biquad_type_t::lowpass, 1000.0));
+		BiquadFilter filter(pAudioFilter(), sections);
+		audio_buffer_t buffer;
+		buffer.params = audio_params_t(sampling_rate_t::rate_44kHz);
+		buffer.data = samples;
+		buffer.valid_samples = samples.size();
+		REQUIRE(filter.process(buffer) == error_type_t::ok);
+		int peak_left = 0, peak_right = 0;
+		for (size_t i = samples.size() / 2; i < samples.size(); ++i) {
+			peak_left = std::max(peak_left, std::abs(static_cast<int>(buffer.data[i].left)));
+			peak_right = std::max(peak_right, std::abs(static_cast<int>(buffer.data[i].right)));
+		}
+		// About -72 dB
+		REQUIRE(peak_left < 10);
+		REQUIRE(peak_right < 5);
+
+		// Opening the filter passes the sine again
+		filter.set_section(0, biquad_params_t(biquad_type_t::lowpass, 20000.0));
+		filter.set_section(1, biquad_params_t(biquad_type_t::peaking, 1000.0, 1.0, 0.0));
+		buffer.data = samples;
+		REQUIRE(filter.process(buffer) == error_type_t::ok);
+		buffer.data = samples;
+		REQUIRE(filter.process(buffer) == error_type_t::ok);
+		peak_left = 0;
+		for (size_t i = 0; i < samples.size(); ++i) {
+			peak_left = std::max(peak_left, std::abs(static_cast<int>(buffer.data[i].left)));
+		}
+		REQUIRE(peak_left > 9000);
+		REQUIRE(filter.get_sections()[1].type == biquad_type_t::peaking);
+		REQUIRE_THROWS(filter.set_section(2, biquad_params_t()));
+		REQUIRE_THROWS(filter.set_section(0, biquad_params_t(biquad_type_t::lowpass, -1.0)));
+		REQUIRE_THROWS((BiquadFilter{pAudioFilter(), std::vector<biquad_params_t>()}));
+	}
+}
+
+}
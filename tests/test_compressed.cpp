@@ -0,0 +1,206 @@
+/**
+ * @file 	test_compressed.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/CompressedFile.h"
+#include "iimavlib/CompressedSource.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+namespace iimavlib {
+namespace {
+const std::string test_file = "test_compressed_tmp.iac";
+
+bool equal_samples(const audio_sample_t& a, const audio_sample_t& b)
+{
+	return a.left == b.left && a.right == b.right;
+}
+
+/// Two sines with a bit of noise, left and right channels correlated
+std::vector<audio_sample_t> make_music(size_t count)
+{
+	std::mt19937 gen(42);
+	std::uniform_int_distribution<int> noise(-20, 20);
+	std::vector<audio_sample_t> samples(count);
+	for (size_t i = 0; i < count; ++i) {
+		const double t = static_cast<double>(i) / 44100.0;
+		const double value = 12000.0 * std::sin(2 * 3.14159265 * 440.0 * t) + 6000.0 * std::sin(2 * 3.14159265 * 660.0 * t);
+		samples[i] = audio_sample_t(static_cast<int16_t>(value + noise(gen)),
+									static_cast<int16_t>(0.8 * value + noise(gen)));
+	}
+	return samples;
+}
+
+std::vector<audio_sample_t> make_noise(size_t count)
+{
+	std::mt19937 gen(7);
+	std::uniform_int_distribution<int> dist(-32768, 32767);
+	std::vector<audio_sample_t> samples(count);
+	for (size_t i = 0; i < count; ++i) {
+		samples[i] = audio_sample_t(static_cast<int16_t>(dist(gen)), static_cast<int16_t>(dist(gen)));
+	}
+	// Extreme values stress the side channel
+	if (count > 4) {
+		samples[0] = audio_sample_t(32767, -32768);
+		samples[1] = audio_sample_t(-32768, 32767);
+		samples[2] = audio_sample_t(32767, -32768);
+	}
+	return samples;
+}
+
+void write_compressed(const std::vector<audio_sample_t>& samples, size_t frame_size = CompressedFile::default_frame_size)
+{
+	CompressedFile file(test_file, audio_params_t(sampling_rate_t::rate_44kHz), frame_size);
+	// Store in uneven pieces to exercise buffering
+	for (size_t start = 0; start < samples.size(); start += 1000) {
+		const size_t end = std::min(start + 1000, samples.size());
+		std::vector<audio_sample_t> part(samples.begin() + start, samples.begin() + end);
+		REQUIRE(file.store_data(part) == error_type_t::ok);
+	}
+	REQUIRE(file.get_sample_count() == samples.size());
+}
+
+std::vector<audio_sample_t> read_compressed(size_t expected_count)
+{
+	CompressedFile file(test_file);
+	REQUIRE(file.get_sample_count() == expected_count);
+	std::vector<audio_sample_t> data(expected_count + 100);
+	size_t count = data.size();
+	REQUIRE(file.read_data(data, count) == error_type_t::ok);
+	REQUIRE(count == expected_count);
+	data.resize(count);
+	return data;
+}
+
+size_t file_size(const std::string& filename)
+{
+	std::ifstream f(filename, std::ios::binary | std::ios::ate);
+	return static_cast<size_t>(f.tellg());
+}
+}
+
+TEST_CASE("CompressedFile") {
+	SECTION("music") {
+		const auto samples = make_music(100000);
+		write_compressed(samples);
+		const auto data = read_compressed(samples.size());
+		REQUIRE(std::equal(samples.begin(), samples.end(), data.begin(), equal_samples));
+		REQUIRE(file_size(test_file) < samples.size() * sizeof(audio_sample_t) / 2);
+	}
+	SECTION("noise") {
+		const auto samples = make_noise(50000);
+		write_compressed(samples, 1024);
+		const auto data = read_compressed(samples.size());
+		REQUIRE(std::equal(samples.begin(), samples.end(), data.begin(), equal_samples));
+	}
+	SECTION("silence") {
+		const std::vector<audio_sample_t> samples(10000);
+		write_compressed(samples);
+		const auto data = read_compressed(samples.size());
+		REQUIRE(std::equal(samples.begin(), samples.end(), data.begin(), equal_samples));
+		REQUIRE(file_size(test_file) < 1000);
+	}
+	SECTION("short") {
+		const auto samples = make_noise(3);
+		write_compressed(samples);
+		const auto data = read_compressed(samples.size());
+		REQUIRE(std::equal(samples.begin(), samples.end(), data.begin(), equal_samples));
+	}
+	std::remove(test_file.c_str());
+}
+
+TEST_CASE("CompressedFile seeking") {
+	const auto samples = make_music(50000);
+	write_compressed(samples, 2048);
+	CompressedFile file(test_file);
+	REQUIRE(file.get_frame_count() == 25);
+	std::vector<audio_sample_t> data(300);
+	const uint64_t positions[] = {0, 49900, 2047, 2048, 100, 30000, 30100};
+	for (auto position: positions) {
+		REQUIRE(file.seek(position) == error_type_t::ok);
+		size_t count = data.size();
+		REQUIRE(file.read_data(data, count) == error_type_t::ok);
+		REQUIRE(count == std::min<size_t>(300, samples.size() - position));
+		REQUIRE(std::equal(data.begin(), data.begin() + count, samples.begin() + position, equal_samples));
+		REQUIRE(file.get_position() == position + count);
+	}
+	size_t count = data.size();
+	REQUIRE(file.seek(60000) == error_type_t::ok);
+	REQUIRE(file.read_data(data, count) == error_type_t::ok);
+	REQUIRE(count == 0);
+	std::remove(test_file.c_str());
+}
+
+TEST_CASE("CompressedFile recovery") {
+	const auto samples = make_music(10000);
+	write_compressed(samples, 1024);
+	std::vector<char> contents;
+	{
+		std::ifstream f(test_file, std::ios::binary);
+		contents.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	}
+	compressed_header_t header;
+	std::copy(contents.begin(), contents.begin() + sizeof(header), reinterpret_cast<char*>(&header));
+	SECTION("not finalized") {
+		// Drop the seek table and clear the header, as if the writer crashed
+		contents.resize(static_cast<size_t>(header.seek_table));
+		header.seek_table = 0;
+		header.sample_count = 0;
+		std::copy_n(reinterpret_cast<const char*>(&header), sizeof(header), contents.begin());
+		std::ofstream(test_file, std::ios::binary).write(&contents[0], contents.size());
+		const auto data = read_compressed(samples.size());
+		REQUIRE(std::equal(samples.begin(), samples.end(), data.begin(), equal_samples));
+	}
+	SECTION("truncated") {
+		contents.resize(static_cast<size_t>(header.seek_table) - 10);
+		header.seek_table = 0;
+		std::copy_n(reinterpret_cast<const char*>(&header), sizeof(header), contents.begin());
+		std::ofstream(test_file, std::ios::binary).write(&contents[0], contents.size());
+		// The last (incomplete) frame is lost
+		const auto data = read_compressed(9216);
+		REQUIRE(std::equal(data.begin(), data.end(), samples.begin(), equal_samples));
+	}
+	SECTION("corrupted") {
+		// Break the first frame's data
+		std::fill_n(contents.begin() + sizeof(header) + sizeof(compressed_frame_header_t), 64, static_cast<char>(0));
+		std::ofstream(test_file, std::ios::binary).write(&contents[0], contents.size());
+		CompressedFile file(test_file);
+		std::vector<audio_sample_t> data(100);
+		size_t count = data.size();
+		REQUIRE(file.read_data(data, count) == error_type_t::failed);
+	}
+	SECTION("invalid") {
+		contents[0] = 'X';
+		std::ofstream(test_file, std::ios::binary).write(&contents[0], contents.size());
+		REQUIRE_THROWS(CompressedFile{test_file});
+	}
+	std::remove(test_file.c_str());
+}
+
+TEST_CASE("CompressedSource") {
+	const auto samples = make_music(5000);
+	write_compressed(samples);
+	CompressedSource source(test_file);
+	REQUIRE(source.get_params().rate == sampling_rate_t::rate_44kHz);
+	REQUIRE(source.get_sample_count() == samples.size());
+	audio_buffer_t buffer;
+	buffer.data.resize(4096);
+	buffer.valid_samples = 4096;
+	REQUIRE(source.process(buffer) == error_type_t::ok);
+	REQUIRE(buffer.valid_samples == 4096);
+	REQUIRE(std::equal(samples.begin(), samples.begin() + 4096, buffer.data.begin(), equal_samples));
+	REQUIRE(source.seek(4500) == error_type_t::ok);
+	REQUIRE(source.process(buffer) == error_type_t::ok);
+	REQUIRE(buffer.valid_samples == 500);
+	buffer.valid_samples = 4096;
+	REQUIRE(source.process(buffer) == error_type_t::failed);
+	std::remove(test_file.c_str());
+}
+
+}
@@ -0,0 +1,164 @@
+/**
+ * @file 	test_convolution.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/filters/ConvolutionReverb.h"
+#include "iimavlib/WaveFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace iimavlib {
+
+namespace {
+const char* ir_file = "test_convolution_ir.wav";
+
+/// Source filter playing samples from a vector
+class vector_source: public AudioFilter {
+public:
+	vector_source(const std::vector<audio_sample_t>& samples):AudioFilter(pAudioFilter()),samples_(samples),position_(0) {}
+private:
+	error_type_t do_process(audio_buffer_t& buffer) {
+		for (size_t i = 0; i < buffer.valid_samples; ++i, ++position_) {
+			buffer.data[i] = position_ < samples_.size() ? samples_[position_] : audio_sample_t();
+		}
+		return error_type_t::ok;
+	}
+	std::vector<audio_sample_t> samples_;
+	size_t position_;
+};
+
+/// Processes the input in buffers of varying sizes
+std::vector<audio_sample_t> run(AudioFilter& filter, size_t count)
+{
+	std::vector<audio_sample_t> output;
+	audio_buffer_t buffer;
+	buffer.params = audio_params_t(sampling_rate_t::rate_44kHz);
+	const size_t sizes[] = {1000, 1, 333, 64, 4096, 17};
+	for (size_t i = 0; output.size() < count; ++i) {
+		buffer.data.resize(sizes[i % 6]);
+		buffer.valid_samples = buffer.data.size();
+		REQUIRE(filter.process(buffer) == error_type_t::ok);
+		output.insert(output.end(), buffer.data.begin(), buffer.data.begin() + buffer.valid_samples);
+	}
+	output.resize(count);
+	return output;
+}
+
+double energy(const std::vector<float>& ir)
+{
+	double sum = 0.0;
+	for (const auto value: ir) sum += static_cast<double>(value) * value;
+	return sum;
+}
+
+/// Direct convolution of one channel, delayed by @em latency and scaled by @em scale
+std::vector<double> convolve(const std::vector<audio_sample_t>& input, bool left, const std::vector<float>& ir,
+		double scale, size_t latency, size_t count)
+{
+	std::vector<double> output(count, 0.0);
+	for (size_t n = 0; n < input.size(); ++n) {
+		const double x = left ? input[n].left : input[n].right;
+		if (x == 0.0) continue;
+		for (size_t k = 0; k < ir.size() && n + k + latency < count; ++k) {
+			output[n + k + latency] += x * ir[k] * scale;
+		}
+	}
+	return output;
+}
+}
+
+TEST_CASE("ConvolutionReverb") {
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+	SECTION("partitions") {
+		// Long response over several partition sizes, sparse input
+		std::vector<float> left(20000), right(5000);
+		for (size_t i = 0; i < left.size(); ++i) left[i] = distribution(generator) * std::exp(-static_cast<float>(i) / 5000.0f);
+		for (auto& value: right) value = distribution(generator);
+		std::vector<audio_sample_t> input(30000);
+		input[0] = audio_sample_t(3000, -2000);
+		input[1234] = audio_sample_t(-3000, 1000);
+		input[7000] = audio_sample_t(2000, 3000);
+		input[18000] = audio_sample_t(1500, -500);
+		ConvolutionReverb reverb(std::make_shared<vector_source>(input), left, right, 1.0, 0.0, 64, 1024);
+		const auto output = run(reverb, input.size());
+		// Both channels are scaled equally, the louder one to unit energy
+		const double scale = 1.0 / std::sqrt(std::max(energy(left), energy(right)));
+		const auto expected_left = convolve(input, true, left, scale, 64, input.size());
+		const auto expected_right = convolve(input, false, right, scale, 64, input.size());
+		double error = 0.0;
+		for (size_t i = 0; i < output.size(); ++i) {
+			error = std::max(error, std::abs(output[i].left - expected_left[i]));
+			error = std::max(error, std::abs(output[i].right - expected_right[i]));
+		}
+		REQUIRE(error < 2.0);
+
+		const convolution_stats_t stats = reverb.get_stats();
+		REQUIRE(stats.latency == 64);
+		REQUIRE(stats.stages == 3);
+		REQUIRE(stats.max_partition == 1024);
+		// 3x64 + 3x256 + 19x1024 samples
+		REQUIRE(stats.partitions == 25);
+		// The last buffer may run past the end of the input
+		REQUIRE(stats.blocks >= input.size() / 64);
+		REQUIRE(stats.average_load > 0.0);
+		REQUIRE(stats.peak_load >= stats.average_load);
+	}
+	SECTION("dense input") {
+		std::vector<float> ir(3000);
+		for (auto& value: ir) value = distribution(generator);
+		std::vector<audio_sample_t> input(12000);
+		for (auto& sample: input) {
+			sample.left = static_cast<int16_t>(300 * distribution(generator));
+			sample.right = static_cast<int16_t>(300 * distribution(generator));
+		}
+		ConvolutionReverb reverb(std::make_shared<vector_source>(input), ir, ir, 0.5, 1.0, 128, 512);
+		const auto output = run(reverb, input.size());
+		const auto expected = convolve(input, true, ir, 1.0 / std::sqrt(energy(ir)), 128, input.size());
+		double error = 0.0;
+		for (size_t i = 0; i < output.size(); ++i) {
+			error = std::max(error, std::abs(output[i].left - (input[i].left + 0.5 * expected[i])));
+		}
+		REQUIRE(error < 2.0);
+	}
+	SECTION("file") {
+		std::vector<audio_sample_t> samples(2000);
+		std::vector<float> left(samples.size()), right(samples.size());
+		for (size_t i = 0; i < samples.size(); ++i) {
+			samples[i] = audio_sample_t(static_cast<int16_t>(20000 * distribution(generator)), static_cast<int16_t>(i % 100));
+			left[i] = samples[i].left / 32768.0f;
+			right[i] = samples[i].right / 32768.0f;
+		}
+		{
+			WaveFile wav(ir_file, audio_params_t(sampling_rate_t::rate_44kHz));
+			wav.store_data(samples);
+		}
+		std::vector<audio_sample_t> input(5000);
+		input[10] = audio_sample_t(10000, 10000);
+		ConvolutionReverb from_file(std::make_shared<vector_source>(input), ir_file);
+		ConvolutionReverb from_vectors(std::make_shared<vector_source>(input), left, right);
+		const auto output1 = run(from_file, input.size());
+		const auto output2 = run(from_vectors, input.size());
+		for (size_t i = 0; i < input.size(); ++i) {
+			REQUIRE(output1[i].left == output2[i].left);
+			REQUIRE(output1[i].right == output2[i].right);
+		}
+		std::remove(ir_file);
+	}
+	SECTION("errors") {
+		const std::vector<float> ir(100, 0.5f);
+		REQUIRE_THROWS((ConvolutionReverb{pAudioFilter(), ir, ir, 0.3, 1.0, 100}));
+		REQUIRE_THROWS((ConvolutionReverb{pAudioFilter(), ir, ir, 0.3, 1.0, 256, 128}));
+		REQUIRE_THROWS((ConvolutionReverb{pAudioFilter(), std::vector<float>(), std::vector<float>()}));
+		REQUIRE_THROWS((ConvolutionReverb{pAudioFilter(), "nonexistent_ir.wav"}));
+	}
+}
+
+}
@@ -0,0 +1,143 @@
+/**
+ * @file 	test_delay_line.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/DelayLine.h"
+#include "iimavlib/filters/SimpleEchoFilter.h"
+#include <cmath>
+#include <random>
+
+namespace iimavlib {
+
+namespace {
+/// Source filter playing samples from a vector
+class echo_source: public AudioFilter {
+public:
+	echo_source(const std::vector<audio_sample_t>& samples):AudioFilter(pAudioFilter()),samples_(samples),position_(0) {}
+private:
+	error_type_t do_process(audio_buffer_t& buffer) {
+		for (size_t i = 0; i < buffer.valid_samples; ++i, ++position_) {
+			buffer.data[i] = position_ < samples_.size() ? samples_[position_] : audio_sample_t();
+		}
+		return error_type_t::ok;
+	}
+	std::vector<audio_sample_t> samples_;
+	size_t position_;
+};
+}
+
+TEST_CASE("delay_line_t") {
+	SECTION("size") {
+		delay_line_t<float> line(1000);
+		REQUIRE(line.capacity() == 1024);
+		line.resize(1023);
+		REQUIRE(line.capacity() == 2048);
+	}
+	SECTION("integer delays") {
+		delay_line_t<float> line(100);
+		const size_t capacity = line.capacity();
+		REQUIRE(line.read(1) == 0.0f);
+		REQUIRE(line.read(capacity) == 0.0f);
+		// Several times around the ring
+		for (size_t i = 1; i <= 5 * capacity + 3; ++i) {
+			line.write(static_cast<float>(i));
+			REQUIRE(line.read(1) == i);
+			if (i >= capacity) REQUIRE(line.read(capacity) == i - capacity + 1);
+			if (i > 77) REQUIRE(line.read(77) == i - 76);
+		}
+		line.clear();
+		REQUIRE(line.read(1) == 0.0f);
+	}
+	SECTION("blocks") {
+		delay_line_t<int> line(60);
+		const size_t capacity = line.capacity();
+		std::vector<int> values(1000), output(50);
+		for (size_t i = 0; i < values.size(); ++i) values[i] = static_cast<int>(i);
+		size_t written = 0;
+		const size_t sizes[] = {10, 1, 50, 33, 200, 17};
+		for (size_t i = 0; written + 200 <= values.size(); ++i) {
+			const size_t count = sizes[i % 6];
+			line.write(values.data() + written, count);
+			written += count;
+			if (written < capacity) continue;
+			for (size_t k = 1; k <= capacity; ++k) REQUIRE(line.read(k) == static_cast<int>(written - k));
+			line.read(output.data(), 50, 50);
+			for (size_t k = 0; k < 50; ++k) REQUIRE(output[k] == static_cast<int>(written - 50 + k));
+			line.read(output.data(), capacity, 20);
+			for (size_t k = 0; k < 20; ++k) REQUIRE(output[k] == static_cast<int>(written - capacity + k));
+		}
+	}
+	SECTION("fractional delays") {
+		delay_line_t<float> line(64);
+		// Both interpolations are exact for a linear ramp
+		for (size_t i = 0; i < 100; ++i) line.write(static_cast<float>(i));
+		const float last = 99.0f;
+		for (float delay = 2.0f; delay <= 60.0f; delay += 0.37f) {
+			REQUIRE(line.read_linear(delay) == Approx(last + 1.0f - delay));
+			REQUIRE(line.read_cubic(delay) == Approx(last + 1.0f - delay));
+		}
+		REQUIRE(line.read_linear(3.0f) == line.read(3));
+		REQUIRE(line.read_cubic(3.0f) == line.read(3));
+
+		// Cubic interpolation of a sine is much closer than the linear one
+		const double step = 0.3;
+		for (size_t i = 0; i < 100; ++i) line.write(static_cast<float>(std::sin(step * i)));
+		double linear_error = 0.0, cubic_error = 0.0;
+		for (float delay = 2.0f; delay <= 60.0f; delay += 0.25f) {
+			const double expected = std::sin(step * (100.0 - delay));
+			linear_error = std::max(linear_error, std::abs(line.read_linear(delay) - expected));
+			cubic_error = std::max(cubic_error, std::abs(line.read_cubic(delay) - expected));
+		}
+		REQUIRE(linear_error < 0.02);
+		REQUIRE(cubic_error < 0.002);
+	}
+}
+
+TEST_CASE("SimpleEchoFilter") {
+	std::mt19937 generator(3);
+	std::uniform_int_distribution<int> distribution(-20000, 20000);
+	std::vector<audio_sample_t> input(20000);
+	for (auto& sample: input) {
+		sample = audio_sample_t(static_cast<int16_t>(distribution(generator)), static_cast<int16_t>(distribution(generator)));
+	}
+	const double decay = 0.4;
+	// Delays shorter and longer than the buffers
+	const double delays[] = {0.001, 0.01, 0.1};
+	for (const double delay: delays) {
+		const size_t delay_samples = static_cast<size_t>(44100 * delay);
+		std::vector<audio_sample_t> expected(input.size());
+		for (size_t i = 0; i < input.size(); ++i) {
+			const audio_sample_t old = i >= delay_samples ? expected[i - delay_samples] : audio_sample_t();
+			expected[i] = (decay * old) + ((1.0 - decay) * input[i]);
+		}
+
+		auto source = std::make_shared<echo_source>(input);
+		SimpleEchoFilter echo(source, delay, decay);
+		audio_buffer_t buffer;
+		buffer.params = audio_params_t(sampling_rate_t::rate_44kHz);
+		const size_t sizes[] = {512, 1, 333, 64, 4096, 17};
+		size_t position = 0;
+		for (size_t i = 0; position < input.size(); ++i) {
+			buffer.data.resize(std::min(sizes[i % 6], input.size() - position));
+			buffer.valid_samples = buffer.data.size();
+			REQUIRE(echo.process(buffer) == error_type_t::ok);
+			for (size_t k = 0; k < buffer.valid_samples; ++k, ++position) {
+				REQUIRE(buffer.data[k].left == expected[position].left);
+				REQUIRE(buffer.data[k].right == expected[position].right);
+			}
+		}
+
+		// After reset there is no echo of the previous samples
+		echo.reset();
+		buffer.data.assign(delay_samples, audio_sample_t());
+		buffer.valid_samples = delay_samples;
+		REQUIRE(echo.process(buffer) == error_type_t::ok);
+		for (size_t k = 0; k < delay_samples; ++k) REQUIRE(buffer.data[k].left == 0);
+	}
+}
+
+}
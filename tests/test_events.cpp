@@ -0,0 +1,175 @@
+/**
+ * @file 	test_events.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/AudioFilter.h"
+#include "iimavlib/RingBuffer.h"
+#include <thread>
+
+namespace iimavlib {
+
+namespace {
+/// Source producing a constant level, which can be changed by its parent
+class level_source: public AudioFilter {
+public:
+	level_source(size_t limit = 0):AudioFilter(pAudioFilter()),level(0),calls(0),limit_(limit),position_(0) {}
+	int16_t level;
+	size_t calls;
+private:
+	error_type_t do_process(audio_buffer_t& buffer) {
+		++calls;
+		// Source of a limited length returns fewer samples at its end
+		if (limit_ && position_ + buffer.valid_samples > limit_) buffer.valid_samples = limit_ - position_;
+		for (size_t i = 0; i < buffer.valid_samples; ++i) buffer.data[i] = audio_sample_t(level, static_cast<int16_t>(position_ + i));
+		position_ += buffer.valid_samples;
+		return error_type_t::ok;
+	}
+	size_t limit_;
+	size_t position_;
+};
+
+/// Filter changing level of its child at scheduled frames
+class level_control: public AudioFilter {
+public:
+	level_control(const std::shared_ptr<level_source>& source):AudioFilter(source),events(64),calls(0),source_(source),frame_(0) {}
+	event_queue_t<int16_t> events;
+	size_t calls;
+private:
+	size_t do_split(const audio_params_t&, size_t count) {
+		event_queue_t<int16_t>::event_t event;
+		while (events.pop(frame_ + 1, event)) source_->level = event.data;
+		return events.distance(frame_, count);
+	}
+	error_type_t do_process(audio_buffer_t& buffer) {
+		++calls;
+		frame_ += buffer.valid_samples;
+		return error_type_t::ok;
+	}
+	std::shared_ptr<level_source> source_;
+	uint64_t frame_;
+};
+
+/// Processes buffers of the given sizes, returning the samples
+std::vector<audio_sample_t> run(AudioFilter& filter, const std::vector<size_t>& sizes)
+{
+	std::vector<audio_sample_t> output;
+	audio_buffer_t buffer;
+	buffer.params = audio_params_t(sampling_rate_t::rate_44kHz);
+	for (const size_t size: sizes) {
+		buffer.data.assign(size, audio_sample_t());
+		buffer.valid_samples = size;
+		REQUIRE(filter.process(buffer) == error_type_t::ok);
+		output.insert(output.end(), buffer.data.begin(), buffer.data.begin() + buffer.valid_samples);
+		if (buffer.valid_samples < size) break;
+	}
+	return output;
+}
+}
+
+TEST_CASE("event_queue_t") {
+	SECTION("order") {
+		event_queue_t<int> queue(8);
+		const uint64_t frames[] = {50, 10, 30, 10, 70, 30};
+		for (int i = 0; i < 6; ++i) REQUIRE(queue.push(frames[i], i));
+		REQUIRE(queue.next_frame() == 10);
+		REQUIRE(queue.distance(4, 100) == 6);
+		REQUIRE(queue.distance(4, 3) == 3);
+		REQUIRE(queue.distance(10, 100) == 0);
+		event_queue_t<int>::event_t event;
+		REQUIRE(!queue.pop(10, event));
+		// Events with the same frame in the order they were pushed
+		const int expected[] = {1, 3, 2, 5, 0};
+		for (const int data: expected) {
+			REQUIRE(queue.pop(51, event));
+			REQUIRE(event.data == data);
+			REQUIRE(event.frame == frames[data]);
+		}
+		REQUIRE(!queue.pop(51, event));
+		REQUIRE(queue.next_frame() == 70);
+		queue.clear();
+		REQUIRE(queue.next_frame() == std::numeric_limits<uint64_t>::max());
+		REQUIRE(queue.distance(0, 100) == 100);
+	}
+	SECTION("full") {
+		event_queue_t<int> queue(4);
+		for (int i = 0; i < 4; ++i) REQUIRE(queue.push(i, i));
+		REQUIRE(!queue.push(10, 10));
+		REQUIRE(queue.dropped() == 1);
+		// The pending events are taken from the lock-free queue, so there's space for more
+		REQUIRE(queue.next_frame() == 0);
+		REQUIRE(queue.push(10, 10));
+		REQUIRE(queue.next_frame() == 0);
+		REQUIRE(queue.dropped() == 2);
+	}
+	SECTION("producers") {
+		// Events from several threads come out sorted by their frames
+		event_queue_t<int> queue(4096);
+		std::vector<std::thread> producers;
+		for (int t = 0; t < 4; ++t) {
+			producers.push_back(std::thread([&queue, t]() {
+				for (int i = 0; i < 500; ++i) while (!queue.push(static_cast<uint64_t>((i * 7919 + t * 104729) % 3000), t * 1000 + i)) {}
+			}));
+		}
+		for (auto& producer: producers) producer.join();
+		event_queue_t<int>::event_t event;
+		uint64_t last = 0;
+		size_t count = 0;
+		while (queue.pop(std::numeric_limits<uint64_t>::max(), event)) {
+			REQUIRE(event.frame >= last);
+			last = event.frame;
+			++count;
+		}
+		REQUIRE(count == 2000);
+	}
+}
+
+TEST_CASE("AudioFilter splitting") {
+	SECTION("events") {
+		// Changes land on the exact samples, regardless of the buffer sizes
+		const std::vector<size_t> sizes = {512, 100, 1, 3000, 64};
+		auto source = std::make_shared<level_source>();
+		level_control control(source);
+		const uint64_t frames[] = {0, 5, 511, 512, 513, 613, 2000, 2001};
+		for (size_t i = 0; i < 8; ++i) control.events.push(frames[i], static_cast<int16_t>(i + 1));
+		const auto output = run(control, sizes);
+		REQUIRE(output.size() == 3677);
+		int16_t expected = 0;
+		for (size_t i = 0; i < output.size(); ++i) {
+			for (size_t k = 0; k < 8; ++k) if (frames[k] == i) expected = static_cast<int16_t>(k + 1);
+			REQUIRE(output[i].left == expected);
+			REQUIRE(output[i].right == static_cast<int16_t>(i));
+		}
+		REQUIRE(control.calls == source->calls);
+	}
+	SECTION("no events") {
+		// Buffers without events are processed at once
+		auto source = std::make_shared<level_source>();
+		level_control control(source);
+		run(control, std::vector<size_t>(5, 256));
+		REQUIRE(control.calls == 5);
+		REQUIRE(source->calls == 5);
+		// A late event happens at the beginning of the next buffer
+		control.events.push(100, 7);
+		const auto output = run(control, std::vector<size_t>(1, 256));
+		REQUIRE(control.calls == 6);
+		REQUIRE(output.front().left == 7);
+	}
+	SECTION("short source") {
+		// The processing stops when the source runs out of samples
+		auto source = std::make_shared<level_source>(700);
+		level_control control(source);
+		control.events.push(300, 1);
+		control.events.push(690, 2);
+		const auto output = run(control, std::vector<size_t>(3, 512));
+		REQUIRE(output.size() == 700);
+		REQUIRE(output[299].left == 0);
+		REQUIRE(output[300].left == 1);
+		REQUIRE(output[690].left == 2);
+	}
+}
+
+}
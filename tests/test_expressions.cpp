@@ -0,0 +1,52 @@
+/**
+ * @file 	test_expressions.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/ArrayExpressions.h"
+#include "iimavlib/FFT.h"
+
+namespace iimavlib {
+
+TEST_CASE("Array expressions") {
+	const std::vector<float> a = {1.0f, 4.0f, 9.0f, 16.0f};
+	const std::vector<float> b = {2.0f, 2.0f, 3.0f, 0.5f};
+
+	SECTION("arithmetic") {
+		REQUIRE(evaluate(lazy(a) + lazy(b)) == std::vector<float>({3.0f, 6.0f, 12.0f, 16.5f}));
+		REQUIRE(evaluate(lazy(a) - lazy(b) * 2.0f) == std::vector<float>({-3.0f, 0.0f, 3.0f, 15.0f}));
+		REQUIRE(evaluate(1.0f / lazy(b)) == std::vector<float>({0.5f, 0.5f, 1.0f / 3.0f, 2.0f}));
+		REQUIRE(evaluate(-sqrt(lazy(a))) == std::vector<float>({-1.0f, -2.0f, -3.0f, -4.0f}));
+		REQUIRE(evaluate(clamp(lazy(a) - 5.0f, 0.0f, 10.0f)) == std::vector<float>({0.0f, 0.0f, 4.0f, 10.0f}));
+		REQUIRE(evaluate<int>(max(lazy(a), 5.0f)) == std::vector<int>({5, 5, 9, 16}));
+		// Operator + on vectors is still a concatenation
+		REQUIRE((a + b).size() == 8);
+	}
+	SECTION("complex") {
+		const complexarray_t<float> spectrum = {{3.0f, 4.0f}, {0.0f, -1.0f}, {-8.0f, 6.0f}, {0.25f, 0.0f}};
+		REQUIRE(evaluate(abs(lazy(spectrum))) == std::vector<float>({5.0f, 1.0f, 10.0f, 0.25f}));
+		REQUIRE(evaluate(norm(lazy(spectrum))) == std::vector<float>({25.0f, 1.0f, 100.0f, 0.0625f}));
+		REQUIRE((powerSpectrum<float, int>(spectrum) == std::vector<int>({5, 1, 10, 0})));
+
+		std::vector<float> db(4);
+		const auto data = db.data();
+		assign(db, clamp(20.0f * log10(abs(lazy(spectrum)) * 0.1f), -30.0f, 0.0f));
+		REQUIRE(db.data() == data);
+		REQUIRE(db[0] == Approx(-6.0206f));
+		REQUIRE(db[1] == Approx(-20.0f));
+		REQUIRE(db[2] == Approx(0.0f));
+		REQUIRE(db[3] == -30.0f);
+	}
+	SECTION("views") {
+		std::vector<float> storage(6, -1.0f);
+		assign(array_view_t<float>(storage).subview(1, 4), lazy(a) * lazy(array_view_t<const float>(b)));
+		REQUIRE(storage == std::vector<float>({-1.0f, 2.0f, 8.0f, 27.0f, 8.0f, -1.0f}));
+		REQUIRE_THROWS(assign(array_view_t<float>(storage), lazy(a) + 1.0f));
+		REQUIRE_THROWS(lazy(a) + lazy(storage));
+	}
+}
+
+}
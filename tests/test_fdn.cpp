@@ -0,0 +1,138 @@
+/**
+ * @file 	test_fdn.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/filters/FDNReverb.h"
+#include <cmath>
+#include <limits>
+
+namespace iimavlib {
+
+namespace {
+/// Processes an impulse in the left channel followed by silence, returning both channels as floats
+void impulse_response(FDNReverb& reverb, size_t count, std::vector<float>& left, std::vector<float>& right)
+{
+	audio_buffer_t buffer;
+	buffer.params = audio_params_t(sampling_rate_t::rate_44kHz);
+	left.clear();
+	right.clear();
+	for (size_t position = 0; position < count; position += buffer.valid_samples) {
+		buffer.data.assign(std::min<size_t>(512, count - position), audio_sample_t());
+		buffer.valid_samples = buffer.data.size();
+		if (position == 0) buffer.data[0] = audio_sample_t(10000, 0);
+		REQUIRE(reverb.process(buffer) == error_type_t::ok);
+		for (size_t i = 0; i < buffer.valid_samples; ++i) {
+			left.push_back(buffer.data[i].left);
+			right.push_back(buffer.data[i].right);
+		}
+	}
+}
+
+/// Energy of both channels in interval <start, start + length) in decibels
+double energy_db(const std::vector<float>& left, const std::vector<float>& right, size_t start, size_t length)
+{
+	double sum = 0.0;
+	for (size_t i = start; i < start + length; ++i) sum += left[i] * left[i] + right[i] * right[i];
+	return 10.0 * std::log10(sum);
+}
+}
+
+TEST_CASE("FDNReverb") {
+	const size_t rate = 44100;
+	SECTION("decay") {
+		// Without damping, the energy decays by 60 dB per decay time for both matrices and sizes
+		const fdn_matrix_t matrices[] = {fdn_matrix_t::householder, fdn_matrix_t::hadamard};
+		const size_t sizes[] = {8, 16};
+		for (const auto matrix: matrices) {
+			for (const size_t lines: sizes) {
+				fdn_params_t params(lines, 1.0, 1.0, 1.0, 0.0);
+				params.matrix = matrix;
+				params.modulation_depth = 0.0;
+				FDNReverb reverb(pAudioFilter(), params);
+				std::vector<float> left, right;
+				impulse_response(reverb, rate, left, right);
+				// Nothing before the shortest line
+				REQUIRE(energy_db(left, right, 0, rate / 40) == -std::numeric_limits<double>::infinity());
+				const double early = energy_db(left, right, rate / 5, rate / 10);
+				const double late = energy_db(left, right, rate * 7 / 10, rate / 10);
+				REQUIRE(early - late == Approx(30.0).epsilon(0.1));
+				// Both channels are reverberated
+				REQUIRE(energy_db(right, right, rate / 5, rate / 10) > early - 6.0);
+			}
+		}
+	}
+	SECTION("damping") {
+		// High frequencies decay faster, so the tail is smoother than the beginning
+		fdn_params_t params(8, 1.0, 0.2, 1.0, 0.0);
+		FDNReverb reverb(pAudioFilter(), params);
+		REQUIRE(reverb.get_reverb_params().damping == 0.2);
+		std::vector<float> left, right;
+		impulse_response(reverb, rate, left, right);
+		auto roughness = [&left](size_t start) {
+			double difference = 0.0, energy = 0.0;
+			for (size_t i = start; i < start + rate / 10; ++i) {
+				difference += (left[i] - left[i - 1]) * (left[i] - left[i - 1]);
+				energy += left[i] * left[i];
+			}
+			return difference / energy;
+		};
+		REQUIRE(roughness(rate / 30) > 4.0 * roughness(rate / 5));
+	}
+	SECTION("modulation and reset") {
+		FDNReverb reverb(pAudioFilter(), fdn_params_t(16, 3.0, 0.5, 1.0, 0.0));
+		std::vector<float> left, right;
+		impulse_response(reverb, rate / 2, left, right);
+		const double level = energy_db(left, right, rate / 5, rate / 10);
+		REQUIRE(level > 60.0);
+		// The modulation neither amplifies nor kills the tail, which decays by 4 dB at low frequencies
+		const double decay = level - energy_db(left, right, rate * 4 / 10, rate / 10);
+		REQUIRE(decay > 3.0);
+		REQUIRE(decay < 10.0);
+
+		reverb.reset();
+		audio_buffer_t buffer;
+		buffer.params = audio_params_t(sampling_rate_t::rate_44kHz);
+		buffer.data.assign(512, audio_sample_t());
+		buffer.valid_samples = buffer.data.size();
+		REQUIRE(reverb.process(buffer) == error_type_t::ok);
+		for (const auto& sample: buffer.data) REQUIRE((sample.left == 0 && sample.right == 0));
+	}
+	SECTION("small size") {
+		// Lines of a few samples, the modulation is limited so that the interpolation stays inside them
+		fdn_params_t params(8, 0.05, 0.5, 1.0, 0.0);
+		params.size = 0.001;
+		params.modulation_depth = 1.0;
+		FDNReverb reverb(pAudioFilter(), params);
+		std::vector<float> left, right;
+		impulse_response(reverb, rate / 2, left, right);
+		REQUIRE(energy_db(left, right, 0, rate / 100) > 60.0);
+		for (size_t i = rate / 4; i < rate / 2; ++i) REQUIRE((left[i] == 0 && right[i] == 0));
+	}
+	SECTION("dry") {
+		FDNReverb reverb(pAudioFilter(), fdn_params_t(8, 2.0, 0.5, 0.0, 1.0));
+		audio_buffer_t buffer;
+		buffer.params = audio_params_t(sampling_rate_t::rate_44kHz);
+		for (size_t block = 0; block < 10; ++block) {
+			buffer.data.resize(300);
+			for (size_t i = 0; i < buffer.data.size(); ++i) buffer.data[i] = audio_sample_t(static_cast<int16_t>(i * 100), -7);
+			buffer.valid_samples = buffer.data.size();
+			REQUIRE(reverb.process(buffer) == error_type_t::ok);
+			for (size_t i = 0; i < buffer.data.size(); ++i) {
+				REQUIRE(buffer.data[i].left == static_cast<int16_t>(i * 100));
+				REQUIRE(buffer.data[i].right == -7);
+			}
+		}
+	}
+	SECTION("invalid parameters") {
+		REQUIRE_THROWS((FDNReverb{pAudioFilter(), fdn_params_t(12)}));
+		REQUIRE_THROWS((FDNReverb{pAudioFilter(), fdn_params_t(8, 0.0)}));
+		REQUIRE_THROWS((FDNReverb{pAudioFilter(), fdn_params_t(8, 2.0, 0.0)}));
+		REQUIRE_THROWS((FDNReverb{pAudioFilter(), fdn_params_t(8, 2.0, 1.5)}));
+	}
+}
+
+}
@@ -13,6 +13,7 @@
 #include "iimavlib/AudioFFT.h"
 #include <iostream>
 #include <algorithm>
+#include <numeric>
 namespace iimavlib {
 
 namespace {
@@ -123,4 +124,229 @@ TEST_CASE("FFT") {
 
 }
 
+TEST_CASE("fft_plan_t") {
+	REQUIRE_THROWS(fft_plan_t<float>{0});
+	const double pi = 4.0 * std::atan(1.0);
+	for (size_t size = 1; size <= 2048; size *= 2) {
+		// Compare with direct evaluation of DFT, including phase
+		complexarray_t<double> input(size);
+		for (size_t i = 0; i < size; ++i) input[i] = std::complex<double>(std::sin(i * 0.37) + 0.1 * i, std::cos(i * 1.3));
+		complexarray_t<double> expected(size);
+		for (size_t k = 0; k < size; ++k) {
+			for (size_t n = 0; n < size; ++n) expected[k] += input[n] * std::polar(1.0, -2.0 * pi * ((k * n) % size) / size);
+		}
+		fft_plan_t<double> plan(size);
+		complexarray_t<double> out(size);
+		plan.transform(input.data(), out.data());
+		double error = 0.0;
+		for (size_t k = 0; k < size; ++k) error = std::max(error, std::abs(out[k] - expected[k]));
+		REQUIRE(error < 1e-9 * size);
+		// In-place transform gives the same result
+		plan.transform(input.data());
+		REQUIRE(input == out);
+	}
+	// Repeated transforms reuse the cached plan and the output buffer
+	FFT<float> fft;
+	simplearray_t<float> signal(1024, 1.0f);
+	complexarray_t<float> result;
+	fft.FFT1D(signal, result);
+	const auto* plan = &fft.plan(1024);
+	const auto* data = result.data();
+	fft.FFT1D(signal, result);
+	REQUIRE(&fft.plan(1024) == plan);
+	REQUIRE(result.data() == data);
+	REQUIRE(std::abs(result[0] - std::complex<float>(1024.0f, 0.0f)) < 1e-3f);
+}
+
+template<class T>
+void check_vectorized_fft(size_t size, double precision)
+{
+	// long double has no vectorized butterflies, so it serves as a scalar reference
+	fft_plan_t<long double> reference_plan(size);
+	fft_plan_t<T> plan(size);
+	complexarray_t<long double> reference_input(size), reference(size);
+	complexarray_t<T> input(size), out(size);
+	for (size_t i = 0; i < size; ++i) {
+		input[i] = std::complex<T>(static_cast<T>(std::sin(i * 0.37)), static_cast<T>(std::cos(i * 1.3) - 0.25));
+		reference_input[i] = std::complex<long double>(input[i].real(), input[i].imag());
+	}
+	reference_plan.transform(reference_input.data(), reference.data());
+	plan.transform(input.data(), out.data());
+	double error = 0.0;
+	for (size_t k = 0; k < size; ++k) {
+		error = std::max(error, static_cast<double>(std::abs(std::complex<long double>(out[k].real(), out[k].imag()) - reference[k])));
+	}
+	REQUIRE(error < precision * std::sqrt(static_cast<double>(size)));
+	plan.transform(input.data());
+	REQUIRE(std::equal(input.begin(), input.end(), out.begin()));
+}
+
+TEST_CASE("fft arbitrary sizes") {
+	REQUIRE(fft_plan_t<float>(1024).algorithm() == fft_algorithm_t::power_of_2);
+	REQUIRE(fft_plan_t<float>(4410).algorithm() == fft_algorithm_t::mixed_radix);
+	REQUIRE(fft_plan_t<float>(1021).algorithm() == fft_algorithm_t::bluestein);
+	const double pi = 4.0 * std::atan(1.0);
+	std::vector<size_t> sizes;
+	for (size_t size = 1; size <= 100; ++size) sizes.push_back(size);
+	// 3 * 5 * 7 * 2^k, large primes and their multiples
+	const size_t others[] = {105 * 16, 441, 1000, 1021, 2 * 1021, 4410, 7 * 7 * 7 * 3};
+	sizes.insert(sizes.end(), std::begin(others), std::end(others));
+	for (const auto size: sizes) {
+		complexarray_t<double> roots(size);
+		for (size_t i = 0; i < size; ++i) roots[i] = std::polar(1.0, -2.0 * pi * i / size);
+		complexarray_t<double> input(size);
+		for (size_t i = 0; i < size; ++i) input[i] = std::complex<double>(std::sin(i * 0.37) + 0.01 * i, std::cos(i * 1.3));
+		complexarray_t<double> expected(size);
+		for (size_t k = 0; k < size; ++k) {
+			for (size_t n = 0; n < size; ++n) expected[k] += input[n] * roots[(k * n) % size];
+		}
+		fft_plan_t<double> plan(size);
+		complexarray_t<double> out(size), back(size);
+		plan.transform(input.data(), out.data());
+		double error = 0.0;
+		for (size_t k = 0; k < size; ++k) error = std::max(error, std::abs(out[k] - expected[k]));
+		REQUIRE(error < 1e-10 * size);
+		plan.inverse(out.data(), back.data());
+		error = 0.0;
+		for (size_t i = 0; i < size; ++i) error = std::max(error, std::abs(back[i] - input[i]));
+		REQUIRE(error < 1e-12 * size);
+		plan.transform(input.data());
+		for (size_t k = 0; k < size; ++k) REQUIRE(std::abs(input[k] - out[k]) < 1e-12 * size);
+
+		// Single precision, compared with the double precision result
+		fft_plan_t<float> float_plan(size);
+		complexarray_t<float> float_out(size);
+		simplearray_t<float> real_input(size);
+		for (size_t i = 0; i < size; ++i) real_input[i] = static_cast<float>(std::sin(i * 0.37) + 0.01 * i);
+		float_plan.transform(real_input.data(), float_out.data());
+		complexarray_t<double> double_out(size);
+		simplearray_t<double> double_input(real_input.begin(), real_input.end());
+		plan.transform(double_input.data(), double_out.data());
+		error = 0.0;
+		for (size_t k = 0; k < size; ++k) {
+			error = std::max(error, std::abs(std::complex<double>(float_out[k].real(), float_out[k].imag()) - double_out[k]));
+		}
+		REQUIRE(error < 1e-5 * size);
+
+		if (size & 1) continue;
+		real_fft_plan_t<double> real_plan(size);
+		complexarray_t<double> bins(real_plan.bins());
+		real_plan.transform(double_input.data(), bins.data());
+		for (size_t k = 0; k < bins.size(); ++k) REQUIRE(std::abs(bins[k] - double_out[k]) < 1e-10 * size);
+		simplearray_t<double> real_back(size);
+		real_plan.inverse(bins.data(), real_back.data());
+		for (size_t i = 0; i < size; ++i) REQUIRE(std::abs(real_back[i] - double_input[i]) < 1e-12 * size);
+	}
+	SECTION("scratch buffer") {
+		// A buffer reused for several transforms gives the same results as the allocated one
+		REQUIRE(real_fft_plan_t<float>(1024).work_size() == 0);
+		const real_fft_plan_t<float> plan(3088);
+		REQUIRE(plan.work_size() >= 2 * 1544);
+		complexarray_t<float> work(plan.work_size(), std::complex<float>(1e6f, -1e6f));
+		simplearray_t<float> input(plan.size()), back(plan.size());
+		complexarray_t<float> expected(plan.bins()), bins(plan.bins());
+		for (int repeat = 0; repeat < 2; ++repeat) {
+			for (size_t i = 0; i < input.size(); ++i) input[i] = static_cast<float>(std::sin(i * 0.1 * (repeat + 1)));
+			plan.transform(input.data(), expected.data());
+			plan.transform(input.data(), bins.data(), work.data());
+			for (size_t k = 0; k < bins.size(); ++k) REQUIRE(bins[k] == expected[k]);
+			plan.inverse(bins.data(), back.data(), work.data());
+			for (size_t i = 0; i < input.size(); ++i) REQUIRE(std::abs(back[i] - input[i]) < 1e-4);
+		}
+	}
+}
+
+TEST_CASE("fft vectorized butterflies") {
+	REQUIRE_FALSE(fft_plan_t<long double>(1024).vectorized());
+	for (size_t size = 1; size <= 65536; size *= 2) {
+		check_vectorized_fft<float>(size, 1e-5);
+		check_vectorized_fft<double>(size, 1e-13);
+	}
+}
+
+TEST_CASE("real_fft_plan_t") {
+	REQUIRE_THROWS(real_fft_plan_t<float>{1});
+	REQUIRE_THROWS(real_fft_plan_t<float>{13});
+	for (size_t size = 2; size <= 4096; size *= 2) {
+		simplearray_t<double> first(size), second(size);
+		for (size_t i = 0; i < size; ++i) {
+			first[i] = std::sin(i * 0.21) + 0.01 * i;
+			second[i] = std::cos(i * 2.7) - 0.5;
+		}
+		fft_plan_t<double> plan(size);
+		complexarray_t<double> expected_first(size), expected_second(size);
+		plan.transform(first.data(), expected_first.data());
+		plan.transform(second.data(), expected_second.data());
+
+		real_fft_plan_t<double> real_plan(size);
+		REQUIRE(real_plan.bins() == size / 2 + 1);
+		complexarray_t<double> result(real_plan.bins());
+		real_plan.transform(first.data(), result.data());
+		for (size_t k = 0; k < result.size(); ++k) REQUIRE(std::abs(result[k] - expected_first[k]) < 1e-9 * size);
+
+		// Two signals in one complex transform
+		complexarray_t<double> packed(size);
+		for (size_t i = 0; i < size; ++i) packed[i] = std::complex<double>(first[i], second[i]);
+		complexarray_t<double> result_first(size / 2 + 1), result_second(size / 2 + 1);
+		plan.transform_pair(packed.data(), result_first.data(), result_second.data());
+		for (size_t k = 0; k <= size / 2; ++k) {
+			REQUIRE(std::abs(result_first[k] - expected_first[k]) < 1e-9 * size);
+			REQUIRE(std::abs(result_second[k] - expected_second[k]) < 1e-9 * size);
+		}
+	}
+}
+
+TEST_CASE("inverse FFT") {
+	FFT<double> fft;
+	for (size_t size = 1; size <= 4096; size *= 2) {
+		complexarray_t<double> input(size);
+		simplearray_t<double> real_input(size);
+		for (size_t i = 0; i < size; ++i) {
+			input[i] = std::complex<double>(std::sin(i * 0.37) + 0.1 * i, std::cos(i * 1.3));
+			real_input[i] = std::cos(i * 0.11) - 0.002 * i;
+		}
+		const auto output = fft.IFFT1D(fft.FFT1D(real_input));
+		for (size_t i = 0; i < size; ++i) REQUIRE(std::abs(output[i] - real_input[i]) < 1e-12 * size);
+
+		fft_plan_t<double> plan(size);
+		complexarray_t<double> spectrum(size), back(size);
+		plan.transform(input.data(), spectrum.data());
+		plan.inverse(spectrum.data(), back.data());
+		plan.inverse(spectrum.data());
+		for (size_t i = 0; i < size; ++i) {
+			REQUIRE(std::abs(back[i] - input[i]) < 1e-12 * size);
+			REQUIRE(spectrum[i] == back[i]);
+		}
+		if (size < 2) continue;
+		const auto real_output = fft.IRFFT1D(fft.RFFT1D(real_input));
+		REQUIRE(real_output.size() == size);
+		for (size_t i = 0; i < size; ++i) REQUIRE(std::abs(real_output[i] - real_input[i]) < 1e-12 * size);
+	}
+}
+
+TEST_CASE("AudioFFT") {
+	std::vector<audio_sample_t> samples(512);
+	for (size_t i = 0; i < samples.size(); ++i) {
+		samples[i] = audio_sample_t(static_cast<int16_t>(1000 * std::sin(i * 0.3)), static_cast<int16_t>(i % 37));
+	}
+	AudioFFT<float> fft;
+	const auto full = fft.FFT1D(samples.begin(), samples.end());
+	complexarray_t<float> half;
+	fft.RFFT1D(samples.begin(), samples.end(), half);
+	REQUIRE(half.size() == 257);
+	for (size_t k = 0; k < half.size(); ++k) REQUIRE(std::abs(half[k] - full[k]) < 0.1f);
+
+	complexarray_t<float> left, right;
+	fft.StereoFFT1D(samples.begin(), samples.end(), left, right);
+	REQUIRE(left.size() == 257);
+	REQUIRE(right.size() == 257);
+	std::vector<float> right_channel(samples.size());
+	std::transform(samples.begin(), samples.end(), right_channel.begin(), [](const audio_sample_t& s){return s.right;});
+	const auto right_full = FFT<float>().FFT1D(right_channel);
+	for (size_t k = 0; k < left.size(); ++k) {
+		REQUIRE(std::abs(left[k] - full[k]) < 0.1f);
+		REQUIRE(std::abs(right[k] - right_full[k]) < 0.1f);
+	}
+}
+
 }
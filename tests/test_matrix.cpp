@@ -9,6 +9,7 @@
 
 #include "iimavlib/catch/catch.hpp"
 #include "iimavlib/ArrayTypes.h"
+#include <random>
 
 namespace iimavlib {
 namespace {
@@ -22,6 +23,41 @@ const std::vector<int> seq_0_9_trans_5_2 {0, 2, 4, 6, 8, 1, 3, 5, 7, 9};
 
 const std::vector<int> seq_2_2_mult_2_2 {2, 3, 6, 11};
 const std::vector<int> seq_3_3_mult_1_3 {5, 14, 23};
+
+template<class T>
+matrix<T> random_matrix(int rows, int columns, std::mt19937& generator)
+{
+	std::uniform_int_distribution<int> distribution(-8, 8);
+	matrix<T> result(rows, columns);
+	for (int i = 0; i < rows * columns; ++i) result[i] = static_cast<T>(distribution(generator));
+	return result;
+}
+
+/// Reference multiplication, the values are small integers, so the results are exact
+template<class T>
+matrix<T> naive_multiply(const matrix<T>& a, const matrix<T>& b)
+{
+	matrix<T> result(a.rows(), b.columns());
+	for (int i = 0; i < a.rows(); ++i)
+		for (int j = 0; j < b.columns(); ++j)
+			for (int k = 0; k < a.columns(); ++k)
+				result(i, j) += a(i, k) * b(k, j);
+	return result;
+}
+
+template<class T>
+void check_multiply(std::mt19937& generator)
+{
+	// Sizes around the vector widths and the cache blocks
+	const int sizes[][3] = {{1, 1, 1}, {3, 5, 2}, {4, 8, 16}, {7, 17, 9}, {33, 300, 129}, {5, 1, 300}, {130, 257, 19}};
+	for (const auto& size: sizes) {
+		const auto a = random_matrix<T>(size[0], size[1], generator);
+		const auto b = random_matrix<T>(size[1], size[2], generator);
+		REQUIRE((a * b).data() == naive_multiply(a, b).data());
+		const auto x = random_matrix<T>(size[1], 1, generator);
+		REQUIRE((a * x.data()).data() == naive_multiply(a, x).data());
+	}
+}
 }
 TEST_CASE("Matrix") {
 	SECTION("Initialization") {
@@ -114,8 +150,79 @@ TEST_CASE("Matrix") {
 				auto res = mat_3_3 * simple_1_3;
 				REQUIRE(res.data() == seq_3_3_mult_1_3);
 			}
+			SECTION("blocked") {
+				std::mt19937 generator(3);
+				check_multiply<float>(generator);
+				check_multiply<double>(generator);
+				check_multiply<int>(generator);
+			}
+			SECTION("complex by real") {
+				matrix<std::complex<float>> m(2, 2);
+				m.set(0, 0, {1, 1});
+				m.set(0, 1, {0, 2});
+				m.set(1, 0, {3, 0});
+				m.set(1, 1, {-1, -1});
+				simplearray_t<float> v = {2, 1};
+				const complexarray_t<float> expected = {{2, 4}, {5, -1}};
+				REQUIRE((m * v).data() == expected);
+			}
+			SECTION("wrong dimensions") {
+				matrix<float> a(2, 3), b(2, 3);
+				REQUIRE_THROWS(a * b);
+				REQUIRE_THROWS(a * simplearray_t<float>(2));
+			}
+		}
+		SECTION("Transposition") {
+			const int sizes[][2] = {{1, 7}, {7, 1}, {40, 40}, {3, 100}, {100, 3}, {37, 64}, {65, 33}};
+			for (const auto& size: sizes) {
+				matrix<int> m(size[0], size[1]);
+				m.sequence();
+				const auto copy = m.transpose();
+				const auto data = m.data().data();
+				m.self_transpose();
+				REQUIRE(m.data().data() == data);
+				REQUIRE(m.rows() == size[1]);
+				REQUIRE(m.columns() == size[0]);
+				REQUIRE(m.data() == copy.data());
+				for (int i = 0; i < size[0]; ++i)
+					for (int j = 0; j < size[1]; ++j)
+						REQUIRE(m(j, i) == i * size[1] + j);
+			}
 		}
 	}
+	SECTION("Views") {
+		std::vector<float> storage(6 * 5);
+		for (size_t i = 0; i < storage.size(); ++i) storage[i] = static_cast<float>(i);
+		matrix_view_t<float> whole(array_view_t<float>(storage), 6, 5);
+		REQUIRE_THROWS((matrix_view_t<float>{array_view_t<float>(storage), 4, 4}));
+		const auto block = whole.block(1, 2, 3, 2);
+		REQUIRE(block.stride() == 5);
+		REQUIRE(!block.contiguous());
+		REQUIRE(block(0, 0) == 7.0f);
+		REQUIRE(block(2, 1) == 18.0f);
+		REQUIRE(block.row(1).size() == 2);
+		REQUIRE(block.row(1)[0] == 12.0f);
+
+		// Block of the storage multiplied into another block of it
+		matrix<float> b(2, 2);
+		b.sequence();
+		multiply(matrix_view_t<const float>(block.block(0, 0, 2, 2)), b.view(), whole.block(4, 0, 2, 2));
+		REQUIRE(storage[20] == 2.0f * 8.0f);
+		REQUIRE(storage[21] == 7.0f + 3.0f * 8.0f);
+		REQUIRE(storage[25] == 2.0f * 13.0f);
+		REQUIRE(storage[26] == 12.0f + 3.0f * 13.0f);
+		REQUIRE(storage[22] == 22.0f);
+
+		std::vector<float> y(3);
+		const std::vector<float> x = {1.0f, -1.0f};
+		multiply(block, array_view_t<const float>(x), array_view_t<float>(y));
+		REQUIRE(y == std::vector<float>({-1.0f, -1.0f, -1.0f}));
+		REQUIRE_THROWS(multiply(block, array_view_t<const float>(y), array_view_t<float>(y)));
+
+		matrix<float> t(2, 3);
+		transpose(block, t.view());
+		REQUIRE(t.data() == std::vector<float>({7.0f, 12.0f, 17.0f, 8.0f, 13.0f, 18.0f}));
+	}
 
 }
 
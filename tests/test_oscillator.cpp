@@ -0,0 +1,160 @@
+/**
+ * @file 	test_oscillator.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/Oscillator.h"
+#include <cmath>
+
+namespace iimavlib {
+
+namespace {
+const double pi2 = 2.0 * 3.14159265358979323846;
+
+/// Naive (aliasing) waveforms for a phase in interval <0, 1)
+double naive_wave(waveform_t waveform, double t)
+{
+	switch (waveform) {
+		case waveform_t::sine: return std::sin(pi2 * t);
+		case waveform_t::sawtooth: return t < 0.5 ? 2.0 * t : 2.0 * t - 2.0;
+		case waveform_t::square: return t < 0.5 ? 1.0 : -1.0;
+		case waveform_t::triangle: return t < 0.25 ? 4.0 * t : (t < 0.75 ? 2.0 - 4.0 * t : 4.0 * t - 4.0);
+	}
+	return 0.0;
+}
+
+/// Power of a signal at a frequency (in periods per sample)
+double power(const std::vector<float>& signal, double frequency)
+{
+	double re = 0.0, im = 0.0;
+	for (size_t i = 0; i < signal.size(); ++i) {
+		// Hann window, so the strong harmonics don't leak to the other frequencies
+		const double window = 0.5 - 0.5 * std::cos(pi2 * i / signal.size());
+		re += window * signal[i] * std::cos(pi2 * frequency * i);
+		im += window * signal[i] * std::sin(pi2 * frequency * i);
+	}
+	return re * re + im * im;
+}
+}
+
+TEST_CASE("Oscillator") {
+	const double rate = 44100.0;
+	const waveform_t waveforms[] = {waveform_t::sine, waveform_t::sawtooth, waveform_t::square, waveform_t::triangle};
+	SECTION("sine") {
+		// A long run with an unaligned frequency, the phase doesn't drift
+		Oscillator oscillator(waveform_t::sine, 440.7);
+		std::vector<float> output(1000);
+		for (size_t block = 0; block < 300; ++block) {
+			oscillator.generate(output.data(), output.size(), rate);
+			for (size_t i = 0; i < output.size(); ++i) {
+				const double n = static_cast<double>(block * output.size() + i);
+				REQUIRE(std::abs(output[i] - std::sin(pi2 * std::fmod(440.7 * n / rate, 1.0))) < 1e-5);
+			}
+		}
+	}
+	SECTION("blocks") {
+		// Generating in blocks of any size gives the same signal as a single block
+		for (const auto waveform: waveforms) {
+			Oscillator whole(waveform, 1234.5, 0.3), parts(waveform, 1234.5, 0.3);
+			std::vector<float> expected(3000), output(3000);
+			whole.generate(expected.data(), expected.size(), rate);
+			const size_t sizes[] = {1, 7, 64, 3, 333, 16};
+			for (size_t i = 0, position = 0; position < output.size(); ++i) {
+				const size_t count = std::min(sizes[i % 6], output.size() - position);
+				parts.generate(output.data() + position, count, rate);
+				position += count;
+			}
+			for (size_t i = 0; i < output.size(); ++i) REQUIRE(std::abs(output[i] - expected[i]) < 1e-5);
+		}
+	}
+	SECTION("shapes") {
+		// Further than a sample from the edges, the waveforms are the same as the naive ones
+		const double frequency = 100.0;
+		const double dt = frequency / rate;
+		for (const auto waveform: waveforms) {
+			Oscillator oscillator(waveform, frequency);
+			std::vector<float> output(2000, 0.5f);
+			oscillator.add(output.data(), output.size(), rate, 2.0f);
+			for (size_t i = 0; i < output.size(); ++i) {
+				const double t = std::fmod(i * dt, 1.0);
+				bool edge = false;
+				for (double corner = 0.0; corner <= 1.0; corner += 0.25) edge = edge || std::abs(t - corner) < 1.5 * dt;
+				if (edge) continue;
+				REQUIRE(std::abs(output[i] - (0.5 + 2.0 * naive_wave(waveform, t))) < 1e-3);
+			}
+		}
+	}
+	SECTION("aliasing") {
+		// High harmonics of 3 kHz fold back below the Nyquist frequency, far away from the real harmonics
+		const double frequency = 3000.0;
+		const double dt = frequency / rate;
+		const waveform_t aliasing[] = {waveform_t::sawtooth, waveform_t::square, waveform_t::triangle};
+		for (const auto waveform: aliasing) {
+			Oscillator oscillator(waveform, frequency);
+			std::vector<float> output(8820), naive(8820);
+			oscillator.generate(output.data(), output.size(), rate);
+			for (size_t i = 0; i < naive.size(); ++i) naive[i] = static_cast<float>(naive_wave(waveform, std::fmod(i * dt, 1.0)));
+			double aliased = 0.0, naive_aliased = 0.0;
+			for (size_t harmonic = 8; harmonic <= 30; ++harmonic) {
+				double folded = std::fmod(harmonic * dt, 1.0);
+				if (folded > 0.5) folded = 1.0 - folded;
+				aliased += power(output, folded);
+				naive_aliased += power(naive, folded);
+			}
+			REQUIRE(10.0 * std::log10(naive_aliased / aliased) > 10.0);
+			// The fundamental stays the same
+			REQUIRE(power(output, dt) == Approx(power(naive, dt)).epsilon(0.05));
+		}
+	}
+	SECTION("frequency change") {
+		// The phase continues, so there's no jump after changing the frequency
+		Oscillator oscillator(waveform_t::sine, 300.0);
+		std::vector<float> output(1000);
+		oscillator.generate(output.data(), 500, rate);
+		const double phase = oscillator.get_phase();
+		REQUIRE(phase == Approx(std::fmod(500 * 300.0 / rate, 1.0)));
+		oscillator.set_frequency(700.0);
+		oscillator.generate(output.data() + 500, 500, rate);
+		for (size_t i = 500; i < 1000; ++i) {
+			REQUIRE(std::abs(output[i] - std::sin(pi2 * (phase + (i - 500) * 700.0 / rate))) < 1e-5);
+		}
+		oscillator.set_phase(-0.25);
+		REQUIRE(oscillator.get_phase() == 0.75);
+	}
+}
+
+TEST_CASE("OscillatorBank") {
+	const double rate = 48000.0;
+	const waveform_t waveforms[] = {waveform_t::sine, waveform_t::sawtooth, waveform_t::square, waveform_t::triangle};
+	for (const auto waveform: waveforms) {
+		// Number of oscillators not divisible by the vector width
+		const size_t count = 11;
+		OscillatorBank bank(count, waveform);
+		std::vector<Oscillator> oscillators;
+		for (size_t i = 0; i < count; ++i) {
+			bank.set_frequency(i, 110.0 * (i + 1) + 3.3);
+			bank.set_amplitude(i, 1.0f / (i + 1));
+			bank.set_phase(i, 0.1 * i);
+			oscillators.push_back(Oscillator(waveform, 110.0 * (i + 1) + 3.3, 0.1 * i));
+		}
+		std::vector<float> output(4000), expected(4000, 0.0f);
+		const size_t sizes[] = {512, 1, 13, 100, 8};
+		for (size_t i = 0, position = 0; position < output.size(); ++i) {
+			const size_t length = std::min(sizes[i % 5], output.size() - position);
+			bank.generate(output.data() + position, length, rate);
+			position += length;
+		}
+		for (size_t i = 0; i < count; ++i) oscillators[i].add(expected.data(), expected.size(), rate, 1.0f / (i + 1));
+		// The bank accumulates phases in floats for a few hundred samples, which shifts the steep edges slightly
+		for (size_t i = 0; i < output.size(); ++i) REQUIRE(std::abs(output[i] - expected[i]) < 5e-3);
+	}
+	OscillatorBank bank(3);
+	REQUIRE(bank.size() == 3);
+	REQUIRE(bank.get_amplitude(2) == 0.0f);
+	REQUIRE_THROWS(bank.set_frequency(3, 100.0));
+}
+
+}
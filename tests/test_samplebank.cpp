@@ -0,0 +1,155 @@
+/**
+ * @file 	test_samplebank.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/SampleBank.h"
+#include "iimavlib/WaveFile.h"
+#include "iimavlib/CompressedFile.h"
+#include <cstdio>
+
+namespace iimavlib {
+namespace {
+
+std::vector<audio_sample_t> make_samples(size_t count, int16_t offset)
+{
+	std::vector<audio_sample_t> samples(count);
+	for (size_t i = 0; i < count; ++i) {
+		samples[i] = audio_sample_t(static_cast<int16_t>(i + offset), static_cast<int16_t>(offset - i));
+	}
+	return samples;
+}
+
+bool equal_samples(const audio_sample_t& a, const audio_sample_t& b)
+{
+	return a.left == b.left && a.right == b.right;
+}
+
+std::string bank_file(int index)
+{
+	return "test_bank_" + std::to_string(index) + ".wav";
+}
+}
+
+TEST_CASE("SampleBank") {
+	const size_t sample_size = 10000;
+	for (int i = 0; i < 3; ++i) {
+		WaveFile wav(bank_file(i), audio_params_t(sampling_rate_t::rate_44kHz));
+		wav.store_data(make_samples(sample_size, static_cast<int16_t>(i * 100)));
+	}
+	{
+		CompressedFile compressed("test_bank.iac", audio_params_t(sampling_rate_t::rate_48kHz));
+		compressed.store_data(make_samples(5000, 7));
+	}
+
+	SECTION("loading") {
+		SampleBank bank;
+		auto sample = bank.get(bank_file(0));
+		REQUIRE(sample);
+		REQUIRE(bank.wait(sample));
+		REQUIRE(sample->ready());
+		const auto expected = make_samples(sample_size, 0);
+		auto data = sample->data();
+		REQUIRE(data.size() == sample_size);
+		REQUIRE(std::equal(data.begin(), data.end(), expected.begin(), equal_samples));
+		// The same file is loaded only once
+		REQUIRE(bank.get(bank_file(0)) == sample);
+		REQUIRE(bank.get_sample_count() == 1);
+		REQUIRE(bank.get_memory_usage() == sample_size * sizeof(audio_sample_t));
+
+		auto compressed = bank.load("test_bank.iac");
+		REQUIRE(compressed->get_params().rate == sampling_rate_t::rate_48kHz);
+		const auto expected2 = make_samples(5000, 7);
+		REQUIRE(std::equal(compressed->data().begin(), compressed->data().end(), expected2.begin(), equal_samples));
+
+		auto missing = bank.get("nonexistent_file.wav");
+		REQUIRE(!bank.wait(missing));
+		REQUIRE(missing->get_state() == sample_state_t::failed);
+		REQUIRE(missing->data().empty());
+		// The failed sample isn't kept, so a new attempt is made
+		auto retry = bank.get("nonexistent_file.wav");
+		REQUIRE(retry != missing);
+		REQUIRE(!bank.wait(retry));
+		REQUIRE_THROWS(bank.load("nonexistent_file2.wav"));
+	}
+	SECTION("eviction") {
+		// Space for two samples only
+		SampleBank bank(sample_size * sizeof(audio_sample_t) * 2 + 100);
+		auto held = bank.load(bank_file(0));
+		bank.load(bank_file(1));
+		REQUIRE(bank.get_sample_count() == 2);
+		bank.load(bank_file(2));
+		// File 1 wasn't referenced, so it's evicted, file 2 was just loaded by the call above
+		REQUIRE(bank.get_memory_usage() <= sample_size * sizeof(audio_sample_t) * 2);
+		REQUIRE(bank.get_sample_count() == 2);
+		REQUIRE(held->ready());
+		bank.set_memory_budget(0);
+		// Only the referenced sample stays in the bank
+		REQUIRE(bank.get_sample_count() == 1);
+		REQUIRE(bank.get(bank_file(0)) == held);
+	}
+	SECTION("slot") {
+		SampleBank bank;
+		SampleSlot slot;
+		REQUIRE(slot.acquire() == nullptr);
+		auto first = bank.load(bank_file(0));
+		auto second = bank.load(bank_file(1));
+		slot.set(first);
+		REQUIRE(slot.acquire() == first.get());
+		slot.set(second);
+		// The audio thread may still use the first sample
+		REQUIRE(slot.get_retired_count() == 1);
+		first.reset();
+		REQUIRE(slot.acquire() == second.get());
+		slot.collect();
+		REQUIRE(slot.get_retired_count() == 0);
+		second.reset();
+		// Samples held by the slot can't be evicted
+		bank.set_memory_budget(0);
+		REQUIRE(bank.get_sample_count() == 1);
+		REQUIRE(slot.acquire()->ready());
+	}
+	SECTION("streamed") {
+		SampleBank bank;
+		// 0.1s at 44.1kHz
+		auto streamed = bank.load(bank_file(0), 0.1);
+		REQUIRE(streamed->streamed());
+		REQUIRE(streamed->data().size() == 4410);
+		REQUIRE(streamed->get_length() == sample_size);
+		REQUIRE(bank.get_memory_usage() == 4410 * sizeof(audio_sample_t));
+		// Fully loaded variant is stored separately
+		auto full = bank.load(bank_file(0));
+		REQUIRE(full != streamed);
+		REQUIRE(!full->streamed());
+		REQUIRE(full->get_length() == sample_size);
+		// Preload longer than the sample keeps the whole sample
+		auto short_sample = bank.load("test_bank.iac", 1.0);
+		REQUIRE(!short_sample->streamed());
+		REQUIRE(short_sample->data().size() == 5000);
+
+		const auto expected = make_samples(sample_size, 0);
+		REQUIRE(std::equal(streamed->data().begin(), streamed->data().end(), expected.begin(), equal_samples));
+		SampleReader reader(bank_file(0));
+		REQUIRE(reader.get_sample_count() == sample_size);
+		REQUIRE(reader.seek(4410) == error_type_t::ok);
+		std::vector<audio_sample_t> data(10000);
+		REQUIRE(reader.read_data(data) == sample_size - 4410);
+		REQUIRE(std::equal(data.begin(), data.begin() + sample_size - 4410, expected.begin() + 4410, equal_samples));
+		REQUIRE(reader.read_data(data) == 0);
+
+		SampleReader compressed("test_bank.iac");
+		const auto expected2 = make_samples(5000, 7);
+		REQUIRE(compressed.seek(4321) == error_type_t::ok);
+		REQUIRE(compressed.read_data(data, 100) == 100);
+		REQUIRE(compressed.get_position() == 4421);
+		REQUIRE(std::equal(data.begin(), data.begin() + 100, expected2.begin() + 4321, equal_samples));
+		REQUIRE_THROWS(SampleReader{"nonexistent_file.wav"});
+	}
+	for (int i = 0; i < 3; ++i) std::remove(bank_file(i).c_str());
+	std::remove("test_bank.iac");
+}
+
+}
@@ -0,0 +1,115 @@
+/**
+ * @file 	test_spectrogram.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/Spectrogram.h"
+#include "iimavlib/STFT.h"
+#include "iimavlib/WaveFile.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace iimavlib {
+
+namespace {
+const char* spectrogram_file = "test_spectrogram.wav";
+
+std::vector<audio_sample_t> make_noise(size_t count)
+{
+	std::mt19937 generator(3);
+	std::uniform_int_distribution<int> distribution(-8000, 8000);
+	std::vector<audio_sample_t> samples(count);
+	const double pi = 4.0 * std::atan(1.0);
+	for (size_t i = 0; i < count; ++i) {
+		const int tone = static_cast<int>(10000 * std::sin(2.0 * pi * i / 50.0));
+		samples[i] = audio_sample_t(static_cast<int16_t>(tone + distribution(generator)), static_cast<int16_t>(distribution(generator)));
+	}
+	return samples;
+}
+}
+
+TEST_CASE("Spectrogram") {
+	REQUIRE_THROWS(Spectrogram(spectrogram_params_t(101, 10)));
+	REQUIRE_THROWS(Spectrogram(spectrogram_params_t(100, 0)));
+
+	const auto samples = make_noise(50000);
+
+	SECTION("frames") {
+		Spectrogram spectrogram(spectrogram_params_t(1000, 250, window_type_t::hann, 3));
+		REQUIRE(spectrogram.get_threads() == 3);
+		REQUIRE(spectrogram.get_bins() == 501);
+		REQUIRE(spectrogram.get_frame_count(999) == 0);
+		REQUIRE(spectrogram.get_frame_count(1000) == 1);
+		REQUIRE(spectrogram.get_frame_count(1249) == 1);
+		REQUIRE(spectrogram.get_frame_count(1250) == 2);
+		const auto result = spectrogram.compute(samples);
+		REQUIRE(result.frames == 197);
+		REQUIRE(result.bins == 501);
+		REQUIRE(result.data.size() == result.frames * result.bins);
+		REQUIRE(result.frames_per_second() > 0.0);
+
+		// Same frames as from STFT, which produces a frame for every hop of samples
+		STFT stft(1000, 250);
+		std::vector<std::vector<float>> frames;
+		stft.set_callback([&frames](const float* magnitudes, size_t bins){ frames.emplace_back(magnitudes, magnitudes + bins); });
+		stft.push(samples.data(), samples.size());
+		// The first three STFT frames start before the first sample
+		REQUIRE(frames.size() == result.frames + 3);
+		double error = 0.0;
+		for (size_t i = 0; i < result.frames; ++i) {
+			const auto frame = result.frame(i);
+			for (size_t k = 0; k < result.bins; ++k) error = std::max<double>(error, std::abs(frame[k] - frames[i + 3][k]));
+		}
+		REQUIRE(error < 1e-5);
+		// 10000 / 32768 / 2 of a sine wave, averaged with the right channel, at bin 20
+		const auto frame = result.frame(10);
+		REQUIRE(std::max_element(frame.begin(), frame.end()) - frame.begin() == 20);
+		REQUIRE(frame[20] == Approx(10000.0 / 32768.0 / 2.0).epsilon(0.02));
+	}
+	SECTION("threads") {
+		// Results don't depend on number of threads, the output memory is reused
+		const auto expected = Spectrogram(spectrogram_params_t(512, 100, window_type_t::blackman, 1)).compute(samples);
+		spectrogram_t result;
+		for (size_t threads = 2; threads <= 8; threads *= 2) {
+			Spectrogram(spectrogram_params_t(512, 100, window_type_t::blackman, threads)).compute(samples, result);
+			REQUIRE(result.frames == expected.frames);
+			REQUIRE(result.data == expected.data);
+		}
+		const auto* data = result.data.data();
+		Spectrogram(spectrogram_params_t(512, 100, window_type_t::blackman, 5)).compute(samples, result);
+		REQUIRE(result.data.data() == data);
+		// Too short input
+		Spectrogram(spectrogram_params_t(512, 100)).compute(array_view_t<const audio_sample_t>(samples.data(), 500), result);
+		REQUIRE(result.frames == 0);
+		REQUIRE(result.data.empty());
+	}
+	SECTION("file") {
+		// Long enough for several segments
+		const auto long_samples = make_noise(Spectrogram::segment_samples * 2 + 12345);
+		{
+			WaveFile wav(spectrogram_file, audio_params_t(sampling_rate_t::rate_44kHz));
+			wav.store_data(long_samples);
+		}
+		Spectrogram spectrogram(spectrogram_params_t(4410, 1000, window_type_t::hann, 4));
+		const auto expected = spectrogram.compute(long_samples);
+		WaveFile wav(spectrogram_file);
+		const auto result = spectrogram.compute(wav);
+		REQUIRE(result.frames == expected.frames);
+		REQUIRE(result.frames == spectrogram.get_frame_count(long_samples.size()));
+		REQUIRE(result.data == expected.data);
+		// Hop larger than the frame, so some samples between the segments aren't used by any frame
+		Spectrogram sparse(spectrogram_params_t(256, 1024));
+		const auto sparse_expected = sparse.compute(long_samples);
+		WaveFile sparse_wav(spectrogram_file);
+		const auto sparse_result = sparse.compute(sparse_wav);
+		REQUIRE(sparse_result.frames == sparse.get_frame_count(long_samples.size()));
+		REQUIRE(sparse_result.data == sparse_expected.data);
+		std::remove(spectrogram_file);
+	}
+}
+
+}
@@ -0,0 +1,82 @@
+/**
+ * @file 	test_spectrum_kernels.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/SpectrumKernels.h"
+#include <cmath>
+#include <random>
+
+namespace iimavlib {
+
+TEST_CASE("Spectrum kernels") {
+	std::mt19937 generator(5);
+	std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+	// Size not divisible by the vector width, values over a wide range (including zero)
+	const size_t bins = 1027;
+	std::vector<std::complex<float>> spectrum(bins);
+	std::vector<float> real(bins), imag(bins);
+	for (size_t i = 0; i < bins; ++i) {
+		const float magnitude = std::pow(10.0f, static_cast<float>(i % 97) / 8.0f - 8.0f);
+		spectrum[i] = std::complex<float>(distribution(generator), distribution(generator)) * magnitude;
+		real[i] = spectrum[i].real();
+		imag[i] = spectrum[i].imag();
+	}
+	spectrum[3] = 0.0f;
+	real[3] = imag[3] = 0.0f;
+	const float scale = 0.25f;
+	std::vector<float> output(bins), split(bins);
+
+	SECTION("magnitudes and powers") {
+		spectrum_magnitudes(spectrum.data(), output.data(), bins, scale);
+		spectrum_magnitudes(real.data(), imag.data(), split.data(), bins, scale);
+		for (size_t i = 0; i < bins; ++i) {
+			REQUIRE(output[i] == Approx(std::abs(spectrum[i]) * scale));
+			REQUIRE(split[i] == output[i]);
+		}
+		spectrum_powers(spectrum.data(), output.data(), bins, scale);
+		spectrum_powers(real.data(), imag.data(), split.data(), bins, scale);
+		for (size_t i = 0; i < bins; ++i) {
+			REQUIRE(output[i] == Approx(std::norm(spectrum[i] * scale)));
+			REQUIRE(split[i] == output[i]);
+		}
+	}
+	SECTION("decibels") {
+		const float floor_db = -90.0f;
+		spectrum_decibels(spectrum.data(), output.data(), bins, scale, floor_db);
+		spectrum_decibels(real.data(), imag.data(), split.data(), bins, scale, floor_db);
+		std::vector<float> magnitudes(bins);
+		spectrum_magnitudes(spectrum.data(), magnitudes.data(), bins, scale);
+		magnitudes_to_decibels(magnitudes.data(), magnitudes.data(), bins, floor_db);
+		for (size_t i = 0; i < bins; ++i) {
+			const float expected = std::max(20.0f * std::log10(std::abs(spectrum[i]) * scale), floor_db);
+			REQUIRE(std::abs(output[i] - expected) < 1e-3f);
+			REQUIRE(split[i] == output[i]);
+			REQUIRE(std::abs(magnitudes[i] - expected) < 1e-3f);
+		}
+		REQUIRE(output[3] == floor_db);
+		// Floor below the range of float
+		spectrum_decibels(spectrum.data(), output.data(), bins, 1.0f, -1000.0f);
+		REQUIRE(std::isfinite(output[3]));
+		REQUIRE(output[3] < -370.0f);
+	}
+	SECTION("smoothing") {
+		SpectrumSmoother smoother(5, 0.5f, 0.25f, 1.0f);
+		smoother.update(std::vector<float>({0.0f, 10.0f, 20.0f, 30.0f, 40.0f}));
+		REQUIRE(smoother.get_values() == std::vector<float>({0.0f, 10.0f, 20.0f, 30.0f, 40.0f}));
+		smoother.update(std::vector<float>({8.0f, 2.0f, 20.0f, 34.0f, 0.0f}));
+		REQUIRE(smoother.get_values() == std::vector<float>({4.0f, 8.0f, 20.0f, 32.0f, 30.0f}));
+		REQUIRE(smoother.get_peaks() == std::vector<float>({8.0f, 9.0f, 20.0f, 34.0f, 39.0f}));
+		smoother.reset();
+		smoother.update(std::vector<float>(5, 1.0f));
+		REQUIRE(smoother.get_peaks() == std::vector<float>(5, 1.0f));
+		REQUIRE_THROWS((SpectrumSmoother{5, 0.0f}));
+		REQUIRE_THROWS((SpectrumSmoother{5, 1.0f, 1.5f}));
+		REQUIRE_THROWS((SpectrumSmoother{5, 1.0f, 0.5f, -1.0f}));
+	}
+}
+
+}
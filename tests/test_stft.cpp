@@ -0,0 +1,131 @@
+/**
+ * @file 	test_stft.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/STFT.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+namespace iimavlib {
+
+namespace {
+std::vector<audio_sample_t> make_sine(size_t count, double period, double amplitude)
+{
+	const double pi = 4.0 * std::atan(1.0);
+	std::vector<audio_sample_t> samples(count);
+	for (size_t i = 0; i < count; ++i) {
+		const auto value = static_cast<int16_t>(amplitude * std::sin(2.0 * pi * i / period));
+		samples[i] = audio_sample_t(value, value);
+	}
+	return samples;
+}
+}
+
+TEST_CASE("make_window") {
+	const auto rectangular = make_window<float>(window_type_t::rectangular, 64);
+	REQUIRE(std::accumulate(rectangular.begin(), rectangular.end(), 0.0f) == Approx(64.0f));
+	const auto hann = make_window<double>(window_type_t::hann, 64);
+	REQUIRE(hann[0] == Approx(0.0));
+	REQUIRE(hann[32] == Approx(1.0));
+	REQUIRE(std::accumulate(hann.begin(), hann.end(), 0.0) == Approx(32.0));
+	FFT<double> fft;
+	for (int k = 0; k < 64; ++k) REQUIRE(hann[k] == Approx(fft.hann(k, 64)));
+	const auto blackman = make_window<double>(window_type_t::blackman, 64);
+	REQUIRE(std::abs(blackman[0]) < 1e-12);
+	REQUIRE(blackman[32] == Approx(1.0));
+}
+
+TEST_CASE("STFT") {
+	REQUIRE_THROWS((STFT{101, 10}));
+	REQUIRE_THROWS((STFT{1, 1}));
+	REQUIRE_THROWS((STFT{64, 0}));
+
+	SECTION("hops") {
+		STFT stft(256, 64);
+		REQUIRE(stft.get_bins() == 129);
+		size_t callbacks = 0;
+		stft.set_callback([&callbacks](const float*, size_t bins){ REQUIRE(bins == 129); ++callbacks; });
+		std::vector<float> magnitudes;
+		REQUIRE_FALSE(stft.read_frame(magnitudes));
+		const auto samples = make_sine(1000, 16, 1000);
+		REQUIRE(stft.push(samples.data(), 63) == 0);
+		REQUIRE(stft.push(samples.data() + 63, 1) == 1);
+		REQUIRE(stft.read_frame(magnitudes));
+		REQUIRE(magnitudes.size() == 129);
+		REQUIRE_FALSE(stft.read_frame(magnitudes));
+		// Odd chunks, 576 samples make 9 more frames
+		size_t frames = 0;
+		for (size_t pos = 64; pos < 640; pos += 37) {
+			frames += stft.push(samples.data() + pos, std::min<size_t>(37, 640 - pos));
+		}
+		REQUIRE(frames == 9);
+		REQUIRE(stft.get_frame_count() == 10);
+		REQUIRE(callbacks == 10);
+		REQUIRE(stft.read_frame(magnitudes));
+		REQUIRE_FALSE(stft.read_frame(magnitudes));
+	}
+
+	SECTION("magnitudes") {
+		const window_type_t windows[] = {window_type_t::rectangular, window_type_t::hann,
+				window_type_t::hamming, window_type_t::blackman};
+		for (const auto window: windows) {
+			STFT stft(1024, 256, window);
+			// Frequency exactly at bin 64, with half of the full scale
+			const auto samples = make_sine(4096, 16, 16384);
+			REQUIRE(stft.push(samples.data(), samples.size()) == 16);
+			std::vector<float> magnitudes;
+			REQUIRE(stft.read_frame(magnitudes));
+			const auto peak = std::max_element(magnitudes.begin(), magnitudes.end());
+			REQUIRE(peak - magnitudes.begin() == 64);
+			REQUIRE(*peak == Approx(0.5f).epsilon(0.01));
+			REQUIRE(magnitudes[0] < 0.01f);
+		}
+	}
+	SECTION("constant") {
+		STFT stft(64, 64, window_type_t::rectangular);
+		const std::vector<audio_sample_t> samples(64, audio_sample_t(-32768, -32768));
+		REQUIRE(stft.push(samples.data(), samples.size()) == 1);
+		std::vector<float> magnitudes;
+		REQUIRE(stft.read_frame(magnitudes));
+		REQUIRE(magnitudes[0] == Approx(1.0f));
+		REQUIRE(magnitudes[1] < 1e-6f);
+	}
+}
+
+TEST_CASE("triple_buffer_t") {
+	triple_buffer_t<std::vector<uint32_t>> buffer(std::vector<uint32_t>(256, 0));
+	REQUIRE_FALSE(buffer.update());
+	std::atomic<bool> done(false);
+	std::thread writer([&](){
+		for (uint32_t value = 1; value <= 20000; ++value) {
+			auto& data = buffer.back();
+			std::fill(data.begin(), data.end(), value);
+			buffer.publish();
+		}
+		done = true;
+	});
+	uint32_t last = 0;
+	bool consistent = true;
+	while (true) {
+		const bool finished = done;
+		if (buffer.update()) {
+			const auto& data = buffer.front();
+			consistent = consistent && data.front() > last
+					&& std::all_of(data.begin(), data.end(), [&data](uint32_t v){ return v == data.front(); });
+			last = data.front();
+		} else if (finished) {
+			break;
+		}
+	}
+	writer.join();
+	REQUIRE(consistent);
+	REQUIRE(last == 20000);
+}
+
+}
@@ -0,0 +1,261 @@
+/**
+ * @file 	test_voiceengine.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/VoiceEngine.h"
+#include "iimavlib/WaveFile.h"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace iimavlib {
+namespace {
+
+const char* voice_file = "test_voice.wav";
+const size_t voice_length = 3000;
+const char* stream_file = "test_voice_stream.wav";
+const size_t stream_length = 40000;
+
+audio_sample_t voice_sample(size_t index)
+{
+	return audio_sample_t(static_cast<int16_t>(index % 1000), static_cast<int16_t>(-static_cast<int>(index % 700)));
+}
+
+audio_buffer_t make_buffer(size_t size)
+{
+	audio_buffer_t buffer;
+	buffer.params = audio_params_t(sampling_rate_t::rate_44kHz);
+	buffer.data.resize(size);
+	buffer.valid_samples = size;
+	return buffer;
+}
+}
+
+TEST_CASE("mpmc_queue_t") {
+	mpmc_queue_t<int> queue(5);
+	REQUIRE(queue.capacity() == 8);
+	int value = 0;
+	REQUIRE(!queue.pop(value));
+	for (int i = 0; i < 8; ++i) REQUIRE(queue.push(i));
+	REQUIRE(!queue.push(8));
+	for (int i = 0; i < 8; ++i) {
+		REQUIRE(queue.pop(value));
+		REQUIRE(value == i);
+	}
+	REQUIRE(!queue.pop(value));
+
+	// Several producers, every value has to arrive exactly once
+	const int producers = 4;
+	const int count = 10000;
+	mpmc_queue_t<int> shared(64);
+	std::vector<std::thread> threads;
+	for (int p = 0; p < producers; ++p) {
+		threads.emplace_back([&shared, p](){
+			for (int i = 0; i < count; ++i) {
+				while (!shared.push(p * count + i)) std::this_thread::yield();
+			}
+		});
+	}
+	std::vector<int> received(producers * count, 0);
+	int total = 0;
+	while (total < producers * count) {
+		if (shared.pop(value)) {
+			received[value]++;
+			total++;
+		}
+	}
+	for (auto& t: threads) t.join();
+	REQUIRE(std::count(received.begin(), received.end(), 1) == producers * count);
+}
+
+TEST_CASE("VoiceEngine") {
+	{
+		WaveFile wav(voice_file, audio_params_t(sampling_rate_t::rate_44kHz));
+		std::vector<audio_sample_t> samples(voice_length);
+		for (size_t i = 0; i < voice_length; ++i) samples[i] = voice_sample(i);
+		wav.store_data(samples);
+		WaveFile stream_wav(stream_file, audio_params_t(sampling_rate_t::rate_44kHz));
+		samples.resize(stream_length);
+		for (size_t i = 0; i < stream_length; ++i) samples[i] = voice_sample(i);
+		stream_wav.store_data(samples);
+	}
+	SampleBank bank;
+	auto sample = bank.load(voice_file);
+
+	SECTION("playback") {
+		VoiceEngine engine(pAudioFilter(), 4, 2);
+		REQUIRE(engine.set_sample(0, sample) == error_type_t::ok);
+		REQUIRE(engine.set_sample(2, sample) == error_type_t::invalid);
+		REQUIRE(engine.trigger(0) != 0);
+		audio_buffer_t buffer = make_buffer(1000);
+		size_t played = 0;
+		for (int block = 0; block < 4; ++block) {
+			REQUIRE(engine.process(buffer) == error_type_t::ok);
+			for (size_t i = 0; i < buffer.valid_samples; ++i, ++played) {
+				const audio_sample_t expected = played < voice_length ? voice_sample(played) : audio_sample_t();
+				REQUIRE(buffer.data[i].left == expected.left);
+				REQUIRE(buffer.data[i].right == expected.right);
+			}
+		}
+		REQUIRE(engine.get_stats().active_voices == 0);
+		REQUIRE(engine.get_stats().peak_voices == 1);
+	}
+	SECTION("gain, pan and pitch") {
+		VoiceEngine engine(pAudioFilter(), 4, 1);
+		engine.set_sample(0, sample);
+		engine.trigger(0, 0.5f, -1.0f);
+		engine.trigger(0, 1.0f, 0.0f, 2.0f);
+		audio_buffer_t buffer = make_buffer(2000);
+		engine.process(buffer);
+		for (size_t i = 0; i < 1499; ++i) {
+			const audio_sample_t a = voice_sample(i);
+			const audio_sample_t b = voice_sample(2 * i);
+			REQUIRE(std::abs(buffer.data[i].left - (a.left / 2.0 + b.left)) <= 1.0);
+			REQUIRE(buffer.data[i].right == b.right);
+		}
+		// The second voice reached the end of the sample
+		REQUIRE(buffer.data[1600].right == 0);
+	}
+	SECTION("mixing with child and saturation") {
+		class constant_filter: public AudioFilter {
+		public:
+			constant_filter():AudioFilter(pAudioFilter()) {}
+		private:
+			error_type_t do_process(audio_buffer_t& buffer) {
+				for (auto& s: buffer.data) s = audio_sample_t(32000, 100);
+				return error_type_t::ok;
+			}
+		};
+		VoiceEngine engine(std::make_shared<constant_filter>(), 4, 1);
+		engine.set_sample(0, sample);
+		engine.trigger(0);
+		audio_buffer_t buffer = make_buffer(1000);
+		engine.process(buffer);
+		REQUIRE(buffer.data[0].left == 32000);
+		REQUIRE(buffer.data[999].left == 32767);
+		REQUIRE(buffer.data[5].right == 100 + voice_sample(5).right);
+	}
+	SECTION("release") {
+		VoiceEngine engine(pAudioFilter(), 4, 1);
+		engine.set_sample(0, sample);
+		const voice_id_t id = engine.trigger(0);
+		audio_buffer_t buffer = make_buffer(256);
+		engine.process(buffer);
+		REQUIRE(engine.get_stats().active_voices == 1);
+		REQUIRE(engine.release(id));
+		engine.process(buffer);
+		// Fade out over the block
+		REQUIRE(std::abs(buffer.data[255].left) < std::abs(voice_sample(511).left) / 100 + 1);
+		REQUIRE(engine.get_stats().active_voices == 0);
+		engine.process(buffer);
+		REQUIRE(buffer.data[0].left == 0);
+	}
+	SECTION("stealing") {
+		VoiceEngine engine(pAudioFilter(), 2, 1);
+		engine.set_sample(0, sample);
+		audio_buffer_t buffer = make_buffer(64);
+		for (int i = 0; i < 3; ++i) engine.trigger(0);
+		engine.process(buffer);
+		REQUIRE(engine.get_stats().active_voices == 2);
+		REQUIRE(engine.get_stats().stolen_voices == 1);
+
+		engine.set_steal_policy(steal_policy_t::none);
+		engine.trigger(0);
+		engine.process(buffer);
+		REQUIRE(engine.get_stats().rejected_voices == 1);
+		REQUIRE(engine.get_stats().active_voices == 2);
+
+		// Released voices can be replaced even without stealing
+		engine.release_all();
+		engine.trigger(0);
+		engine.process(buffer);
+		REQUIRE(engine.get_stats().rejected_voices == 1);
+		REQUIRE(engine.get_stats().active_voices == 1);
+	}
+	SECTION("event queue overflow") {
+		VoiceEngine engine(pAudioFilter(), 4, 1);
+		const size_t queue_size = VoiceEngine::event_queue_size;
+		size_t accepted = 0;
+		for (size_t i = 0; i < queue_size + 10; ++i) {
+			if (engine.trigger(0)) accepted++;
+		}
+		REQUIRE(accepted == queue_size);
+		REQUIRE(engine.get_stats().dropped_events == 10);
+	}
+	SECTION("streaming") {
+		// 0.05s (2205 samples) preloaded, rest streamed
+		auto streamed = bank.load(stream_file, 0.05);
+		REQUIRE(streamed->streamed());
+		VoiceEngine engine(pAudioFilter(), 4, 1);
+		REQUIRE(engine.enable_streaming(1, 0.2) == error_type_t::ok);
+		REQUIRE(engine.enable_streaming(1, 0.2) == error_type_t::busy);
+		engine.set_sample(0, streamed);
+		audio_buffer_t buffer = make_buffer(1000);
+		// The same sample is played twice, so the stream is reused after the first voice ends
+		for (int repeat = 0; repeat < 2; ++repeat) {
+			engine.trigger(0);
+			size_t played = 0;
+			while (played < stream_length + 1000) {
+				REQUIRE(engine.process(buffer) == error_type_t::ok);
+				for (size_t i = 0; i < buffer.valid_samples; ++i, ++played) {
+					const audio_sample_t expected = played < stream_length ? voice_sample(played) : audio_sample_t();
+					if (buffer.data[i].left != expected.left || buffer.data[i].right != expected.right) {
+						FAIL("Wrong sample at " << played);
+					}
+				}
+				// Gives the prefetch thread time to fill the ring
+				std::this_thread::sleep_for(std::chrono::milliseconds(3));
+			}
+			REQUIRE(engine.get_stats().active_voices == 0);
+		}
+		// Only one stream, so the second voice plays just the preloaded part
+		engine.trigger(0);
+		engine.trigger(0, 1.0f, 0.0f, 1.5f);
+		for (int i = 0; i < 20; ++i) {
+			engine.process(buffer);
+			std::this_thread::sleep_for(std::chrono::milliseconds(3));
+		}
+		const voice_stats_t stats = engine.get_stats();
+		REQUIRE(stats.stream_failures == 1);
+		REQUIRE(stats.active_voices == 1);
+		REQUIRE(stats.active_streams == 1);
+		REQUIRE(stats.starved_blocks == 0);
+		REQUIRE(stats.starved_samples == 0);
+	}
+	SECTION("starved stream") {
+		// Blocks processed without waiting, so the voice runs out of the preloaded part before the prefetch thread fills the ring
+		auto streamed = bank.load(stream_file, 0.05);
+		VoiceEngine engine(pAudioFilter(), 4, 1);
+		REQUIRE(engine.enable_streaming(1, 0.2) == error_type_t::ok);
+		engine.set_sample(0, streamed);
+		// Blocks are rendered in parts of block_size samples, so a single part per block
+		audio_buffer_t buffer = make_buffer(VoiceEngine::block_size);
+		engine.trigger(0);
+		size_t played = 0;
+		uint64_t starved = 0;
+		for (size_t block = 0; played < stream_length && block < 1000000; ++block) {
+			REQUIRE(engine.process(buffer) == error_type_t::ok);
+			// The voice waits while starving, so the end of the block is silent and the next one continues with the following sample
+			const uint64_t silent = engine.get_stats().starved_samples - starved;
+			starved += silent;
+			const size_t valid = buffer.valid_samples - static_cast<size_t>(silent);
+			for (size_t i = 0; i < buffer.valid_samples; ++i) {
+				const audio_sample_t expected = i < valid && played < stream_length ? voice_sample(played++) : audio_sample_t();
+				if (buffer.data[i].left != expected.left || buffer.data[i].right != expected.right) {
+					FAIL("Wrong sample at " << played << " in block " << block);
+				}
+			}
+		}
+		REQUIRE(played == stream_length);
+		REQUIRE(engine.get_stats().starved_blocks > 0);
+	}
+	sample.reset();
+	std::remove(voice_file);
+	std::remove(stream_file);
+}
+
+}
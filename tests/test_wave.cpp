@@ -0,0 +1,426 @@
+/*!
+ * @file 		test_wave.cpp
+ * @copyright	Institute of Intermedia, CTU in Prague, 2013
+ * 				Distributed under BSD Licence, details in file doc/LICENSE
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/WaveFile.h"
+#include "iimavlib/WaveSource.h"
+#include "iimavlib/MappedWaveFile.h"
+#include "iimavlib/WaveRecorder.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+namespace iimavlib {
+namespace {
+const std::string test_file = "test_wave_tmp.wav";
+
+std::vector<audio_sample_t> make_samples(size_t count)
+{
+	std::vector<audio_sample_t> samples(count);
+	for (size_t i = 0; i < count; ++i) {
+		samples[i] = audio_sample_t(static_cast<int16_t>(i), static_cast<int16_t>(-static_cast<int>(i)));
+	}
+	return samples;
+}
+
+bool equal_samples(const audio_sample_t& a, const audio_sample_t& b)
+{
+	return a.left == b.left && a.right == b.right;
+}
+
+void put_le(std::vector<uint8_t>& out, uint32_t value, int bytes)
+{
+	for (int i = 0; i < bytes; ++i) out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void put_id(std::vector<uint8_t>& out, const char* id)
+{
+	out.insert(out.end(), id, id + 4);
+}
+
+/*
+ * Builds a WAV file with a LIST chunk before the fmt chunk and a fact chunk before data
+ */
+std::vector<uint8_t> build_wav(uint16_t tag, uint16_t channels, uint16_t bits, const std::vector<uint8_t>& payload, bool extensible)
+{
+	std::vector<uint8_t> fmt;
+	put_le(fmt, extensible?0xFFFE:tag, 2);
+	put_le(fmt, channels, 2);
+	put_le(fmt, 44100, 4);
+	put_le(fmt, 44100 * channels * bits / 8, 4);
+	put_le(fmt, channels * bits / 8, 2);
+	put_le(fmt, bits, 2);
+	if (extensible) {
+		put_le(fmt, 22, 2);
+		put_le(fmt, bits, 2);
+		put_le(fmt, 3, 4);
+		put_le(fmt, tag, 2);
+		const uint8_t guid[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+		fmt.insert(fmt.end(), guid, guid + 14);
+	}
+	std::vector<uint8_t> body;
+	put_id(body, "WAVE");
+	put_id(body, "LIST");
+	put_le(body, 5, 4);
+	put_id(body, "INFO");
+	body.push_back(0); body.push_back(0); // odd sized chunk with padding
+	put_id(body, "fmt ");
+	put_le(body, static_cast<uint32_t>(fmt.size()), 4);
+	body.insert(body.end(), fmt.begin(), fmt.end());
+	put_id(body, "fact");
+	put_le(body, 4, 4);
+	put_le(body, static_cast<uint32_t>(payload.size() / (channels * bits / 8)), 4);
+	put_id(body, "data");
+	put_le(body, static_cast<uint32_t>(payload.size()), 4);
+	body.insert(body.end(), payload.begin(), payload.end());
+	std::vector<uint8_t> file;
+	put_id(file, "RIFF");
+	put_le(file, static_cast<uint32_t>(body.size()), 4);
+	file.insert(file.end(), body.begin(), body.end());
+	return file;
+}
+
+void write_file(const std::string& filename, const std::vector<uint8_t>& data)
+{
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(&data[0]), data.size());
+}
+
+/*
+ * Reads the file using both WaveFile and MappedWaveFile and compares the results
+ */
+std::vector<audio_sample_t> read_both(const std::string& filename, size_t expected_count)
+{
+	WaveFile wav(filename);
+	REQUIRE(wav.get_sample_count() == expected_count);
+	std::vector<audio_sample_t> data(expected_count + 5);
+	size_t count = data.size();
+	wav.read_data(data, count);
+	REQUIRE(count == expected_count);
+	data.resize(count);
+
+	MappedWaveFile mapped(filename);
+	REQUIRE(mapped.get_sample_count() == expected_count);
+	std::vector<audio_sample_t> mapped_data(expected_count);
+	REQUIRE(mapped.read_data(mapped_data, 0) == expected_count);
+	REQUIRE(std::equal(data.begin(), data.end(), mapped_data.begin(), equal_samples));
+	return data;
+}
+
+uint64_t five_gb_marker()
+{
+	return 5 * 0x40000000ull;
+}
+
+std::vector<char> read_file(const std::string& filename)
+{
+	std::ifstream f(filename, std::ios::binary);
+	return std::vector<char>((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+}
+
+TEST_CASE("WaveFile writer") {
+	const auto samples = make_samples(5000);
+	const std::string copy_file = "test_wave_copy.wav";
+	SECTION("deferred header") {
+		{
+			WaveFile wav(test_file, audio_params_t(sampling_rate_t::rate_44kHz));
+			wav.set_buffer_size(8192);
+			wav.set_header_interval(0);
+			wav.store_data(samples);
+			REQUIRE(wav.get_sample_count() == samples.size());
+			// Everything but the unaligned tail is on the disk, but the header wasn't updated yet
+			const auto contents = read_file(test_file);
+			REQUIRE(contents.size() % WaveFile::write_alignment == 0);
+			REQUIRE(contents.size() > sizeof(wav_header_t));
+			wav_header_t header;
+			std::copy(contents.begin(), contents.begin() + sizeof(header), reinterpret_cast<char*>(&header));
+			REQUIRE(header.dataSize == 0);
+			// Simulate a crash by copying the file in current state
+			std::ofstream out(copy_file, std::ios::binary | std::ios::trunc);
+			out.write(&contents[0], contents.size());
+		}
+		WaveFile complete(test_file);
+		REQUIRE(complete.get_sample_count() == samples.size());
+		std::vector<audio_sample_t> data(samples.size() + 10);
+		size_t count = data.size();
+		complete.read_data(data, count);
+		REQUIRE(count == samples.size());
+		REQUIRE(std::equal(samples.begin(), samples.end(), data.begin(), equal_samples));
+
+		WaveFile recovered(copy_file);
+		const size_t expected = (read_file(copy_file).size() - sizeof(wav_header_t)) / 4;
+		REQUIRE(recovered.get_sample_count() == expected);
+		count = data.size();
+		recovered.read_data(data, count);
+		REQUIRE(count == expected);
+		REQUIRE(std::equal(samples.begin(), samples.begin() + count, data.begin(), equal_samples));
+	}
+	SECTION("periodic header") {
+		WaveFile wav(test_file, audio_params_t(sampling_rate_t::rate_44kHz));
+		wav.set_buffer_size(0);
+		wav.set_header_interval(1);
+		wav.store_data(samples, 100);
+		const auto contents = read_file(test_file);
+		REQUIRE(contents.size() == sizeof(wav_header_t) + 400);
+		wav_header_t header;
+		std::copy(contents.begin(), contents.begin() + sizeof(header), reinterpret_cast<char*>(&header));
+		REQUIRE(header.dataSize == 400);
+		REQUIRE(header.cSize == sizeof(wav_header_t) - 8 + 400);
+	}
+	std::remove(test_file.c_str());
+	std::remove(copy_file.c_str());
+}
+
+TEST_CASE("WAV formats") {
+	// Values chosen to cover rounding, both extremes and the sign
+	const std::vector<int16_t> expected = {0, 1, -1, 32767, -32768, 12345, -12345, 256, -256, 100,
+											7, -7, 1000, -1000, 20000, -20000, 3, -3, 42};
+	const size_t count = expected.size();
+	SECTION("24bit extensible stereo") {
+		std::vector<uint8_t> payload;
+		for (auto v: expected) put_le(payload, static_cast<uint32_t>(v * 256 + 0x7F), 3);
+		payload.resize(payload.size() - 3); // odd number of values, drop the last one
+		write_file(test_file, build_wav(1, 2, 24, payload, true));
+		auto data = read_both(test_file, count / 2);
+		for (size_t i = 0; i < count / 2; ++i) {
+			REQUIRE(data[i].left == expected[2 * i]);
+			REQUIRE(data[i].right == expected[2 * i + 1]);
+		}
+	}
+	SECTION("32bit mono") {
+		std::vector<uint8_t> payload;
+		for (auto v: expected) put_le(payload, static_cast<uint32_t>(v * 65536 + 0x1234), 4);
+		write_file(test_file, build_wav(1, 1, 32, payload, false));
+		auto data = read_both(test_file, count);
+		for (size_t i = 0; i < count; ++i) {
+			REQUIRE(data[i].left == expected[i]);
+			REQUIRE(data[i].right == expected[i]);
+		}
+	}
+	SECTION("float mono") {
+		std::vector<uint8_t> payload;
+		auto put_float = [&payload](float f) {
+			uint32_t bits;
+			std::memcpy(&bits, &f, sizeof(bits));
+			put_le(payload, bits, 4);
+		};
+		// Values out of range have to be clamped, both by the vectorized code (at the beginning) and the scalar one (at the end)
+		const float extremes[] = {1.5f, -1.5f, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+		const int16_t clamped[] = {32767, -32768, 32767, -32768};
+		for (auto f: extremes) put_float(f);
+		for (auto v: expected) put_float(v / 32767.0f);
+		for (auto f: extremes) put_float(f);
+		write_file(test_file, build_wav(3, 1, 32, payload, false));
+		auto data = read_both(test_file, count + 8);
+		for (size_t i = 0; i < count; ++i) {
+			// -32768 can't be represented exactly as v/32767
+			REQUIRE(std::abs(data[i + 4].left - expected[i]) <= 1);
+		}
+		for (size_t i = 0; i < 4; ++i) {
+			REQUIRE(data[i].left == clamped[i]);
+			REQUIRE(data[count + 4 + i].left == clamped[i]);
+		}
+	}
+	SECTION("8bit 4 channels") {
+		std::vector<uint8_t> payload;
+		for (int i = 0; i < 40; ++i) payload.push_back(static_cast<uint8_t>(i * 6));
+		write_file(test_file, build_wav(1, 4, 8, payload, false));
+		auto data = read_both(test_file, 10);
+		for (size_t i = 0; i < 10; ++i) {
+			REQUIRE(data[i].left == (static_cast<int>(payload[4 * i]) - 128) * 256);
+			REQUIRE(data[i].right == (static_cast<int>(payload[4 * i + 1]) - 128) * 256);
+		}
+	}
+	SECTION("16bit with extra chunks") {
+		std::vector<uint8_t> payload;
+		for (auto v: expected) put_le(payload, static_cast<uint16_t>(v), 2);
+		payload.resize(payload.size() - 2);
+		write_file(test_file, build_wav(1, 2, 16, payload, false));
+		auto data = read_both(test_file, count / 2);
+		REQUIRE(data[1].left == expected[2]);
+		MappedWaveFile mapped(test_file);
+		REQUIRE(mapped.has_native_format());
+		REQUIRE(mapped.get_samples()[1].right == expected[3]);
+	}
+	SECTION("unsupported") {
+		std::vector<uint8_t> payload(16);
+		write_file(test_file, build_wav(3, 2, 64, payload, false));
+		REQUIRE_THROWS(WaveFile{test_file});
+		REQUIRE_THROWS(MappedWaveFile{test_file});
+	}
+	std::remove(test_file.c_str());
+}
+
+TEST_CASE("RF64") {
+	const uint64_t four_gb = 0x100000000ull;
+	SECTION("header upgrade") {
+		wav_header_t header;
+		REQUIRE(!header.is_rf64());
+		header.add_size(four_gb - sizeof(wav_header_t));
+		REQUIRE(!header.is_rf64());
+		REQUIRE(header.cSize == 0xFFFFFFF8u);
+		header.add_size(8);
+		REQUIRE(header.is_rf64());
+		REQUIRE(header.cSize == 0xFFFFFFFFu);
+		REQUIRE(header.dataSize == 0xFFFFFFFFu);
+		REQUIRE(header.data_size() == four_gb - sizeof(wav_header_t) + 8);
+		REQUIRE(header.riffSize64 == four_gb);
+		REQUIRE(header.sampleCount64 == header.data_size() / 4);
+		REQUIRE(std::equal(header.ds64ID, header.ds64ID + 4, "ds64"));
+		// The header keeps its size, so it can be rewritten in place
+		header.add_size(4);
+		REQUIRE(header.data_size() == four_gb - sizeof(wav_header_t) + 12);
+	}
+	SECTION("parse large file") {
+		wav_header_t header;
+		const uint64_t data_size = 6 * four_gb;
+		header.add_size(data_size);
+		std::string contents(reinterpret_cast<const char*>(&header), sizeof(header));
+		std::istringstream stream(contents);
+		// Only the header is needed for parsing, so the size of the file can be faked
+		const auto info = parse_wav_header(stream, sizeof(header) + data_size);
+		REQUIRE(info.data_size == data_size);
+		REQUIRE(info.frames() == data_size / 4);
+		REQUIRE(info.data_offset == sizeof(header));
+		REQUIRE(!info.recovered);
+	}
+	SECTION("read") {
+		const auto samples = make_samples(1000);
+		wav_header_t header;
+		header.add_size(five_gb_marker());
+		header.riffSize64 = sizeof(header) - 8 + 4000 + 12;
+		header.dataSize64 = 4000;
+		{
+			std::ofstream out(test_file, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(&samples[0]), 4000);
+			// Trailing chunk after the data
+			out.write("LIST\x04\x00\x00\x00INFO", 12);
+		}
+		auto data = read_both(test_file, 1000);
+		REQUIRE(std::equal(samples.begin(), samples.end(), data.begin(), equal_samples));
+		std::remove(test_file.c_str());
+	}
+}
+
+TEST_CASE("MappedWaveFile") {
+	const auto samples = make_samples(3000);
+	{
+		WaveFile wav(test_file, audio_params_t(sampling_rate_t::rate_48kHz));
+		wav.store_data(samples, 1000);
+		std::vector<audio_sample_t> rest(samples.begin() + 1000, samples.end());
+		wav.store_data(rest);
+	}
+
+	SECTION("view") {
+		MappedWaveFile mapped(test_file, access_hint_t::sequential);
+		REQUIRE(mapped.get_params().rate == sampling_rate_t::rate_48kHz);
+		REQUIRE(mapped.get_channels() == 2);
+		REQUIRE(mapped.get_sample_count() == samples.size());
+		auto view = mapped.get_samples();
+		REQUIRE(view.size() == samples.size());
+		REQUIRE(std::equal(view.begin(), view.end(), samples.begin(), equal_samples));
+		REQUIRE(mapped.advise(access_hint_t::random, 100, 200) == error_type_t::ok);
+		auto sub = view.subview(2990, 100);
+		REQUIRE(sub.size() == 10);
+	}
+	SECTION("read") {
+		MappedWaveFile mapped(test_file);
+		std::vector<audio_sample_t> data(512);
+		REQUIRE(mapped.read_data(data, 2900) == 100);
+		REQUIRE(std::equal(data.begin(), data.begin() + 100, samples.begin() + 2900, equal_samples));
+		REQUIRE(mapped.read_data(data, 3000) == 0);
+	}
+	SECTION("source") {
+		WaveSource source(test_file, access_hint_t::sequential);
+		auto view = source.get_view(512);
+		REQUIRE(view.size() == 512);
+		REQUIRE(equal_samples(view[511], samples[511]));
+		audio_buffer_t buffer;
+		buffer.data.resize(512);
+		buffer.valid_samples = 512;
+		REQUIRE(source.process(buffer) == error_type_t::ok);
+		REQUIRE(equal_samples(buffer.data[0], samples[512]));
+		REQUIRE(source.seek(2800) == error_type_t::ok);
+		buffer.valid_samples = 512;
+		REQUIRE(source.process(buffer) == error_type_t::ok);
+		REQUIRE(buffer.valid_samples == 200);
+		buffer.valid_samples = 512;
+		REQUIRE(source.process(buffer) == error_type_t::failed);
+	}
+	SECTION("truncated") {
+		{
+			std::fstream f(test_file, std::ios::in | std::ios::out | std::ios::binary);
+			std::vector<char> contents((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+			f.close();
+			std::ofstream out(test_file, std::ios::binary | std::ios::trunc);
+			out.write(&contents[0], sizeof(wav_header_t) + 1000 * 4 + 2);
+		}
+		MappedWaveFile mapped(test_file);
+		REQUIRE(mapped.get_sample_count() == 1000);
+	}
+	std::remove(test_file.c_str());
+	SECTION("missing") {
+		REQUIRE_THROWS(MappedWaveFile("nonexistent_file.wav"));
+	}
+}
+
+TEST_CASE("spsc_ring_t") {
+	spsc_ring_t<int> ring(100);
+	REQUIRE(ring.capacity() == 128);
+	std::vector<int> in(100), out(128);
+	for (size_t i = 0; i < in.size(); ++i) in[i] = static_cast<int>(i);
+	REQUIRE(ring.push(&in[0], 100));
+	REQUIRE(!ring.push(&in[0], 29));
+	REQUIRE(ring.pop(&out[0], 60) == 60);
+	// Wraps around the end of the storage
+	REQUIRE(ring.push(&in[0], 80));
+	REQUIRE(ring.size() == 120);
+	REQUIRE(ring.pop(&out[0], 128) == 120);
+	REQUIRE(std::equal(out.begin(), out.begin() + 40, in.begin() + 60));
+	REQUIRE(std::equal(out.begin() + 40, out.begin() + 120, in.begin()));
+	REQUIRE(ring.pop(&out[0], 128) == 0);
+}
+
+TEST_CASE("WaveRecorder") {
+	const std::string record_file = "test_wave_rec.wav";
+	const auto samples = make_samples(20000);
+	{
+		WaveFile wav(test_file, audio_params_t(sampling_rate_t::rate_44kHz));
+		wav.store_data(samples);
+	}
+	{
+		auto source = std::make_shared<WaveSource>(test_file);
+		WaveRecorder recorder(source, record_file, 1.0, 1.0);
+		audio_buffer_t buffer;
+		buffer.data.resize(512);
+		do {
+			buffer.valid_samples = 512;
+		} while (recorder.process(buffer) == error_type_t::ok);
+		const recorder_stats_t stats = recorder.get_stats();
+		REQUIRE(stats.ring_size >= 44100);
+		REQUIRE(stats.dropped_blocks == 0);
+		REQUIRE(stats.high_water >= 512);
+	}
+	WaveFile recorded(record_file);
+	REQUIRE(recorded.get_params().rate == sampling_rate_t::rate_44kHz);
+	REQUIRE(recorded.get_sample_count() == samples.size());
+	// Reserved space has to be released when the file is closed
+	REQUIRE(read_file(record_file).size() == sizeof(wav_header_t) + samples.size() * 4);
+	std::vector<audio_sample_t> data(samples.size());
+	size_t count = data.size();
+	REQUIRE(recorded.read_data(data, count) == error_type_t::ok);
+	REQUIRE(count == samples.size());
+	REQUIRE(std::equal(data.begin(), data.end(), samples.begin(), equal_samples));
+	std::remove(test_file.c_str());
+	std::remove(record_file.c_str());
+}
+
+}
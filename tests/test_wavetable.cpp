@@ -0,0 +1,181 @@
+/**
+ * @file 	test_wavetable.cpp
+ *
+ * @copyright GNU Public License 3.0
+ *
+ */
+
+#include "iimavlib/catch/catch.hpp"
+#include "iimavlib/filters/WavetableOscillator.h"
+#include "iimavlib/FFT.h"
+#include "iimavlib/WaveFile.h"
+#include <cmath>
+#include <cstdio>
+
+namespace iimavlib {
+
+namespace {
+const double pi2 = 2.0 * 3.14159265358979323846;
+const char* wavetable_file = "test_wavetable.wav";
+
+/// Single period of a sawtooth rising from -1 to 1
+std::vector<float> sawtooth_period(size_t length)
+{
+	std::vector<float> period(length);
+	for (size_t i = 0; i < length; ++i) period[i] = static_cast<float>(2.0 * i / length - 1.0);
+	return period;
+}
+
+/// Runs the oscillator for @em count samples, returning the left channel
+std::vector<float> generate(WavetableOscillator& oscillator, size_t count)
+{
+	audio_buffer_t buffer;
+	buffer.params = audio_params_t(sampling_rate_t::rate_44kHz);
+	std::vector<float> output;
+	const size_t sizes[] = {512, 1, 77, 300};
+	for (size_t i = 0; output.size() < count; ++i) {
+		buffer.data.assign(std::min(sizes[i % 4], count - output.size()), audio_sample_t());
+		buffer.valid_samples = buffer.data.size();
+		REQUIRE(oscillator.process(buffer) == error_type_t::ok);
+		for (const auto& sample: buffer.data) {
+			REQUIRE(sample.left == sample.right);
+			output.push_back(sample.left);
+		}
+	}
+	return output;
+}
+
+/// Power of a signal at a frequency (in periods per sample)
+double power(const std::vector<float>& signal, double frequency)
+{
+	double re = 0.0, im = 0.0;
+	for (size_t i = 0; i < signal.size(); ++i) {
+		const double window = 0.5 - 0.5 * std::cos(pi2 * i / signal.size());
+		re += window * signal[i] * std::cos(pi2 * frequency * i);
+		im += window * signal[i] * std::sin(pi2 * frequency * i);
+	}
+	return re * re + im * im;
+}
+}
+
+TEST_CASE("Wavetable") {
+	const size_t size = Wavetable::table_size;
+	SECTION("levels") {
+		// Each level contains the harmonics of the sawtooth up to its limit, and nothing above it
+		Wavetable table(sawtooth_period(3000));
+		REQUIRE(table.levels() == 10);
+		fft_plan_t<float> plan(size);
+		std::vector<std::complex<float>> spectrum(size);
+		for (size_t level = 0; level < table.levels(); ++level) {
+			const float* values = table.get_level(level);
+			REQUIRE(values[size] == values[0]);
+			plan.transform(values, spectrum.data());
+			REQUIRE(std::abs(spectrum[0]) < 1e-2);
+			const size_t harmonics = Wavetable::max_harmonics >> level;
+			for (size_t h = 1; h < size / 2; ++h) {
+				const double magnitude = std::abs(spectrum[h]) / (size / 2);
+				if (h <= harmonics) {
+					// Harmonics of the sawtooth (sampled with 3000 points) have magnitude close to 2 / (pi * h)
+					REQUIRE(magnitude == Approx(2.0 / (pi2 / 2.0 * h)).epsilon(0.01));
+				} else {
+					REQUIRE(magnitude < 1e-5);
+				}
+			}
+		}
+	}
+	SECTION("short period") {
+		// A period of 8 samples has only 3 harmonics
+		Wavetable table(sawtooth_period(8));
+		fft_plan_t<float> plan(size);
+		std::vector<std::complex<float>> spectrum(size);
+		plan.transform(table.get_level(0), spectrum.data());
+		REQUIRE(std::abs(spectrum[3]) > 100.0);
+		for (size_t h = 4; h < size / 2; ++h) REQUIRE(std::abs(spectrum[h]) < 1e-2);
+	}
+	SECTION("invalid") {
+		REQUIRE_THROWS(Wavetable{std::vector<float>(1)});
+		REQUIRE_THROWS(Wavetable{std::string("nonexistent_wavetable.wav")});
+	}
+}
+
+TEST_CASE("WavetableOscillator") {
+	const double rate = 44100.0;
+	SECTION("sine") {
+		std::vector<float> period(1000);
+		for (size_t i = 0; i < period.size(); ++i) period[i] = static_cast<float>(std::sin(pi2 * i / period.size()));
+		auto table = std::make_shared<Wavetable>(period);
+		WavetableOscillator oscillator(pAudioFilter(), table, 3);
+		oscillator.set_voice(1, 440.0, 0.5f);
+		const auto output = generate(oscillator, 20000);
+		for (size_t i = 0; i < output.size(); ++i) {
+			REQUIRE(std::abs(output[i] - 0.5 * 32767.0 * std::sin(pi2 * std::fmod(440.0 * i / rate, 1.0))) < 2.0);
+		}
+	}
+	SECTION("aliasing") {
+		// Harmonics of 3 kHz above the Nyquist frequency are missing, not folded back
+		WavetableOscillator oscillator(pAudioFilter(), std::make_shared<Wavetable>(sawtooth_period(4096)), 1);
+		const double frequency = 3000.0;
+		oscillator.set_voice(0, frequency, 0.5f);
+		const auto output = generate(oscillator, 8820);
+		const double fundamental = power(output, frequency / rate);
+		REQUIRE(fundamental > 1e12);
+		for (size_t harmonic = 8; harmonic <= 30; ++harmonic) {
+			double folded = std::fmod(harmonic * frequency / rate, 1.0);
+			if (folded > 0.5) folded = 1.0 - folded;
+			REQUIRE(power(output, folded) < 1e-5 * fundamental);
+		}
+	}
+	SECTION("crossfade") {
+		// The fundamental has the same level at any pitch, as all the levels contain it
+		auto table = std::make_shared<Wavetable>(sawtooth_period(4096));
+		double reference = 0.0;
+		for (double frequency = 100.0; frequency < 5000.0; frequency *= 1.19) {
+			WavetableOscillator oscillator(pAudioFilter(), table, 1);
+			oscillator.set_voice(0, frequency, 0.25f);
+			const double level = power(generate(oscillator, 8820), frequency / rate);
+			if (reference == 0.0) reference = level;
+			REQUIRE(level == Approx(reference).epsilon(0.02));
+		}
+	}
+	SECTION("voices") {
+		// Voices are summed and added to the output of the child
+		auto table = std::make_shared<Wavetable>(sawtooth_period(500));
+		const size_t count = 11;
+		auto all = std::make_shared<WavetableOscillator>(pAudioFilter(), table, count);
+		for (size_t i = 0; i < count; ++i) all->set_voice(i, 55.0 * (i + 1) * 1.01, 0.05f);
+		const auto expected = generate(*all, 5000);
+
+		pAudioFilter chain;
+		for (size_t i = 0; i < count; ++i) {
+			auto single = std::make_shared<WavetableOscillator>(chain, table, 2);
+			single->set_voice(1, 55.0 * (i + 1) * 1.01, 0.05f);
+			chain = single;
+		}
+		const auto output = generate(*std::static_pointer_cast<WavetableOscillator>(chain), 5000);
+		// Each of the oscillators rounds its output to integers
+		for (size_t i = 0; i < output.size(); ++i) REQUIRE(std::abs(output[i] - expected[i]) <= count);
+
+		REQUIRE_THROWS(all->set_voice(count, 100.0, 1.0f));
+	}
+	SECTION("file") {
+		{
+			WaveFile wav(wavetable_file, audio_params_t(sampling_rate_t::rate_44kHz));
+			std::vector<audio_sample_t> samples(600);
+			for (size_t i = 0; i < samples.size(); ++i) {
+				samples[i].left = static_cast<int16_t>(16000.0 * std::sin(pi2 * i / samples.size()));
+				samples[i].right = 0;
+			}
+			wav.store_data(samples);
+		}
+		WavetableOscillator oscillator(pAudioFilter(), wavetable_file, 1);
+		oscillator.set_voice(0, 1000.0, 1.0f);
+		const auto output = generate(oscillator, 1000);
+		// Both the file and the output are rounded
+		for (size_t i = 0; i < output.size(); ++i) {
+			REQUIRE(std::abs(output[i] - 16000.0 * std::sin(pi2 * std::fmod(1000.0 * i / rate, 1.0))) < 3.0);
+		}
+		std::remove(wavetable_file);
+	}
+}
+
+}